@@ -0,0 +1,178 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+#include "allocations.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+/* A plain counter per thread, so counting never takes a lock */
+static thread_local Uint64 tAllocations = 0;
+
+/* What SDL allocated with before the hooks went in */
+static SDL_malloc_func sMalloc = NULL;
+static SDL_calloc_func sCalloc = NULL;
+static SDL_realloc_func sRealloc = NULL;
+static SDL_free_func sFree = NULL;
+
+static void* SDLCALL countedMalloc(size_t size)
+{
+	tAllocations++;
+	return sMalloc(size);
+}
+
+static void* SDLCALL countedCalloc(size_t count, size_t size)
+{
+	tAllocations++;
+	return sCalloc(count, size);
+}
+
+static void* SDLCALL countedRealloc(void* memory, size_t size)
+{
+	tAllocations++;
+	return sRealloc(memory, size);
+}
+
+bool installAllocationHooks()
+{
+	SDL_GetMemoryFunctions(&sMalloc, &sCalloc, &sRealloc, &sFree);
+	if (SDL_SetMemoryFunctions(countedMalloc, countedCalloc, countedRealloc, sFree) < 0)
+	{
+		printf("SDL's allocations will not be counted!\nSDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	return true;
+}
+
+Uint64 threadAllocations()
+{
+	return tAllocations;
+}
+
+/* Every new and new[] in the program comes through here */
+void* operator new(size_t size)
+{
+	tAllocations++;
+	void* memory = malloc(size ? size : 1);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	tAllocations++;
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+
+AllocationMeter::AllocationMeter(const char* name)
+{
+	mName = name;
+	for (int i = 0; i < MAX_PHASES; i++)
+	{
+		mPhaseNames[i] = NULL;
+		mWarmup[i] =
+			mSteady[i] = 0;
+	}
+	mPhases = 0;
+	mSteadyFrame = false;
+	mLast =
+		mFrameStart = 0;
+	mFrames =
+		mSteadyFrames =
+		mAllocatingFrames = 0;
+	mWorstFrame =
+		mSteadyTotal = 0;
+}
+
+void AllocationMeter::beginFrame(bool steady)
+{
+	mSteadyFrame = steady;
+	mLast =
+		mFrameStart = tAllocations;
+}
+
+void AllocationMeter::mark(int phase, const char* name)
+{
+	if ((phase < 0) || (phase >= MAX_PHASES))
+	{
+		return;
+	}
+	Uint64 now = tAllocations;
+	mPhaseNames[phase] = name;
+	mPhases = (phase + 1 > mPhases) ? phase + 1 : mPhases;
+	(mSteadyFrame ? mSteady : mWarmup)[phase] += now - mLast;
+	mLast = now;
+}
+
+void AllocationMeter::endFrame()
+{
+	mFrames++;
+	if (!mSteadyFrame)
+	{
+		return;
+	}
+	Uint64 allocations = tAllocations - mFrameStart;
+	mSteadyFrames++;
+	mSteadyTotal += allocations;
+	if (allocations)
+	{
+		mAllocatingFrames++;
+		mWorstFrame = (allocations > mWorstFrame) ? allocations : mWorstFrame;
+	}
+}
+
+void AllocationMeter::print()
+{
+	printf("%s allocations over %u frames, %u of them steady:\n", mName, mFrames, mSteadyFrames);
+	printf("  %-12s %10s %10s\n", "phase", "warm-up", "steady");
+	for (int i = 0; i < mPhases; i++)
+	{
+		printf("  %-12s %10llu %10llu\n", mPhaseNames[i] ? mPhaseNames[i] : "?",
+			(unsigned long long)mWarmup[i], (unsigned long long)mSteady[i]);
+	}
+	if (mAllocatingFrames)
+	{
+		printf("  %u steady frames allocated, %.2f a frame on average, %llu at most.\n", mAllocatingFrames,
+			mSteadyFrames ? (double)mSteadyTotal / mSteadyFrames : 0.0, (unsigned long long)mWorstFrame);
+	}
+	else
+	{
+		printf("  No steady frame allocated.\n");
+	}
+}
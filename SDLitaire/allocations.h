@@ -0,0 +1,59 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _ALLOCATIONS_H
+#define _ALLOCATIONS_H
+
+/*
+	Counts heap allocations on each thread. Every operator new in the program is counted,
+	and SDL's own allocations are too once installAllocationHooks has run.
+*/
+
+#include <SDL.h>
+
+/* Routes SDL_malloc, SDL_calloc and SDL_realloc through the counter. Call before SDL allocates anything. */
+bool installAllocationHooks();
+
+/* Allocations the calling thread has made so far */
+Uint64 threadAllocations();
+
+/* A loop's allocations, charged to its phases, with warm-up kept apart from steady state */
+class AllocationMeter
+{
+public:
+	static const int MAX_PHASES = 8;
+
+	AllocationMeter(const char* name);
+
+	/* Starts an iteration. Steady iterations are expected not to allocate at all. */
+	void beginFrame(bool steady);
+
+	/* Ends a phase. What the thread allocated since the last mark is charged to it. */
+	void mark(int phase, const char* name);
+
+	void endFrame();
+
+	Uint64 getSteadyAllocations() { return mSteadyTotal; }
+
+	/* Prints each phase, then the frames that allocated */
+	void print();
+
+private:
+	const char* mName;
+	const char* mPhaseNames[MAX_PHASES];
+	Uint64 mWarmup[MAX_PHASES], /* Per phase */
+		mSteady[MAX_PHASES];
+	int mPhases;
+
+	bool mSteadyFrame;
+	Uint64 mLast, /* Thread count at the last mark */
+		mFrameStart;
+	Uint32 mFrames,
+		mSteadyFrames,
+		mAllocatingFrames; /* Steady frames that allocated */
+	Uint64 mWorstFrame, /* Most allocations in one steady frame */
+		mSteadyTotal;
+};
+
+#endif /* _ALLOCATIONS_H */
@@ -0,0 +1,374 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+#include "cardpainter.h"
+#include <cmath>
+
+#define COLOR_PAPER 0xFFFFFFFF
+#define COLOR_EDGE 0xFF808080
+#define COLOR_BLACK 0xFF202020
+#define COLOR_RED 0xFFC81E1E
+#define COLOR_COURT 0xFFF4E6B4 /* Behind the court figures */
+
+#define PEN_UP -1.0f /* Lifts the pen between strokes in a glyph */
+#define GLYPH_END -2.0f
+
+/*
+	Rank glyphs as strokes in a unit box, y down.
+	Pairs of points, with PEN_UP between strokes.
+*/
+const float glyphAce[] = { 0.0f, 1.0f, 0.5f, 0.0f, 1.0f, 1.0f, PEN_UP, 0.2f, 0.62f, 0.8f, 0.62f, GLYPH_END };
+const float glyph2[] = { 0.0f, 0.25f, 0.15f, 0.05f, 0.5f, 0.0f, 0.85f, 0.05f, 1.0f, 0.25f, 0.9f, 0.45f, 0.0f, 1.0f, 1.0f, 1.0f, GLYPH_END };
+const float glyph3[] = { 0.0f, 0.1f, 0.5f, 0.0f, 0.95f, 0.15f, 0.95f, 0.35f, 0.45f, 0.5f, 1.0f, 0.65f, 1.0f, 0.85f, 0.5f, 1.0f, 0.0f, 0.9f, GLYPH_END };
+const float glyph4[] = { 0.75f, 1.0f, 0.75f, 0.0f, 0.0f, 0.7f, 1.0f, 0.7f, GLYPH_END };
+const float glyph5[] = { 1.0f, 0.0f, 0.1f, 0.0f, 0.05f, 0.45f, 0.5f, 0.4f, 0.95f, 0.55f, 0.95f, 0.85f, 0.5f, 1.0f, 0.0f, 0.9f, GLYPH_END };
+const float glyph6[] = { 0.9f, 0.05f, 0.5f, 0.0f, 0.1f, 0.2f, 0.0f, 0.6f, 0.1f, 0.9f, 0.5f, 1.0f, 0.9f, 0.9f, 1.0f, 0.7f,
+	0.9f, 0.5f, 0.5f, 0.42f, 0.1f, 0.5f, 0.0f, 0.65f, GLYPH_END };
+const float glyph7[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.35f, 1.0f, GLYPH_END };
+const float glyph8[] = { 0.5f, 0.0f, 0.9f, 0.1f, 0.9f, 0.35f, 0.5f, 0.47f, 0.1f, 0.35f, 0.1f, 0.1f, 0.5f, 0.0f, PEN_UP,
+	0.5f, 0.47f, 0.95f, 0.6f, 0.95f, 0.88f, 0.5f, 1.0f, 0.05f, 0.88f, 0.05f, 0.6f, 0.5f, 0.47f, GLYPH_END };
+const float glyph9[] = { 0.1f, 0.95f, 0.5f, 1.0f, 0.9f, 0.8f, 1.0f, 0.4f, 0.9f, 0.1f, 0.5f, 0.0f, 0.1f, 0.1f, 0.0f, 0.3f,
+	0.1f, 0.5f, 0.5f, 0.58f, 0.9f, 0.5f, 1.0f, 0.35f, GLYPH_END };
+const float glyph10[] = { 0.0f, 0.2f, 0.2f, 0.0f, 0.2f, 1.0f, PEN_UP,
+	0.7f, 0.0f, 0.95f, 0.15f, 1.0f, 0.5f, 0.95f, 0.85f, 0.7f, 1.0f, 0.45f, 0.85f, 0.4f, 0.5f, 0.45f, 0.15f, 0.7f, 0.0f, GLYPH_END };
+const float glyphJack[] = { 0.3f, 0.0f, 1.0f, 0.0f, PEN_UP, 0.75f, 0.0f, 0.75f, 0.75f, 0.6f, 0.95f, 0.35f, 1.0f, 0.1f, 0.9f, 0.0f, 0.7f, GLYPH_END };
+const float glyphQueen[] = { 0.5f, 0.0f, 0.9f, 0.15f, 1.0f, 0.5f, 0.9f, 0.85f, 0.5f, 1.0f, 0.1f, 0.85f, 0.0f, 0.5f, 0.1f, 0.15f, 0.5f, 0.0f, PEN_UP,
+	0.6f, 0.7f, 1.0f, 1.05f, GLYPH_END };
+const float glyphKing[] = { 0.05f, 0.0f, 0.05f, 1.0f, PEN_UP, 1.0f, 0.0f, 0.05f, 0.6f, PEN_UP, 0.35f, 0.4f, 1.0f, 1.0f, GLYPH_END };
+
+const float* glyphs[NUM_FACES + 1] = { NULL, glyphAce, glyph2, glyph3, glyph4, glyph5, glyph6, glyph7, glyph8, glyph9, glyph10,
+	glyphJack, glyphQueen, glyphKing };
+
+/* Where the pips go on the spot cards, in the pip area: x across the three columns, y down */
+struct pipSpot
+{
+	float x, y;
+};
+
+const pipSpot pips2[] = { { 0.5f, 0.0f }, { 0.5f, 1.0f } };
+const pipSpot pips3[] = { { 0.5f, 0.0f }, { 0.5f, 0.5f }, { 0.5f, 1.0f } };
+const pipSpot pips4[] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+const pipSpot pips5[] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.5f, 0.5f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+const pipSpot pips6[] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 0.5f }, { 1.0f, 0.5f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+const pipSpot pips7[] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.5f, 0.25f }, { 0.0f, 0.5f }, { 1.0f, 0.5f }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+const pipSpot pips8[] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.5f, 0.25f }, { 0.0f, 0.5f }, { 1.0f, 0.5f }, { 0.5f, 0.75f },
+	{ 0.0f, 1.0f }, { 1.0f, 1.0f } };
+const pipSpot pips9[] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f / 3 }, { 1.0f, 1.0f / 3 }, { 0.5f, 0.5f },
+	{ 0.0f, 2.0f / 3 }, { 1.0f, 2.0f / 3 }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+const pipSpot pips10[] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.5f, 1.0f / 6 }, { 0.0f, 1.0f / 3 }, { 1.0f, 1.0f / 3 },
+	{ 0.0f, 2.0f / 3 }, { 1.0f, 2.0f / 3 }, { 0.5f, 5.0f / 6 }, { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+
+const pipSpot* pipLayouts[11] = { NULL, NULL, pips2, pips3, pips4, pips5, pips6, pips7, pips8, pips9, pips10 };
+
+/*
+	A card's worth of pixels.
+	Shapes are given as signed distance functions: negative inside, positive outside, in pixels.
+*/
+struct canvas
+{
+	uint32_t* pixels;
+	int pitch, width, height;
+};
+
+/* Puts color over the pixel with the given coverage. color is opaque. */
+inline void blendPixel(uint32_t& pixel, uint32_t color, float coverage)
+{
+	if (coverage >= 1.0f)
+	{
+		pixel = color;
+		return;
+	}
+	uint32_t a = (uint32_t)(coverage * 256.0f);
+	uint32_t keep = 256 - a;
+	uint32_t rb = (((color & 0x00FF00FF) * a + (pixel & 0x00FF00FF) * keep) >> 8) & 0x00FF00FF;
+	uint32_t ag = ((((color >> 8) & 0x00FF00FF) * a + ((pixel >> 8) & 0x00FF00FF) * keep)) & 0xFF00FF00;
+	pixel = rb | ag;
+}
+
+/* Fills a shape, only visiting the pixels in its bounds */
+template <typename SHAPE>
+void fill(canvas& c, float left, float top, float right, float bottom, uint32_t color, const SHAPE& shape)
+{
+	int x0 = (int)floorf(left) - 1, y0 = (int)floorf(top) - 1;
+	int x1 = (int)ceilf(right) + 1, y1 = (int)ceilf(bottom) + 1;
+	x0 = x0 < 0 ? 0 : x0;
+	y0 = y0 < 0 ? 0 : y0;
+	x1 = x1 > c.width ? c.width : x1;
+	y1 = y1 > c.height ? c.height : y1;
+
+	for (int y = y0; y < y1; y++)
+	{
+		uint32_t* row = c.pixels + y * c.pitch;
+		float py = y + 0.5f;
+		for (int x = x0; x < x1; x++)
+		{
+			/* Half a pixel either side of the edge is blended */
+			float coverage = 0.5f - shape(x + 0.5f, py);
+			if (coverage > 0.0f)
+			{
+				blendPixel(row[x], color, coverage);
+			}
+		}
+	}
+}
+
+struct circleShape
+{
+	float cx, cy, r;
+	float operator()(float x, float y) const { return sqrtf((x - cx) * (x - cx) + (y - cy) * (y - cy)) - r; }
+};
+
+/* A line with round ends */
+struct capsuleShape
+{
+	float ax, ay, bx, by, r;
+	float operator()(float x, float y) const
+	{
+		float px = x - ax, py = y - ay;
+		float dx = bx - ax, dy = by - ay;
+		float length = dx * dx + dy * dy;
+		float t = length > 0.0f ? (px * dx + py * dy) / length : 0.0f;
+		t = t < 0.0f ? 0.0f : (t > 1.0f ? 1.0f : t);
+		px -= dx * t;
+		py -= dy * t;
+		return sqrtf(px * px + py * py) - r;
+	}
+};
+
+struct roundedBoxShape
+{
+	float cx, cy, halfW, halfH, r;
+	float operator()(float x, float y) const
+	{
+		float qx = fabsf(x - cx) - halfW + r;
+		float qy = fabsf(y - cy) - halfH + r;
+		float outX = qx > 0.0f ? qx : 0.0f;
+		float outY = qy > 0.0f ? qy : 0.0f;
+		float inside = qx > qy ? qx : qy;
+		return sqrtf(outX * outX + outY * outY) + (inside < 0.0f ? inside : 0.0f) - r;
+	}
+};
+
+/* Only close to exact near the edges, which is all the blending needs */
+struct diamondShape
+{
+	float cx, cy, halfW, halfH;
+	float operator()(float x, float y) const
+	{
+		float scale = halfW * halfH / sqrtf(halfW * halfW + halfH * halfH);
+		return (fabsf(x - cx) / halfW + fabsf(y - cy) / halfH - 1.0f) * scale;
+	}
+};
+
+struct triangleShape
+{
+	float ax, ay, bx, by, cx, cy;
+	float operator()(float x, float y) const
+	{
+		/* Distance to the nearest edge, negative when inside all three */
+		float e[3][4] = { { ax, ay, bx, by }, { bx, by, cx, cy }, { cx, cy, ax, ay } };
+		float area = (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+		float sign = area < 0.0f ? -1.0f : 1.0f;
+		float worst = -1e9f;
+		for (int i = 0; i < 3; i++)
+		{
+			float dx = e[i][2] - e[i][0], dy = e[i][3] - e[i][1];
+			float length = sqrtf(dx * dx + dy * dy);
+			float d = sign * (dx * (e[i][1] - y) - dy * (e[i][0] - x)) / length; /* Positive outside */
+			worst = d > worst ? d : worst;
+		}
+		return worst;
+	}
+};
+
+/*
+	Suit pips in a box of size s centred on (x, y).
+	Upside-down pips are mirrored top to bottom, the way the lower half of a card is printed.
+*/
+void paintPip(canvas& c, int suit, float x, float y, float s, bool upsideDown, uint32_t color)
+{
+	float f = upsideDown ? -1.0f : 1.0f; /* Flips offsets in y */
+	float h = s * 0.5f;
+
+	switch (suit)
+	{
+	case DIAMONDS:
+	{
+		diamondShape shape = { x, y, h * 0.75f, h };
+		fill(c, x - h, y - h, x + h, y + h, color, shape);
+		break;
+	}
+	case HEARTS:
+	{
+		float r = s * 0.27f;
+		circleShape left = { x - s * 0.23f, y - f * s * 0.17f, r };
+		circleShape right = { x + s * 0.23f, y - f * s * 0.17f, r };
+		triangleShape point = { x - s * 0.48f, y - f * s * 0.08f, x + s * 0.48f, y - f * s * 0.08f, x, y + f * s * 0.48f };
+		fill(c, x - h, y - h, x + h, y + h, color, left);
+		fill(c, x - h, y - h, x + h, y + h, color, right);
+		fill(c, x - h, y - h, x + h, y + h, color, point);
+		break;
+	}
+	case SPADES:
+	{
+		/* A heart standing on its point, with a stem */
+		float r = s * 0.24f;
+		circleShape left = { x - s * 0.22f, y + f * s * 0.12f, r };
+		circleShape right = { x + s * 0.22f, y + f * s * 0.12f, r };
+		triangleShape point = { x - s * 0.45f, y + f * s * 0.05f, x + s * 0.45f, y + f * s * 0.05f, x, y - f * s * 0.5f };
+		triangleShape stem = { x, y + f * s * 0.05f, x - s * 0.18f, y + f * s * 0.5f, x + s * 0.18f, y + f * s * 0.5f };
+		fill(c, x - h, y - h, x + h, y + h, color, left);
+		fill(c, x - h, y - h, x + h, y + h, color, right);
+		fill(c, x - h, y - h, x + h, y + h, color, point);
+		fill(c, x - h, y - h, x + h, y + h, color, stem);
+		break;
+	}
+	case CLUBS:
+	{
+		float r = s * 0.2f;
+		circleShape top = { x, y - f * s * 0.25f, r };
+		circleShape left = { x - s * 0.25f, y + f * s * 0.08f, r };
+		circleShape right = { x + s * 0.25f, y + f * s * 0.08f, r };
+		triangleShape stem = { x, y - f * s * 0.05f, x - s * 0.18f, y + f * s * 0.5f, x + s * 0.18f, y + f * s * 0.5f };
+		fill(c, x - h, y - h, x + h, y + h, color, top);
+		fill(c, x - h, y - h, x + h, y + h, color, left);
+		fill(c, x - h, y - h, x + h, y + h, color, right);
+		fill(c, x - h, y - h, x + h, y + h, color, stem);
+		break;
+	}
+	}
+}
+
+/* Strokes a glyph into the box at (x, y), w by h. Upside-down glyphs are turned half a circle. */
+void paintGlyph(canvas& c, const float* glyph, float x, float y, float w, float h, float pen, bool upsideDown, uint32_t color)
+{
+	for (int i = 0; glyph[i] != GLYPH_END; )
+	{
+		if ((glyph[i] == PEN_UP) || (glyph[i + 2] == PEN_UP) || (glyph[i + 2] == GLYPH_END))
+		{
+			i += (glyph[i] == PEN_UP) ? 1 : 2;
+			continue;
+		}
+		float ax = glyph[i], ay = glyph[i + 1], bx = glyph[i + 2], by = glyph[i + 3];
+		if (upsideDown)
+		{
+			ax = 1.0f - ax;
+			ay = 1.0f - ay;
+			bx = 1.0f - bx;
+			by = 1.0f - by;
+		}
+		capsuleShape stroke = { x + ax * w, y + ay * h, x + bx * w, y + by * h, pen * 0.5f };
+		fill(c, (ax < bx ? stroke.ax : stroke.bx) - pen, (ay < by ? stroke.ay : stroke.by) - pen,
+			(ax > bx ? stroke.ax : stroke.bx) + pen, (ay > by ? stroke.ay : stroke.by) + pen, color, stroke);
+		i += 2;
+	}
+}
+
+/* A crown, a tiara or a feathered cap over the court letter */
+void paintCourtMark(canvas& c, int value, float x, float y, float s, float pen, uint32_t color)
+{
+	if (value == KING)
+	{
+		const float crown[] = { 0.0f, 1.0f, 0.0f, 0.2f, 0.25f, 0.6f, 0.5f, 0.0f, 0.75f, 0.6f, 1.0f, 0.2f, 1.0f, 1.0f, 0.0f, 1.0f, GLYPH_END };
+		paintGlyph(c, crown, x - s * 0.5f, y - s * 0.3f, s, s * 0.6f, pen, false, color);
+	}
+	else if (value == QUEEN)
+	{
+		for (int i = 0; i < 5; i++)
+		{
+			circleShape jewel = { x + (i - 2) * s * 0.22f, y - (i == 2 ? s * 0.15f : 0.0f), s * 0.08f };
+			fill(c, jewel.cx - jewel.r, jewel.cy - jewel.r, jewel.cx + jewel.r, jewel.cy + jewel.r, color, jewel);
+		}
+	}
+	else
+	{
+		const float cap[] = { 0.0f, 1.0f, 1.0f, 1.0f, 0.8f, 0.3f, 0.2f, 0.3f, 0.0f, 1.0f, PEN_UP, 0.8f, 0.3f, 1.0f, 0.0f, GLYPH_END };
+		paintGlyph(c, cap, x - s * 0.5f, y - s * 0.3f, s, s * 0.6f, pen, false, color);
+	}
+}
+
+void CardPainter::paint(uint32_t* pixels, int pitch, int width, int height, cardFace face)
+{
+	canvas c = { pixels, pitch, width, height };
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			pixels[y * pitch + x] = 0; /* Transparent outside the corners */
+		}
+	}
+
+	float w = (float)width, h = (float)height;
+	float corner = w * 0.06f;
+	uint32_t ink = ((face.suit == DIAMONDS) || (face.suit == HEARTS)) ? COLOR_RED : COLOR_BLACK;
+
+	/* The card, with a hairline edge */
+	roundedBoxShape edge = { w * 0.5f, h * 0.5f, w * 0.5f, h * 0.5f, corner };
+	roundedBoxShape paper = { w * 0.5f, h * 0.5f, w * 0.5f - 1.0f, h * 0.5f - 1.0f, corner - 1.0f };
+	fill(c, 0.0f, 0.0f, w, h, COLOR_EDGE, edge);
+	fill(c, 0.0f, 0.0f, w, h, COLOR_PAPER, paper);
+
+	/* Corner indices, the bottom one turned around */
+	const float* glyph = glyphs[face.value];
+	float indexW = w * (face.value == 10 ? 0.14f : 0.1f);
+	float indexH = h * 0.09f;
+	float pen = w * 0.018f > 1.0f ? w * 0.018f : 1.0f;
+	float margin = w * 0.06f;
+	float indexPip = w * 0.1f;
+	paintGlyph(c, glyph, margin, margin, indexW, indexH, pen, false, ink);
+	paintPip(c, face.suit, margin + indexW * 0.5f, margin + indexH + indexPip * 0.75f, indexPip, false, ink);
+	paintGlyph(c, glyph, w - margin - indexW, h - margin - indexH, indexW, indexH, pen, true, ink);
+	paintPip(c, face.suit, w - margin - indexW * 0.5f, h - margin - indexH - indexPip * 0.75f, indexPip, true, ink);
+
+	/* The middle: one big pip, a pip layout, or a court figure */
+	float areaL = w * 0.32f, areaR = w * 0.68f;
+	float areaT = h * 0.18f, areaB = h * 0.82f;
+	if (face.value == ACE)
+	{
+		paintPip(c, face.suit, w * 0.5f, h * 0.5f, w * 0.45f, false, ink);
+	}
+	else if (face.value <= 10)
+	{
+		const pipSpot* spots = pipLayouts[face.value];
+		float pip = w * 0.18f;
+		for (int i = 0; i < face.value; i++)
+		{
+			float x = areaL + spots[i].x * (areaR - areaL);
+			float y = areaT + spots[i].y * (areaB - areaT);
+			paintPip(c, face.suit, x, y, pip, spots[i].y > 0.5f, ink);
+		}
+	}
+	else
+	{
+		float frameL = w * 0.2f, frameR = w * 0.8f;
+		float frameT = h * 0.14f, frameB = h * 0.86f;
+		roundedBoxShape frame = { w * 0.5f, h * 0.5f, (frameR - frameL) * 0.5f, (frameB - frameT) * 0.5f, corner * 0.5f };
+		roundedBoxShape inside = { w * 0.5f, h * 0.5f, (frameR - frameL) * 0.5f - pen, (frameB - frameT) * 0.5f - pen, corner * 0.5f };
+		fill(c, frameL, frameT, frameR, frameB, ink, frame);
+		fill(c, frameL, frameT, frameR, frameB, COLOR_COURT, inside);
+
+		/* The letter, big, with its mark above and pips in the frame's corners */
+		float letterW = w * 0.28f, letterH = h * 0.26f;
+		paintGlyph(c, glyph, (w - letterW) * 0.5f, h * 0.5f - letterH * 0.3f, letterW, letterH, pen * 2.0f, false, ink);
+		paintCourtMark(c, face.value, w * 0.5f, h * 0.5f - letterH * 0.7f, w * 0.3f, pen * 1.5f, ink);
+		float pip = w * 0.12f;
+		paintPip(c, face.suit, frameL + pip, frameT + pip, pip, false, ink);
+		paintPip(c, face.suit, frameR - pip, frameB - pip, pip, true, ink);
+	}
+}
+
+void CardPainter::paintAtlas(uint32_t* pixels, int pitch, int cardW, int cardH, int columns)
+{
+	for (int suit = 0; suit < NUM_SUITS; suit++)
+	{
+		for (int value = ACE; value <= NUM_FACES; value++)
+		{
+			int n = suit * NUM_FACES + value - 1;
+			uint32_t* card = pixels + (n / columns) * cardH * pitch + (n % columns) * cardW;
+			cardFace face = { suit, value };
+			paint(card, pitch, cardW, cardH, face);
+		}
+	}
+}
@@ -0,0 +1,26 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _CARDPAINTER_H
+#define _CARDPAINTER_H
+
+/*
+	Draws card faces from shapes instead of loading images, so they are sharp at any size.
+	Every edge is anti-aliased from its distance to the pixel, so nothing is supersampled.
+	Pixels are ARGB8888 with premultiplied alpha, like the card art the game loads.
+*/
+
+#include "klondike.h"
+
+class CardPainter
+{
+public:
+	/* Paints one face. pitch is in pixels. */
+	static void paint(uint32_t* pixels, int pitch, int width, int height, cardFace face);
+
+	/* Paints every face into a grid, columns wide, in suit order. Card n is at (n % columns, n / columns). */
+	static void paintAtlas(uint32_t* pixels, int pitch, int cardW, int cardH, int columns);
+};
+
+#endif /* _CARDPAINTER_H */
@@ -20,9 +20,20 @@
 
 #define TRANSPARENT_COLOR 0xFF, 0, 0xFF /* Purple is rendered clear. */
 #define RENDER_BGCOLOR 0x0, 0x64, 0x0, 0xFF /* Areas with no objects are medium-green. */
+#define SOFT_BGCOLOR 0xFF006400 /* RENDER_BGCOLOR as ARGB8888 */
+
+#define RENDER_BENCH_SECONDS 2 /* Each renderer draws for this long */
 
 #define DOUBLECLICK_DELAY 250
 
+#define TEXTURE_STATS_SHOWN 8 /* The largest images listed at exit */
+
+#define FACE_PREFETCH_STOCK 3 /* Cards off the top of the stock decoded before they are drawn */
+
+#define WALL_MAX_MOVES 1000 /* A bot table gives up after this many */
+#define WALL_END_MS 2000 /* A finished table is shown this long before it deals again */
+#define WALL_TILE_CARDS_HIGH 4.2f /* Two rows of cards and a long column fanned below them */
+
 const char* nameOfSuit(int suit)
 {
 	switch (suit)
@@ -89,6 +100,59 @@ bool testRectCollision(SDL_Rect &rect1, SDL_Rect &rect2)
 }
 
 
+/* Textures hold premultiplied color, so blend with (1, 1 - srcAlpha) */
+SDL_BlendMode premultipliedBlendMode()
+{
+	return SDL_ComposeCustomBlendMode(
+		SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD,
+		SDL_BLENDFACTOR_ONE, SDL_BLENDFACTOR_ONE_MINUS_SRC_ALPHA, SDL_BLENDOPERATION_ADD);
+}
+
+/* Turns the color key into transparency and premultiplies alpha so filtering doesn't bleed purple */
+void premultiplyKeyed(SDL_Surface* surface, Uint32 key)
+{
+	for (int y = 0; y < surface->h; y++)
+	{
+		Uint32* row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+		for (int x = 0; x < surface->w; x++)
+		{
+			Uint32 a = row[x] >> 24;
+			if ((row[x] & 0x00FFFFFF) == key || !a)
+			{
+				row[x] = 0;
+			}
+			else if (a != 0xFF)
+			{
+				Uint32 r = ((row[x] >> 16) & 0xFF) * a / 0xFF;
+				Uint32 g = ((row[x] >> 8) & 0xFF) * a / 0xFF;
+				Uint32 b = (row[x] & 0xFF) * a / 0xFF;
+				row[x] = (a << 24) | (r << 16) | (g << 8) | b;
+			}
+		}
+	}
+}
+
+/* Back to straight alpha, for renderers that can only blend that. pitch is in pixels. */
+void unpremultiply(Uint32* pixels, int pitch, int width, int height)
+{
+	for (int y = 0; y < height; y++)
+	{
+		Uint32* row = pixels + y * pitch;
+		for (int x = 0; x < width; x++)
+		{
+			Uint32 a = row[x] >> 24;
+			if (a && (a != 0xFF))
+			{
+				Uint32 r = (((row[x] >> 16) & 0xFF) * 0xFF + a / 2) / a;
+				Uint32 g = (((row[x] >> 8) & 0xFF) * 0xFF + a / 2) / a;
+				Uint32 b = ((row[x] & 0xFF) * 0xFF + a / 2) / a;
+				row[x] = (a << 24) | ((r > 0xFF ? 0xFF : r) << 16) | ((g > 0xFF ? 0xFF : g) << 8) | (b > 0xFF ? 0xFF : b);
+			}
+		}
+	}
+}
+
+
 Timer::Timer()
 {
 	stop(); /* set vars */
@@ -183,6 +247,11 @@ bool Timer::isPaused()
 }
 
 
+int Texture::sMipTextures[Texture::MAX_MIP_LEVELS];
+Uint64 Texture::sMipBytes[Texture::MAX_MIP_LEVELS];
+Uint64 Texture::sMipDraws[Texture::MAX_MIP_LEVELS];
+Uint64 Texture::sMipTexels[Texture::MAX_MIP_LEVELS];
+
 Texture::Texture()
 {
 	clear();
@@ -194,33 +263,132 @@ Texture::~Texture()
 
 bool Texture::loadFromFile(std::string path, SDL_Renderer* renderer)
 {
-	free(); /* Get rid of any preexisting texture */
-	SDL_Texture* newTexture = NULL;
 	SDL_Surface* loadedSurface = IMG_Load(path.c_str());
 	if (!loadedSurface)
 	{
 		printf("This image could not be loaded: %s\nSDL_image Error: %s\n", path.c_str(), IMG_GetError());
+		free(); /* Get rid of any preexisting texture */
+		return false;
+	}
+	return loadFromSurface(loadedSurface, renderer, path);
+}
+
+bool Texture::loadFromSurface(SDL_Surface* loadedSurface, SDL_Renderer* renderer, const std::string& path)
+{
+	free(); /* Get rid of any preexisting texture */
+	SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB(loadedSurface->format, TRANSPARENT_COLOR)); /* Color key image */
+	mTexture = SDL_CreateTextureFromSurface(renderer, loadedSurface); /* Create texture from surface pixels */
+	if (!mTexture)
+	{
+		printf("A texture could not be created from %s\nSDL Error: %s\n", path.c_str(), SDL_GetError());
 	}
 	else
 	{
-		SDL_SetColorKey(loadedSurface, SDL_TRUE, SDL_MapRGB(loadedSurface->format, TRANSPARENT_COLOR)); /* Color key image */
-		newTexture = SDL_CreateTextureFromSurface(renderer, loadedSurface); /* Create texture from surface pixels */
-		if (!newTexture)
+		mWidth = loadedSurface->w;
+		mHeight = loadedSurface->h;
+	}
+	SDL_FreeSurface(loadedSurface);
+	return mTexture != NULL;
+}
+
+bool Texture::loadMipChainFromFile(std::string path, SDL_Renderer* renderer)
+{
+	SDL_Surface* level = decodeMipSource(path);
+	if (!level)
+	{
+		free(); /* Get rid of any preexisting texture */
+		return false;
+	}
+	return loadMipChain(level, renderer, path);
+}
+
+SDL_Surface* Texture::decodeMipSource(const std::string& path)
+{
+	SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+	if (!loadedSurface)
+	{
+		printf("This image could not be loaded: %s\nSDL_image Error: %s\n", path.c_str(), IMG_GetError());
+		return NULL;
+	}
+
+	SDL_Surface* level = SDL_ConvertSurfaceFormat(loadedSurface, SDL_PIXELFORMAT_ARGB8888, 0);
+	SDL_FreeSurface(loadedSurface);
+	if (!level)
+	{
+		printf("This image could not be converted: %s\nSDL Error: %s\n", path.c_str(), SDL_GetError());
+		return NULL;
+	}
+	premultiplyKeyed(level, SDL_MapRGB(level->format, TRANSPARENT_COLOR) & 0x00FFFFFF);
+	return level;
+}
+
+bool Texture::loadMipChain(SDL_Surface* level, SDL_Renderer* renderer, const std::string& path)
+{
+	free(); /* Get rid of any preexisting texture */
+
+	SDL_BlendMode premultiplied = premultipliedBlendMode();
+	bool straight = false; /* The renderer rejected premultiplied blending */
+
+	mMipLevels = 0;
+	while (level && mMipLevels < MAX_MIP_LEVELS)
+	{
+		/* Stop once either side would drop below one pixel. Filtered while level is still premultiplied. */
+		SDL_Surface* next = NULL;
+		if ((level->w >= 2) && (level->h >= 2))
+		{
+			next = SDL_CreateRGBSurfaceWithFormat(0, level->w / 2, level->h / 2, 32, SDL_PIXELFORMAT_ARGB8888);
+			if (next)
+			{
+				boxDownsample((Uint32*)level->pixels, level->pitch, (Uint32*)next->pixels, next->pitch, next->w, next->h);
+			}
+		}
+
+		if (straight)
 		{
-			printf("A texture could not be created from %s\nSDL Error: %s\n", path.c_str(), SDL_GetError());
+			unpremultiply((Uint32*)level->pixels, level->pitch / 4, level->w, level->h);
 		}
-		else
+		SDL_Texture* levelTexture = SDL_CreateTextureFromSurface(renderer, level);
+		if (levelTexture && !straight && (SDL_SetTextureBlendMode(levelTexture, premultiplied) < 0))
 		{
-			mWidth = loadedSurface->w;
-			mHeight = loadedSurface->h;
+			/* Plain blending multiplies by alpha again, so this level and the rest go up straight */
+			straight = true;
+			SDL_DestroyTexture(levelTexture);
+			unpremultiply((Uint32*)level->pixels, level->pitch / 4, level->w, level->h);
+			levelTexture = SDL_CreateTextureFromSurface(renderer, level);
 		}
-		SDL_FreeSurface(loadedSurface);
+		if (!levelTexture)
+		{
+			printf("Mip level %i could not be created from %s\nSDL Error: %s\n", mMipLevels, path.c_str(), SDL_GetError());
+			SDL_FreeSurface(next);
+			break;
+		}
+		if (straight)
+		{
+			SDL_SetTextureBlendMode(levelTexture, SDL_BLENDMODE_BLEND);
+		}
+
+		mMips[mMipLevels] = levelTexture;
+		mMipWidths[mMipLevels] = level->w;
+		mMipHeights[mMipLevels] = level->h;
+		sMipTextures[mMipLevels]++;
+		sMipBytes[mMipLevels] += (Uint64)level->w * level->h * 4;
+		mMipLevels++;
+
+		SDL_FreeSurface(level);
+		level = next;
+	}
+	SDL_FreeSurface(level);
+
+	if (mMipLevels)
+	{
+		mTexture = mMips[0];
+		mWidth = mMipWidths[0];
+		mHeight = mMipHeights[0];
 	}
-	mTexture = newTexture;
 	return mTexture != NULL;
 }
 
-bool Texture::loadFromRenderedText(std::string textureText, SDL_Color textColor, TTF_Font* font, SDL_Renderer* renderer)
+bool Texture::loadFromRenderedText(const std::string& textureText, SDL_Color textColor, TTF_Font* font, SDL_Renderer* renderer)
 {
 	free(); /* Get rid of any preexisting texture */
 
@@ -250,21 +418,99 @@ bool Texture::loadFromRenderedText(std::string textureText, SDL_Color textColor,
 	return mTexture != NULL;
 }
 
+bool Texture::createBlank(int width, int height, SDL_Renderer* renderer, SDL_TextureAccess access)
+{
+	free(); /* Get rid of any preexisting texture */
+
+	/* Create uninitialized texture */
+	mTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, access, width, height);
+	if (!mTexture)
+	{
+		printf("A blank texture could not be created!\nSDL Error: %s\n", SDL_GetError());
+	}
+	else
+	{
+		mWidth = width;
+		mHeight = height;
+	}
+	return mTexture != NULL;
+}
+
+void Texture::setAsRenderTarget(SDL_Renderer* renderer)
+{
+	/* Make self render target */
+	SDL_SetRenderTarget(renderer, mTexture);
+}
+
+void Texture::setAtlasRegion(Texture* atlas, SDL_Rect region)
+{
+	free(); /* Get rid of any preexisting texture */
+	mAtlas = atlas;
+	mRegion = region;
+	mWidth = region.w;
+	mHeight = region.h;
+}
+
+void Texture::share(const TextureHandle& image)
+{
+	free(); /* Get rid of any preexisting texture */
+	Texture* source = image.get();
+	if (!source)
+	{
+		return;
+	}
+	mShared = image;
+	mTexture = source->mTexture;
+	mMipLevels = source->mMipLevels;
+	for (int i = 0; i < mMipLevels; i++)
+	{
+		mMips[i] = source->mMips[i];
+		mMipWidths[i] = source->mMipWidths[i];
+		mMipHeights[i] = source->mMipHeights[i];
+	}
+	mWidth = source->mWidth;
+	mHeight = source->mHeight;
+}
+
 void Texture::free()
 {
+	/* The registry frees the image with its last reference */
+	if (mShared.isValid())
+	{
+		mShared.release();
+		clear();
+	}
+	/* Free the mip chain, which includes the texture */
+	else if (mMipLevels)
+	{
+		for (int i = 0; i < mMipLevels; i++)
+		{
+			SDL_DestroyTexture(mMips[i]);
+			sMipTextures[i]--;
+			sMipBytes[i] -= (Uint64)mMipWidths[i] * mMipHeights[i] * 4;
+		}
+		clear();
+	}
 	/* Free texture if it exists */
-	if (mTexture)
+	else if (mTexture)
 	{
 		SDL_DestroyTexture(mTexture);
 		clear();
 	}
+	/* The atlas belongs to someone else */
+	else if (mAtlas)
+	{
+		clear();
+	}
 }
 
 void Texture::clear()
 {
 	mTexture = NULL;
+	mAtlas = NULL;
 	mWidth = 0;
 	mHeight = 0;
+	mMipLevels = 0;
 }
 
 void Texture::setColor(Uint8 red, Uint8 green, Uint8 blue)
@@ -338,778 +584,4273 @@ void Texture::render(SDL_Renderer* renderer, int x, int y,
 		renderQuad.h = clip->h;
 	}
 
-	/* Render to screen */
-	//* Hack!
-	if (mTexture < (void*)0x40000)
+	SDL_Texture* texture = getSDLTexture();
+	if (!texture)
 	{
-		printf("ATTEMPTED TO RENDER AN UNKNOWN TEXTURE!\n");
 		return;
 	}
-	//*/
-	SDL_RenderCopyEx(renderer, mTexture, clip, &renderQuad, angle, center, flip);
-}
-
-
-Card::Card()
-{
-	mTexture = NULL;
-	mClickable =
-		mDragging =
-		mSliding =
-		mFaceUp = false;
-	mOffsetX =
-	mOffsetY =
-	mPosX =
-		mPosY =
-		mVelX =
-		mVelY =
-		mFile =
-		mRank =
-		mDestRank = 0;
-	mFace.suit = SPADES;
-	mFace.value = ACE;
-	mLastClickTime = GetCurrentTime();
-}
 
-void Card::handleEvent(SDL_Event& e)
-{
-	if (e.type == SDL_MOUSEMOTION)
+	/* A clip within a region is relative to the region */
+	SDL_Rect atlasClip;
+	if (mAtlas)
 	{
-		if (mDragging)
+		atlasClip = clip ? *clip : mRegion;
+		if (clip)
 		{
-			/* Get mouse position */
-			int x, y;
-			SDL_GetMouseState(&x, &y);
-			mPosX = x + mOffsetX;
-			mPosY = y + mOffsetY;
+			atlasClip.x += mRegion.x;
+			atlasClip.y += mRegion.y;
 		}
+		clip = &atlasClip;
 	}
 
-	if (e.type == SDL_MOUSEBUTTONDOWN)
+	/* Render to screen */
+	countDraw();
+	if ((angle == 0.0) && (flip == SDL_FLIP_NONE))
 	{
-		if ((e.button.button == SDL_BUTTON_LEFT) && (mClickable))
-		{
-			/* Get mouse position */
-			int x, y;
-			SDL_GetMouseState(&x, &y);
-			if (pointWithinBounds(x, y, mPosX, mPosY, mTexture->getWidth(), mTexture->getHeight()))
-			{
-				DWORD newClickTime = GetCurrentTime();
-				if (mFaceUp)
-				{
-					/* If mLastClickTime was recent */
-					if (newClickTime - DOUBLECLICK_DELAY <= mLastClickTime)
-					{
-						//Try to auto-move
-					}
-					else /* Maybe this else should be like an if(!automove) ? */
-					{
-						mDragging = true;
-						mOffsetX = mPosX - x;
-						mOffsetY = mPosY - y;
-					}
-				}
-				else
-				{
-					if (mRank == 0)
-					{
-						dealTo(1);
-					}
-					flip();
-				}
-				mLastClickTime = newClickTime;
-			}
-		}
+		SDL_RenderCopy(renderer, texture, clip, &renderQuad);
 	}
-
-	if (e.type == SDL_MOUSEBUTTONUP)
+	else
 	{
-		if (e.button.button == SDL_BUTTON_LEFT)
-		{
-			if (mDragging)
-			{
-				mDragging = false;
-				mOffsetX = 0;
-				mOffsetY = 0;
-				land();
-			}
-		}
+		SDL_RenderCopyEx(renderer, texture, clip, &renderQuad, angle, center, flip);
 	}
 }
 
-void Card::move(int timeStep)
+int Texture::mipLevel()
 {
-	if (mDestRank == mRank)
+	int level = 0;
+	while ((level + 1 < mMipLevels) &&
+		(mMipWidths[level + 1] >= mWidth) && (mMipHeights[level + 1] >= mHeight))
 	{
-		return;
+		level++;
 	}
+	return level;
+}
 
-	/* FIXME: Is there any y-drift when the DestRank fills up? */
-	point* dest = mTable->getCardPlace(mDestRank);
-
-	bool xCond = mPosX != dest->x;
-	bool yCond = mPosY != dest->y;
-
-	/*
-		FIXME:BUGBUG: Sometimes cards miss and fly forever
-			Moving in big steps with little tolerance?
-	*/
-	if (mTable->options()->animation)
+Uint64 Texture::getBytes()
+{
+	if (!mMipLevels)
 	{
-		if (xCond)
-		{
-			mPosX += mVelX * timeStep;
-		}
-
-		if (yCond)
-		{
-			mPosY += mVelY * timeStep;
-		}
+		return mTexture ? (Uint64)mWidth * mHeight * 4 : 0;
 	}
-	else
+	Uint64 bytes = 0;
+	for (int i = 0; i < mMipLevels; i++)
 	{
-		mPosX = dest->x;
-		mPosY = dest->y;
+		bytes += (Uint64)mMipWidths[i] * mMipHeights[i] * 4;
 	}
+	return bytes;
+}
 
-	xCond = mPosX != dest->x;
-	yCond = mPosY != dest->y;
-
-	if (yCond || xCond)
+SDL_Texture* Texture::getSDLTexture()
+{
+	if (mAtlas)
 	{
-		mSliding = true;
+		return mAtlas->getSDLTexture();
 	}
-	else
+	if (mMipLevels < 2)
 	{
-		mSliding = false;
-		land();
+		return mTexture;
 	}
+	return mMips[mipLevel()];
 }
 
-void Card::flip()
+void Texture::countDraw()
 {
-	if (!mFaceUp)
-	{
-		setTexture(mTable->getCardTexture(mFace.suit, mFace.value));
-	}
-	else
+	if (mMipLevels < 2)
 	{
-		setTexture(mTable->getCardBack());
+		return;
 	}
-	mFaceUp = !mFaceUp;
+	int level = mipLevel();
+	sMipDraws[level]++;
+	sMipTexels[level] += (Uint64)mMipWidths[level] * mMipHeights[level];
 }
 
-void Card::setTexture(Texture* texture)
+void Texture::printMipStats()
 {
-	mTexture = texture;
-}
+	/* Nothing to report without card art, as when running headless */
+	bool any = false;
+	for (int i = 0; i < MAX_MIP_LEVELS; i++)
+	{
+		any = any || sMipTextures[i] || sMipDraws[i];
+	}
+	if (!any)
+	{
+		return;
+	}
 
-void Card::render(SDL_Renderer* renderer, point* slot)
-{
-	if (!mDragging && !mSliding)
+	printf("Mip level  Textures  Memory (KB)  Draws  Texels/draw\n");
+	for (int i = 0; i < MAX_MIP_LEVELS; i++)
 	{
-		mPosX = slot->x;
-		mPosY = slot->y;
-		if (mRank > 5)
+		if (!sMipTextures[i] && !sMipDraws[i])
 		{
-			mPosY += (mFile * (mTexture->getHeight() / 10 ));
+			continue;
 		}
+		printf("%9i  %8i  %11.1f  %5llu  %11.0f\n", i, sMipTextures[i], sMipBytes[i] / 1024.0,
+			(unsigned long long)sMipDraws[i], sMipDraws[i] ? (double)sMipTexels[i] / sMipDraws[i] : 0.0);
 	}
-	mTexture->render(renderer, mPosX, mPosY);
 }
 
-void Card::setRank(int rank)
-{
-	if (0 > rank || rank > CARD_RANKS)
-	{
-		rank = 0;
-	}
-	mRank = rank;
-	mDestRank = rank;
-}
-void Card::setFile(int file)
+
+TextureHandle::TextureHandle()
 {
-	if (0 > file || file > NUM_CARDS)
-	{
-		file = 0;
-	}
-	mFile = file;
+	mAsset = NULL;
 }
 
-void Card::setClickability(bool state)
+TextureHandle::TextureHandle(textureAsset* asset)
 {
-	mClickable = state;
+	mAsset = asset;
+	mAsset->refs++;
 }
 
-void Card::setFace(cardFace face)
+TextureHandle::TextureHandle(const TextureHandle& other)
 {
-	if (((face.suit >= SPADES) && (face.suit < NUM_SUITS)) &&
-		((face.value >= ACE) && (face.value <= KING)))
+	mAsset = other.mAsset;
+	if (mAsset)
 	{
-		mFace = face;
+		mAsset->refs++;
 	}
 }
 
-void Card::dealTo(int rank)
+TextureHandle& TextureHandle::operator=(const TextureHandle& other)
 {
-	if ((0 <= rank) && (rank < CARD_RANKS))
+	/* Take the new reference first, in case they are the same image */
+	if (other.mAsset)
 	{
-		if (mRank != rank)
-		{
-			mDestRank = rank;
-			mSliding = true;
-			if (mTable->options()->animation)
-			{
-				mVelY = CARD_VEL;
-				mVelX = CARD_VEL;
-				if (mTable->getCardPlace(rank)->y < mTable->getCardPlace(mRank)->y) //BUGBUG: Head a little further down for each card that is already there
-				{
-					mVelY *= -1;
-				}
-				if (mTable->getCardPlace(rank)->x < mTable->getCardPlace(mRank)->x)
-				{
-					mVelX *= -1;
-				}
-			}
-		}
+		other.mAsset->refs++;
 	}
+	release();
+	mAsset = other.mAsset;
+	return *this;
 }
 
-void Card::setDestRank(int rank)
+TextureHandle::~TextureHandle()
 {
-	if ((0 > rank) || (rank > CARD_RANKS))
-	{
-		rank = 0;
-	}
-	mDestRank = rank;
+	release();
 }
 
-void Card::land()
+Texture* TextureHandle::get() const
 {
-	mTable->cardDrop(this);
+	return mAsset ? &mAsset->texture : NULL;
 }
 
-void Card::assocGame(AssetManager& game)
+void TextureHandle::release()
 {
-	mTable = &game;
-	mTable->registerCard(this);
+	if (mAsset && !--mAsset->refs)
+	{
+		mAsset->registry->destroy(mAsset);
+	}
+	mAsset = NULL;
 }
 
 
-Window::Window()
+static bool largerAsset(textureAsset* a, textureAsset* b)
+{
+	return a->bytes > b->bytes;
+}
+
+TextureRegistry::TextureRegistry()
 {
-	mWindow = NULL;
 	mRenderer = NULL;
-	mMouseFocus =
-	mKeyboardFocus =
-	mFullScreen =
-	mMinimized = false;
-	mWidth =
-	mHeight = 0;
+	mBytes =
+		mPeakBytes = 0;
+	mLoads =
+		mShared = 0;
 }
 
-bool Window::init()
+TextureRegistry::~TextureRegistry()
 {
-	mWindow = SDL_CreateWindow(WINDOW_TITLE, SDL_WINDOWPOS_UNDEFINED,
-		SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+	close();
+	for (std::multimap<Uint64, textureAsset*>::iterator i = mAssets.begin(); i != mAssets.end(); ++i)
+	{
+		i->second->registry = NULL;
+		delete i->second;
+	}
+}
 
-	if (!mWindow)
+TextureHandle TextureRegistry::load(const std::string& path)
+{
+	SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+	if (!loadedSurface)
 	{
-		printf("The window could not be created!\n");
-		return false;
+		printf("This image could not be loaded: %s\nSDL_image Error: %s\n", path.c_str(), IMG_GetError());
+		return TextureHandle();
 	}
 
-	mMouseFocus =
-		mKeyboardFocus = true;
-	mWidth = SCREEN_WIDTH;
-	mHeight = SCREEN_HEIGHT;
-
-	SDL_SysWMinfo info;
-	SDL_VERSION(&info.version);
-	if (SDL_GetWindowWMInfo(mWindow, &info))
+	textureDigest digest = digestSurface(loadedSurface, TEXTURE_KEYED);
+	TextureHandle handle = find(digest);
+	if (handle.isValid())
 	{
-		std::stringstream ssGmeVer, ssSDLver, ssTTFver, ssMIXver, ssIMGver;
-		ssGmeVer << PROG_NAME << " version " << GAME_VERSION;
-		ssSDLver << "SDL main version " << SDL_MAJOR_VERSION << "." << SDL_MINOR_VERSION << "." << SDL_PATCHLEVEL;
-		ssTTFver << "SDL TTF version " << SDL_TTF_MAJOR_VERSION << "." << SDL_TTF_MINOR_VERSION << "." << SDL_TTF_PATCHLEVEL;
-		ssMIXver << "SDL Mixer version " << SDL_MIXER_MAJOR_VERSION << "." << SDL_MIXER_MINOR_VERSION << "." << SDL_MIXER_PATCHLEVEL;
-		ssIMGver << "SDL Image version " << SDL_IMAGE_MAJOR_VERSION <<"."<< SDL_IMAGE_MINOR_VERSION << "." << SDL_IMAGE_PATCHLEVEL;
-
-		HMENU hMenubar = CreateMenu();
-		HMENU hGame = CreateMenu();
-		HMENU hAbout = CreateMenu();
-		AppendMenu(hMenubar, MF_POPUP, (UINT_PTR)hGame, "&Game");
-		AppendMenu(hMenubar, MF_POPUP, (UINT_PTR)hAbout, "&About");
-		AppendMenu(hGame, MF_STRING, MENU_EXIT, "&Exit");
-		AppendMenu(hAbout, MF_STRING, NULL, "This awesome clone was created by Chris Roxby.");
-		AppendMenu(hAbout, MF_STRING, NULL, ssGmeVer.str().c_str());
-		AppendMenu(hAbout, MF_SEPARATOR, NULL, "");
-		AppendMenu(hAbout, MF_STRING, NULL, ssTTFver.str().c_str());
-		AppendMenu(hAbout, MF_STRING, NULL, ssMIXver.str().c_str());
-		AppendMenu(hAbout, MF_STRING, NULL, ssIMGver.str().c_str());
-		SetMenu(info.info.win.window, hMenubar);
-		return true;
+		SDL_FreeSurface(loadedSurface);
+		return handle;
 	}
-	else
+	textureAsset* asset = new textureAsset;
+	if (!asset->texture.loadFromSurface(loadedSurface, mRenderer, path))
 	{
-		printf("The menu bar could not be created!\n");
-		return false;
+		delete asset;
+		return TextureHandle();
 	}
+	return add(digest, path, asset);
 }
 
-SDL_Renderer* Window::createRenderer()
+TextureHandle TextureRegistry::loadMipChain(const std::string& path)
 {
-	mRenderer = SDL_CreateRenderer(mWindow, -1, SDL_RENDERER_ACCELERATED);
-	return mRenderer;
+	SDL_Surface* level = Texture::decodeMipSource(path);
+	if (!level)
+	{
+		return TextureHandle();
+	}
+	return uploadMipChain(level, path);
 }
 
-void Window::handleEvent(SDL_Event& e)
+TextureHandle TextureRegistry::uploadMipChain(SDL_Surface* level, const std::string& path)
 {
-	if (e.type == SDL_WINDOWEVENT)
+	textureDigest digest = digestSurface(level, TEXTURE_MIPMAPPED);
+	TextureHandle handle = find(digest);
+	if (handle.isValid())
 	{
-		switch (e.window.event)
-		{
-			/* Get new dimensions and repaint on window size change */
-		case SDL_WINDOWEVENT_SIZE_CHANGED:
-			mWidth = e.window.data1;
-			mHeight = e.window.data2;
-			SDL_RenderPresent(mRenderer);
-			break;
-
-			/* Repaint on exposure */
-		case SDL_WINDOWEVENT_EXPOSED:
-			SDL_RenderPresent(mRenderer);
-			break;
+		SDL_FreeSurface(level);
+		return handle;
+	}
+	textureAsset* asset = new textureAsset;
+	if (!asset->texture.loadMipChain(level, mRenderer, path))
+	{
+		delete asset;
+		return TextureHandle();
+	}
+	return add(digest, path, asset);
+}
 
-		case SDL_WINDOWEVENT_ENTER:
-			mMouseFocus = true;
-			break;
-		case SDL_WINDOWEVENT_LEAVE:
-			mMouseFocus = false;
-			break;
+textureDigest TextureRegistry::digestSurface(SDL_Surface* surface, TEXTURE_KINDS kind)
+{
+	textureDigest digest;
+	digest.kind = kind;
+	digest.format = surface->format->format;
+	digest.w = surface->w;
+	digest.h = surface->h;
 
-		case SDL_WINDOWEVENT_FOCUS_GAINED:
-			mKeyboardFocus = true;
-			break;
-		case SDL_WINDOWEVENT_FOCUS_LOST:
-			mKeyboardFocus = false;
-			break;
+	/*
+		FNV-1a a word at a time, with a shift so high bits reach the low ones.
+		The check adds and rotates instead of xoring, with other constants, so it doesn't collide along with it.
+	*/
+	Uint64 hash = 0xCBF29CE484222325ull;
+	Uint64 check = 0x9E3779B97F4A7C15ull;
+	const Uint64 prime = 0x100000001B3ull;
+	const Uint64 mix = 0xC2B2AE3D27D4EB4Full;
+	hash = (hash ^ kind) * prime;
+	hash = (hash ^ digest.format) * prime;
+	hash = (hash ^ (Uint64)digest.w) * prime;
+	hash = (hash ^ (Uint64)digest.h) * prime;
+
+	/* Rows only, since the padding after each one is never drawn */
+	int rowBytes = surface->w * surface->format->BytesPerPixel;
+	for (int y = 0; y < surface->h; y++)
+	{
+		const Uint8* row = (const Uint8*)surface->pixels + y * surface->pitch;
+		int x = 0;
+		for (; x + 8 <= rowBytes; x += 8)
+		{
+			Uint64 word;
+			memcpy(&word, row + x, sizeof(word));
+			hash = (hash ^ word) * prime;
+			hash ^= hash >> 29;
+			check += word * mix;
+			check = ((check << 31) | (check >> 33)) * 0x9E3779B97F4A7C15ull;
+		}
+		for (; x < rowBytes; x++)
+		{
+			hash = (hash ^ row[x]) * prime;
+			check = (check + row[x]) * mix;
+		}
+	}
+	digest.hash = hash;
+	digest.check = check ^ (check >> 32);
+	return digest;
+}
 
-		case SDL_WINDOWEVENT_MINIMIZED:
-			mMinimized = true;
-			break;
-		case SDL_WINDOWEVENT_MAXIMIZED:
-			mMinimized = false;
-			break;
-		case SDL_WINDOWEVENT_RESTORED:
-			mMinimized = false;
-			break;
+TextureHandle TextureRegistry::find(const textureDigest& digest)
+{
+	mLoads++;
+	std::pair<std::multimap<Uint64, textureAsset*>::iterator, std::multimap<Uint64, textureAsset*>::iterator> found = mAssets.equal_range(digest.hash);
+	for (std::multimap<Uint64, textureAsset*>::iterator i = found.first; i != found.second; ++i)
+	{
+		textureAsset* asset = i->second;
+		const textureDigest& other = asset->digest;
+		if ((other.kind != digest.kind) || (other.format != digest.format) || (other.w != digest.w) || (other.h != digest.h))
+		{
+			continue;
+		}
+		if (other.check == digest.check)
+		{
+			asset->shared++;
+			mShared++;
+			return TextureHandle(asset);
 		}
+		printf("An image has the same hash as %s, but different pixels. It is loaded separately.\n", asset->path.c_str());
 	}
-	/* Enter\exit full screen */
-	else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_RETURN)
+	return TextureHandle();
+}
+
+TextureHandle TextureRegistry::add(const textureDigest& digest, const std::string& path, textureAsset* asset)
+{
+	asset->registry = this;
+	asset->digest = digest;
+	asset->path = path;
+	asset->bytes = asset->texture.getBytes();
+	asset->refs = 0;
+	asset->shared = 0;
+	mAssets.insert(std::make_pair(digest.hash, asset));
+
+	mBytes += asset->bytes;
+	if (mBytes > mPeakBytes)
 	{
-		const Uint8 *kBstate = SDL_GetKeyboardState(NULL);
-		if (kBstate[SDL_SCANCODE_LALT] || kBstate[SDL_SCANCODE_RALT])
+		mPeakBytes = mBytes;
+	}
+	return TextureHandle(asset);
+}
+
+void TextureRegistry::destroy(textureAsset* asset)
+{
+	mBytes -= asset->bytes;
+	std::pair<std::multimap<Uint64, textureAsset*>::iterator, std::multimap<Uint64, textureAsset*>::iterator> found = mAssets.equal_range(asset->digest.hash);
+	for (std::multimap<Uint64, textureAsset*>::iterator i = found.first; i != found.second; ++i)
+	{
+		if (i->second == asset)
 		{
-			if (mFullScreen)
-			{
-				SDL_SetWindowFullscreen(mWindow, SDL_FALSE);
-				mFullScreen = false;
-			}
-			else
-			{
-				SDL_SetWindowFullscreen(mWindow, SDL_TRUE);
-				mFullScreen = true;
-				mMinimized = false;
-			}
+			mAssets.erase(i);
+			break;
 		}
 	}
+	delete asset;
 }
 
-void Window::free()
+void TextureRegistry::printStats()
 {
-	if (mRenderer != NULL)
+	if (!mLoads)
 	{
-		SDL_DestroyRenderer(mRenderer);
+		return;
 	}
-	if (mWindow != NULL)
+	printf("Textures: %u loads, %u shared an image already resident. %u images hold %.1f MB, at most %.1f MB.\n",
+		mLoads, mShared, (unsigned)mAssets.size(), mBytes / (1024.0 * 1024.0), mPeakBytes / (1024.0 * 1024.0));
+
+	/* Largest first */
+	std::vector<textureAsset*> assets;
+	for (std::multimap<Uint64, textureAsset*>::iterator i = mAssets.begin(); i != mAssets.end(); ++i)
 	{
-		SDL_DestroyWindow(mWindow);
+		assets.push_back(i->second);
 	}
+	std::sort(assets.begin(), assets.end(), largerAsset);
 
-	mMouseFocus = false;
-	mKeyboardFocus = false;
-	mWidth = 0;
-	mHeight = 0;
+	Uint64 rest = 0;
+	for (size_t i = 0; i < assets.size(); i++)
+	{
+		if (i < TEXTURE_STATS_SHOWN)
+		{
+			printf("  %-24s %8.1f KB  %i references\n", assets[i]->path.c_str(), assets[i]->bytes / 1024.0, assets[i]->refs);
+		}
+		else
+		{
+			rest += assets[i]->bytes;
+		}
+	}
+	if (assets.size() > TEXTURE_STATS_SHOWN)
+	{
+		printf("  and %u more, %.1f KB\n", (unsigned)(assets.size() - TEXTURE_STATS_SHOWN), rest / 1024.0);
+	}
 }
 
-int Window::getWidth()
+int TextureRegistry::close()
 {
-	return mWidth;
+	/* Anything left wasn't freed by whatever drew it */
+	int leaks = 0;
+	for (std::multimap<Uint64, textureAsset*>::iterator i = mAssets.begin(); i != mAssets.end(); ++i)
+	{
+		textureAsset* asset = i->second;
+		if (!asset->bytes)
+		{
+			continue; /* Already reported */
+		}
+		printf("Texture leak: %s still has %i references, holding %.1f KB\n",
+			asset->path.c_str(), asset->refs, asset->bytes / 1024.0);
+		asset->texture.free();
+		mBytes -= asset->bytes;
+		asset->bytes = 0;
+		leaks++;
+	}
+	mRenderer = NULL;
+	return leaks;
 }
-int Window::getHeight()
+
+
+SpriteBatch::SpriteBatch()
 {
-	return mHeight;
+	mLastSprites =
+		mLastDrawCalls = 0;
 }
-bool Window::hasMouseFocus()
+
+void SpriteBatch::begin()
 {
-	return mMouseFocus;
+	mSprites.clear();
+	mBatches.clear();
 }
-bool Window::hasKeyboardFocus()
+
+void SpriteBatch::add(Texture* texture, int x, int y)
 {
-	return mKeyboardFocus;
+	SDL_Rect dest = { x, y, texture->getWidth(), texture->getHeight() };
+	texture->countDraw();
+	add(texture->getSDLTexture(), dest, texture->getRegion());
 }
-bool Window::isMinimized()
+
+void SpriteBatch::add(SDL_Texture* texture, SDL_Rect& dest, const SDL_Rect* source)
 {
-	return mMinimized;
+	if (!texture)
+	{
+		return;
+	}
+
+	sprite s;
+	s.texture = texture;
+	s.dest = dest;
+	s.clipped = source != NULL;
+	s.u0 =
+		s.v0 = 0.0f;
+	s.u1 =
+		s.v1 = 1.0f;
+	if (source)
+	{
+		int w, h;
+		s.source = *source;
+		if ((SDL_QueryTexture(texture, NULL, NULL, &w, &h) == 0) && w && h)
+		{
+			s.u0 = (float)source->x / w;
+			s.v0 = (float)source->y / h;
+			s.u1 = (float)(source->x + source->w) / w;
+			s.v1 = (float)(source->y + source->h) / h;
+		}
+	}
+	s.batch = findBatch(s);
+
+	if (s.batch < 0)
+	{
+		batch b;
+		b.texture = texture;
+		b.bounds = dest;
+		b.count = 0;
+		b.first = 0;
+		b.last = -1;
+		mBatches.push_back(b);
+		s.batch = (int)mBatches.size() - 1;
+	}
+	else
+	{
+		SDL_UnionRect(&mBatches[s.batch].bounds, &dest, &mBatches[s.batch].bounds);
+	}
+	mBatches[s.batch].count++;
+	s.previous = mBatches[s.batch].last;
+	mBatches[s.batch].last = (int)mSprites.size();
+	mSprites.push_back(s);
 }
 
+int SpriteBatch::findBatch(sprite& s)
+{
+	/*
+		Walk back through the batches. A sprite may join an earlier batch with its texture
+		as long as it doesn't overlap anything that is drawn after that batch.
+	*/
+	for (int b = (int)mBatches.size() - 1; b >= 0; b--)
+	{
+		if (mBatches[b].texture == s.texture)
+		{
+			return b;
+		}
+		if (SDL_HasIntersection(&mBatches[b].bounds, &s.dest))
+		{
+			/* Only the batch's own sprites are checked, not the whole frame */
+			for (int i = mBatches[b].last; i >= 0; i = mSprites[i].previous)
+			{
+				if (SDL_HasIntersection(&mSprites[i].dest, &s.dest))
+				{
+					return -1;
+				}
+			}
+		}
+	}
+	return -1;
+}
 
-AssetManager::AssetManager()
+void SpriteBatch::flush(SDL_Renderer* renderer)
 {
-	Close(); /* Null init pointers */
+	mLastSprites = (int)mSprites.size();
+	mLastDrawCalls = 0;
+
+	/* Counting sort of the sprites by batch. z-order holds inside each batch. */
+	int offset = 0;
+	for (size_t b = 0; b < mBatches.size(); b++)
+	{
+		mBatches[b].first = offset;
+		offset += mBatches[b].count;
+		mBatches[b].count = 0;
+	}
+	mOrder.resize(mSprites.size());
+	for (size_t i = 0; i < mSprites.size(); i++)
+	{
+		batch& b = mBatches[mSprites[i].batch];
+		mOrder[b.first + b.count++] = (int)i;
+	}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	/* Two triangles per sprite. The index pattern is shared by every draw call. */
+	mVertices.resize(mSprites.size() * 4);
+	while (mIndices.size() < mSprites.size() * 6)
+	{
+		int v = (int)(mIndices.size() / 6) * 4;
+		mIndices.push_back(v);
+		mIndices.push_back(v + 1);
+		mIndices.push_back(v + 2);
+		mIndices.push_back(v + 2);
+		mIndices.push_back(v + 1);
+		mIndices.push_back(v + 3);
+	}
+
+	for (size_t i = 0; i < mOrder.size(); i++)
+	{
+		sprite& s = mSprites[mOrder[i]];
+		SDL_Rect& d = s.dest;
+		SDL_Vertex* v = &mVertices[i * 4];
+		for (int corner = 0; corner < 4; corner++)
+		{
+			float u = (float)(corner & 1);
+			float t = (float)(corner >> 1);
+			v[corner].position.x = (float)d.x + u * (float)d.w;
+			v[corner].position.y = (float)d.y + t * (float)d.h;
+			v[corner].color.r =
+				v[corner].color.g =
+				v[corner].color.b =
+				v[corner].color.a = 0xFF;
+			v[corner].tex_coord.x = s.u0 + u * (s.u1 - s.u0);
+			v[corner].tex_coord.y = s.v0 + t * (s.v1 - s.v0);
+		}
+	}
 
-	/* The whole deck is in the draw pile for the first tick. */
-	mHeldCards[0] = 52;
-	for (int i = 1; i < CARD_RANKS; i++)
+	for (size_t b = 0; b < mBatches.size(); b++)
+	{
+		SDL_RenderGeometry(renderer, mBatches[b].texture, &mVertices[mBatches[b].first * 4],
+			mBatches[b].count * 4, &mIndices[0], mBatches[b].count * 6);
+		mLastDrawCalls++;
+	}
+#else
+	for (size_t i = 0; i < mOrder.size(); i++)
 	{
-		mHeldCards[i] = 0;
+		sprite& s = mSprites[mOrder[i]];
+		SDL_RenderCopy(renderer, s.texture, s.clipped ? &s.source : NULL, &s.dest);
+		mLastDrawCalls++;
 	}
+#endif
+
+	begin();
 }
 
-AssetManager::~AssetManager()
+
+GlyphAtlas::GlyphAtlas()
 {
-	/* Deallocate */
-	mFPSTextTexture.free();
-	mDeckTexture.free();
-	mBackgroundTexture.free();
+	mSurface = NULL;
+	mTexture = NULL;
+	mHeight = 0;
+	for (int i = 0; i <= LAST - FIRST; i++)
+	{
+		mGlyphs[i].x =
+			mGlyphs[i].y =
+			mGlyphs[i].w =
+			mGlyphs[i].h = 0;
+		mAdvance[i] = 0;
+	}
+}
 
-	/* Free the font */
-	TTF_CloseFont(mFont);
+GlyphAtlas::~GlyphAtlas()
+{
+	free();
+}
 
-	/* Free the sound effects */
-	Mix_FreeChunk(mSound);
+bool GlyphAtlas::load(TTF_Font* font, SDL_Color color, SDL_Renderer* renderer)
+{
+	free();
+	if (!font)
+	{
+		return false;
+	}
 
-	/* Destroy window */
-	mWindow.free();
-	SDL_DestroyRenderer(mRenderer);
+	/* Render each glyph on its own, then pack them into one row */
+	SDL_Surface* glyphs[LAST - FIRST + 1];
+	int width = 0;
+	mHeight = TTF_FontHeight(font);
+	for (int i = 0; i <= LAST - FIRST; i++)
+	{
+		int minX, maxX, minY, maxY;
+		if (TTF_GlyphMetrics(font, (Uint16)(FIRST + i), &minX, &maxX, &minY, &maxY, &mAdvance[i]) < 0)
+		{
+			mAdvance[i] = 0;
+		}
+		glyphs[i] = TTF_RenderGlyph_Blended(font, (Uint16)(FIRST + i), color);
+		int w = glyphs[i] ? glyphs[i]->w : 0;
+		mGlyphs[i].x = width;
+		mGlyphs[i].y = 0;
+		mGlyphs[i].w = w;
+		mGlyphs[i].h = glyphs[i] ? glyphs[i]->h : 0;
+		width += w;
+	}
 
-	/* NULL out pointers */
-	Close();
+	bool success = (width > 0) && (mHeight > 0);
+	if (success)
+	{
+		mSurface = SDL_CreateRGBSurfaceWithFormat(0, width, mHeight, 32, SDL_PIXELFORMAT_ARGB8888);
+		success = mSurface != NULL;
+	}
+	if (!success)
+	{
+		printf("The glyph atlas could not be made!\nSDL Error: %s\n", SDL_GetError());
+	}
+	else
+	{
+		SDL_FillRect(mSurface, NULL, 0);
+		for (int i = 0; i <= LAST - FIRST; i++)
+		{
+			if (glyphs[i])
+			{
+				/* Copy the coverage as it is, instead of blending it over nothing */
+				SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+				SDL_BlitSurface(glyphs[i], NULL, mSurface, &mGlyphs[i]);
+			}
+		}
+		SDL_SetSurfaceBlendMode(mSurface, SDL_BLENDMODE_BLEND);
+	}
+	for (int i = 0; i <= LAST - FIRST; i++)
+	{
+		SDL_FreeSurface(glyphs[i]);
+	}
 
-	/* Quit SDL subsystems */
-	Mix_CloseAudio();
-	TTF_Quit();
-	IMG_Quit();
-	SDL_Quit();
+	if (success && renderer)
+	{
+		mTexture = SDL_CreateTextureFromSurface(renderer, mSurface);
+		if (!mTexture)
+		{
+			printf("The glyph texture could not be created!\nSDL Error: %s\n", SDL_GetError());
+			success = false;
+		}
+		else
+		{
+			SDL_SetTextureBlendMode(mTexture, SDL_BLENDMODE_BLEND);
+		}
+	}
+	return success;
 }
 
-bool AssetManager::Init()
+void GlyphAtlas::free()
 {
-	bool success = true;
+	if (mTexture)
+	{
+		SDL_DestroyTexture(mTexture);
+		mTexture = NULL;
+	}
+	SDL_FreeSurface(mSurface);
+	mSurface = NULL;
+}
+
+int GlyphAtlas::glyphOf(char c)
+{
+	return ((c < FIRST) || (c > LAST)) ? 0 : c - FIRST;
+}
+
+int GlyphAtlas::measure(const char* text)
+{
+	int width = 0;
+	for (const char* c = text; *c; c++)
+	{
+		width += mAdvance[glyphOf(*c)];
+	}
+	return width;
+}
+
+void GlyphAtlas::draw(SpriteBatch* batch, const char* text, int x, int y)
+{
+	if (!mTexture)
+	{
+		return;
+	}
+	for (const char* c = text; *c; c++)
+	{
+		int glyph = glyphOf(*c);
+		if (mGlyphs[glyph].w)
+		{
+			SDL_Rect dest = { x, y, mGlyphs[glyph].w, mGlyphs[glyph].h };
+			batch->add(mTexture, dest, &mGlyphs[glyph]);
+		}
+		x += mAdvance[glyph];
+	}
+}
+
+void GlyphAtlas::blit(SDL_Surface* target, const char* text, int x, int y)
+{
+	if (!mSurface)
+	{
+		return;
+	}
+	for (const char* c = text; *c; c++)
+	{
+		int glyph = glyphOf(*c);
+		if (mGlyphs[glyph].w)
+		{
+			SDL_Rect dest = { x, y, mGlyphs[glyph].w, mGlyphs[glyph].h };
+			SDL_BlitSurface(mSurface, &mGlyphs[glyph], target, &dest);
+		}
+		x += mAdvance[glyph];
+	}
+}
+
+/* Where each image is loaded from, numbered like cardStore::texture */
+std::string softImagePath(int image)
+{
+	if (image == SOFT_BACKGROUND_IMAGE)
+	{
+		return "table.png";
+	}
+	if (image == SOFT_OUTLINE_IMAGE)
+	{
+		return "cards/outline.png";
+	}
+	if (image == CARD_BACK_TEXTURE)
+	{
+		return "cards/back.png";
+	}
+	std::stringstream filename;
+	filename << "cards/" << nameOfSuit(suitOf(image - 1)) << "/" << valueOf(image - 1) << ".png";
+	return filename.str();
+}
+
+SoftRenderer::SoftRenderer()
+{
+	/* Workers are only started for -software */
+	mRaster = new SoftRasterizer(1);
+	mPaintFaces = false;
+	mStaticVersion = 0;
+	mStaticCount = 0;
+	mConverted = NULL;
+	mFrameSurface = NULL;
+	mFrameW = mFrameH = 0;
+	mFrameCardW = mFrameCardH = 0;
+	mFrameRestingCount = mFrameMovingCount = 0;
+	mOverlayCount = 0;
+	SDL_AtomicSet(&mExposed, 0);
+	mFrames = mPixelsDrawn = mPixelsInFrames = 0;
+}
+
+SoftRenderer::~SoftRenderer()
+{
+	delete mRaster;
+	SDL_FreeSurface(mConverted);
+}
+
+bool SoftRenderer::load(bool proceduralFaces)
+{
+	bool success = true;
+	mPaintFaces = proceduralFaces;
+
+	if (!loadImage(SOFT_BACKGROUND_IMAGE, softImagePath(SOFT_BACKGROUND_IMAGE)))
+	{
+		printf("The background image could not be loaded!\n");
+		success = false;
+	}
+	if (!loadImage(CARD_BACK_TEXTURE, softImagePath(CARD_BACK_TEXTURE)))
+	{
+		printf("The deck image could not be loaded!\n");
+		success = false;
+	}
+	if (!loadImage(SOFT_OUTLINE_IMAGE, softImagePath(SOFT_OUTLINE_IMAGE)))
+	{
+		printf("The outline image could not be loaded!\n");
+		success = false;
+	}
+
+	/* Painted faces are made when they're first drawn, at the card size */
+	for (int n = 0; n < NUM_CARDS && !proceduralFaces; n++)
+	{
+		if (!loadImage(n + 1, softImagePath(n + 1)))
+		{
+			printf("The image could not be loaded for the %i of %s!\n", valueOf(n), nameOfSuit(suitOf(n)));
+			success = false;
+			break;
+		}
+	}
+	return success;
+}
+
+bool SoftRenderer::loadImage(int image, std::string path)
+{
+	SDL_Surface* loadedSurface = IMG_Load(path.c_str());
+	if (!loadedSurface)
+	{
+		printf("This image could not be loaded: %s\nSDL_image Error: %s\n", path.c_str(), IMG_GetError());
+		return false;
+	}
+
+	SDL_Surface* converted = SDL_ConvertSurfaceFormat(loadedSurface, SDL_PIXELFORMAT_ARGB8888, 0);
+	SDL_FreeSurface(loadedSurface);
+	if (!converted)
+	{
+		printf("%s could not be converted!\nSDL Error: %s\n", path.c_str(), SDL_GetError());
+		return false;
+	}
+	premultiplyKeyed(converted, SDL_MapRGB(converted->format, TRANSPARENT_COLOR) & 0x00FFFFFF);
+
+	softImage& native = mNative[image];
+	native.width = converted->w;
+	native.height = converted->h;
+	native.pixels.resize(native.width * native.height);
+	for (int y = 0; y < native.height; y++)
+	{
+		memcpy(&native.pixels[y * native.width], (Uint8*)converted->pixels + y * converted->pitch, native.width * 4);
+	}
+	SDL_FreeSurface(converted);
+	classifyImage(native);
+
+	mSized[image].width = 0; /* Scale it again */
+	return true;
+}
+
+void SoftRenderer::setThreads(int threads)
+{
+	delete mRaster;
+	mRaster = new SoftRasterizer(threads > 1 ? threads : 1);
+}
+
+const softImage* SoftRenderer::sized(int image, int width, int height)
+{
+	softImage& out = mSized[image];
+	if ((out.width == width) && (out.height == height))
+	{
+		return &out;
+	}
+
+	if (mPaintFaces && (image != CARD_BACK_TEXTURE) && (image <= NUM_CARDS) && (width > 0) && (height > 0))
+	{
+		cardFace face = { suitOf(image - 1), valueOf(image - 1) };
+		out.width = width;
+		out.height = height;
+		out.pixels.resize(width * height);
+		CardPainter::paint(&out.pixels[0], width, width, height, face);
+		classifyImage(out);
+	}
+	else
+	{
+		mRaster->scale(mNative[image], out, width, height);
+	}
+	return &out;
+}
+
+void SoftRenderer::addTable(tableSnapshot* snapshot)
+{
+	mRaster->add(sized(SOFT_BACKGROUND_IMAGE, snapshot->width, snapshot->height), 0, 0);
+
+	const softImage* outline = sized(SOFT_OUTLINE_IMAGE, snapshot->cardW, snapshot->cardH);
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		if (i != 1) /* No outline for the discard pile */
+		{
+			mRaster->add(outline, snapshot->places[i].x, snapshot->places[i].y);
+		}
+	}
+
+	for (int i = 0; i < snapshot->restingCount; i++)
+	{
+		cardSprite& card = snapshot->resting[i];
+		mRaster->add(sized(card.image, snapshot->cardW, snapshot->cardH), card.x, card.y);
+	}
+}
+
+void SoftRenderer::diffSprites(DamageList& damage, drawnSprite* drawn, int& drawnCount, const cardSprite* sprites, int count, int cardW, int cardH)
+{
+	int most = (count > drawnCount) ? count : drawnCount;
+	for (int i = 0; i < most; i++)
+	{
+		if (i < drawnCount)
+		{
+			if ((i < count) && (drawn[i].image == sprites[i].image) && (drawn[i].x == sprites[i].x) && (drawn[i].y == sprites[i].y))
+			{
+				continue;
+			}
+			damage.add(drawn[i].x, drawn[i].y, cardW, cardH);
+		}
+		if (i < count)
+		{
+			damage.add(sprites[i].x, sprites[i].y, cardW, cardH);
+			drawn[i].image = sprites[i].image;
+			drawn[i].x = sprites[i].x;
+			drawn[i].y = sprites[i].y;
+		}
+	}
+	drawnCount = count;
+}
+
+void SoftRenderer::draw(uint32_t* pixels, int pitch, int width, int height, tableSnapshot* snapshot, bool cacheStatic, const DamageList* damage)
+{
+	if (cacheStatic)
+	{
+		bool resized = (mStatic.width != width) || (mStatic.height != height);
+		if (resized || (mStaticVersion != snapshot->boardVersion))
+		{
+			/* A move only changes a few pile tops, so only they are drawn again */
+			mStaticDamage.reset(width, height);
+			if (resized)
+			{
+				mStaticDamage.addAll();
+			}
+			diffSprites(mStaticDamage, mStaticSprites, mStaticCount, snapshot->resting, snapshot->restingCount, snapshot->cardW, snapshot->cardH);
+
+			mStatic.width = width;
+			mStatic.height = height;
+			mStatic.pixels.resize(width * height);
+			mRaster->begin(&mStatic.pixels[0], width, width, height, SOFT_BGCOLOR);
+			addTable(snapshot);
+			mRaster->flush(mStaticDamage);
+
+			if (resized)
+			{
+				/* The clear color is solid, so every row is a straight copy */
+				mStatic.spans.resize(height * 4);
+				for (int y = 0; y < height; y++)
+				{
+					int* span = &mStatic.spans[y * 4];
+					span[0] = span[2] = 0;
+					span[1] = span[3] = width;
+				}
+				mStatic.opaque = true;
+			}
+			mStaticVersion = snapshot->boardVersion;
+		}
+		mRaster->begin(pixels, pitch, width, height, SOFT_BGCOLOR);
+		mRaster->add(&mStatic, 0, 0);
+	}
+	else
+	{
+		mRaster->begin(pixels, pitch, width, height, SOFT_BGCOLOR);
+		addTable(snapshot);
+	}
+
+	for (int i = 0; i < snapshot->movingCount; i++)
+	{
+		cardSprite& card = snapshot->moving[i];
+		mRaster->add(sized(card.image, snapshot->cardW, snapshot->cardH), card.x, card.y);
+	}
+	if (damage)
+	{
+		mRaster->flush(*damage);
+	}
+	else
+	{
+		mRaster->flush();
+	}
+}
+
+void SoftRenderer::findDamage(tableSnapshot* snapshot, int width, int height, bool all)
+{
+	mDamage.reset(width, height);
+	if (all || (width != mFrameW) || (height != mFrameH) || (snapshot->cardW != mFrameCardW) || (snapshot->cardH != mFrameCardH))
+	{
+		mDamage.addAll();
+	}
+	for (int i = 0; i < CARD_RANKS && !mDamage.isAll(); i++)
+	{
+		if ((snapshot->places[i].x != mFramePlaces[i].x) || (snapshot->places[i].y != mFramePlaces[i].y))
+		{
+			mDamage.addAll();
+		}
+	}
+
+	/* Where cards were and are */
+	diffSprites(mDamage, mFrameResting, mFrameRestingCount, snapshot->resting, snapshot->restingCount, snapshot->cardW, snapshot->cardH);
+	diffSprites(mDamage, mFrameMoving, mFrameMovingCount, snapshot->moving, snapshot->movingCount, snapshot->cardW, snapshot->cardH);
+	for (int i = 0; i < mOverlayCount; i++)
+	{
+		mDamage.add(mOverlays[i].x, mOverlays[i].y, mOverlays[i].w, mOverlays[i].h);
+	}
+	mOverlayCount = 0;
+
+	mFrameW = width;
+	mFrameH = height;
+	mFrameCardW = snapshot->cardW;
+	mFrameCardH = snapshot->cardH;
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		mFramePlaces[i] = snapshot->places[i];
+	}
+}
+
+void SoftRenderer::damage(int x, int y, int width, int height)
+{
+	if (mOverlayCount < MAX_OVERLAYS)
+	{
+		softRect& overlay = mOverlays[mOverlayCount++];
+		overlay.x = x;
+		overlay.y = y;
+		overlay.w = width;
+		overlay.h = height;
+	}
+	else
+	{
+		damageAll();
+	}
+}
+
+SDL_Surface* SoftRenderer::drawToWindow(SDL_Window* window, tableSnapshot* snapshot, FrameRecorder* recorder)
+{
+	SDL_Surface* surface = SDL_GetWindowSurface(window);
+	if (!surface)
+	{
+		printf("The window surface could not be found!\nSDL Error: %s\n", SDL_GetError());
+		return NULL;
+	}
+
+	/* Draw straight into the window when its pixels are laid out the same, alpha or not */
+	SDL_Surface* target = surface;
+	/* The last frame is still there unless the surface is new or was uncovered */
+	bool all = (surface != mFrameSurface) || SDL_AtomicGet(&mExposed);
+	SDL_AtomicSet(&mExposed, 0);
+	if ((surface->format->BytesPerPixel != 4) || (surface->format->Rmask != 0x00FF0000) ||
+		(surface->format->Gmask != 0x0000FF00) || (surface->format->Bmask != 0x000000FF))
+	{
+		if (!mConverted || (mConverted->w != surface->w) || (mConverted->h != surface->h))
+		{
+			SDL_FreeSurface(mConverted);
+			mConverted = SDL_CreateRGBSurfaceWithFormat(0, surface->w, surface->h, 32, SDL_PIXELFORMAT_ARGB8888);
+			if (!mConverted)
+			{
+				printf("The frame surface could not be created!\nSDL Error: %s\n", SDL_GetError());
+				return NULL;
+			}
+			SDL_SetSurfaceBlendMode(mConverted, SDL_BLENDMODE_NONE);
+			all = true;
+		}
+		target = mConverted;
+	}
+
+	if (SDL_MUSTLOCK(target) && (SDL_LockSurface(target) < 0))
+	{
+		printf("The window surface could not be locked!\nSDL Error: %s\n", SDL_GetError());
+		return NULL;
+	}
+	findDamage(snapshot, target->w, target->h, all);
+	draw((uint32_t*)target->pixels, target->pitch / 4, target->w, target->h, snapshot, true, &mDamage);
+	if (recorder && recorder->isRecording())
+	{
+		recorder->capturePixels(target->pixels, target->pitch, target->w, target->h);
+	}
+	if (SDL_MUSTLOCK(target))
+	{
+		SDL_UnlockSurface(target);
+	}
+
+	if ((target != surface) && mDamage.isAll())
+	{
+		SDL_BlitSurface(target, NULL, surface, NULL);
+	}
+	else if (target != surface)
+	{
+		for (int i = 0; i < mDamage.getCount(); i++)
+		{
+			const softRect& damaged = mDamage.getRects()[i];
+			SDL_Rect rect = { damaged.x, damaged.y, damaged.w, damaged.h };
+			SDL_Rect to = rect; /* The blit clips this one */
+			SDL_BlitSurface(target, &rect, surface, &to);
+		}
+	}
+	mFrameSurface = surface;
+
+	mFrames++;
+	mPixelsDrawn += mDamage.isAll() ? (Uint64)target->w * target->h : (Uint64)mDamage.getArea();
+	mPixelsInFrames += (Uint64)target->w * target->h;
+	return surface;
+}
+
+void SoftRenderer::present(SDL_Window* window)
+{
+	int result = 0;
+	if (mDamage.isAll())
+	{
+		result = SDL_UpdateWindowSurface(window);
+	}
+	else if (!mDamage.isEmpty())
+	{
+		for (int i = 0; i < mDamage.getCount(); i++)
+		{
+			const softRect& damaged = mDamage.getRects()[i];
+			mShownRects[i].x = damaged.x;
+			mShownRects[i].y = damaged.y;
+			mShownRects[i].w = damaged.w;
+			mShownRects[i].h = damaged.h;
+		}
+		result = SDL_UpdateWindowSurfaceRects(window, mShownRects, mDamage.getCount());
+	}
+	if (result < 0)
+	{
+		printf("The window surface could not be shown!\nSDL Error: %s\n", SDL_GetError());
+	}
+}
+
+void SoftRenderer::printStats()
+{
+	if (mFrames && mPixelsInFrames)
+	{
+		printf("Software frames: %llu, drawing %.1f%% of the window on average\n",
+			(unsigned long long)mFrames, 100.0 * mPixelsDrawn / mPixelsInFrames);
+	}
+}
+
+void SoftRenderer::dropScaled()
+{
+	for (int i = 0; i < NUM_SOFT_IMAGES; i++)
+	{
+		mSized[i].width =
+			mSized[i].height = 0;
+	}
+	mStatic.width =
+		mStatic.height = 0;
+	mFrameSurface = NULL; /* Draw all of the next frame */
+}
+
+
+Card::Card()
+{
+	mStore = NULL;
+	mIndex = 0;
+	mTable = NULL;
+}
+
+void Card::handleEvent(SDL_Event& e)
+{
+	cardStore& c = *mStore;
+	int i = mIndex;
+
+	if (e.type == SDL_MOUSEMOTION)
+	{
+		if (c.flags[i] & CARD_DRAGGING)
+		{
+			/* The mouse position travels with the event */
+			c.posX[i] = e.motion.x + c.offsetX[i];
+			c.posY[i] = e.motion.y + c.offsetY[i];
+			mTable->traceInput();
+		}
+	}
+
+	if (e.type == SDL_MOUSEBUTTONDOWN)
+	{
+		/* A down while a run is held means the up was missed, so wait for one */
+		if ((e.button.button == SDL_BUTTON_LEFT) && (c.flags[i] & CARD_CLICKABLE) && !mTable->getDragBase())
+		{
+			/* Get mouse position */
+			int x = e.button.x;
+			int y = e.button.y;
+			if (mTable->cardAt(x, y) == this) /* Fanned cards overlap, so only the top one counts */
+			{
+				Uint32 newClickTime = e.button.timestamp; /* Not the clock, so replayed input clicks the same way */
+				if (c.flags[i] & CARD_FACE_UP)
+				{
+					/* If the last click was recent */
+					if (newClickTime - DOUBLECLICK_DELAY <= c.lastClickTime[i])
+					{
+						//Try to auto-move
+					}
+					else /* Maybe this else should be like an if(!automove) ? */
+					{
+						mTable->beginDrag(this, x, y); /* Takes the cards on top along */
+					}
+				}
+				else
+				{
+					if (c.rank[i] == STOCK_RANK)
+					{
+						dealTo(WASTE_RANK);
+					}
+					flip();
+				}
+				c.lastClickTime[i] = newClickTime;
+			}
+		}
+	}
+
+	if (e.type == SDL_MOUSEBUTTONUP)
+	{
+		if (e.button.button == SDL_BUTTON_LEFT)
+		{
+			/* The whole run lands with its bottom card */
+			if ((c.flags[i] & CARD_DRAGGING) && (mTable->getDragBase() == this))
+			{
+				mTable->getSounds()->play(SOUND_DROP);
+				land();
+			}
+		}
+	}
+}
+
+void Card::flip()
+{
+	cardStore& c = *mStore;
+	c.flags[mIndex] ^= CARD_FACE_UP;
+	if (c.flags[mIndex] & CARD_FACE_UP)
+	{
+		c.flags[mIndex] |= CARD_SEEN;
+		c.texture[mIndex] = codeOf(c.face[mIndex]) + 1;
+		mTable->getFacePager()->prefetch(codeOf(c.face[mIndex])); /* Drawn within a frame or two */
+	}
+	else
+	{
+		c.texture[mIndex] = CARD_BACK_TEXTURE;
+	}
+	mTable->invalidateBoard();
+	mTable->getSounds()->play(SOUND_FLIP);
+}
+
+void Card::setFlag(int flag, bool state)
+{
+	if (state)
+	{
+		mStore->flags[mIndex] |= flag;
+	}
+	else
+	{
+		mStore->flags[mIndex] &= ~flag;
+	}
+}
+
+void Card::rest(point* slot)
+{
+	cardStore& c = *mStore;
+	if (!(c.flags[mIndex] & (CARD_DRAGGING | CARD_SLIDING)))
+	{
+		c.posX[mIndex] = slot->x;
+		c.posY[mIndex] = slot->y;
+		if (c.rank[mIndex] >= FIRST_TABLEAU)
+		{
+			c.posY[mIndex] += (c.file[mIndex] * (mTable->getCardHeight() / 10 ));
+		}
+	}
+}
+
+void Card::setRank(int rank)
+{
+	if (0 > rank || rank >= CARD_RANKS)
+	{
+		rank = 0;
+	}
+	mStore->rank[mIndex] = rank;
+	mStore->destRank[mIndex] = rank;
+}
+void Card::setFile(int file)
+{
+	if (0 > file || file >= NUM_CARDS)
+	{
+		file = 0;
+	}
+	mStore->file[mIndex] = file;
+}
+
+void Card::setClickability(bool state)
+{
+	setFlag(CARD_CLICKABLE, state);
+}
+
+void Card::setFace(cardFace face)
+{
+	if (((face.suit >= SPADES) && (face.suit < NUM_SUITS)) &&
+		((face.value >= ACE) && (face.value <= KING)))
+	{
+		mStore->face[mIndex] = face;
+		if (getFlipState())
+		{
+			mStore->texture[mIndex] = codeOf(face) + 1;
+		}
+	}
+}
+
+void Card::pickUp(int x, int y)
+{
+	cardStore& c = *mStore;
+	c.flags[mIndex] |= CARD_DRAGGING;
+	c.offsetX[mIndex] = c.posX[mIndex] - x;
+	c.offsetY[mIndex] = c.posY[mIndex] - y;
+}
+
+void Card::putDown()
+{
+	cardStore& c = *mStore;
+	c.flags[mIndex] &= ~CARD_DRAGGING;
+	c.offsetX[mIndex] = 0;
+	c.offsetY[mIndex] = 0;
+}
+
+void Card::dealTo(int rank)
+{
+	cardStore& c = *mStore;
+	if ((0 <= rank) && (rank < CARD_RANKS))
+	{
+		int from = c.rank[mIndex];
+		if (from != rank)
+		{
+			c.destRank[mIndex] = rank;
+			c.flags[mIndex] |= CARD_SLIDING;
+			mTable->invalidateBoard();
+			mTable->getSounds()->play(SOUND_DEAL);
+			if (mTable->options()->animation)
+			{
+				c.velY[mIndex] = CARD_VEL;
+				c.velX[mIndex] = CARD_VEL;
+				if (mTable->getCardPlace(rank)->y < mTable->getCardPlace(from)->y) //BUGBUG: Head a little further down for each card that is already there
+				{
+					c.velY[mIndex] *= -1;
+				}
+				if (mTable->getCardPlace(rank)->x < mTable->getCardPlace(from)->x)
+				{
+					c.velX[mIndex] *= -1;
+				}
+			}
+		}
+	}
+}
+
+void Card::setDestRank(int rank)
+{
+	if ((0 > rank) || (rank >= CARD_RANKS))
+	{
+		rank = 0;
+	}
+	mStore->destRank[mIndex] = rank;
+}
+
+void Card::land()
+{
+	mTable->cardDrop(this);
+}
+
+void Card::assocGame(AssetManager& game, cardStore& store, int index)
+{
+	mTable = &game;
+	mStore = &store;
+	mIndex = index;
+	mTable->registerCard(this);
+}
+
+
+Pile::Pile()
+{
+	mCount =
+		mRank = 0;
+}
+
+void Pile::push(Card* card)
+{
+	mCards[mCount] = card;
+	card->setRank(mRank);
+	card->setFile(mCount);
+	mCount++;
+}
+
+Card* Pile::pop()
+{
+	return mCount ? mCards[--mCount] : NULL;
+}
+
+void Pile::remove(int file)
+{
+	if ((file < 0) || (file >= mCount))
+	{
+		return;
+	}
+	memmove(&mCards[file], &mCards[file + 1], (mCount - file - 1) * sizeof(Card*));
+	mCount--;
+	reseat(file);
+}
+
+void Pile::splice(Pile& to, int count)
+{
+	if ((count < 1) || (count > mCount))
+	{
+		return;
+	}
+	int file = to.mCount;
+	memcpy(&to.mCards[file], &mCards[mCount - count], count * sizeof(Card*));
+	to.mCount += count;
+	mCount -= count;
+	to.reseat(file);
+}
+
+void Pile::spliceReversed(Pile& to, int count)
+{
+	if ((count < 1) || (count > mCount))
+	{
+		return;
+	}
+	int file = to.mCount;
+	for (int i = 0; i < count; i++)
+	{
+		to.mCards[file + i] = mCards[mCount - 1 - i];
+	}
+	to.mCount += count;
+	mCount -= count;
+	to.reseat(file);
+}
+
+void Pile::reseat(int file)
+{
+	for (int i = file; i < mCount; i++)
+	{
+		mCards[i]->setRank(mRank);
+		mCards[i]->setFile(i);
+	}
+}
+
+
+SoundBoard::SoundBoard()
+{
+	for (int i = 0; i < NUM_SOUNDS; i++)
+	{
+		mChunks[i] = NULL;
+		mSamples[i] = NULL;
+	}
+	for (int i = 0; i < CHANNELS; i++)
+	{
+		mChannelStarts[i] = 0;
+	}
+	mFrequency =
+		mChannels =
+		mBufferSamples = 0;
+	mFormat = 0;
+	mOpen = false;
+	for (int i = 0; i < NUM_SOUNDS; i++)
+	{
+		mSoundStarts[i] = 0;
+	}
+	mMixStart = 0;
+	mMixUs = 0;
+	SDL_AtomicSet(&mMixes, 0);
+	SDL_AtomicSet(&mOverruns, 0);
+	SDL_AtomicSet(&mWorstMixUs, 0);
+	mVoicesStolen =
+		mSoundsDropped = 0;
+}
+
+bool SoundBoard::open(int bufferMs)
+{
+	/* SDL wants a power of two, so round up */
+	int wanted = max(AUDIO_FREQUENCY * bufferMs / 1000, 64);
+	int samples = 64;
+	while (samples < wanted)
+	{
+		samples *= 2;
+	}
+
+	if (Mix_OpenAudio(AUDIO_FREQUENCY, MIX_DEFAULT_FORMAT, MIX_DEFAULT_CHANNELS, samples) < 0)
+	{
+		printf("SDL_mixer could not initialize!\nSDL_mixer Error: %s\n", Mix_GetError());
+		return false;
+	}
+	mOpen = true;
+	mBufferSamples = samples;
+
+	/* The device may not have given us what we asked for */
+	Mix_QuerySpec(&mFrequency, &mFormat, &mChannels);
+	Mix_AllocateChannels(CHANNELS);
+	Mix_HookMusic(preMix, this);
+	Mix_SetPostMix(postMix, this);
+
+	/* Nothing has played yet */
+	for (int i = 0; i < NUM_SOUNDS; i++)
+	{
+		mSoundStarts[i] = SDL_GetTicks() - SOUND_REPEAT_MS;
+	}
+	return true;
+}
+
+bool SoundBoard::load()
+{
+	const char* names[NUM_SOUNDS] = { "deal", "flip", "drop", "win" };
+	bool success = true;
+
+	for (int i = 0; i < NUM_SOUNDS; i++)
+	{
+		std::stringstream filename;
+		filename << "sounds/" << names[i] << ".wav";
+
+		SDL_AudioSpec spec;
+		Uint8* wav = NULL;
+		Uint32 length = 0;
+		if (!SDL_LoadWAV(filename.str().c_str(), &spec, &wav, &length))
+		{
+			/* Themes without their own effects fall back to the example sound */
+			if (!SDL_LoadWAV("fire.wav", &spec, &wav, &length))
+			{
+				printf("The %s sound effect could not be loaded!\nSDL Error: %s\n", names[i], SDL_GetError());
+				success = false;
+				continue;
+			}
+		}
+
+		/* Convert once now so the mixer only has to copy */
+		SDL_AudioCVT cvt;
+		if (SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq, mFormat, (Uint8)mChannels, mFrequency) < 0)
+		{
+			printf("The %s sound effect could not be converted!\nSDL Error: %s\n", names[i], SDL_GetError());
+			SDL_FreeWAV(wav);
+			success = false;
+			continue;
+		}
+		cvt.len = (int)length;
+		cvt.buf = (Uint8*)SDL_malloc(cvt.len * cvt.len_mult);
+		if (!cvt.buf)
+		{
+			SDL_FreeWAV(wav);
+			success = false;
+			continue;
+		}
+		memcpy(cvt.buf, wav, length);
+		SDL_FreeWAV(wav);
+		SDL_ConvertAudio(&cvt);
+
+		mSamples[i] = cvt.buf;
+		mChunks[i] = Mix_QuickLoad_RAW(cvt.buf, (Uint32)cvt.len_cvt);
+		if (!mChunks[i])
+		{
+			printf("The %s sound effect could not be loaded!\nSDL_mixer Error: %s\n", names[i], Mix_GetError());
+			success = false;
+		}
+	}
+	return success;
+}
+
+void SoundBoard::play(int sound)
+{
+	if (!mOpen || (sound < 0) || (sound >= NUM_SOUNDS) || !mChunks[sound])
+	{
+		return;
+	}
+
+	/* Dealing moves 28 cards at once, which should be heard as one deal */
+	Uint32 now = SDL_GetTicks();
+	if (now - mSoundStarts[sound] < SOUND_REPEAT_MS)
+	{
+		mSoundsDropped++;
+		return;
+	}
+	mSoundStarts[sound] = now;
+
+	int channel = Mix_PlayChannel(-1, mChunks[sound], 0);
+	if (channel < 0)
+	{
+		/* Every channel is busy, so steal the one that has played longest */
+		channel = 0;
+		for (int i = 1; i < CHANNELS; i++)
+		{
+			if (mChannelStarts[i] < mChannelStarts[channel])
+			{
+				channel = i;
+			}
+		}
+		Mix_HaltChannel(channel);
+		channel = Mix_PlayChannel(channel, mChunks[sound], 0);
+		mVoicesStolen++;
+	}
+	if ((channel >= 0) && (channel < CHANNELS))
+	{
+		mChannelStarts[channel] = now;
+	}
+}
+
+void SoundBoard::close()
+{
+	if (!mOpen)
+	{
+		return;
+	}
+	Mix_SetPostMix(NULL, NULL);
+	Mix_HookMusic(NULL, NULL);
+	Mix_HaltChannel(-1);
+	for (int i = 0; i < NUM_SOUNDS; i++)
+	{
+		Mix_FreeChunk(mChunks[i]); /* Quick-loaded chunks don't own their samples */
+		SDL_free(mSamples[i]);
+		mChunks[i] = NULL;
+		mSamples[i] = NULL;
+	}
+	Mix_CloseAudio();
+	mOpen = false;
+}
+
+void SoundBoard::printStats()
+{
+	if (!mOpen)
+	{
+		return;
+	}
+	int mixes = SDL_AtomicGet(&mMixes);
+	printf("Audio: %i Hz, %i samples per buffer (%.1f ms), %i mixes averaging %.3f ms, worst %.3f ms, %i overran, %i voices stolen, %i repeats dropped\n",
+		mFrequency, mBufferSamples, mBufferSamples * 1000.0 / mFrequency, mixes, mixes ? mMixUs.load() / 1000.0 / mixes : 0.0,
+		SDL_AtomicGet(&mWorstMixUs) / 1000.0, SDL_AtomicGet(&mOverruns), mVoicesStolen, mSoundsDropped);
+}
+
+void SDLCALL SoundBoard::preMix(void* udata, Uint8* /* stream */, int /* len */)
+{
+	/* The mixer has already silenced the stream, and the channels are mixed into it after this */
+	((SoundBoard*)udata)->mMixStart = SDL_GetPerformanceCounter();
+}
+
+void SDLCALL SoundBoard::postMix(void* udata, Uint8* /* stream */, int /* len */)
+{
+	SoundBoard* board = (SoundBoard*)udata;
+	if (!board->mMixStart)
+	{
+		return;
+	}
+
+	/* How long this mix took, against how long its buffer plays for */
+	int mixUs = (int)((SDL_GetPerformanceCounter() - board->mMixStart) * 1000000 / SDL_GetPerformanceFrequency());
+	int periodUs = (int)((Uint64)board->mBufferSamples * 1000000 / board->mFrequency);
+	if (mixUs > periodUs)
+	{
+		SDL_AtomicAdd(&board->mOverruns, 1);
+	}
+	if (mixUs > SDL_AtomicGet(&board->mWorstMixUs))
+	{
+		SDL_AtomicSet(&board->mWorstMixUs, mixUs);
+	}
+	board->mMixUs += mixUs;
+	SDL_AtomicAdd(&board->mMixes, 1);
+}
+
+Window::Window()
+{
+	mWindow = NULL;
+	mRenderer = NULL;
+	mMouseFocus =
+	mKeyboardFocus =
+	mFullScreen =
+	mMinimized = false;
+	mWidth =
+	mHeight = 0;
+}
+
+bool Window::init()
+{
+	mWindow = SDL_CreateWindow(WINDOW_TITLE, SDL_WINDOWPOS_UNDEFINED,
+		SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH, SCREEN_HEIGHT, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+
+	if (!mWindow)
+	{
+		printf("The window could not be created!\n");
+		return false;
+	}
+
+	mMouseFocus =
+		mKeyboardFocus = true;
+	mWidth = SCREEN_WIDTH;
+	mHeight = SCREEN_HEIGHT;
+
+	SDL_SysWMinfo info;
+	SDL_VERSION(&info.version);
+	if (SDL_GetWindowWMInfo(mWindow, &info))
+	{
+		std::stringstream ssGmeVer, ssSDLver, ssTTFver, ssMIXver, ssIMGver;
+		ssGmeVer << PROG_NAME << " version " << GAME_VERSION;
+		ssSDLver << "SDL main version " << SDL_MAJOR_VERSION << "." << SDL_MINOR_VERSION << "." << SDL_PATCHLEVEL;
+		ssTTFver << "SDL TTF version " << SDL_TTF_MAJOR_VERSION << "." << SDL_TTF_MINOR_VERSION << "." << SDL_TTF_PATCHLEVEL;
+		ssMIXver << "SDL Mixer version " << SDL_MIXER_MAJOR_VERSION << "." << SDL_MIXER_MINOR_VERSION << "." << SDL_MIXER_PATCHLEVEL;
+		ssIMGver << "SDL Image version " << SDL_IMAGE_MAJOR_VERSION <<"."<< SDL_IMAGE_MINOR_VERSION << "." << SDL_IMAGE_PATCHLEVEL;
+
+		HMENU hMenubar = CreateMenu();
+		HMENU hGame = CreateMenu();
+		HMENU hAbout = CreateMenu();
+		AppendMenu(hMenubar, MF_POPUP, (UINT_PTR)hGame, "&Game");
+		AppendMenu(hMenubar, MF_POPUP, (UINT_PTR)hAbout, "&About");
+		AppendMenu(hGame, MF_STRING, MENU_NEW_GAME, "&New Game");
+		AppendMenu(hGame, MF_STRING, MENU_NEW_WINNABLE, "New &Winnable Game");
+		AppendMenu(hGame, MF_SEPARATOR, NULL, "");
+		AppendMenu(hGame, MF_STRING, MENU_EXIT, "&Exit");
+		AppendMenu(hAbout, MF_STRING, NULL, "This awesome clone was created by Chris Roxby.");
+		AppendMenu(hAbout, MF_STRING, NULL, ssGmeVer.str().c_str());
+		AppendMenu(hAbout, MF_SEPARATOR, NULL, "");
+		AppendMenu(hAbout, MF_STRING, NULL, ssTTFver.str().c_str());
+		AppendMenu(hAbout, MF_STRING, NULL, ssMIXver.str().c_str());
+		AppendMenu(hAbout, MF_STRING, NULL, ssIMGver.str().c_str());
+		SetMenu(info.info.win.window, hMenubar);
+		return true;
+	}
+	else
+	{
+		printf("The menu bar could not be created!\n");
+		return false;
+	}
+}
+
+SDL_Renderer* Window::createRenderer()
+{
+	mRenderer = SDL_CreateRenderer(mWindow, -1, SDL_RENDERER_ACCELERATED);
+	if (!mRenderer)
+	{
+		/* Headless and GPU-less machines still get SDL's software renderer */
+		mRenderer = SDL_CreateRenderer(mWindow, -1, SDL_RENDERER_SOFTWARE);
+	}
+	return mRenderer;
+}
+
+void Window::handleEvent(SDL_Event& e)
+{
+	if (e.type == SDL_WINDOWEVENT)
+	{
+		switch (e.window.event)
+		{
+			/* Get new dimensions. The render thread repaints on its own. */
+		case SDL_WINDOWEVENT_SIZE_CHANGED:
+			mWidth = e.window.data1;
+			mHeight = e.window.data2;
+			break;
+
+		case SDL_WINDOWEVENT_ENTER:
+			mMouseFocus = true;
+			break;
+		case SDL_WINDOWEVENT_LEAVE:
+			mMouseFocus = false;
+			break;
+
+		case SDL_WINDOWEVENT_FOCUS_GAINED:
+			mKeyboardFocus = true;
+			break;
+		case SDL_WINDOWEVENT_FOCUS_LOST:
+			mKeyboardFocus = false;
+			break;
+
+		case SDL_WINDOWEVENT_MINIMIZED:
+			mMinimized = true;
+			break;
+		case SDL_WINDOWEVENT_MAXIMIZED:
+			mMinimized = false;
+			break;
+		case SDL_WINDOWEVENT_RESTORED:
+			mMinimized = false;
+			break;
+		}
+	}
+	/* Enter\exit full screen */
+	else if (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_RETURN)
+	{
+		const Uint8 *kBstate = SDL_GetKeyboardState(NULL);
+		if (kBstate[SDL_SCANCODE_LALT] || kBstate[SDL_SCANCODE_RALT])
+		{
+			if (mFullScreen)
+			{
+				SDL_SetWindowFullscreen(mWindow, SDL_FALSE);
+				mFullScreen = false;
+			}
+			else
+			{
+				SDL_SetWindowFullscreen(mWindow, SDL_TRUE);
+				mFullScreen = true;
+				mMinimized = false;
+			}
+		}
+	}
+}
+
+void Window::free()
+{
+	if (mRenderer != NULL)
+	{
+		SDL_DestroyRenderer(mRenderer);
+	}
+	if (mWindow != NULL)
+	{
+		SDL_DestroyWindow(mWindow);
+	}
+
+	mMouseFocus = false;
+	mKeyboardFocus = false;
+	mWidth = 0;
+	mHeight = 0;
+}
+
+int Window::getWidth()
+{
+	return mWidth;
+}
+int Window::getHeight()
+{
+	return mHeight;
+}
+bool Window::hasMouseFocus()
+{
+	return mMouseFocus;
+}
+bool Window::hasKeyboardFocus()
+{
+	return mKeyboardFocus;
+}
+bool Window::isMinimized()
+{
+	return mMinimized;
+}
+
+
+AssetManager::AssetManager()
+{
+	Close(); /* Null init pointers */
+
+	mTableW =
+		mTableH =
+		mCardNativeW =
+		mCardNativeH =
+		mCardW =
+		mCardH = 0;
+	mMinimized = false;
+	mWon = false;
+	mDealSeed = 0;
+	mDealRandom.seed((uint64_t)time(NULL));
+	mGameStart = 0;
+	mBoardVersion = 1;
+	mStaticVersion = 0;
+	mOddsVersion = 0;
+	mPositionVersion = 0;
+	mPrefetchVersion = 0;
+	mTracing = false;
+	mTracedStamp = 0;
+	mPendingCount = 0;
+	mDroppedStamps = 0;
+	mTracedInputs = 0;
+	mAtlasCardW =
+		mAtlasCardH =
+		mAtlasWantW =
+		mAtlasWantH = 0;
+	mAtlasWantSince = 0;
+	SDL_AtomicSet(&mStaticLayerLost, 0);
+	SDL_AtomicSet(&mFrontSnapshot, 0);
+	SDL_AtomicSet(&mReadingSnapshot, -1);
+	SDL_AtomicSet(&mDrawnSerial, 0);
+	SDL_zero(mSnapshots);
+	mDragBase = NULL;
+
+	/* The card pool starts face-down with nothing handed out */
+	SDL_zero(mCardData);
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		mCardData.face[i].value = ACE;
+	}
+	mCardsInUse = 0;
+
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		mPiles[i].setRank(i);
+	}
+}
+
+AssetManager::~AssetManager()
+{
+	/* Report how the card art was sampled */
+	Texture::printMipStats();
+
+	/* Finish writing what was recorded */
+	mRecorder.stop();
+	mOdds.stop();
+	mFacePager.printStats();
+	mTextures.printStats();
+	mSoftRenderer.printStats();
+
+	/* The game being played when the window closed */
+	mMoveLog.endGame(mWon);
+	mMoveLog.close();
+	if (mPositionLog.isOpen() && !mPositionLog.close())
+	{
+		printf("Some positions could not be logged.\n");
+	}
+
+	/* Deallocate, while the renderer they came from is still there */
+	mStaticLayer.free();
+	mFacePager.stop();
+	mFaceAtlas.free();
+	mFPSGlyphs.free();
+	mOutlineTexture.free();
+	mDeckTexture.free();
+	mBackgroundTexture.free();
+	mTextures.close();
+
+	/* Free the font */
+	TTF_CloseFont(mFont);
+
+	/* Free the sound effects */
+	mSounds.printStats();
+	mSounds.close();
+
+	/* Destroy window */
+	mWindow.free();
+	SDL_DestroyRenderer(mRenderer);
+
+	/* NULL out pointers */
+	Close();
+
+	/* Quit SDL subsystems */
+	TTF_Quit();
+	IMG_Quit();
+	SDL_Quit();
+}
+
+bool AssetManager::Init()
+{
+	bool success = true;
+
+	/* Initialize SDL */
+	if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
+	{
+		printf("SDL could not initialize!\nSDL Error: %s\n", SDL_GetError());
+		success = false;
+	}
+	else
+	{
+		/* Set texture filtering quality */
+		if (!SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "2")) /* "2" = "best", but currently "best" = "linear" */
+		{
+			printf("Texture filtering could not be enabled!");
+		}
+
+		/* Create window */
+		if (!mWindow.init())
+		{
+			printf("The window could not be created!\nSDL Error: %s\n", SDL_GetError());
+			success = false;
+		}
+		else
+		{
+			mTableW = mWindow.getWidth();
+			mTableH = mWindow.getHeight();
+
+			/* Create renderer for window. The software path draws into the window surface instead. */
+			mRenderer = mOptions.softwareRender ? NULL : mWindow.createRenderer();
+			if (!mRenderer && !mOptions.softwareRender)
+			{
+				printf("The renderer could not be created!\nSDL Error: %s\n", SDL_GetError());
+				success = false;
+			}
+			else
+			{
+				/* Initialize renderer color */
+				if (mRenderer)
+				{
+					SDL_SetRenderDrawColor(mRenderer, RENDER_BGCOLOR);
+				}
+
+				/* Initialize PNG loading */
+				int imgFlags = IMG_INIT_PNG;
+				if (!(IMG_Init(imgFlags) & imgFlags))
+				{
+					printf("SDL_image could not initialize!\nSDL_image Error: %s\n", IMG_GetError());
+					success = false;
+				}
+
+				/* Initialize SDL_ttf */
+				if (TTF_Init() == -1)
+				{
+					printf("SDL_ttf could not initialize!\nSDL_ttf Error: %s\n", TTF_GetError());
+					success = false;
+				}
+
+				/* Initialize SDL_mixer */
+				if (!mSounds.open(mOptions.audioBufferMs))
+				{
+					success = false;
+				}
+			}
+		}
+	}
+	return success;
+}
+
+bool AssetManager::LoadMedia()
+{
+	bool success = true;
+
+	/* Open the font */
+	mFont = TTF_OpenFont("C:/Windows/Fonts/calibri.ttf", 28);
+	if (!mFont)
+	{
+		printf("The font could not be loaded!\nSDL_ttf Error: %s\n", TTF_GetError());
+		success = false;
+	}
+
+	/* Load sound effects */
+	if (!mSounds.load())
+	{
+		success = false;
+	}
+
+	if (mOptions.softwareRender)
+	{
+		/* The CPU draws everything, so the art stays in memory */
+		mSoftRenderer.setThreads(SDL_GetCPUCount());
+		if (!mSoftRenderer.load(mOptions.proceduralFaces))
+		{
+			success = false;
+		}
+		mCardNativeW = mSoftRenderer.getCardArtWidth();
+		mCardNativeH = mSoftRenderer.getCardArtHeight();
+	}
+	else if (!loadTextures())
+	{
+		success = false;
+	}
+
+	/* Winnable deals come from a prebuilt index. The game still plays without one. */
+	if (!mDeals.open(mOptions.dealIndexPath))
+	{
+		printf("Every deal will be random.\n");
+	}
+
+	if (mOptions.moveLogPath && !mMoveLog.open(mOptions.moveLogPath))
+	{
+		printf("Games will not be logged.\n");
+	}
+	if (mOptions.positionLogPath && !mPositionLog.open(mOptions.positionLogPath, false))
+	{
+		printf("Positions will not be logged.\n");
+	}
+
+	/* The render thread keeps a core, and the rest encode */
+	if (mOptions.recordPath && !mRecorder.start(mOptions.recordPath, mOptions.recordYUV, mOptions.recordFPS, SDL_GetCPUCount() - 1))
+	{
+		printf("The game will not be recorded.\n");
+	}
+
+	/* The render and simulation threads keep a core between them */
+	if (mOptions.winOdds)
+	{
+		mOdds.start(SDL_GetCPUCount() - 1);
+	}
+
+	return success;
+}
+
+bool AssetManager::loadTextures()
+{
+	bool success = true;
+	mTextures.setRenderer(mRenderer);
+
+	mBackgroundTexture.share(mTextures.load("table.png"));
+	if (!mBackgroundTexture.isLoaded())
+	{
+		printf("The background texture could not be loaded!\n");
+		success = false;
+	}
+
+	/* Load deck texture */
+	mDeckTexture.share(mTextures.loadMipChain("cards/back.png"));
+	if (!mDeckTexture.isLoaded())
+	{
+		printf("The deck texture could not be loaded!\n");
+		success = false;
+	}
+
+	mCardNativeW = mDeckTexture.getWidth();
+	mCardNativeH = mDeckTexture.getHeight();
+
+	/* Load outline texture */
+	mOutlineTexture.share(mTextures.loadMipChain("cards/outline.png"));
+	if (!mOutlineTexture.isLoaded())
+	{
+		printf("The outline texture could not be loaded!\n");
+		success = false;
+	}
+
+	/*
+		Face textures are loaded as they are first drawn, so only check they are all there.
+		Painted faces are made by the render thread once it knows the card size.
+	*/
+	if (mOptions.proceduralFaces)
+	{
+		Texture::printMipStats();
+		return success;
+	}
+	Texture* faces[NUM_CARDS];
+	for (int n = 0; n < NUM_CARDS; n++)
+	{
+		faces[n] = &mFaceTextures[suitOf((cardCode)n)][valueOf((cardCode)n)];
+		SDL_RWops* file = SDL_RWFromFile(softImagePath(n + 1).c_str(), "rb");
+		if (!file)
+		{
+			printf("The texture could not be found for the %i of %s!\n", valueOf((cardCode)n), nameOfSuit(suitOf((cardCode)n)));
+			success = false;
+			continue;
+		}
+		SDL_RWclose(file);
+	}
+	if (!mFacePager.start(&mTextures, faces, (Uint64)mOptions.faceBudgetMB * 1024 * 1024))
+	{
+		success = false;
+	}
+
+	Texture::printMipStats();
+	return success;
+}
+
+void AssetManager::Close()
+{
+	mRenderer = NULL;
+	mSDLWindow = NULL;
+	mIconSurface = NULL;
+	mFont = NULL;
+}
+
+void AssetManager::clearRenderer()
+{
+	SDL_SetRenderDrawColor(mRenderer, RENDER_BGCOLOR);
+	SDL_RenderClear(mRenderer);
+}
+
+void AssetManager::computeCardPlaces()
+{
+	/* Fit the card art to a fraction of the window, keeping its aspect ratio */
+	int fitW = mTableW / CARD_SCALE;
+	int fitH = mTableH / CARD_SCALE;
+	if ((mCardNativeW > 0) && (mCardNativeH > 0))
+	{
+		if (fitH < fitW)
+		{
+			mCardH = fitH;
+			mCardW = (int)roundf(mCardNativeW * ((float)fitH / (float)mCardNativeH));
+		}
+		else
+		{
+			mCardW = fitW;
+			mCardH = (int)roundf(mCardNativeH * ((float)fitW / (float)mCardNativeW));
+		}
+	}
+
+	int cardW = mCardW;
+	int cardH = mCardH;
+
+	int margin_y = max(cardW / 8, 4);
+	int margin_x = max((mTableW - (cardW * 7)) / 8, 4);
+
+	mCardPlaces[0].y = margin_y;
+	mCardPlaces[1].y = margin_y;
+	mCardPlaces[2].y = margin_y;
+	mCardPlaces[3].y = margin_y;
+	mCardPlaces[4].y = margin_y;
+	mCardPlaces[5].y = margin_y;
+
+	mCardPlaces[6].y = margin_y * 2 + cardH;
+	mCardPlaces[7].y = margin_y * 2 + cardH;
+	mCardPlaces[8].y = margin_y * 2 + cardH;
+	mCardPlaces[9].y = margin_y * 2 + cardH;
+	mCardPlaces[10].y = margin_y * 2 + cardH;
+	mCardPlaces[11].y = margin_y * 2 + cardH;
+	mCardPlaces[12].y = margin_y * 2 + cardH;
+
+	mCardPlaces[0].x = margin_x;
+	mCardPlaces[6].x = margin_x;
+
+	mCardPlaces[1].x = mCardPlaces[0].x + margin_x + cardW;
+	mCardPlaces[7].x = mCardPlaces[6].x + margin_x + cardW;
+
+	mCardPlaces[8].x = mCardPlaces[7].x + margin_x + cardW;
+
+	mCardPlaces[2].x = mCardPlaces[8].x + margin_x + cardW;
+	mCardPlaces[9].x = mCardPlaces[8].x + margin_x + cardW;
+
+	mCardPlaces[3].x = mCardPlaces[2].x + margin_x + cardW;
+	mCardPlaces[10].x = mCardPlaces[2].x + margin_x + cardW;
+
+	mCardPlaces[4].x = mCardPlaces[3].x + margin_x + cardW;
+	mCardPlaces[11].x = mCardPlaces[3].x + margin_x + cardW;
+
+	mCardPlaces[5].x = mCardPlaces[4].x + margin_x + cardW;
+	mCardPlaces[12].x = mCardPlaces[4].x + margin_x + cardW;
+}
+
+void AssetManager::cardDrop(Card* card)
+{
+	int oldRank = card->getRank();
+	Pile& from = mPiles[oldRank];
+
+	invalidateBoard();
+
+	/* Dealt cards already know where they are going */
+	if (card->getDestRank() != oldRank)
+	{
+		int destRank = card->getDestRank();
+		if ((oldRank == STOCK_RANK) && (destRank == WASTE_RANK))
+		{
+			logMove(MOVE_DRAW, STOCK_RANK, WASTE_RANK, 1);
+		}
+		from.remove(card->getFile());
+		mPiles[destRank].push(card);
+		updateClickability(oldRank);
+		updateClickability(destRank);
+		checkForWin();
+		return;
+	}
+
+	/* Otherwise it is the bottom of a dragged run */
+	int count = from.size() - card->getFile();
+	for (int i = card->getFile(); i < from.size(); i++)
+	{
+		from.at(i)->putDown();
+	}
+	mDragBase = NULL;
+
+	SDL_Rect cardRect;
+	SDL_Rect rankRect;
+
+	cardRect.w = mCardW;
+	cardRect.h = mCardH;
+	cardRect.x = card->getX();
+	cardRect.y = card->getY();
+
+	rankRect.w = cardRect.w;
+
+	for (int i = FIRST_FOUNDATION; i < CARD_RANKS; i++)
+	{
+		if (i == oldRank)
+		{
+			continue;
+		}
+
+		/* A tableau's drop zone reaches down to its top card */
+		rankRect.x = mCardPlaces[i].x;
+		rankRect.y = mCardPlaces[i].y;
+		rankRect.h = mCardH;
+		if ((i >= FIRST_TABLEAU) && (mPiles[i].size() > 1))
+		{
+			rankRect.h += (mPiles[i].size() - 1) * (mCardH / 10);
+		}
+
+		if (testRectCollision(cardRect, rankRect) && accepts(i, card, count))
+		{
+			logMove(MOVE_CARDS, oldRank, i, count);
+			from.splice(mPiles[i], count);
+			updateClickability(oldRank);
+			updateClickability(i);
+			checkForWin();
+			return;
+		}
+	}
+	/* Nowhere to go, so the run rests back where it came from */
+}
+
+Card* AssetManager::newCard()
+{
+	if (mCardsInUse == NUM_CARDS)
+	{
+		return NULL;
+	}
+	Card* card = &mCards[mCardsInUse];
+	card->assocGame(*this, mCardData, mCardsInUse);
+	mCardsInUse++;
+	return card;
+}
+
+void AssetManager::moveCards(int timeStep)
+{
+	cardStore& c = mCardData;
+	int destX[NUM_CARDS], destY[NUM_CARDS];
+
+	/* Where each card is headed. Anything not dealt is headed where it already is. */
+	for (int i = 0; i < mCardsInUse; i++)
+	{
+		bool moving = c.destRank[i] != c.rank[i];
+		destX[i] = moving ? mCardPlaces[c.destRank[i]].x : c.posX[i];
+		destY[i] = moving ? mCardPlaces[c.destRank[i]].y : c.posY[i];
+	}
+
+	/* Plain arithmetic on the packed arrays, with nothing in the way of vectorizing it */
+	if (mOptions.animation)
+	{
+		/*
+			FIXME:BUGBUG: Sometimes cards miss and fly forever
+				Moving in big steps with little tolerance?
+		*/
+		for (int i = 0; i < mCardsInUse; i++)
+		{
+			c.posX[i] += (c.posX[i] != destX[i]) ? c.velX[i] * timeStep : 0;
+			c.posY[i] += (c.posY[i] != destY[i]) ? c.velY[i] * timeStep : 0;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < mCardsInUse; i++)
+		{
+			c.posX[i] = destX[i];
+			c.posY[i] = destY[i];
+		}
+	}
+
+	/* Landing reshuffles the piles, so the arrivals are handled one at a time */
+	for (int i = 0; i < mCardsInUse; i++)
+	{
+		if (c.destRank[i] == c.rank[i])
+		{
+			continue;
+		}
+		if ((c.posX[i] != destX[i]) || (c.posY[i] != destY[i]))
+		{
+			c.flags[i] |= CARD_SLIDING;
+		}
+		else
+		{
+			c.flags[i] &= ~CARD_SLIDING;
+			cardDrop(&mCards[i]);
+		}
+	}
+}
+
+void AssetManager::newGame(Uint32 seed)
+{
+	/* The simulator deals from the same seeds */
+	mDealSeed = seed;
+	Klondike::shuffleDeck(mAllFaces, mDealSeed);
+	mMoveLog.endGame(mWon);
+	mMoveLog.beginGame(seed);
+	mGameStart = SDL_GetTicks();
+	mWon = false;
+	mDragBase = NULL;
+
+	/* Everything goes back on the stock face-down, with the first card to deal on top */
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		mPiles[i].clear();
+	}
+	for (int i = mCardsInUse - 1; i >= 0; i--)
+	{
+		mCardData.flags[i] = 0;
+		mCardData.texture[i] = CARD_BACK_TEXTURE;
+		mCardData.offsetX[i] =
+			mCardData.offsetY[i] = 0;
+		mCardData.lastClickTime[i] = 0; /* Nothing on the new deal has been clicked */
+		mCardData.posX[i] = mCardPlaces[STOCK_RANK].x;
+		mCardData.posY[i] = mCardPlaces[STOCK_RANK].y;
+		mCards[i].setFace(mAllFaces[i]);
+		mPiles[STOCK_RANK].push(&mCards[i]);
+	}
+	invalidateBoard();
+
+	if (mCardsInUse < NUM_CARDS)
+	{
+		return; /* Not a whole deck to deal from */
+	}
+
+	/* Deal Cards */
+	int rank = FIRST_TABLEAU; /* The first one in the second row */
+	int file = 1;
+	mCards[0].flip(); /* Flip the first card while it flys to 6,0 */
+	for (int i = 0; i < FIRST_DEAL; i++)
+	{
+		if (rank == CARD_RANKS)
+		{
+			rank = FIRST_TABLEAU + file;
+			file++;
+			mCards[i].flip(); /* When a new row starts, flip the first card */
+		}
+		mCards[i].dealTo(rank);
+		rank++;
+	}
+	mCards[FIRST_DEAL].setClickability(true); /* Top Deck Card */
+}
+
+Uint32 AssetManager::chooseDealSeed(bool winnable)
+{
+	uint32_t seed = mDealRandom.next();
+	if (winnable && !mDeals.pick(mDealRandom, mOptions.minDifficulty, mOptions.maxDifficulty, &seed))
+	{
+		printf("No winnable deal is indexed with difficulty %i-%i, so this one is random.\n",
+			mOptions.minDifficulty, mOptions.maxDifficulty);
+	}
+	return seed;
+}
+
+void AssetManager::logMove(int kind, int from, int to, int count)
+{
+	if (mMoveLog.isOpen())
+	{
+		klondikeMove move = { (uint8_t)kind, (uint8_t)from, (uint8_t)to, (uint8_t)count };
+		mMoveLog.addMove(move, SDL_GetTicks() - mGameStart);
+	}
+}
+
+void AssetManager::beginDrag(Card* card, int x, int y)
+{
+	Pile& pile = mPiles[card->getRank()];
+	for (int i = card->getFile(); i < pile.size(); i++)
+	{
+		pile.at(i)->pickUp(x, y);
+	}
+	mDragBase = card;
+	invalidateBoard(); /* Lift them off the static layer */
+}
+
+Card* AssetManager::cardAt(int x, int y)
+{
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		for (int j = mPiles[i].size() - 1; j >= 0; j--)
+		{
+			Card* card = mPiles[i].at(j);
+			if (pointWithinBounds(x, y, card->getX(), card->getY(), mCardW, mCardH))
+			{
+				return card;
+			}
+		}
+	}
+	return NULL;
+}
+
+bool AssetManager::accepts(int rank, Card* card, int count)
+{
+	Card* top = mPiles[rank].top();
+	if (!top)
+	{
+		return slotAccepts(rank, codeOf(card->getFace()), count, true, 0);
+	}
+	if (!top->getFlipState())
+	{
+		return false; /* Turn it over first */
+	}
+	return slotAccepts(rank, codeOf(card->getFace()), count, false, codeOf(top->getFace()));
+}
+
+void AssetManager::updateClickability(int rank)
+{
+	Pile& pile = mPiles[rank];
+	for (int i = 0; i < pile.size(); i++)
+	{
+		Card* card = pile.at(i);
+		card->setClickability((i == pile.size() - 1) || ((rank >= FIRST_TABLEAU) && card->getFlipState()));
+	}
+}
+
+void AssetManager::checkForWin()
+{
+	/* Every card on the foundations wins the game */
+	int cards = 0;
+	for (int i = FIRST_FOUNDATION; i < FIRST_TABLEAU; i++)
+	{
+		cards += mPiles[i].size();
+	}
+	if (!mWon && (cards == NUM_CARDS))
+	{
+		mWon = true;
+		mSounds.play(SOUND_WIN);
+	}
+}
+
+bool AssetManager::isAtRest()
+{
+	if (mDragBase || (mCardsInUse < NUM_CARDS))
+	{
+		return false;
+	}
+	for (int i = 0; i < mCardsInUse; i++)
+	{
+		if (mCardData.destRank[i] != mCardData.rank[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void AssetManager::getPosition(Klondike& game, bool seen[NUM_CARDS])
+{
+	cardStore& c = mCardData;
+	cardCode cards[NUM_CARDS];
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		int faceDown = 0;
+		for (int j = 0; j < mPiles[i].size(); j++)
+		{
+			int index = mPiles[i].at(j)->getIndex();
+			cards[j] = codeOf(c.face[index]);
+			seen[cards[j]] = (c.flags[index] & CARD_SEEN) != 0;
+			faceDown += (c.flags[index] & CARD_FACE_UP) ? 0 : 1;
+		}
+		game.setPile(i, cards, mPiles[i].size(), faceDown);
+	}
+}
+
+void AssetManager::updateWinOdds()
+{
+	/* Only a position at rest is worth estimating */
+	if (!mOptions.winOdds || (mOddsVersion == mBoardVersion) || !isAtRest())
+	{
+		return;
+	}
+	mOddsVersion = mBoardVersion;
+
+	Klondike game;
+	bool seen[NUM_CARDS];
+	getPosition(game, seen);
+
+	/* A face-down card on top of a column is only a click from being turned over */
+	for (int i = FIRST_TABLEAU; i < CARD_RANKS; i++)
+	{
+		int count = game.count(i);
+		if (count && (game.faceDown(i) == count))
+		{
+			cardCode cards[NUM_CARDS];
+			for (int j = 0; j < count; j++)
+			{
+				cards[j] = game.card(i, j);
+			}
+			game.setPile(i, cards, count, count - 1);
+		}
+	}
+	mOdds.setPosition(game, seen);
+}
+
+void AssetManager::logPosition()
+{
+	if (!mPositionLog.isOpen() || (mPositionVersion == mBoardVersion) || !isAtRest())
+	{
+		return;
+	}
+	mPositionVersion = mBoardVersion;
+
+	Klondike game;
+	bool seen[NUM_CARDS];
+	getPosition(game, seen);
+	mPositionLog.write(game);
+}
+
+void AssetManager::prefetchFaces()
+{
+	if (mPrefetchVersion == mBoardVersion)
+	{
+		return;
+	}
+	mPrefetchVersion = mBoardVersion;
+
+	/* The top face-down card of each column is turned over once the cards on it move */
+	cardStore& c = mCardData;
+	for (int i = FIRST_TABLEAU; i < CARD_RANKS; i++)
+	{
+		for (int j = mPiles[i].size() - 1; j >= 0; j--)
+		{
+			int index = mPiles[i].at(j)->getIndex();
+			if (!(c.flags[index] & CARD_FACE_UP))
+			{
+				mFacePager.prefetch(codeOf(c.face[index]));
+				break;
+			}
+		}
+	}
+
+	/* And the stock is dealt from the top */
+	Pile& stock = mPiles[STOCK_RANK];
+	for (int j = stock.size() - 1; (j >= 0) && (j >= stock.size() - FACE_PREFETCH_STOCK); j--)
+	{
+		mFacePager.prefetch(codeOf(c.face[stock.at(j)->getIndex()]));
+	}
+}
+
+bool AssetManager::publishSnapshot()
+{
+	/* The render thread may still be drawing the older snapshot */
+	int back = 1 - SDL_AtomicGet(&mFrontSnapshot);
+	if (SDL_AtomicGet(&mReadingSnapshot) == back)
+	{
+		return false;
+	}
+
+	tableSnapshot& snapshot = mSnapshots[back];
+	snapshot.width = mTableW;
+	snapshot.height = mTableH;
+	snapshot.cardW = mCardW;
+	snapshot.cardH = mCardH;
+	snapshot.minimized = mMinimized;
+	snapshot.boardVersion = mBoardVersion;
+	snapshot.restingCount = 0;
+	snapshot.movingCount = 0;
+	snapshot.serial = mSnapshots[1 - back].serial + 1;
+	snapshot.odds = mOdds.getEstimate();
+
+	/*
+		Inputs stay pending until a snapshot that showed them is drawn,
+		since the render thread skips any snapshot published between two frames.
+	*/
+	Uint32 drawn = (Uint32)SDL_AtomicGet(&mDrawnSerial);
+	int kept = 0;
+	for (int i = 0; i < mPendingCount; i++)
+	{
+		if (mPendingSerials[i] && (mPendingSerials[i] <= drawn))
+		{
+			continue; /* Already measured */
+		}
+		mPendingStamps[kept] = mPendingStamps[i];
+		mPendingSerials[kept] = mPendingSerials[i] ? mPendingSerials[i] : snapshot.serial;
+		snapshot.inputStamps[kept] = mPendingStamps[kept];
+		snapshot.inputSerials[kept] = mPendingSerials[kept];
+		kept++;
+	}
+	mPendingCount =
+		snapshot.inputCount = kept;
+
+	for (int i = 0; i < CARD_RANKS; i++) /* Implicit Z ordering */
+	{
+		snapshot.places[i] = mCardPlaces[i];
+		for (int j = 0; j < mPiles[i].size(); j++)
+		{
+			Card* card = mPiles[i].at(j);
+			card->rest(&mCardPlaces[i]);
+
+			int index = card->getIndex();
+			cardSprite sprite = { getTextureByIndex(mCardData.texture[index]), mCardData.posX[index], mCardData.posY[index], mCardData.texture[index] };
+			if (mCardData.flags[index] & CARD_DRAGGING)
+			{
+				continue; /* Drawn after everything else */
+			}
+			if (mCardData.flags[index] & CARD_SLIDING)
+			{
+				snapshot.moving[snapshot.movingCount++] = sprite;
+			}
+			else
+			{
+				snapshot.resting[snapshot.restingCount++] = sprite;
+			}
+		}
+	}
+	if (mDragBase) /* The dragged run is rendered last */
+	{
+		Pile& pile = mPiles[mDragBase->getRank()];
+		for (int i = mDragBase->getFile(); i < pile.size(); i++)
+		{
+			int index = pile.at(i)->getIndex();
+			cardSprite sprite = { getTextureByIndex(mCardData.texture[index]), mCardData.posX[index], mCardData.posY[index], mCardData.texture[index] };
+			snapshot.moving[snapshot.movingCount++] = sprite;
+		}
+	}
+
+	SDL_AtomicSet(&mFrontSnapshot, back);
+	return true;
+}
+
+void AssetManager::dispatchInput(SDL_Event& e)
+{
+	switch (e.type)
+	{
+	case SDL_MOUSEMOTION:
+		/* Only the held run follows the mouse */
+		if (mDragBase)
+		{
+			Pile& pile = mPiles[mDragBase->getRank()];
+			for (int i = mDragBase->getFile(); i < pile.size(); i++)
+			{
+				pile.at(i)->handleEvent(e);
+			}
+		}
+		break;
+	case SDL_MOUSEBUTTONDOWN:
+		/* Only the top card under the mouse can be clicked */
+		if (Card* card = cardAt(e.button.x, e.button.y))
+		{
+			card->handleEvent(e);
+		}
+		break;
+	case SDL_MOUSEBUTTONUP:
+		/* The run lands with its bottom card */
+		if (mDragBase)
+		{
+			mDragBase->handleEvent(e);
+		}
+		break;
+	}
+
+	handleEvent(e);
+}
+
+void AssetManager::beginInputTrace(SDL_Event& e)
+{
+	mTracing = mOptions.measureLatency &&
+		((e.type == SDL_MOUSEBUTTONDOWN) || (e.type == SDL_MOUSEMOTION));
+	mTracedStamp = e.common.timestamp;
+}
+
+void AssetManager::traceInput()
+{
+	if (!mTracing)
+	{
+		return;
+	}
+	mTracing = false; /* Only the first effect counts */
+
+	if (mPendingCount < MAX_TRACED_INPUTS)
+	{
+		mPendingStamps[mPendingCount] = mTracedStamp;
+		mPendingSerials[mPendingCount++] = 0; /* Not published yet */
+		mTracedInputs++;
+	}
+	else
+	{
+		mDroppedStamps++;
+	}
+}
+
+int AssetManager::undrawnInputTraces()
+{
+	Uint32 drawn = (Uint32)SDL_AtomicGet(&mDrawnSerial);
+	int undrawn = 0;
+	for (int i = 0; i < mPendingCount; i++)
+	{
+		if (!mPendingSerials[i] || (mPendingSerials[i] > drawn))
+		{
+			undrawn++;
+		}
+	}
+	return undrawn;
+}
+
+tableSnapshot* AssetManager::acquireSnapshot()
+{
+	/* Claim the front snapshot, then make sure it didn't change underneath the claim */
+	int front;
+	do
+	{
+		front = SDL_AtomicGet(&mFrontSnapshot);
+		SDL_AtomicSet(&mReadingSnapshot, front);
+	} while (SDL_AtomicGet(&mFrontSnapshot) != front);
+	return &mSnapshots[front];
+}
+
+void AssetManager::releaseSnapshot(bool drawn)
+{
+	/* Tells the simulation which inputs have been shown */
+	if (drawn)
+	{
+		SDL_AtomicSet(&mDrawnSerial, (int)mSnapshots[SDL_AtomicGet(&mReadingSnapshot)].serial);
+	}
+	SDL_AtomicSet(&mReadingSnapshot, -1);
+}
+
+bool AssetManager::updateStaticLayer(tableSnapshot* snapshot)
+{
+	int winW = snapshot->width;
+	int winH = snapshot->height;
+
+	/* Without render targets the layer is simply drawn every frame */
+	bool cached = SDL_RenderTargetSupported(mRenderer) == SDL_TRUE;
+	bool lost = SDL_AtomicSet(&mStaticLayerLost, 0) != 0;
+
+	/* The layer follows the window size */
+	if (cached && ((mStaticLayer.getWidth() != winW) || (mStaticLayer.getHeight() != winH)))
+	{
+		cached = mStaticLayer.createBlank(winW, winH, mRenderer, SDL_TEXTUREACCESS_TARGET);
+		mStaticLayer.setBlendMode(SDL_BLENDMODE_NONE); /* The table covers every pixel */
+		lost = true;
+	}
+
+	if (cached && !lost && (mStaticVersion == snapshot->boardVersion))
+	{
+		return true;
+	}
+
+	if (cached)
+	{
+		mStaticLayer.setAsRenderTarget(mRenderer);
+		clearRenderer();
+	}
+
+	mSpriteBatch.add(&mBackgroundTexture, 0, 0);
+
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		if (i != 1) /* No outline for the discard pile */
+		{
+			mSpriteBatch.add(&mOutlineTexture, snapshot->places[i].x, snapshot->places[i].y);
+		}
+	}
+
+	for (int i = 0; i < snapshot->restingCount; i++)
+	{
+		mSpriteBatch.add(snapshot->resting[i].texture, snapshot->resting[i].x, snapshot->resting[i].y);
+	}
+
+	if (cached)
+	{
+		mSpriteBatch.flush(mRenderer);
+		SDL_SetRenderTarget(mRenderer, NULL);
+		mStaticVersion = snapshot->boardVersion;
+	}
+	return cached;
+}
+
+bool AssetManager::updateFaceAtlas(int cardW, int cardH)
+{
+	if (!mOptions.proceduralFaces || (cardW < 1) || (cardH < 1) ||
+		((cardW == mAtlasCardW) && (cardH == mAtlasCardH)))
+	{
+		return false;
+	}
+
+	/* While a resize is being dragged the old faces are scaled. The first atlas can't wait. */
+	Uint32 now = SDL_GetTicks();
+	if ((cardW != mAtlasWantW) || (cardH != mAtlasWantH))
+	{
+		mAtlasWantW = cardW;
+		mAtlasWantH = cardH;
+		mAtlasWantSince = now;
+	}
+	if (mAtlasCardW && (now - mAtlasWantSince < FACE_ATLAS_SETTLE))
+	{
+		return false;
+	}
+
+	/* One row per suit, unless that is wider than the renderer allows */
+	SDL_RendererInfo info;
+	int maxW = 4096, maxH = 4096;
+	if ((SDL_GetRendererInfo(mRenderer, &info) == 0) && info.max_texture_width && info.max_texture_height)
+	{
+		maxW = info.max_texture_width;
+		maxH = info.max_texture_height;
+	}
+	int columns = maxW / cardW;
+	columns = (columns > NUM_FACES) ? NUM_FACES : columns;
+	int rows = columns ? (NUM_CARDS + columns - 1) / columns : 0;
+	if (!columns || (rows * cardH > maxH))
+	{
+		printf("%ix%i cards are too big to paint. The faces will be scaled.\n", cardW, cardH);
+		mAtlasCardW = cardW;
+		mAtlasCardH = cardH;
+		return false;
+	}
+
+	if (!mFaceAtlas.createBlank(columns * cardW, rows * cardH, mRenderer, SDL_TEXTUREACCESS_STREAMING))
+	{
+		mAtlasCardW = cardW;
+		mAtlasCardH = cardH;
+		return false;
+	}
+	/* SDL's software renderer can't blend premultiplied color, and would darken every anti-aliased edge */
+	bool straight = SDL_SetTextureBlendMode(mFaceAtlas.getSDLTexture(), premultipliedBlendMode()) < 0;
+	if (straight)
+	{
+		mFaceAtlas.setBlendMode(SDL_BLENDMODE_BLEND);
+	}
+
+	/* Paint straight into the texture */
+	void* pixels;
+	int pitch;
+	if (SDL_LockTexture(mFaceAtlas.getSDLTexture(), NULL, &pixels, &pitch) < 0)
+	{
+		printf("The face atlas could not be locked!\nSDL Error: %s\n", SDL_GetError());
+		mFaceAtlas.free();
+		mAtlasCardW = cardW;
+		mAtlasCardH = cardH;
+		return false;
+	}
+	CardPainter::paintAtlas((uint32_t*)pixels, pitch / 4, cardW, cardH, columns);
+	if (straight)
+	{
+		unpremultiply((Uint32*)pixels, pitch / 4, columns * cardW, rows * cardH);
+	}
+	SDL_UnlockTexture(mFaceAtlas.getSDLTexture());
+
+	for (int n = 0; n < NUM_CARDS; n++)
+	{
+		SDL_Rect region = { (n % columns) * cardW, (n / columns) * cardH, cardW, cardH };
+		mFaceTextures[suitOf((cardCode)n)][valueOf((cardCode)n)].setAtlasRegion(&mFaceAtlas, region);
+	}
+	mAtlasCardW = cardW;
+	mAtlasCardH = cardH;
+
+	/* Resting cards in the cached layer still show the old faces */
+	loseStaticLayer();
+	return true;
+}
+
+void AssetManager::pageFaces(tableSnapshot* snapshot)
+{
+	for (int i = 0; i < snapshot->restingCount; i++)
+	{
+		if (snapshot->resting[i].image != CARD_BACK_TEXTURE)
+		{
+			mFacePager.use(snapshot->resting[i].image - 1);
+		}
+	}
+	for (int i = 0; i < snapshot->movingCount; i++)
+	{
+		if (snapshot->moving[i].image != CARD_BACK_TEXTURE)
+		{
+			mFacePager.use(snapshot->moving[i].image - 1);
+		}
+	}
+}
+
+/* What a benchmark frame draws with */
+struct renderBench
+{
+	tableSnapshot* snapshot;
+	int dragX; /* Where the dragged card started */
+	int width, height;
+	SDL_Renderer* renderer; /* SDL's software renderer */
+	Texture* textures; /* Numbered like the software images */
+	SoftRenderer* soft;
+	std::vector<uint32_t> pixels;
+	bool cached;
+};
+
+/* The top card of the last pile is dragged across the table, so something changes every frame */
+void benchDrag(renderBench* bench, int frame)
+{
+	if (bench->snapshot->movingCount)
+	{
+		bench->snapshot->moving[bench->snapshot->movingCount - 1].x = bench->dragX - (frame % 64) * 4;
+	}
+}
+
+void benchSDLFrame(renderBench* bench, int frame)
+{
+	benchDrag(bench, frame);
+	tableSnapshot* snapshot = bench->snapshot;
+	SDL_RenderClear(bench->renderer);
+
+	SDL_Rect dest = { 0, 0, bench->width, bench->height };
+	SDL_RenderCopy(bench->renderer, bench->textures[SOFT_BACKGROUND_IMAGE].getSDLTexture(), NULL, &dest);
+	dest.w = snapshot->cardW;
+	dest.h = snapshot->cardH;
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		if (i != 1) /* No outline for the discard pile */
+		{
+			dest.x = snapshot->places[i].x;
+			dest.y = snapshot->places[i].y;
+			SDL_RenderCopy(bench->renderer, bench->textures[SOFT_OUTLINE_IMAGE].getSDLTexture(), NULL, &dest);
+		}
+	}
+	for (int i = 0; i < snapshot->restingCount + snapshot->movingCount; i++)
+	{
+		cardSprite& card = (i < snapshot->restingCount) ? snapshot->resting[i] : snapshot->moving[i - snapshot->restingCount];
+		dest.x = card.x;
+		dest.y = card.y;
+		SDL_RenderCopy(bench->renderer, bench->textures[card.image].getSDLTexture(), NULL, &dest);
+	}
+
+	/* Runs the queued commands. A surface renderer has nothing else to present to. */
+	SDL_RenderPresent(bench->renderer);
+}
+
+void benchSoftFrame(renderBench* bench, int frame)
+{
+	benchDrag(bench, frame);
+	bench->soft->draw(&bench->pixels[0], bench->width, bench->width, bench->height, bench->snapshot, bench->cached);
+}
+
+/* Draws frames for RENDER_BENCH_SECONDS and prints the rate */
+void benchFrames(const char* name, void (*frame)(renderBench* bench, int frame), renderBench* bench)
+{
+	Uint64 frequency = SDL_GetPerformanceFrequency();
+	Uint64 start = SDL_GetPerformanceCounter();
+	Uint64 end = start + frequency * RENDER_BENCH_SECONDS;
+	Uint64 now;
+	int frames = 0;
+	do
+	{
+		frame(bench, frames++);
+		now = SDL_GetPerformanceCounter();
+	} while ((now < end) || (frames < 3));
+	printf("  %-32s %8.1f fps\n", name, frames * (double)frequency / (double)(now - start));
+}
+
+void AssetManager::benchmarkRenderers()
+{
+	const int sizes[][2] = { { 1920, 1080 }, { 3840, 2160 } };
+	int threads = SDL_GetCPUCount();
+	int oldW = mTableW, oldH = mTableH;
+	printf("Software rendering: %s blending, %i threads\n", blendKernelName(), threads);
+
+	SDL_Event resize;
+	SDL_zero(resize);
+	resize.type = SDL_WINDOWEVENT;
+	resize.window.event = SDL_WINDOWEVENT_SIZE_CHANGED;
+
+	for (int s = 0; s < (int)(sizeof(sizes) / sizeof(sizes[0])); s++)
+	{
+		/* Lay the table out at this size */
+		resize.window.data1 = sizes[s][0];
+		resize.window.data2 = sizes[s][1];
+		handleEvent(resize);
+		publishSnapshot();
+		tableSnapshot snapshot = *acquireSnapshot();
+		releaseSnapshot(false);
+		if (snapshot.restingCount)
+		{
+			snapshot.moving[snapshot.movingCount++] = snapshot.resting[--snapshot.restingCount];
+		}
+
+		renderBench bench;
+		bench.snapshot = &snapshot;
+		bench.dragX = snapshot.movingCount ? snapshot.moving[snapshot.movingCount - 1].x : 0;
+		bench.width = sizes[s][0];
+		bench.height = sizes[s][1];
+		bench.renderer = NULL;
+		bench.textures = NULL;
+		bench.soft = &mSoftRenderer;
+		bench.pixels.resize(bench.width * bench.height);
+		bench.cached = false;
+		printf("%ix%i\n", bench.width, bench.height);
+
+		/* SDL's own software renderer, scaling the color-keyed art every frame */
+		SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, bench.width, bench.height, 32, SDL_PIXELFORMAT_ARGB8888);
+		bench.renderer = surface ? SDL_CreateSoftwareRenderer(surface) : NULL;
+		if (!bench.renderer)
+		{
+			printf("  SDL's software renderer could not be created!\n  SDL Error: %s\n", SDL_GetError());
+		}
+		else
+		{
+			bool loaded = true;
+			bench.textures = new Texture[NUM_SOFT_IMAGES];
+			for (int i = 0; i < NUM_SOFT_IMAGES && loaded; i++)
+			{
+				loaded = bench.textures[i].loadFromFile(softImagePath(i), bench.renderer);
+			}
+			SDL_SetRenderDrawColor(bench.renderer, RENDER_BGCOLOR);
+			if (loaded)
+			{
+				benchFrames("SDL software renderer", benchSDLFrame, &bench);
+			}
+			delete[] bench.textures;
+			SDL_DestroyRenderer(bench.renderer);
+		}
+		SDL_FreeSurface(surface);
+
+		/* Scaling (or painting) the art happens once, on the first frame at a new size */
+		mSoftRenderer.setThreads(threads);
+		mSoftRenderer.dropScaled();
+		Uint64 start = SDL_GetPerformanceCounter();
+		benchSoftFrame(&bench, 0);
+		printf("  %-32s %8.1f ms\n", "First frame, sizing the art", (SDL_GetPerformanceCounter() - start) * 1000.0 / SDL_GetPerformanceFrequency());
+
+		std::stringstream name;
+		mSoftRenderer.setThreads(1);
+		benchFrames("CPU, 1 thread", benchSoftFrame, &bench);
+		if (threads > 1)
+		{
+			mSoftRenderer.setThreads(threads);
+			name << "CPU, " << threads << " threads";
+			benchFrames(name.str().c_str(), benchSoftFrame, &bench);
+		}
+
+		/* Only the dragged card is drawn over the cached table */
+		bench.cached = true;
+		name.str("");
+		name << "CPU, " << threads << (threads > 1 ? " threads" : " thread") << ", cached table";
+		benchFrames(name.str().c_str(), benchSoftFrame, &bench);
+	}
+
+	/* Back to the window */
+	resize.window.data1 = oldW;
+	resize.window.data2 = oldH;
+	handleEvent(resize);
+	mSoftRenderer.setThreads(threads);
+	mSoftRenderer.dropScaled();
+}
+
+void AssetManager::registerCard(Card* card)
+{
+	mPiles[card->getRank()].push(card);
+	invalidateBoard();
+}
+
+Texture* AssetManager::getCardTexture(int suit, int value)
+{
+	if ((suit < SPADES) || (suit >= NUM_SUITS))
+		suit = SPADES;
+	if ((value < ACE) || (value > NUM_FACES))
+		value = ACE;
+	return& mFaceTextures[suit][value];
+}
+
+Texture* AssetManager::getTextureByIndex(int texture)
+{
+	if (texture == CARD_BACK_TEXTURE)
+	{
+		return& mDeckTexture;
+	}
+	return getCardTexture(suitOf(texture - 1), valueOf(texture - 1));
+}
+
+void AssetManager::handleEvent(SDL_Event& e)
+{
+	/* Keep the simulation's own copy of the window state */
+	if (e.type == SDL_WINDOWEVENT)
+	{
+		switch (e.window.event)
+		{
+		case SDL_WINDOWEVENT_SIZE_CHANGED:
+			mTableW = e.window.data1;
+			mTableH = e.window.data2;
+			computeCardPlaces();
+			invalidateBoard();
+			break;
+		case SDL_WINDOWEVENT_MINIMIZED:
+			mMinimized = true;
+			break;
+		case SDL_WINDOWEVENT_MAXIMIZED:
+		case SDL_WINDOWEVENT_RESTORED:
+			mMinimized = false;
+			break;
+		}
+	}
+
+	/* Menu choices the main thread passed along */
+	if (e.type == SDL_USEREVENT)
+	{
+		switch (e.user.code)
+		{
+		case MENU_NEW_GAME:
+			newGame(chooseDealSeed(mOptions.winnableOnly));
+			break;
+		case MENU_NEW_WINNABLE:
+			newGame(chooseDealSeed(true));
+			break;
+		}
+	}
+
+	if (e.type == SDL_MOUSEBUTTONDOWN)
+	{
+		if ((e.button.button == SDL_BUTTON_LEFT) && !mDragBase)
+		{
+			/* Get mouse position */
+			int x = e.button.x;
+			int y = e.button.y;
+			if (pointWithinBounds(x, y, mCardPlaces[0].x, mCardPlaces[0].y, mCardW, mCardH))
+			{
+				Pile& stock = mPiles[STOCK_RANK];
+				Pile& waste = mPiles[WASTE_RANK];
+				if (stock.empty() && !waste.empty())
+				{
+					/* Turning the waste over puts the first card drawn back on top */
+					logMove(MOVE_RECYCLE, WASTE_RANK, STOCK_RANK, waste.size());
+					waste.spliceReversed(stock, waste.size());
+					for (int i = 0; i < stock.size(); i++)
+					{
+						if (stock.at(i)->getFlipState())
+						{
+							stock.at(i)->flip();
+						}
+					}
+					updateClickability(STOCK_RANK);
+					invalidateBoard();
+				}
+			}
+		}
+	}
+}
+
+
+EventQueue::EventQueue()
+{
+	SDL_AtomicSet(&mHead, 0);
+	SDL_AtomicSet(&mTail, 0);
+}
+
+bool EventQueue::push(SDL_Event& e)
+{
+	int tail = SDL_AtomicGet(&mTail);
+	int next = (tail + 1) % CAPACITY;
+	if (next == SDL_AtomicGet(&mHead))
+	{
+		return false;
+	}
+	mEvents[tail] = e;
+	SDL_AtomicSet(&mTail, next); /* Publishes the event */
+	return true;
+}
+
+bool EventQueue::pop(SDL_Event& e)
+{
+	int head = SDL_AtomicGet(&mHead);
+	if (head == SDL_AtomicGet(&mTail))
+	{
+		return false;
+	}
+	e = mEvents[head];
+	SDL_AtomicSet(&mHead, (head + 1) % CAPACITY); /* Hands the slot back */
+	return true;
+}
+
+
+InputFrame::InputFrame()
+{
+	mCount = 0;
+	mMerged = 0;
+}
+
+void InputFrame::drain(EventQueue& queue)
+{
+	mCount = 0;
+	SDL_Event e;
+	while ((mCount < CAPACITY) && queue.pop(e))
+	{
+		if ((e.type == SDL_MOUSEMOTION) && mCount && (mEvents[mCount - 1].type == SDL_MOUSEMOTION))
+		{
+			SDL_Event& last = mEvents[mCount - 1];
+
+			/* Latency still counts from the first motion folded in */
+			Uint32 first = last.motion.timestamp;
+			Sint32 xrel = last.motion.xrel + e.motion.xrel;
+			Sint32 yrel = last.motion.yrel + e.motion.yrel;
+			last = e;
+			last.motion.timestamp = first;
+			last.motion.xrel = xrel;
+			last.motion.yrel = yrel;
+			mMerged++;
+			continue;
+		}
+		mEvents[mCount++] = e;
+	}
+}
+
+
+LatencyHistogram::LatencyHistogram()
+{
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		mCounts[i] = 0;
+	}
+	mTotal =
+		mMax = 0;
+	mSum = 0;
+}
+
+void LatencyHistogram::add(Uint32 ms)
+{
+	mCounts[min(ms, (Uint32)(BUCKETS - 1))]++;
+	mTotal++;
+	mSum += ms;
+	mMax = max(mMax, ms);
+}
+
+void LatencyHistogram::print()
+{
+	if (!mTotal)
+	{
+		printf("No input latency was measured.\n");
+		return;
+	}
+
+	/* Percentiles come straight out of the buckets */
+	const double percents[] = { 0.5, 0.9, 0.99 };
+	int percentiles[3];
+	for (int p = 0; p < 3; p++)
+	{
+		Uint32 seen = 0;
+		int bucket = 0;
+		while ((bucket < BUCKETS - 1) && (seen + mCounts[bucket] < percents[p] * mTotal))
+		{
+			seen += mCounts[bucket++];
+		}
+		percentiles[p] = bucket;
+	}
+
+	printf("Input to present latency: %u inputs, mean %.1f ms, p50 %i ms, p90 %i ms, p99 %i ms, max %u ms\n",
+		mTotal, (double)mSum / mTotal, percentiles[0], percentiles[1], percentiles[2], mMax);
+
+	Uint32 tallest = 1;
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		tallest = max(tallest, mCounts[i]);
+	}
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		if (!mCounts[i])
+		{
+			continue;
+		}
+		printf("%3i%s ms %7u ", i, (i == BUCKETS - 1) ? "+" : " ", mCounts[i]);
+		for (Uint32 bar = 0; bar < (mCounts[i] * 50 + tallest - 1) / tallest; bar++)
+		{
+			printf("#");
+		}
+		printf("\n");
+	}
+}
+
+FrameRecorder::FrameRecorder()
+{
+	mFreeCount =
+		mQueueHead =
+		mQueueCount = 0;
+	mLock = NULL;
+	mReady = NULL;
+	mStopping = false;
+	mYUV = false;
+	mStream = NULL;
+	mStreamW =
+		mStreamH = 0;
+	mWriteLock = NULL;
+	mWritten = NULL;
+	mNextWrite = 0;
+	mInterval =
+		mNextDue = 0;
+	mFrames =
+		mDropped =
+		mRenderFrames = 0;
+	mFirstFrame =
+		mLastFrame =
+		mCaptureTime = 0;
+	SDL_AtomicSet(&mFailed, 0);
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	stop();
+}
+
+bool FrameRecorder::start(const char* path, bool yuv, int fps, int workers)
+{
+	stop();
+	mPath = path;
+	mYUV = yuv;
+	mInterval = 1000 / (fps > 0 ? fps : 1);
+	mNextDue = 0;
+	mFrames =
+		mDropped =
+		mRenderFrames =
+		mNextWrite = 0;
+	mCaptureTime = 0;
+	SDL_AtomicSet(&mFailed, 0);
+
+	mFreeCount = BUFFERS;
+	for (int i = 0; i < BUFFERS; i++)
+	{
+		mFree[i] = i;
+	}
+	mQueueHead =
+		mQueueCount = 0;
+	mStopping = false;
+
+	mLock = SDL_CreateMutex();
+	mReady = SDL_CreateCond();
+	mWriteLock = SDL_CreateMutex();
+	mWritten = SDL_CreateCond();
+	if (!mLock || !mReady || !mWriteLock || !mWritten)
+	{
+		printf("The recorder could not be set up!\nSDL Error: %s\n", SDL_GetError());
+		stop();
+		return false;
+	}
+
+	/* The last buffer would only be waiting for a worker anyway */
+	workers = (workers < 1) ? 1 : ((workers > BUFFERS - 1) ? BUFFERS - 1 : workers);
+	for (int i = 0; i < workers; i++)
+	{
+		SDL_Thread* worker = SDL_CreateThread(work, "Recorder", this);
+		if (!worker)
+		{
+			printf("A recording thread could not be started!\nSDL Error: %s\n", SDL_GetError());
+			break;
+		}
+		mWorkers.push_back(worker);
+	}
+	if (mWorkers.empty())
+	{
+		stop();
+		return false;
+	}
+
+	printf("Recording to %s_* as %s at %i fps on %i threads.\n", path, yuv ? "raw I420" : "PNG", fps, (int)mWorkers.size());
+	return true;
+}
+
+void FrameRecorder::stop()
+{
+	if (mLock)
+	{
+		SDL_LockMutex(mLock);
+		mStopping = true;
+		SDL_CondBroadcast(mReady);
+		SDL_UnlockMutex(mLock);
+	}
+	for (size_t i = 0; i < mWorkers.size(); i++)
+	{
+		SDL_WaitThread(mWorkers[i], NULL);
+	}
+	bool recorded = !mWorkers.empty();
+	mWorkers.clear();
+
+	if (mStream)
+	{
+		fclose(mStream);
+		mStream = NULL;
+	}
+	SDL_DestroyCond(mWritten);
+	SDL_DestroyMutex(mWriteLock);
+	SDL_DestroyCond(mReady);
+	SDL_DestroyMutex(mLock);
+	mWritten = NULL;
+	mWriteLock = NULL;
+	mReady = NULL;
+	mLock = NULL;
+
+	if (!recorded)
+	{
+		return;
+	}
+
+	printf("Recorded %u frames to %s_*. %u were dropped because every buffer was still being written.\n",
+		mFrames, mPath.c_str(), mDropped);
+	if (SDL_AtomicGet(&mFailed))
+	{
+		printf("%i frames could not be written.\n", SDL_AtomicGet(&mFailed));
+	}
+	if (mFrames && (mRenderFrames > 1))
+	{
+		double frequency = (double)SDL_GetPerformanceFrequency();
+		double frameMs = (mLastFrame - mFirstFrame) * 1000.0 / frequency / (mRenderFrames - 1);
+		double perFrameMs = mCaptureTime * 1000.0 / frequency / mRenderFrames;
+		printf("Capture took %.2f ms a recorded frame, %.2f ms a frame on average: %.1f%% of the %.2f ms frame time.\n",
+			mCaptureTime * 1000.0 / frequency / mFrames, perFrameMs, frameMs > 0 ? 100.0 * perFrameMs / frameMs : 0.0, frameMs);
+	}
+}
+
+bool FrameRecorder::isDue(Uint64 now)
+{
+	if (!mRenderFrames++)
+	{
+		mFirstFrame = now;
+	}
+	mLastFrame = now;
+
+	Uint32 ticks = SDL_GetTicks();
+	if ((mRenderFrames > 1) && !SDL_TICKS_PASSED(ticks, mNextDue))
+	{
+		return false;
+	}
+
+	/* A render thread slower than the recording rate records every frame it draws */
+	mNextDue += mInterval;
+	if ((mRenderFrames == 1) || SDL_TICKS_PASSED(ticks, mNextDue))
+	{
+		mNextDue = ticks + mInterval;
+	}
+	return true;
+}
+
+FrameRecorder::frameBuffer* FrameRecorder::claim(int width, int height)
+{
+	SDL_LockMutex(mLock);
+	int index = mFreeCount ? mFree[--mFreeCount] : -1;
+	SDL_UnlockMutex(mLock);
+	if (index < 0)
+	{
+		mDropped++;
+		return NULL;
+	}
+
+	/* Buffers only grow, so a steady window size never allocates */
+	frameBuffer* frame = &mBuffers[index];
+	if (frame->pixels.size() < (size_t)(width * height))
+	{
+		frame->pixels.resize(width * height);
+	}
+	frame->width = width;
+	frame->height = height;
+	return frame;
+}
+
+void FrameRecorder::submit(frameBuffer* frame, Uint64 started)
+{
+	frame->number = mFrames++;
+	SDL_LockMutex(mLock);
+	mQueue[(mQueueHead + mQueueCount++) % BUFFERS] = (int)(frame - mBuffers);
+	SDL_CondSignal(mReady);
+	SDL_UnlockMutex(mLock);
+	mCaptureTime += SDL_GetPerformanceCounter() - started;
+}
+
+void FrameRecorder::captureRenderer(SDL_Renderer* renderer)
+{
+	Uint64 started = SDL_GetPerformanceCounter();
+	int width, height;
+	if (!isDue(started) || (SDL_GetRendererOutputSize(renderer, &width, &height) < 0) || (width < 1) || (height < 1))
+	{
+		return;
+	}
+
+	frameBuffer* frame = claim(width, height);
+	if (!frame)
+	{
+		mCaptureTime += SDL_GetPerformanceCounter() - started;
+		return;
+	}
+	if (SDL_RenderReadPixels(renderer, NULL, SDL_PIXELFORMAT_ARGB8888, &frame->pixels[0], width * 4) < 0)
+	{
+		printf("A frame could not be read back!\nSDL Error: %s\n", SDL_GetError());
+		SDL_LockMutex(mLock);
+		mFree[mFreeCount++] = (int)(frame - mBuffers);
+		SDL_UnlockMutex(mLock);
+		return;
+	}
+	submit(frame, started);
+}
+
+void FrameRecorder::capturePixels(const void* pixels, int pitch, int width, int height)
+{
+	Uint64 started = SDL_GetPerformanceCounter();
+	if (!isDue(started) || (width < 1) || (height < 1))
+	{
+		return;
+	}
+
+	frameBuffer* frame = claim(width, height);
+	if (!frame)
+	{
+		mCaptureTime += SDL_GetPerformanceCounter() - started;
+		return;
+	}
+	for (int y = 0; y < height; y++)
+	{
+		memcpy(&frame->pixels[y * width], (const Uint8*)pixels + y * pitch, width * 4);
+	}
+	submit(frame, started);
+}
+
+int FrameRecorder::work(void* data)
+{
+	FrameRecorder* recorder = (FrameRecorder*)data;
+	std::vector<Uint8> yuv; /* Each worker converts into its own */
+
+	SDL_LockMutex(recorder->mLock);
+	for (;;)
+	{
+		while (!recorder->mQueueCount && !recorder->mStopping)
+		{
+			SDL_CondWait(recorder->mReady, recorder->mLock);
+		}
+		if (!recorder->mQueueCount)
+		{
+			break; /* Stopping, with nothing left to write */
+		}
+		int index = recorder->mQueue[recorder->mQueueHead];
+		recorder->mQueueHead = (recorder->mQueueHead + 1) % BUFFERS;
+		recorder->mQueueCount--;
+		SDL_UnlockMutex(recorder->mLock);
+
+		recorder->encode(recorder->mBuffers[index], yuv);
+
+		SDL_LockMutex(recorder->mLock);
+		recorder->mFree[recorder->mFreeCount++] = index;
+	}
+	SDL_UnlockMutex(recorder->mLock);
+	return 0;
+}
+
+void FrameRecorder::encode(frameBuffer& frame, std::vector<Uint8>& yuv)
+{
+	int width = frame.width;
+	int height = frame.height;
+
+	if (!mYUV)
+	{
+		char number[16];
+		snprintf(number, sizeof(number), "%06u", frame.number);
+		std::stringstream filename;
+		filename << mPath << "_" << number << ".png";
+		SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormatFrom(&frame.pixels[0], width, height, 32, width * 4, SDL_PIXELFORMAT_ARGB8888);
+		if (!surface || (IMG_SavePNG(surface, filename.str().c_str()) < 0))
+		{
+			SDL_AtomicIncRef(&mFailed);
+		}
+		SDL_FreeSurface(surface);
+		return;
+	}
+
+	/* Converting happens in parallel. Only the write waits its turn. */
+	int chroma = ((width + 1) / 2) * ((height + 1) / 2);
+	yuv.resize(width * height + chroma * 2);
+	bool converted = SDL_ConvertPixels(width, height, SDL_PIXELFORMAT_ARGB8888, &frame.pixels[0], width * 4,
+		SDL_PIXELFORMAT_IYUV, &yuv[0], width) == 0;
+
+	SDL_LockMutex(mWriteLock);
+	while (mNextWrite != frame.number)
+	{
+		SDL_CondWait(mWritten, mWriteLock);
+	}
+
+	if (converted && (!mStream || (mStreamW != width) || (mStreamH != height)))
+	{
+		if (mStream)
+		{
+			fclose(mStream);
+		}
+		std::stringstream filename;
+		filename << mPath << "_" << width << "x" << height << "_" << frame.number << ".yuv";
+		mStream = fopen(filename.str().c_str(), "wb");
+		mStreamW = width;
+		mStreamH = height;
+		if (!mStream)
+		{
+			printf("%s could not be opened for recording!\n", filename.str().c_str());
+		}
+		else
+		{
+			printf("Recording %s. Play it with: ffplay -f rawvideo -pixel_format yuv420p -video_size %ix%i -framerate %u %s\n",
+				filename.str().c_str(), width, height, 1000 / mInterval, filename.str().c_str());
+		}
+	}
+	if (!converted || !mStream || (fwrite(&yuv[0], 1, yuv.size(), mStream) != yuv.size()))
+	{
+		SDL_AtomicIncRef(&mFailed);
+	}
+
+	mNextWrite++;
+	SDL_CondBroadcast(mWritten);
+	SDL_UnlockMutex(mWriteLock);
+}
+
+
+FacePager::FacePager()
+{
+	mTextures = NULL;
+	mBudget = 0;
+	mWorker = NULL;
+	mLock = NULL;
+	mWake = NULL;
+	mStopping = false;
+	mDecoding = -1;
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		mFaces[i] = NULL;
+		mWanted[i] = false;
+		mResident[i] = false;
+		mDecoded[i] = NULL;
+		mLastUsed[i] = 0;
+		mMissing[i] = false;
+	}
+	mFrame = 1;
+	mResidentBytes =
+		mPeakBytes = 0;
+	mDemandLoads =
+		mPrefetched =
+		mEvictions =
+		mOverBudget = 0;
+}
+
+FacePager::~FacePager()
+{
+	stop();
+}
+
+bool FacePager::start(TextureRegistry* textures, Texture* faces[NUM_CARDS], Uint64 budget)
+{
+	stop();
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		mFaces[i] = faces[i];
+	}
+	mBudget = budget;
+	mStopping = false;
+
+	mLock = SDL_CreateMutex();
+	mWake = SDL_CreateCond();
+	if (!mLock || !mWake)
+	{
+		printf("The face pager could not be set up!\nSDL Error: %s\n", SDL_GetError());
+		stop();
+		return false;
+	}
+	mTextures = textures;
+
+	/* Without the worker every face is decoded when it is first drawn */
+	mWorker = SDL_CreateThread(work, "Faces", this);
+	if (!mWorker)
+	{
+		printf("The face prefetching thread could not be started!\nSDL Error: %s\n", SDL_GetError());
+	}
+	return true;
+}
+
+void FacePager::stop()
+{
+	if (mLock)
+	{
+		SDL_LockMutex(mLock);
+		mStopping = true;
+		SDL_CondBroadcast(mWake);
+		SDL_UnlockMutex(mLock);
+	}
+	if (mWorker)
+	{
+		SDL_WaitThread(mWorker, NULL);
+		mWorker = NULL;
+	}
+
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		SDL_FreeSurface(mDecoded[i]);
+		mDecoded[i] = NULL;
+		mWanted[i] = false;
+		if (mResident[i])
+		{
+			mFaces[i]->free();
+			mResident[i] = false;
+		}
+	}
+	mResidentBytes = 0;
+
+	SDL_DestroyCond(mWake);
+	SDL_DestroyMutex(mLock);
+	mWake = NULL;
+	mLock = NULL;
+	mTextures = NULL;
+}
+
+void FacePager::prefetch(int card)
+{
+	if (!mTextures || !mWorker || (card < 0) || (card >= NUM_CARDS))
+	{
+		return;
+	}
+	SDL_LockMutex(mLock);
+	if (!mResident[card] && !mDecoded[card] && !mWanted[card])
+	{
+		mWanted[card] = true;
+		SDL_CondSignal(mWake);
+	}
+	SDL_UnlockMutex(mLock);
+}
+
+bool FacePager::use(int card)
+{
+	if (!mTextures || (card < 0) || (card >= NUM_CARDS))
+	{
+		return false;
+	}
+	mLastUsed[card] = mFrame;
+	if (mFaces[card]->isLoaded())
+	{
+		return true;
+	}
+	if (mMissing[card])
+	{
+		return false; /* Already said so */
+	}
+
+	/* Take the worker's decode if it got there first */
+	SDL_LockMutex(mLock);
+	SDL_Surface* level = mDecoded[card];
+	mDecoded[card] = NULL;
+	mWanted[card] = false;
+	SDL_UnlockMutex(mLock);
+	return load(card, level);
+}
+
+bool FacePager::load(int card, SDL_Surface* level)
+{
+	Texture* face = mFaces[card];
+	int width = face->getWidth();
+	int height = face->getHeight();
+
+	if (level)
+	{
+		mPrefetched++;
+	}
+	else
+	{
+		mDemandLoads++;
+		level = Texture::decodeMipSource(softImagePath(card + 1));
+		if (!level)
+		{
+			mMissing[card] = true;
+			return false;
+		}
+	}
+	face->share(mTextures->uploadMipChain(level, softImagePath(card + 1)));
+	if (!face->isLoaded())
+	{
+		mMissing[card] = true;
+		return false;
+	}
+
+	/* Drawn at the card size, not the art's */
+	face->setWidth(width);
+	face->setHeight(height);
+
+	SDL_LockMutex(mLock);
+	mResident[card] = true;
+	SDL_UnlockMutex(mLock);
+	mResidentBytes += face->getBytes();
+	if (mResidentBytes > mPeakBytes)
+	{
+		mPeakBytes = mResidentBytes;
+	}
+	return true;
+}
+
+void FacePager::endFrame()
+{
+	if (!mTextures)
+	{
+		return;
+	}
 
-	/* Initialize SDL */
-	if (SDL_Init(SDL_INIT_EVENTS | SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0)
+	/* Faces decoded ahead of time count as used now, so they aren't the first to go */
+	SDL_Surface* decoded[NUM_CARDS];
+	SDL_LockMutex(mLock);
+	for (int i = 0; i < NUM_CARDS; i++)
 	{
-		printf("SDL could not initialize!\nSDL Error: %s\n", SDL_GetError());
-		success = false;
+		decoded[i] = mDecoded[i];
+		mDecoded[i] = NULL;
 	}
-	else
+	SDL_UnlockMutex(mLock);
+	for (int i = 0; i < NUM_CARDS; i++)
 	{
-		/* Set texture filtering quality */
-		if (!SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "2")) /* "2" = "best", but currently "best" = "linear" */
+		if (decoded[i])
 		{
-			printf("Texture filtering could not be enabled!");
+			mLastUsed[i] = mFrame;
+			load(i, decoded[i]);
 		}
+	}
 
-		/* Create window */
-		if (!mWindow.init())
-		{
-			printf("The window could not be created!\nSDL Error: %s\n", SDL_GetError());
-			success = false;
-		}
-		else
+	/* Least recently drawn first. What this frame drew stays, even over the budget. */
+	while (mBudget && (mResidentBytes > mBudget))
+	{
+		int oldest = -1;
+		for (int i = 0; i < NUM_CARDS; i++)
 		{
-			/* Create renderer for window */
-			mRenderer = mWindow.createRenderer();
-			if (!mRenderer)
-			{
-				printf("The renderer could not be created!\nSDL Error: %s\n", SDL_GetError());
-				success = false;
-			}
-			else
+			if (mFaces[i]->isLoaded() && (mLastUsed[i] != mFrame) &&
+				((oldest < 0) || (mLastUsed[i] < mLastUsed[oldest])))
 			{
-				/* Initialize renderer color */
-				SDL_SetRenderDrawColor(mRenderer, RENDER_BGCOLOR);
-
-				/* Initialize PNG loading */
-				int imgFlags = IMG_INIT_PNG;
-				if (!(IMG_Init(imgFlags) & imgFlags))
-				{
-					printf("SDL_image could not initialize!\nSDL_image Error: %s\n", IMG_GetError());
-					success = false;
-				}
-
-				/* Initialize SDL_ttf */
-				if (TTF_Init() == -1)
-				{
-					printf("SDL_ttf could not initialize!\nSDL_ttf Error: %s\n", TTF_GetError());
-					success = false;
-				}
-
-				/* Initialize SDL_mixer */
-				if (Mix_OpenAudio(44100, MIX_DEFAULT_FORMAT, MIX_DEFAULT_CHANNELS, 2048) < 0)
-				{
-					printf("SDL_mixer could not initialize!\nSDL_mixer Error: %s\n", Mix_GetError());
-					success = false;
-				}
+				oldest = i;
 			}
 		}
+		if (oldest < 0)
+		{
+			mOverBudget++;
+			break;
+		}
+
+		/* Free keeps nothing, so the size the face was drawn at goes back on */
+		int width = mFaces[oldest]->getWidth();
+		int height = mFaces[oldest]->getHeight();
+		mResidentBytes -= mFaces[oldest]->getBytes();
+		mFaces[oldest]->free();
+		mFaces[oldest]->setWidth(width);
+		mFaces[oldest]->setHeight(height);
+		mEvictions++;
+
+		SDL_LockMutex(mLock);
+		mResident[oldest] = false;
+		SDL_UnlockMutex(mLock);
 	}
-	return success;
+	mFrame++;
 }
 
-bool AssetManager::LoadMedia()
+bool FacePager::isBusy()
 {
-	bool success = true;
-
-	/* Open the font */
-	mFont = TTF_OpenFont("C:/Windows/Fonts/calibri.ttf", 28);
-	if (!mFont)
+	/* Without the worker nothing is decoded ahead, so there's nothing to wait for */
+	if (!mTextures || !mWorker)
 	{
-		printf("The font could not be loaded!\nSDL_ttf Error: %s\n", TTF_GetError());
-		success = false;
+		return false;
 	}
-
-	if (!mBackgroundTexture.loadFromFile("table.png", mRenderer))
+	SDL_LockMutex(mLock);
+	bool busy = mDecoding >= 0;
+	for (int i = 0; !busy && (i < NUM_CARDS); i++)
 	{
-		printf("The background texture could not be loaded!\n");
-		success = false;
+		busy = mWanted[i] || mDecoded[i];
 	}
+	SDL_UnlockMutex(mLock);
+	return busy;
+}
 
-	/* Load sound effect */
-	mSound = Mix_LoadWAV("fire.wav");
-	if (!mSound)
+void FacePager::printStats()
+{
+	if (!mDemandLoads && !mPrefetched)
 	{
-		printf("The sound effect could not be loaded!\nSDL_mixer Error: %s\n", Mix_GetError());
-		success = false;
+		return;
 	}
-
-	/* Load deck texture */
-	if (!mDeckTexture.loadFromFile("cards/back.png", mRenderer))
+	printf("Faces: %u loaded when first drawn, %u prefetched, %u evicted. At most %.1f MB were resident",
+		mDemandLoads, mPrefetched, mEvictions, mPeakBytes / (1024.0 * 1024.0));
+	if (mBudget)
 	{
-		printf("The deck texture could not be loaded!\n");
-		success = false;
+		printf(" of the %.1f MB budget", mBudget / (1024.0 * 1024.0));
 	}
-
-	/* Load outline texture */
-	if (!mOutlineTexture.loadFromFile("cards/outline.png", mRenderer))
+	printf(".\n");
+	if (mOverBudget)
 	{
-		printf("The outline texture could not be loaded!\n");
-		success = false;
+		printf("The faces on the table needed more than the budget for %u frames.\n", mOverBudget);
 	}
+}
 
-	/* Load face textures */
-	/* Init to back */
-	for (int i = 0; i < NUM_SUITS; i++)
+int FacePager::work(void* data)
+{
+	FacePager* pager = (FacePager*)data;
+
+	SDL_LockMutex(pager->mLock);
+	for (;;)
 	{
-		for (int j = 0; j <= NUM_FACES; j++)
+		int card = -1;
+		while (!pager->mStopping)
 		{
-			/* FIXME: Can't we just set these = mDeckTexture ? */
-			if (!mFaceTextures[i][j].loadFromFile("cards/back.png", mRenderer))
+			for (int i = 0; (card < 0) && (i < NUM_CARDS); i++)
 			{
-				printf("The card back texture could not be loaded!\n");
-				success = false;
-				break;
+				card = pager->mWanted[i] ? i : -1;
 			}
-		}
-	}
-
-	/*
-		Yes, I'm pretending that index 0 doesn't exist.
-		This way 1 = Ace, 2 = 2, ... (13 = King)
-	*/
-	for (int i = 0; i < NUM_SUITS; i++)
-	{
-		const std::string suitName (nameOfSuit(i));
-		for (int j = 1; j <= NUM_FACES; j++)
-		{
-			std::stringstream filename;
-			filename << "cards/" << suitName << "/" << j << ".png";
-			if (!mFaceTextures[i][j].loadFromFile(filename.str(), mRenderer))
+			if (card >= 0)
 			{
-				printf("The texture could not be loaded for the %i of %s!\n", j, suitName.c_str());
-				success = false;
 				break;
 			}
-			/* I don't understand the math either... */
-			mAllFaces[(i * NUM_FACES) + (j - 1)].suit = i;
-			mAllFaces[(i * NUM_FACES) + (j - 1)].value = j;
+			SDL_CondWait(pager->mWake, pager->mLock);
 		}
-	}
+		if (pager->mStopping)
+		{
+			break;
+		}
+		pager->mWanted[card] = false;
+		pager->mDecoding = card;
+		SDL_UnlockMutex(pager->mLock);
 
-	srand(unsigned(time(NULL)));
-	/* Serious (new) C++ magic */
-	std::random_shuffle(std::begin(mAllFaces), std::end(mAllFaces));
+		SDL_Surface* level = Texture::decodeMipSource(softImagePath(card + 1));
 
-	return success;
+		/* The render thread may have needed it first */
+		SDL_LockMutex(pager->mLock);
+		pager->mDecoding = -1;
+		if (pager->mResident[card] || pager->mDecoded[card] || pager->mStopping)
+		{
+			SDL_FreeSurface(level);
+		}
+		else
+		{
+			pager->mDecoded[card] = level;
+		}
+	}
+	SDL_UnlockMutex(pager->mLock);
+	return 0;
 }
 
-void AssetManager::Close()
+TableWall::TableWall()
 {
-	mRenderer = NULL;
-	mSDLWindow = NULL;
-	mIconSurface = NULL;
-	mFont = NULL;
-	mSound = NULL;
+	mGame = NULL;
+	mPolicy = NULL;
+	mMoveMs = 0;
+	mNextSeed = 0;
+	mWon =
+		mPlayed = 0;
+	for (int i = 0; i < 2; i++)
+	{
+		mSnapshots[i].won =
+			mSnapshots[i].played = 0;
+	}
+	SDL_AtomicSet(&mFront, 0);
+	SDL_AtomicSet(&mReading, -1);
+	SDL_AtomicSet(&mLost, 0);
+	mWidth =
+		mHeight =
+		mColumns =
+		mTileW =
+		mTileH =
+		mCardW =
+		mCardH =
+		mFan = 0;
 }
 
-void AssetManager::clearRenderer()
+TableWall::~TableWall()
 {
-	SDL_SetRenderDrawColor(mRenderer, RENDER_BGCOLOR);
-	SDL_RenderClear(mRenderer);
+	mWall.free();
+	delete mPolicy;
 }
 
-void AssetManager::computeCardPlaces()
+bool TableWall::init(AssetManager& game, int count, const char* policyName, int moveMs)
 {
-	int cardW = mDeckTexture.getWidth();
-	int cardH = mDeckTexture.getHeight();
+	mPolicy = createPolicy(policyName);
+	if (!mPolicy)
+	{
+		printf("There is no %s policy to play the tables!\n", policyName);
+		return false;
+	}
 
-	int margin_y = max(cardW / 8, 4);
-	int margin_x = max((mWindow.getWidth() - (cardW * 7)) / 8, 4);
+	mGame = &game;
+	mMoveMs = moveMs;
+	count = (count < MIN_TABLES) ? MIN_TABLES : (count > MAX_TABLES) ? MAX_TABLES : count;
+	mTables.resize(count);
+	for (int i = 0; i < 2; i++)
+	{
+		mSnapshots[i].games.resize(count);
+		mSnapshots[i].versions.assign(count, 0);
+	}
+	mDrawn.assign(count, 0);
 
-	mCardPlaces[0].y = margin_y;
-	mCardPlaces[1].y = margin_y;
-	mCardPlaces[2].y = margin_y;
-	mCardPlaces[3].y = margin_y;
-	mCardPlaces[4].y = margin_y;
-	mCardPlaces[5].y = margin_y;
+	/* Spread the moves out, so the tables don't all change in the same frame */
+	Uint32 now = SDL_GetTicks();
+	for (int i = 0; i < count; i++)
+	{
+		mTables[i].version = 0;
+		deal(mTables[i]);
+		mTables[i].nextMove = now + (Uint32)(mMoveMs * i / count);
+	}
 
-	mCardPlaces[6].y = margin_y * 2 + cardH;
-	mCardPlaces[7].y = margin_y * 2 + cardH;
-	mCardPlaces[8].y = margin_y * 2 + cardH;
-	mCardPlaces[9].y = margin_y * 2 + cardH;
-	mCardPlaces[10].y = margin_y * 2 + cardH;
-	mCardPlaces[11].y = margin_y * 2 + cardH;
-	mCardPlaces[12].y = margin_y * 2 + cardH;
+	/* The render thread needs something to draw straight away */
+	publish();
+	printf("%i tables played by %s, one move every %i ms.\n", count, mPolicy->name(), mMoveMs);
+	return true;
+}
 
-	mCardPlaces[0].x = margin_x;
-	mCardPlaces[6].x = margin_x;
+void TableWall::deal(wallTable& table)
+{
+	Uint32 seed = mGame->chooseDealSeed(mGame->options()->winnableOnly);
+	table.game.deal(seed);
+	table.random.seed(seed);
+	table.progress = true;
+	table.finished = false;
+	table.version++;
+}
 
-	mCardPlaces[1].x = mCardPlaces[0].x + margin_x + cardW;
-	mCardPlaces[7].x = mCardPlaces[6].x + margin_x + cardW;
+void TableWall::step(Uint32 now)
+{
+	for (size_t i = 0; i < mTables.size(); i++)
+	{
+		wallTable& table = mTables[i];
+		if ((Sint32)(now - table.nextMove) < 0)
+		{
+			continue;
+		}
 
-	mCardPlaces[8].x = mCardPlaces[7].x + margin_x + cardW;
+		if (table.finished)
+		{
+			deal(table);
+			table.nextMove = now + mMoveMs;
+			continue;
+		}
 
-	mCardPlaces[2].x = mCardPlaces[8].x + margin_x + cardW;
-	mCardPlaces[9].x = mCardPlaces[8].x + margin_x + cardW;
+		if ((table.game.getMoves() >= WALL_MAX_MOVES) || !playMove(table.game, *mPolicy, table.random, table.progress))
+		{
+			table.finished = true;
+			mPlayed++;
+			mWon += table.game.isWon() ? 1 : 0;
+			table.nextMove = now + WALL_END_MS;
+			continue;
+		}
+		table.version++;
 
-	mCardPlaces[3].x = mCardPlaces[2].x + margin_x + cardW;
-	mCardPlaces[10].x = mCardPlaces[2].x + margin_x + cardW;
+		/* One move a step at most, however far behind it is */
+		table.nextMove += mMoveMs;
+		if ((Sint32)(now - table.nextMove) > 0)
+		{
+			table.nextMove = now;
+		}
+	}
+}
 
-	mCardPlaces[4].x = mCardPlaces[3].x + margin_x + cardW;
-	mCardPlaces[11].x = mCardPlaces[3].x + margin_x + cardW;
+bool TableWall::publish()
+{
+	/* The render thread may still be drawing the older snapshot */
+	int back = 1 - SDL_AtomicGet(&mFront);
+	if (SDL_AtomicGet(&mReading) == back)
+	{
+		return false;
+	}
 
-	mCardPlaces[5].x = mCardPlaces[4].x + margin_x + cardW;
-	mCardPlaces[12].x = mCardPlaces[4].x + margin_x + cardW;
+	/* Only the games that moved since this snapshot was last filled are copied */
+	wallSnapshot& snapshot = mSnapshots[back];
+	for (size_t i = 0; i < mTables.size(); i++)
+	{
+		if (snapshot.versions[i] != mTables[i].version)
+		{
+			snapshot.games[i] = mTables[i].game;
+			snapshot.versions[i] = mTables[i].version;
+		}
+	}
+	snapshot.won = mWon;
+	snapshot.played = mPlayed;
+
+	SDL_AtomicSet(&mFront, back);
+	return true;
 }
 
-void AssetManager::cardDrop(Card* card)
+wallSnapshot* TableWall::acquire()
 {
-	int oldRank = card->getRank();
-	int oldFile = card->getFile();
+	/* Claim the front snapshot, then make sure it didn't change underneath the claim */
+	int front;
+	do
+	{
+		front = SDL_AtomicGet(&mFront);
+		SDL_AtomicSet(&mReading, front);
+	} while (SDL_AtomicGet(&mFront) != front);
+	return &mSnapshots[front];
+}
 
-	SDL_Rect cardRect;
-	SDL_Rect rankRect;
+void TableWall::release()
+{
+	SDL_AtomicSet(&mReading, -1);
+}
 
-	cardRect.w = mDeckTexture.getWidth();
-	cardRect.h = mDeckTexture.getHeight();
-	cardRect.x = card->getX();
-	cardRect.y = card->getY();
+bool TableWall::layout(int width, int height)
+{
+	if ((width == mWidth) && (height == mHeight))
+	{
+		return false;
+	}
+	mWidth = width;
+	mHeight = height;
 
-	rankRect.w = cardRect.w;
-	rankRect.h = cardRect.h;
-	
-	mRanks[oldRank][oldFile] = nullptr;
-	if (oldFile > 0)
+	int artW = mGame->getCardArtWidth();
+	int artH = mGame->getCardArtHeight();
+	if ((artW < 1) || (artH < 1))
+	{
+		artW = 5;
+		artH = 7;
+	}
+
+	/* The number of columns that gives the biggest cards */
+	int count = (int)mTables.size();
+	mCardW = 0;
+	for (int columns = 1; columns <= count; columns++)
 	{
-		if (mRanks[oldRank][oldFile - 1])
+		int rows = (count + columns - 1) / columns;
+		int tileW = width / columns;
+		int tileH = height / rows;
+
+		/* Seven cards and their margins across, and WALL_TILE_CARDS_HIGH down */
+		int cardW = tileW / 8;
+		int cardH = cardW * artH / artW;
+		int fitH = (int)(tileH / WALL_TILE_CARDS_HIGH);
+		if (cardH > fitH)
 		{
-			mRanks[oldRank][oldFile - 1]->setClickability(true);
+			cardH = fitH;
+			cardW = cardH * artW / artH;
 		}
+		if (cardW > mCardW)
+		{
+			mColumns = columns;
+			mTileW = tileW;
+			mTileH = tileH;
+			mCardW = cardW;
+			mCardH = cardH;
+		}
+	}
+	mCardW = (mCardW < 1) ? 1 : mCardW;
+	mCardH = (mCardH < 1) ? 1 : mCardH;
+	mFan = mCardH / 10;
+
+	/* The table's own layout, shrunk into a tile */
+	int marginX = (mTileW - mCardW * NUM_TABLEAUS) / (NUM_TABLEAUS + 1);
+	int marginY = (mCardW / 8 > 1) ? mCardW / 8 : 1;
+	for (int i = 0; i < NUM_TABLEAUS; i++)
+	{
+		mPlaces[FIRST_TABLEAU + i].x = marginX + i * (marginX + mCardW);
+		mPlaces[FIRST_TABLEAU + i].y = marginY * 2 + mCardH;
 	}
+	mPlaces[STOCK_RANK] = mPlaces[FIRST_TABLEAU];
+	mPlaces[WASTE_RANK] = mPlaces[FIRST_TABLEAU + 1];
+	for (int i = 0; i < NUM_FOUNDATIONS; i++)
+	{
+		mPlaces[FIRST_FOUNDATION + i] = mPlaces[FIRST_TABLEAU + NUM_TABLEAUS - NUM_FOUNDATIONS + i];
+	}
+	for (int i = STOCK_RANK; i < FIRST_TABLEAU; i++)
+	{
+		mPlaces[i].y = marginY;
+	}
+	return true;
+}
+
+void TableWall::addTile(SpriteBatch* batch, int table, const Klondike& game)
+{
+	int x = (table % mColumns) * mTileW;
+	int y = (table / mColumns) * mTileH;
+	Texture* back = mGame->getCardBack();
 
+	batch->add(mGame->getBackground(), x, y);
 	for (int i = 0; i < CARD_RANKS; i++)
 	{
-		/* FIXME: Each rank's "drop zone" does not expand down as it fills */
-		rankRect.x = mCardPlaces[i].x;
-		rankRect.y = mCardPlaces[i].y;
+		if (i != WASTE_RANK) /* No outline for the discard pile */
+		{
+			batch->add(mGame->getCardOutline(), x + mPlaces[i].x, y + mPlaces[i].y);
+		}
+	}
 
-		if (testRectCollision(cardRect, rankRect))
+	/* Only the top card shows anywhere but down the columns */
+	for (int i = STOCK_RANK; i < FIRST_TABLEAU; i++)
+	{
+		if (!game.count(i))
+		{
+			continue;
+		}
+		cardCode top = game.top(i);
+		if (i != STOCK_RANK)
+		{
+			mGame->getFacePager()->use(top);
+		}
+		Texture* texture = (i == STOCK_RANK) ? back : mGame->getCardTexture(suitOf(top), valueOf(top));
+		batch->add(texture, x + mPlaces[i].x, y + mPlaces[i].y);
+	}
+	for (int i = FIRST_TABLEAU; i < CARD_RANKS; i++)
+	{
+		for (int j = 0; j < game.count(i); j++)
 		{
-			for (int j = 0; j < NUM_CARDS; j++)
+			cardCode card = game.card(i, j);
+			if (j >= game.faceDown(i))
 			{
-				if (!mRanks[i][j])
-				{
-					--mHeldCards[card->getRank()];
-					card->setRank(i);
-					card->setFile(j);
-					mRanks[i][j] = card;
-					mHeldCards[card->getRank()]++;
-					if (j > 0)
-					{
-						if (mRanks[i][j - 1])
-						{
-							mRanks[i][j - 1]->setClickability(false);
-						}
-					}
-					card->setClickability(true);
-					return;
-				}
+				mGame->getFacePager()->use(card);
 			}
+			Texture* texture = (j < game.faceDown(i)) ? back : mGame->getCardTexture(suitOf(card), valueOf(card));
+			batch->add(texture, x + mPlaces[i].x, y + mPlaces[i].y + j * mFan);
 		}
 	}
 }
 
-void AssetManager::registerCard(Card* card)
+int TableWall::draw(SDL_Renderer* renderer, SpriteBatch* batch, wallSnapshot* snapshot, int width, int height)
 {
-	mRanks[card->getRank()][card->getFile()] = card;
-}
+	bool all = layout(width, height);
+
+	/* Every tile is the same size, so the shared textures are too */
+	mGame->getBackground()->setWidth(mTileW);
+	mGame->getBackground()->setHeight(mTileH);
+	mGame->getCardBack()->setWidth(mCardW);
+	mGame->getCardBack()->setHeight(mCardH);
+	mGame->getCardOutline()->setWidth(mCardW);
+	mGame->getCardOutline()->setHeight(mCardH);
+	for (int i = 0; i < NUM_SUITS; i++)
+	{
+		for (int j = 1; j <= NUM_FACES; j++)
+		{
+			mGame->getCardTexture(i, j)->setWidth(mCardW);
+			mGame->getCardTexture(i, j)->setHeight(mCardH);
+		}
+	}
+	all = mGame->updateFaceAtlas(mCardW, mCardH) || all;
+	all = (SDL_AtomicSet(&mLost, 0) != 0) || all;
 
-Texture* AssetManager::getCardTexture(int suit, int value)
-{
-	if ((suit < SPADES) || (suit >= NUM_SUITS))
-		suit = SPADES;
-	if ((value < ACE) || (value > NUM_FACES))
-		value = ACE;
-	return& mFaceTextures[suit][value];
-}
+	/* Without render targets every tile is drawn every frame */
+	bool cached = SDL_RenderTargetSupported(renderer) == SDL_TRUE;
+	if (cached && ((mWall.getWidth() != width) || (mWall.getHeight() != height)))
+	{
+		cached = mWall.createBlank(width, height, renderer, SDL_TEXTUREACCESS_TARGET);
+		mWall.setBlendMode(SDL_BLENDMODE_NONE); /* Cleared, then covered by tiles */
+		all = true;
+	}
+	if (cached)
+	{
+		mWall.setAsRenderTarget(renderer);
+		if (all)
+		{
+			mGame->clearRenderer();
+		}
+	}
 
-void AssetManager::handleEvent(SDL_Event& e)
-{
-	if (e.type == SDL_MOUSEBUTTONDOWN)
+	int redrawn = 0;
+	for (int i = 0; i < (int)mTables.size(); i++)
 	{
-		if (e.button.button == SDL_BUTTON_LEFT)
+		if (cached && !all && (mDrawn[i] == snapshot->versions[i]))
 		{
-			/* Get mouse position */
-			int x, y;
-			SDL_GetMouseState(&x, &y);
-			if (pointWithinBounds(x, y, mCardPlaces[0].x, mCardPlaces[0].y, mOutlineTexture.getWidth(), mOutlineTexture.getHeight()))
-			{
-				if (!mRanks[0][0])
-				{
-					//This loop runs backward to put the draw pile back like it was.
-					for (int i = NUM_CARDS; i >= 0; i--)
-					{
-						if (mRanks[1][i])
-						{
-							mRanks[1][i]->dealTo(0);
-							mRanks[1][i]->flip();
-						}
-					}
-				}
-			}
+			continue;
 		}
+		addTile(batch, i, snapshot->games[i]);
+		mDrawn[i] = snapshot->versions[i];
+		redrawn++;
 	}
-}
\ No newline at end of file
+
+	if (cached)
+	{
+		batch->flush(renderer);
+		SDL_SetRenderTarget(renderer, NULL);
+		batch->add(&mWall, 0, 0);
+	}
+	return redrawn;
+}
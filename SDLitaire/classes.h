@@ -5,24 +5,48 @@
 #ifndef _CLASSES_H
 #define _CLASSES_H
 
+#include "klondike.h"
+#include "dealindex.h"
+#include "movelog.h"
+#include "cardpainter.h"
+#include "softrender.h"
+#include "winodds.h"
+#include "policy.h"
+#include "notation.h"
 #include <SDL_ttf.h>
 #include <SDL_mixer.h>
 #include <SDL_SysWM.h>
+#include <atomic>
+#include <map>
 #include <string>
 #include <sstream>
+#include <vector>
 
-#define NUM_CARDS 52
-#define FIRST_DEAL 28 /* This is the number of cards dealt at the start of the game. */
+#define CARD_SCALE 4 /* Cards are sized to a quarter of the window */
 
-#define CARD_RANKS 13 /* The number of slots on the table */
+#define FACE_ATLAS_SETTLE 150 /* ms a new card size has to hold before painted faces are redrawn */
+
+#define MAX_TRACED_INPUTS 32 /* Input timestamps one snapshot can carry */
+
+#define AUDIO_FREQUENCY 44100 /* Hz the mixer is opened at */
+#define SOUND_REPEAT_MS 40 /* An effect started again sooner than this is dropped, so a deal is one sound */
 
 /* Menu Choices */
 #define MENU_EXIT 1
+#define MENU_NEW_GAME 2
+#define MENU_NEW_WINNABLE 3
 
 class Timer;
 class Texture;
+class TextureRegistry;
+struct textureAsset;
+class SpriteBatch;
 class Card;
 class Window;
+class EventQueue;
+class InputFrame;
+class FrameRecorder;
+class SoundBoard;
 class AssetManager;
 
 struct point
@@ -30,27 +54,43 @@ struct point
 	int x,y;
 };
 
-struct cardFace
+enum SOUNDS
 {
-	int suit,value;
+	SOUND_DEAL,
+	SOUND_FLIP,
+	SOUND_DROP,
+	SOUND_WIN,
+	NUM_SOUNDS
 };
 
-enum SUITS
+/* One card as the render thread sees it */
+struct cardSprite
 {
-	SPADES,
-	CLUBS,
-	DIAMONDS,
-	HEARTS,
-	NUM_SUITS
+	Texture* texture;
+	int x, y;
+	int image; /* The cardStore texture index, for the software renderer */
 };
 
-enum FACES
+/*
+	A copy of everything the render thread draws.
+	The simulation thread fills one while the render thread reads the other.
+*/
+struct tableSnapshot
 {
-	ACE = 1,
-	JACK = 11,
-	QUEEN,
-	KING,
-	NUM_FACES = KING /* Card Values per Suit */
+	int width, height; /* Window size */
+	int cardW, cardH;
+	bool minimized;
+	Uint32 boardVersion; /* Changes whenever a resting card does */
+	point places[CARD_RANKS];
+	cardSprite resting[NUM_CARDS]; /* In z-order */
+	int restingCount;
+	cardSprite moving[NUM_CARDS]; /* In z-order, the dragged card last */
+	int movingCount;
+	Uint32 serial; /* Counts publishes */
+	Uint32 inputStamps[MAX_TRACED_INPUTS]; /* Inputs whose effect shows here and hasn't been seen drawn yet */
+	Uint32 inputSerials[MAX_TRACED_INPUTS]; /* The snapshot each of them first showed in */
+	int inputCount;
+	winEstimate odds; /* For the last position the cards rested in */
 };
 
 /* Contains all of the game's configuration options */
@@ -58,10 +98,35 @@ struct optionSet
 {
 	bool animation = false; /* Animate Card Motion */
 	bool showFPS = true; /* Display the FPS Counter */
+	bool measureLatency = false; /* Trace mouse input to the frame that shows it */
+	int audioBufferMs = 10; /* Mixer latency. Rounded up to a power of two samples. */
+	bool winnableOnly = false; /* New Game only deals what the index says can be won */
+	int minDifficulty = 0, maxDifficulty = 0xFFFF; /* Winnable deals are picked from this range */
+	const char* dealIndexPath = "deals.idx"; /* Built by SDLitaireIndex */
+	const char* moveLogPath = NULL; /* Every game played is logged here, for SDLitaireLog */
+	const char* positionLogPath = NULL; /* Every position the cards come to rest in is written here, as text */
+	bool proceduralFaces = false; /* Paint the faces at the card size instead of loading them */
+	int faceBudgetMB = 64; /* Loaded faces past this are freed, least recently drawn first. 0 for no limit. */
+	bool softwareRender = false; /* Draw on the CPU and present the window surface */
+	bool renderBench = false; /* Time the software renderers and quit */
+	const char* recordPath = NULL; /* Gameplay is recorded to files starting with this */
+	bool recordYUV = false; /* Record a raw I420 stream instead of PNGs */
+	int recordFPS = 30;
+	bool allocCheck = false; /* Drag a card around for a while, then fail if steady frames allocated */
+	bool winOdds = true; /* Estimate the chance of winning on spare cores */
+	int tables = 0; /* Bots play this many tables at once instead of the player's one */
+	int tableMoveMs = 250; /* Between one table's moves */
+	const char* tablePolicy = "greedy";
 };
 
 const char* nameOfSuit(int suit);
 
+/* Is the point inside the rectangle at pos, edges included? */
+bool pointWithinBounds(int test_x, int test_y, int pos_x, int pos_y, int width, int height);
+
+/* Do the rectangles overlap or touch? */
+bool testRectCollision(SDL_Rect &rect1, SDL_Rect &rect2);
+
 /* The application-time based timer */
 class Timer
 {
@@ -93,18 +158,68 @@ private:
 		 mPaused;
 };
 
+/* A counted reference to an image in a TextureRegistry. Copies share it, and the last one to go frees it. */
+class TextureHandle
+{
+public:
+	TextureHandle();
+	TextureHandle(const TextureHandle& other);
+	TextureHandle& operator=(const TextureHandle& other);
+	~TextureHandle();
+
+	/* The image, or NULL when this holds nothing */
+	Texture* get() const;
+	bool isValid() const { return mAsset != NULL; }
+
+	/* Lets go of the image early */
+	void release();
+
+private:
+	friend class TextureRegistry;
+	explicit TextureHandle(textureAsset* asset);
+
+	textureAsset* mAsset;
+};
+
 /* Texture wrapper class */
 class Texture
 {
 public:
+	/* Level 0 is the source image, each level after it is half the size */
+	static const int MAX_MIP_LEVELS = 8;
+
 	Texture();
 	~Texture();
 
 	/* Loads image at specified path */
 	bool loadFromFile(std::string path, SDL_Renderer* renderer);
+	/* The uploading half of loadFromFile. Takes the loaded image and frees it. path is only for errors. */
+	bool loadFromSurface(SDL_Surface* loadedSurface, SDL_Renderer* renderer, const std::string& path);
+
+	/* Loads image at specified path and builds its mip chain */
+	bool loadMipChainFromFile(std::string path, SDL_Renderer* renderer);
+
+	/* The decoding half of loadMipChainFromFile, which needs no renderer, so any thread can do it */
+	static SDL_Surface* decodeMipSource(const std::string& path);
+	/* The uploading half. Takes the decoded image and frees it. path is only for errors. */
+	bool loadMipChain(SDL_Surface* level, SDL_Renderer* renderer, const std::string& path);
 
 	/* Creates image from font string */
-	bool loadFromRenderedText(std::string textureText, SDL_Color textColor, TTF_Font* font, SDL_Renderer* renderer);
+	bool loadFromRenderedText(const std::string& textureText, SDL_Color textColor, TTF_Font* font, SDL_Renderer* renderer);
+
+	/* Creates blank texture */
+	bool createBlank(int width, int height, SDL_Renderer* renderer, SDL_TextureAccess access = SDL_TEXTUREACCESS_STREAMING);
+
+	/* Set self as render target */
+	void setAsRenderTarget(SDL_Renderer* renderer);
+
+	/* Becomes a view of part of another texture, which it doesn't own */
+	void setAtlasRegion(Texture* atlas, SDL_Rect region);
+
+	/* Draws a registry's image at a size of its own, holding a reference until freed */
+	void share(const TextureHandle& image);
+	/* The part of the hardware texture to draw, or NULL for all of it */
+	const SDL_Rect* getRegion() { return mAtlas ? &mRegion : NULL; }
 
 	/* Deallocates texture */
 	void free();
@@ -135,16 +250,346 @@ public:
 	int getWidth() { return mWidth; }
 	int getHeight() { return mHeight; }
 
+	/* Has a hardware texture, of its own or in an atlas */
+	bool isLoaded() { return mTexture || mAtlas; }
+	/* Video memory held, counting every mip level */
+	Uint64 getBytes();
+
+	/* Gets the hardware texture that best fits the current dimensions */
+	SDL_Texture* getSDLTexture();
+
+	/* Records one draw for the mip statistics */
+	void countDraw();
+
+	/* Prints memory per mip level, and sampling cost once frames have been drawn */
+	static void printMipStats();
+
 private:
+	/* Picks the smallest mip level that is no smaller than the current dimensions */
+	int mipLevel();
+
 	/* The actual hardware texture */
 	SDL_Texture* mTexture;
 
+	/* Set when this is a view into an atlas */
+	Texture* mAtlas;
+	SDL_Rect mRegion;
+
+	/* Set when the hardware textures belong to a TextureRegistry */
+	TextureHandle mShared;
+
+	/* Downsampled copies. mMips[0] is mTexture. */
+	SDL_Texture* mMips[MAX_MIP_LEVELS];
+	int mMipWidths[MAX_MIP_LEVELS],
+		mMipHeights[MAX_MIP_LEVELS],
+		mMipLevels;
+
+	/* Mip statistics across all textures */
+	static int sMipTextures[MAX_MIP_LEVELS];
+	static Uint64 sMipBytes[MAX_MIP_LEVELS];
+	static Uint64 sMipDraws[MAX_MIP_LEVELS];
+	static Uint64 sMipTexels[MAX_MIP_LEVELS];
+
 	/* Image dimensions */
 	int mWidth,
 		mHeight;
 };
 
-/* The Cards */
+/* How the registry loaded an image, so the same pixels loaded two ways stay apart */
+enum TEXTURE_KINDS
+{
+	TEXTURE_KEYED = 1, /* TextureRegistry::load */
+	TEXTURE_MIPMAPPED /* TextureRegistry::loadMipChain */
+};
+
+/* Names an image by its decoded pixels. The two hashes are independent, so both matching is taken as the same image. */
+struct textureDigest
+{
+	Uint64 hash, /* The registry's key */
+		check;
+	TEXTURE_KINDS kind;
+	Uint32 format;
+	int w, h;
+};
+
+/* One image, however many Textures draw it */
+struct textureAsset
+{
+	TextureRegistry* registry;
+	textureDigest digest;
+	std::string path; /* The first file it came from */
+	Texture texture; /* Owns the hardware textures */
+	Uint64 bytes;
+	int refs;
+	Uint32 shared; /* Loads that found it already resident */
+};
+
+/*
+	Every image file the GPU path draws, keyed by a hash of its pixels,
+	so art that appears twice in a theme is only uploaded once.
+	A match is only shared when a second hash, the size and the format agree too, so the pixels are never read back.
+	Hands out TextureHandles, and counts what each image holds in video memory.
+	Render thread only.
+*/
+class TextureRegistry
+{
+public:
+	TextureRegistry();
+	~TextureRegistry();
+
+	void setRenderer(SDL_Renderer* renderer) { mRenderer = renderer; }
+
+	/* Color keyed, the way Texture::loadFromFile loads it. Empty if the file couldn't be loaded. */
+	TextureHandle load(const std::string& path);
+	/* With its mip chain, the way Texture::loadMipChainFromFile loads it */
+	TextureHandle loadMipChain(const std::string& path);
+	/* Takes an image from Texture::decodeMipSource and frees it. path is only for errors and stats. */
+	TextureHandle uploadMipChain(SDL_Surface* level, const std::string& path);
+
+	/* Video memory held by every image */
+	Uint64 getBytes() { return mBytes; }
+
+	/* The largest images resident, and the most they all held */
+	void printStats();
+	/* Frees what is still referenced, reporting each as a leak. Call before the renderer goes. Returns the leak count. */
+	int close();
+
+private:
+	friend class TextureHandle;
+
+	static textureDigest digestSurface(SDL_Surface* surface, TEXTURE_KINDS kind);
+	/* An image already resident with the same digest, counted as shared */
+	TextureHandle find(const textureDigest& digest);
+	/* Takes over a loaded texture */
+	TextureHandle add(const textureDigest& digest, const std::string& path, textureAsset* asset);
+	/* The last handle went */
+	void destroy(textureAsset* asset);
+
+	SDL_Renderer* mRenderer;
+	std::multimap<Uint64, textureAsset*> mAssets; /* Colliding hashes get an entry each */
+	Uint64 mBytes,
+		mPeakBytes;
+	Uint32 mLoads,
+		mShared;
+};
+
+/*
+	Collects a frame's sprites and submits them in as few draw calls as possible.
+	That is one per texture at best, so loaded faces, 52 textures of their own, take more than painted ones in their atlas.
+*/
+class SpriteBatch
+{
+public:
+	SpriteBatch();
+
+	/* Forgets the last frame's sprites */
+	void begin();
+
+	/* Queues a texture at its current size. Later calls are drawn on top. */
+	void add(Texture* texture, int x, int y);
+	/* source is the part of the texture to draw, NULL for all of it */
+	void add(SDL_Texture* texture, SDL_Rect& dest, const SDL_Rect* source = NULL);
+
+	/* Groups the queued sprites by texture and draws them */
+	void flush(SDL_Renderer* renderer);
+
+	/* Statistics from the last flush */
+	int getSpriteCount() { return mLastSprites; }
+	int getDrawCalls() { return mLastDrawCalls; }
+
+private:
+	struct sprite
+	{
+		SDL_Texture* texture;
+		SDL_Rect dest;
+		SDL_Rect source;
+		bool clipped; /* Only source is drawn */
+		float u0, v0, u1, v1; /* source as texture coordinates */
+		int batch; /* The draw call this sprite joined */
+		int previous; /* The sprite before it in the same batch, or -1 */
+	};
+
+	struct batch
+	{
+		SDL_Texture* texture;
+		SDL_Rect bounds; /* Union of every sprite in the batch */
+		int count;
+		int first; /* Offset into mOrder */
+		int last; /* Its newest sprite, which leads back through the rest by sprite::previous */
+	};
+
+	/* Picks the earliest batch a sprite can join without breaking z-order */
+	int findBatch(sprite& s);
+
+	std::vector<sprite> mSprites; /* In z-order */
+	std::vector<batch> mBatches; /* In submission order */
+	std::vector<int> mOrder; /* Sprite indices sorted by batch */
+	std::vector<SDL_Vertex> mVertices;
+	std::vector<int> mIndices;
+
+	int mLastSprites,
+		mLastDrawCalls;
+};
+
+/* Printable ASCII rendered once, so text that changes every frame never allocates */
+class GlyphAtlas
+{
+public:
+	static const int FIRST = 32; /* Space */
+	static const int LAST = 126; /* Tilde */
+
+	GlyphAtlas();
+	~GlyphAtlas();
+
+	/* Renders every glyph. The texture is only made when there is a renderer. */
+	bool load(TTF_Font* font, SDL_Color color, SDL_Renderer* renderer);
+	void free();
+
+	/* Width of text in pixels. Anything outside the atlas counts as a space. */
+	int measure(const char* text);
+	int getHeight() { return mHeight; }
+
+	/* Queues text with its top left corner at (x, y) */
+	void draw(SpriteBatch* batch, const char* text, int x, int y);
+	/* Blends text onto a surface */
+	void blit(SDL_Surface* target, const char* text, int x, int y);
+
+private:
+	int glyphOf(char c);
+
+	SDL_Surface* mSurface; /* Every glyph in a row */
+	SDL_Texture* mTexture; /* The same, for the renderer */
+	SDL_Rect mGlyphs[LAST - FIRST + 1]; /* Where each glyph is in the atlas */
+	int mAdvance[LAST - FIRST + 1]; /* How far the pen moves after it */
+	int mHeight;
+};
+
+/* Bits in cardStore::flags */
+enum CARD_FLAGS
+{
+	CARD_FACE_UP = 1,
+	CARD_SLIDING = 2,
+	CARD_DRAGGING = 4,
+	CARD_CLICKABLE = 8,
+	CARD_SEEN = 16 /* Has been face-up this game, so the player knows where it is */
+};
+
+#define CARD_BACK_TEXTURE 0 /* Any other texture index is a face's cardCode + 1 */
+
+/* Software images after the card textures, which are numbered like cardStore::texture */
+#define SOFT_OUTLINE_IMAGE (NUM_CARDS + 1)
+#define SOFT_BACKGROUND_IMAGE (NUM_CARDS + 2)
+#define NUM_SOFT_IMAGES (NUM_CARDS + 3)
+
+/* Draws the table with SoftRasterizer and shows it with SDL_UpdateWindowSurface, for machines without a GPU */
+class SoftRenderer
+{
+public:
+	SoftRenderer();
+	~SoftRenderer();
+
+	/* Loads the table and card art. Painted faces are made at the card size instead. */
+	bool load(bool proceduralFaces);
+	int getCardArtWidth() { return mNative[CARD_BACK_TEXTURE].width; }
+	int getCardArtHeight() { return mNative[CARD_BACK_TEXTURE].height; }
+
+	/* Threads to draw with, counting the caller */
+	void setThreads(int threads);
+	int getThreads() { return mRaster->getThreads(); }
+
+	/*
+		Draws a snapshot into ARGB8888 pixels. pitch is in pixels. Cached, the table is only redrawn where the board changed.
+		With damage, only those parts of pixels are drawn and the rest is left as it was.
+	*/
+	void draw(uint32_t* pixels, int pitch, int width, int height, tableSnapshot* snapshot, bool cacheStatic, const DamageList* damage = NULL);
+
+	/*
+		Render thread: draws a snapshot into the window surface and hands it to the recorder. NULL when it couldn't.
+		Only what changed since the last frame is drawn: where moving cards were and are, and resting cards that changed.
+	*/
+	SDL_Surface* drawToWindow(SDL_Window* window, tableSnapshot* snapshot, FrameRecorder* recorder = NULL);
+	/* Render thread: the next frame draws this again too, for what is drawn over the table */
+	void damage(int x, int y, int width, int height);
+	/* Any thread: the next frame draws and shows the whole window, as when it was uncovered */
+	void damageAll() { SDL_AtomicSet(&mExposed, 1); }
+	/* Render thread: shows what drawToWindow drew, only where it changed */
+	void present(SDL_Window* window);
+
+	/* How much of the window the frames drew */
+	void printStats();
+
+	/* Forgets every scaled image and the cached table */
+	void dropScaled();
+
+private:
+	static const int MAX_OVERLAYS = 4;
+
+	/* A sprite as it was last drawn */
+	struct drawnSprite
+	{
+		int image, x, y;
+	};
+
+	bool loadImage(int image, std::string path);
+	/* Queues the table, outlines and resting cards */
+	void addTable(tableSnapshot* snapshot);
+	/* Damages where sprites were and are, for each one that isn't what was drawn, and remembers the new ones */
+	void diffSprites(DamageList& damage, drawnSprite* drawn, int& drawnCount, const cardSprite* sprites, int count, int cardW, int cardH);
+	/* Works out mDamage from the last frame. all when the window's pixels can't be trusted. */
+	void findDamage(tableSnapshot* snapshot, int width, int height, bool all);
+	/* An image at the size it is drawn, scaled or painted the first time it's asked for */
+	const softImage* sized(int image, int width, int height);
+
+	SoftRasterizer* mRaster;
+	softImage mNative[NUM_SOFT_IMAGES]; /* As loaded */
+	softImage mSized[NUM_SOFT_IMAGES]; /* As drawn */
+	bool mPaintFaces;
+	softImage mStatic; /* Table, outlines and resting cards */
+	Uint32 mStaticVersion; /* The board version in mStatic */
+	drawnSprite mStaticSprites[NUM_CARDS]; /* The resting cards in mStatic */
+	int mStaticCount;
+	DamageList mStaticDamage;
+	SDL_Surface* mConverted; /* Drawn into when the window surface isn't 32-bit RGB */
+
+	/* The last frame, which stays in the window surface */
+	SDL_Surface* mFrameSurface; /* NULL until something is drawn */
+	int mFrameW, mFrameH,
+		mFrameCardW, mFrameCardH;
+	point mFramePlaces[CARD_RANKS];
+	drawnSprite mFrameResting[NUM_CARDS],
+		mFrameMoving[NUM_CARDS];
+	int mFrameRestingCount,
+		mFrameMovingCount;
+	DamageList mDamage; /* What this frame draws and shows */
+	softRect mOverlays[MAX_OVERLAYS];
+	int mOverlayCount;
+	SDL_atomic_t mExposed;
+	SDL_Rect mShownRects[DamageList::MAX_RECTS];
+	Uint64 mFrames,
+		mPixelsDrawn,
+		mPixelsInFrames;
+};
+
+/*
+	Every card's data, one array per field.
+	The per-frame loops run straight down the hot arrays,
+	and input is the only thing that reaches into the cold ones.
+*/
+struct cardStore
+{
+	/* Hot: read or written every frame */
+	int posX[NUM_CARDS], posY[NUM_CARDS];
+	int velX[NUM_CARDS], velY[NUM_CARDS];
+	uint8_t rank[NUM_CARDS], file[NUM_CARDS], destRank[NUM_CARDS];
+	uint8_t flags[NUM_CARDS];
+	uint8_t texture[NUM_CARDS];
+	/* Cold */
+	cardFace face[NUM_CARDS];
+	int offsetX[NUM_CARDS], offsetY[NUM_CARDS]; /* From the mouse while dragging */
+	Uint32 lastClickTime[NUM_CARDS]; /* Event timestamp of the last click */
+};
+
+/* The Cards. Each one is a handle to its slot in the AssetManager's cardStore. */
 class Card
 {
 public:
@@ -154,17 +599,12 @@ public:
 	/* Initializes the variables */
 	Card();
 
-	/* Assign Texture */
-	void setTexture(Texture* texture);
-
 	void handleEvent(SDL_Event& e);
 
-	void move(int timeStep);
-
 	void flip();
 
-	/* Shows the card on the screen */
-	void render(SDL_Renderer* renderer, point* rank);
+	/* Places a resting card on its slot */
+	void rest(point* slot);
 
 	void setRank(int rank);
 	void setFile(int file);
@@ -173,45 +613,74 @@ public:
 
 	void setClickability(bool state);
 
+	/* Starts or ends a drag that holds the card at its offset from the mouse */
+	void pickUp(int x, int y);
+	void putDown();
+
 	void dealTo( int rank );
 	void setDestRank(int rank);
 
 	void land();
 
-	void assocGame(AssetManager& game);
-
-	bool getClickability() { return mClickable; }
-	bool getFlipState() { return mFaceUp; }
-	bool isDragging() { return mDragging; }
-	bool isSliding() { return mSliding; }
-	int getRank() { return mRank; }
-	int getDestRank() { return mDestRank; }
-	int getFile() { return mFile; }
-	int getX() { return mPosX; }
-	int getY() { return mPosY; }
-	cardFace getFace() { return mFace; }
+	/* Binds the handle to a slot in the game's store and puts it on top of the stock */
+	void assocGame(AssetManager& game, cardStore& store, int index);
+
+	bool getClickability() { return (mStore->flags[mIndex] & CARD_CLICKABLE) != 0; }
+	bool getFlipState() { return (mStore->flags[mIndex] & CARD_FACE_UP) != 0; }
+	bool isDragging() { return (mStore->flags[mIndex] & CARD_DRAGGING) != 0; }
+	bool isSliding() { return (mStore->flags[mIndex] & CARD_SLIDING) != 0; }
+	int getRank() { return mStore->rank[mIndex]; }
+	int getDestRank() { return mStore->destRank[mIndex]; }
+	int getFile() { return mStore->file[mIndex]; }
+	int getX() { return mStore->posX[mIndex]; }
+	int getY() { return mStore->posY[mIndex]; }
+	cardFace getFace() { return mStore->face[mIndex]; }
+	int getIndex() { return mIndex; }
 
 private:
-	/* Game state */
-	bool mFaceUp; /* Flip state */
-	cardFace mFace; /* suit and value */
+	void setFlag(int flag, bool state);
 
-	/* The X,Y Position and Spot on the Table*/
-	int mPosX, mPosY, mRank, mFile;
-	/* For sliding */
-	int mVelX, mVelY, mDestRank;
-	bool mSliding;
+	cardStore* mStore;
+	int mIndex;
 
-	/* Mouse data */
-	int mOffsetX, mOffsetY;
-	bool mDragging;
-	bool mClickable;
-	DWORD mLastClickTime;
+	AssetManager* mTable;
+};
 
-	/* The Texture */
-	Texture* mTexture;
+/*
+	One slot's cards, bottom to top, with no gaps.
+	Each card's rank and file always match where it sits in here.
+*/
+class Pile
+{
+public:
+	Pile();
 
-	AssetManager* mTable;
+	void setRank(int rank) { mRank = rank; }
+
+	int size() { return mCount; }
+	bool empty() { return !mCount; }
+	Card* top() { return mCount ? mCards[mCount - 1] : NULL; }
+	Card* at(int file) { return mCards[file]; }
+	void clear() { mCount = 0; }
+
+	void push(Card* card);
+	Card* pop();
+
+	/* Takes a card out from anywhere, closing the gap */
+	void remove(int file);
+
+	/* Moves the top count cards onto another pile as one run */
+	void splice(Pile& to, int count);
+	/* The same, but the run lands upside down, like turning the waste over */
+	void spliceReversed(Pile& to, int count);
+
+private:
+	/* Renumbers the cards from file up */
+	void reseat(int file);
+
+	Card* mCards[NUM_CARDS];
+	int mCount;
+	int mRank;
 };
 
 /* Window Wrapper Class */
@@ -261,7 +730,347 @@ private:
 		mMinimized;
 };
 
-/* Manages Cards, Textures, SDL, and more */
+/* Lock-free queue of input events from the main thread to the simulation thread */
+class EventQueue
+{
+public:
+	static const int CAPACITY = 256;
+
+	EventQueue();
+
+	/* Main thread only. Fails when the queue is full. */
+	bool push(SDL_Event& e);
+
+	/* Simulation thread only. Fails when the queue is empty. */
+	bool pop(SDL_Event& e);
+
+private:
+	SDL_Event mEvents[CAPACITY];
+	SDL_atomic_t mHead, /* Next slot to read */
+		mTail; /* Next slot to write */
+};
+
+/*
+	One step's input, drained from the queue at once.
+	Runs of motion collapse into their latest position, so a fast mouse costs no more than a slow one.
+	Everything else keeps its order, with the motion before it.
+*/
+class InputFrame
+{
+public:
+	static const int CAPACITY = 64; /* Whatever doesn't fit waits for the next step */
+
+	InputFrame();
+
+	/* Empties the frame and fills it from the queue */
+	void drain(EventQueue& queue);
+
+	int size() { return mCount; }
+	SDL_Event& at(int i) { return mEvents[i]; }
+
+	/* Motion events folded into another since the start */
+	Uint32 getMerged() { return mMerged; }
+
+private:
+	SDL_Event mEvents[CAPACITY];
+	int mCount;
+	Uint32 mMerged;
+};
+
+/* Plays the game's sound effects on a fixed pool of mixer channels */
+class SoundBoard
+{
+public:
+	static const int CHANNELS = 8;
+
+	SoundBoard();
+
+	/* Opens the mixer with a buffer of about the given length */
+	bool open(int bufferMs);
+
+	/* Loads every effect, converted up front to the device's format */
+	bool load();
+
+	/* Plays an effect, taking over the oldest channel when all are busy. Repeats closer than SOUND_REPEAT_MS are dropped. */
+	void play(int sound);
+
+	/* Frees the effects and closes the mixer */
+	void close();
+
+	/* Prints buffer size and how long the mixes took */
+	void printStats();
+
+private:
+	/* Run on the audio thread before and after every mix. The game plays no music, so its hook is free. */
+	static void SDLCALL preMix(void* udata, Uint8* stream, int len);
+	static void SDLCALL postMix(void* udata, Uint8* stream, int len);
+
+	Mix_Chunk* mChunks[NUM_SOUNDS];
+	Uint8* mSamples[NUM_SOUNDS]; /* Converted audio owned by the chunks */
+	Uint32 mChannelStarts[CHANNELS]; /* When each channel was last started */
+	Uint32 mSoundStarts[NUM_SOUNDS]; /* When each effect was last started */
+
+	/* Device format */
+	int mFrequency,
+		mChannels,
+		mBufferSamples;
+	Uint16 mFormat;
+	bool mOpen;
+
+	/* Audio thread timing */
+	Uint64 mMixStart;
+	SDL_atomic_t mMixes,
+		mOverruns, /* Took longer than the buffer plays for, which is heard as a glitch */
+		mWorstMixUs;
+	std::atomic<Uint64> mMixUs; /* Total, summed by the audio thread while printStats reads it */
+	int mVoicesStolen,
+		mSoundsDropped;
+};
+
+/* Input-to-present latency in one millisecond buckets */
+class LatencyHistogram
+{
+public:
+	static const int BUCKETS = 100; /* The last bucket also holds everything slower */
+
+	LatencyHistogram();
+
+	void add(Uint32 ms);
+	Uint32 getCount() { return mTotal; }
+
+	/* Prints the summary and the histogram */
+	void print();
+
+private:
+	Uint32 mCounts[BUCKETS];
+	Uint32 mTotal,
+		mMax;
+	Uint64 mSum;
+};
+
+/*
+	Records gameplay to disk, as numbered PNGs or a raw I420 stream.
+	The render thread only copies a frame into a free buffer. Workers encode and write it,
+	so a slow disk drops frames instead of slowing the game down.
+*/
+class FrameRecorder
+{
+public:
+	static const int BUFFERS = 8;
+
+	FrameRecorder();
+	~FrameRecorder();
+
+	/* Frames are written to path_NNNNNN.png, or to path_WxH_N.yuv when yuv, at most fps a second */
+	bool start(const char* path, bool yuv, int fps, int workers);
+
+	/* Writes what is queued, then prints what was recorded and what it cost */
+	void stop();
+
+	bool isRecording() { return mWorkers.size() != 0; }
+
+	/* Render thread: queues the frame being drawn, if one is due. Call before presenting. */
+	void captureRenderer(SDL_Renderer* renderer);
+	/* Render thread: the same for ARGB8888 pixels. pitch is in bytes. */
+	void capturePixels(const void* pixels, int pitch, int width, int height);
+
+private:
+	struct frameBuffer
+	{
+		std::vector<Uint32> pixels; /* Kept between frames */
+		int width, height;
+		Uint32 number;
+	};
+
+	/* Counts a render frame and says whether this one is recorded */
+	bool isDue(Uint64 now);
+	/* A free buffer of this size, or NULL when all of them are still queued */
+	frameBuffer* claim(int width, int height);
+	void submit(frameBuffer* frame, Uint64 started);
+	void encode(frameBuffer& frame, std::vector<Uint8>& yuv);
+	static int work(void* data);
+
+	frameBuffer mBuffers[BUFFERS];
+	int mFree[BUFFERS], /* Buffer indices */
+		mFreeCount;
+	int mQueue[BUFFERS], /* Waiting to be encoded, oldest first */
+		mQueueHead,
+		mQueueCount;
+	SDL_mutex* mLock; /* Guards the free list and the queue */
+	SDL_cond* mReady; /* A frame was queued, or recording is stopping */
+	std::vector<SDL_Thread*> mWorkers;
+	bool mStopping;
+
+	std::string mPath;
+	bool mYUV;
+	FILE* mStream; /* The open .yuv segment. A new one starts when the size changes. */
+	int mStreamW, mStreamH;
+	SDL_mutex* mWriteLock; /* Frames go into the stream in order */
+	SDL_cond* mWritten;
+	Uint32 mNextWrite;
+
+	/* Render thread */
+	Uint32 mInterval; /* Ms between recorded frames */
+	Uint32 mNextDue;
+	Uint32 mFrames, /* Recorded */
+		mDropped; /* Due, but no buffer was free */
+	Uint32 mRenderFrames; /* Every frame the render thread drew while recording */
+	Uint64 mFirstFrame, mLastFrame; /* Performance counter */
+	Uint64 mCaptureTime; /* Spent by the render thread in capture calls */
+	SDL_atomic_t mFailed; /* Encoded but not written */
+};
+
+/*
+	Loads the face textures when they are first drawn, instead of all 52 before the first frame.
+	A worker decodes the faces likely to be turned over next, so the render thread usually only uploads,
+	and once the faces hold more than the budget the ones drawn longest ago are freed.
+*/
+class FacePager
+{
+public:
+	FacePager();
+	~FacePager();
+
+	/* faces is indexed by cardCode. budget is in bytes, 0 for no limit. Nothing is loaded yet. */
+	bool start(TextureRegistry* textures, Texture* faces[NUM_CARDS], Uint64 budget);
+	/* Stops the worker and frees every face it loaded */
+	void stop();
+
+	/* Any thread: decodes a face ahead of its first draw. Does nothing without the worker. Doesn't allocate. */
+	void prefetch(int card);
+
+	/* Render thread: makes a face resident for this frame, loading it now if it must. Keeps the size it was given. */
+	bool use(int card);
+	/* Render thread, between frames: uploads what the worker decoded, then evicts down to the budget */
+	void endFrame();
+	/* Prefetches are still being decoded or waiting to be uploaded */
+	bool isBusy();
+
+	/* Where the faces were loaded from, and the most memory they held */
+	void printStats();
+
+private:
+	static int work(void* data);
+	/* Render thread: uploads a decoded face, or decodes it first when level is NULL */
+	bool load(int card, SDL_Surface* level);
+
+	TextureRegistry* mTextures; /* NULL when not paging */
+	Texture* mFaces[NUM_CARDS];
+	Uint64 mBudget;
+	SDL_Thread* mWorker;
+
+	/* Guarded by mLock */
+	SDL_mutex* mLock;
+	SDL_cond* mWake;
+	bool mStopping;
+	bool mWanted[NUM_CARDS]; /* Waiting to be decoded */
+	int mDecoding; /* The card the worker has, or -1 */
+	bool mResident[NUM_CARDS];
+	SDL_Surface* mDecoded[NUM_CARDS]; /* Waiting to be uploaded */
+
+	/* Render thread */
+	Uint32 mFrame;
+	Uint32 mLastUsed[NUM_CARDS]; /* Frame */
+	bool mMissing[NUM_CARDS]; /* Couldn't be loaded, and won't be tried again */
+	Uint64 mResidentBytes,
+		mPeakBytes;
+	Uint32 mDemandLoads, /* Decoded on the render thread, because the worker hadn't */
+		mPrefetched, /* Uploaded from the worker's decode */
+		mEvictions,
+		mOverBudget; /* Frames where everything resident was in use and still over */
+};
+
+/* What the render thread draws of the wall */
+struct wallSnapshot
+{
+	std::vector<Klondike> games;
+	std::vector<Uint32> versions; /* Changes whenever that table's game does */
+	Uint32 won, played; /* Games finished so far */
+};
+
+/*
+	-tables: a wall of games played by bots, for watching them and for soak tests.
+	Every table is its own Klondike, drawn with the AssetManager's card textures.
+	The wall is cached in a render target, and only the tiles whose game moved are redrawn.
+*/
+class TableWall
+{
+public:
+	static const int MIN_TABLES = 4;
+	static const int MAX_TABLES = 256;
+
+	TableWall();
+	~TableWall();
+
+	/* Deals every table. count is clamped to the limits above. */
+	bool init(AssetManager& game, int count, const char* policyName, int moveMs);
+
+	/* Simulation thread: plays the moves that are due, and deals again when a game ends */
+	void step(Uint32 now);
+	/* Simulation thread: copies the tables that changed into the free snapshot */
+	bool publish();
+
+	/* Render thread: the same double buffering as the table snapshots */
+	wallSnapshot* acquire();
+	void release();
+
+	/* Render thread: redraws the tiles that changed and queues the wall. Returns the tiles redrawn. */
+	int draw(SDL_Renderer* renderer, SpriteBatch* batch, wallSnapshot* snapshot, int width, int height);
+	void lose() { SDL_AtomicSet(&mLost, 1); }
+
+	int getCount() { return (int)mTables.size(); }
+	Policy* getPolicy() { return mPolicy; }
+
+private:
+	struct wallTable
+	{
+		Klondike game;
+		Random random;
+		Uint32 nextMove; /* Ticks */
+		Uint32 version;
+		bool progress; /* For playMove */
+		bool finished; /* Showing the end of a game before the next deal */
+	};
+
+	void deal(wallTable& table);
+	/* Lays the tiles out for a window size. True if anything moved. */
+	bool layout(int width, int height);
+	void addTile(SpriteBatch* batch, int table, const Klondike& game);
+
+	AssetManager* mGame;
+	Policy* mPolicy;
+	int mMoveMs;
+
+	/* Simulation thread */
+	std::vector<wallTable> mTables;
+	Uint32 mNextSeed;
+	Uint32 mWon, mPlayed;
+
+	wallSnapshot mSnapshots[2];
+	SDL_atomic_t mFront,
+		mReading;
+
+	/* Render thread */
+	Texture mWall; /* Every tile as last drawn */
+	std::vector<Uint32> mDrawn; /* The version each tile was drawn at */
+	SDL_atomic_t mLost;
+	int mWidth, mHeight;
+	int mColumns;
+	int mTileW, mTileH;
+	int mCardW, mCardH;
+	int mFan; /* Between cards down a column */
+	point mPlaces[CARD_RANKS]; /* In a tile */
+};
+
+/*
+	Manages Cards, Textures, SDL, and more
+
+	Once the game is running, the piles, cards and layout belong to the
+	simulation thread while the renderer, textures and sprite batch belong
+	to the render thread. They only meet through the snapshots.
+	The render thread is the main thread, which also pumps the events,
+	since SDL only supports drawing on the thread that made the window.
+*/
 class AssetManager
 {
 public:
@@ -273,25 +1082,108 @@ public:
 	void clearRenderer();
 	void computeCardPlaces();
 	void cardDrop(Card* card);
+
+	/* Simulation thread: hands out the next card in the pool, on top of the stock */
+	Card* newCard();
+	/* Simulation thread: slides every dealt card one step and lands the ones that arrive */
+	void moveCards(int timeStep);
+
+	/* Simulation thread: gathers every card up and deals this seed */
+	void newGame(Uint32 seed);
+	/* A fresh seed, from the deal index when it has to be winnable */
+	Uint32 chooseDealSeed(bool winnable);
+
+	/* Simulation thread: lifts a card and everything on top of it */
+	void beginDrag(Card* card, int x, int y);
+	Card* getDragBase() { return mDragBase; }
+	/* The topmost card under a point, if any */
+	Card* cardAt(int x, int y);
+	void invalidateBoard() { mBoardVersion++; traceInput(); }
+
+	/* Simulation thread: hands one input to the cards it can affect, then to the table */
+	void dispatchInput(SDL_Event& e);
+
+	/* Simulation thread: the input being handled, and a note that it changed the table */
+	void beginInputTrace(SDL_Event& e);
+	void traceInput();
+	Uint32 droppedInputTraces() { return mDroppedStamps; }
+	Uint32 tracedInputs() { return mTracedInputs; }
+	/* Once both threads stop: the traced inputs no drawn snapshot showed */
+	int undrawnInputTraces();
 	void registerCard(Card* card);
+
+	/* Simulation thread: nothing is held or sliding */
+	bool isAtRest();
+	/* Simulation thread: the table as the rules see it. seen is indexed by cardCode. */
+	void getPosition(Klondike& game, bool seen[NUM_CARDS]);
+
+	/* Simulation thread: hands the position to the win estimator once the cards come to rest */
+	void updateWinOdds();
+	/* Simulation thread: writes the position to the -positionlog once the cards come to rest */
+	void logPosition();
+
+	/* Simulation thread: asks for the faces that could be turned over next, once the board changes */
+	void prefetchFaces();
+
+	/* Simulation thread: copies the table into the free snapshot */
+	bool publishSnapshot();
+
+	/* Render thread: holds the newest snapshot until it is released. Only drawn snapshots count as showing their inputs. */
+	tableSnapshot* acquireSnapshot();
+	void releaseSnapshot(bool drawn = true);
+
+	/* Render thread: brings the cached layer up to date. False means it was batched directly. */
+	bool updateStaticLayer(tableSnapshot* snapshot);
+	/* Render thread: repaints the procedural faces once the card size settles. True if it did. */
+	bool updateFaceAtlas(int cardW, int cardH);
+	void loseStaticLayer() { SDL_AtomicSet(&mStaticLayerLost, 1); }
+	/* Render thread: loads the faces the snapshot shows. Call getFacePager()->endFrame() after presenting. */
+	void pageFaces(tableSnapshot* snapshot);
+
 	Texture* getCardTexture(int suit, int value);
+	Texture* getTextureByIndex(int texture);
 	void handleEvent(SDL_Event& e);
 
 	Window* getWindow() { return& mWindow; }
 	SDL_Renderer* getRenderer() { return mRenderer; }
-	Mix_Chunk* getSound() { return mSound; }
+	SoundBoard* getSounds() { return& mSounds; }
 	TTF_Font* getFont() { return mFont; }
 	Texture* getBackground() { return& mBackgroundTexture; }
-	Texture* getFPSTexture() { return& mFPSTextTexture; }
+	GlyphAtlas* getFPSGlyphs() { return& mFPSGlyphs; }
 	Texture* getCardBack() { return& mDeckTexture; }
 	Texture* getCardOutline() { return&mOutlineTexture; }
+	Texture* getStaticLayer() { return& mStaticLayer; }
+	SpriteBatch* getSpriteBatch() { return& mSpriteBatch; }
+	SoftRenderer* getSoftRenderer() { return& mSoftRenderer; }
+	FrameRecorder* getRecorder() { return& mRecorder; }
+	FacePager* getFacePager() { return& mFacePager; }
 	point* getCardPlace(int place) { return& mCardPlaces[place]; }
-	int stackedCards(int place) { return mHeldCards[place]; }
-	Card* getCard(int rank, int file) { return mRanks[rank][file]; }
+	int getCardWidth() { return mCardW; }
+	int getCardHeight() { return mCardH; }
+	int getCardArtWidth() { return mCardNativeW; }
+	int getCardArtHeight() { return mCardNativeH; }
+	int stackedCards(int place) { return mPiles[place].size(); }
+	Card* getCard(int rank, int file) { return mPiles[rank].at(file); }
 	cardFace getFace(int index) { return mAllFaces[index]; }
+	Uint32 getDealSeed() { return mDealSeed; }
 	optionSet* options() { return &mOptions; }
 
+	/* Times SDL's software renderer against SoftRenderer at 1080p and 4K. Call before the game threads start. */
+	void benchmarkRenderers();
+
+	/* The card art size LoadMedia reads. Only for running without media, as SDLitaireFuzz does. */
+	void setCardArtSize(int width, int height) { mCardNativeW = width; mCardNativeH = height; }
+
 private:
+	/* Can a run starting with this card go on that slot? */
+	bool accepts(int rank, Card* card, int count);
+	/* Face-up tableau cards can be picked up with the cards on them, anything else only from the top */
+	void updateClickability(int rank);
+	void checkForWin();
+	void logMove(int kind, int from, int to, int count);
+	/* The art as textures, for the GPU */
+	bool loadTextures();
+
 	/* Window data */
 	Window mWindow;
 	SDL_Window* mSDLWindow;
@@ -299,16 +1191,59 @@ private:
 	SDL_Surface* mIconSurface; /* Will be the window icon */
 	/* Game Data */
 	TTF_Font* mFont; /* Main Font */
-	Mix_Chunk* mSound; /* Example Sound Effect */
+	SoundBoard mSounds; /* Sound Effects */
+	bool mWon; /* The win has been celebrated */
+	TextureRegistry mTextures; /* The art the textures below draw. Outlives them. */
 	Texture mBackgroundTexture; /* Backdrop (Table) */
-	Texture mFPSTextTexture; /* Rendered FPS Count */
+	GlyphAtlas mFPSGlyphs; /* Draws the FPS Count */
 	Texture mDeckTexture; /* The Card Back */
 	Texture mOutlineTexture; /* The Card Outline */
 	Texture mFaceTextures[NUM_SUITS][NUM_FACES + 1]; /* The Card Faces. Index 0 will be ignored to make faces more logical. */
+	Texture mFaceAtlas; /* Painted faces, when mFaceTextures are views into it */
+	FacePager mFacePager; /* Loads mFaceTextures as they are drawn, when they aren't painted */
+	Uint32 mPrefetchVersion; /* The board version faces were last prefetched for */
+	int mAtlasCardW, mAtlasCardH; /* The card size the atlas was painted at */
+	int mAtlasWantW, mAtlasWantH; /* A new card size waiting to settle */
+	Uint32 mAtlasWantSince;
+	Texture mStaticLayer; /* Table, outlines and resting cards */
+	Uint32 mStaticVersion; /* The board version in the static layer */
+	SDL_atomic_t mStaticLayerLost; /* Set when render targets were reset */
+	SpriteBatch mSpriteBatch; /* Draws the table each frame */
+	SoftRenderer mSoftRenderer; /* Draws the table instead, with -software */
+	FrameRecorder mRecorder; /* Gameplay capture, with -record */
+	WinEstimator mOdds; /* Solves guesses at the face-down cards */
+	Uint32 mOddsVersion; /* The board version it was last given */
+	/* Simulation state */
+	int mTableW, mTableH; /* Window size as the simulation knows it */
+	bool mMinimized;
+	int mCardNativeW, mCardNativeH; /* Card art size */
+	int mCardW, mCardH; /* Card size on the table */
+	Uint32 mBoardVersion; /* Bumped whenever a resting card changes */
+	bool mTracing; /* The current input hasn't shown an effect yet */
+	Uint32 mTracedStamp;
+	Uint32 mPendingStamps[MAX_TRACED_INPUTS]; /* Effects not yet seen drawn */
+	Uint32 mPendingSerials[MAX_TRACED_INPUTS]; /* The snapshot each first went out in, or 0 */
+	int mPendingCount;
+	Uint32 mDroppedStamps;
+	Uint32 mTracedInputs;
+	tableSnapshot mSnapshots[2];
+	SDL_atomic_t mFrontSnapshot, /* The newest published snapshot */
+		mReadingSnapshot, /* The snapshot the render thread holds, or -1 */
+		mDrawnSerial; /* The serial the render thread last drew */
 	point mCardPlaces[CARD_RANKS]; /* Card Holding Spots */
-	int mHeldCards[CARD_RANKS]; /* The number of cards in each spot */
-	Card* mRanks[CARD_RANKS][NUM_CARDS]; /* The card in each position */
+	cardStore mCardData; /* Every card's state */
+	Card mCards[NUM_CARDS]; /* Handles into mCardData */
+	int mCardsInUse;
+	Pile mPiles[CARD_RANKS]; /* The cards in each spot */
+	Card* mDragBase; /* The bottom card of the run being dragged */
 	cardFace mAllFaces[NUM_CARDS]; /* All possible card face values */
+	Uint32 mDealSeed; /* Klondike::shuffleDeck makes mAllFaces from this */
+	Random mDealRandom; /* Picks the seeds */
+	DealIndex mDeals; /* Mapped, not loaded */
+	MoveLogWriter mMoveLog;
+	PositionWriter mPositionLog;
+	Uint32 mPositionVersion; /* The board version last logged */
+	Uint32 mGameStart; /* Ticks when the deal was made */
 	optionSet mOptions; /* Game Options */
 };
 
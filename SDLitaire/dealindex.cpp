@@ -0,0 +1,233 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+#include "dealindex.h"
+#include <algorithm>
+#include <cstdio>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool easierThan(const dealRecord& a, const dealRecord& b)
+{
+	return a.difficulty < b.difficulty;
+}
+
+DealIndex::DealIndex()
+{
+	mHeader = NULL;
+	mRecords = NULL;
+	mBytes = 0;
+	mFile =
+		mMapping =
+		mView = NULL;
+}
+
+DealIndex::~DealIndex()
+{
+	close();
+}
+
+bool DealIndex::open(const char* path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		printf("Unable to open the deal index %s!\n", path);
+		return false;
+	}
+	LARGE_INTEGER bytes;
+	GetFileSizeEx(file, &bytes);
+	mFile = file;
+	mBytes = (size_t)bytes.QuadPart;
+	if (mBytes < sizeof(dealIndexHeader))
+	{
+		printf("The deal index %s is too short!\n", path);
+		close();
+		return false;
+	}
+	mMapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	mView = mMapping ? MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+	int file = ::open(path, O_RDONLY);
+	if (file < 0)
+	{
+		printf("Unable to open the deal index %s!\n", path);
+		return false;
+	}
+	struct stat info;
+	fstat(file, &info);
+	mFile = (void*)(intptr_t)(file + 1); /* So descriptor 0 isn't NULL */
+	mBytes = (size_t)info.st_size;
+	if (mBytes < sizeof(dealIndexHeader))
+	{
+		printf("The deal index %s is too short!\n", path);
+		close();
+		return false;
+	}
+	mView = mmap(NULL, mBytes, PROT_READ, MAP_SHARED, file, 0);
+	if (mView == MAP_FAILED)
+	{
+		mView = NULL;
+	}
+	else
+	{
+		madvise(mView, mBytes, MADV_RANDOM); /* Binary searches only touch a few pages */
+	}
+#endif
+	if (!mView)
+	{
+		printf("Unable to map the deal index %s!\n", path);
+		close();
+		return false;
+	}
+
+	const dealIndexHeader* header = (const dealIndexHeader*)mView;
+	uint64_t records = 0;
+	for (int i = 0; i < NUM_SOLVE_RESULTS; i++)
+	{
+		records += header->counts[i];
+	}
+	if ((header->magic != DEAL_INDEX_MAGIC) || (header->version != DEAL_INDEX_VERSION) ||
+		(sizeof(dealIndexHeader) + records * sizeof(dealRecord) > mBytes))
+	{
+		printf("%s is not a deal index this version can read!\n", path);
+		close();
+		return false;
+	}
+	mHeader = header;
+	mRecords = (const dealRecord*)(header + 1);
+	return true;
+}
+
+void DealIndex::close()
+{
+#ifdef _WIN32
+	if (mView)
+	{
+		UnmapViewOfFile(mView);
+	}
+	if (mMapping)
+	{
+		CloseHandle((HANDLE)mMapping);
+	}
+	if (mFile)
+	{
+		CloseHandle((HANDLE)mFile);
+	}
+#else
+	if (mView)
+	{
+		munmap(mView, mBytes);
+	}
+	if (mFile)
+	{
+		::close((int)(intptr_t)mFile - 1);
+	}
+#endif
+	mHeader = NULL;
+	mRecords = NULL;
+	mBytes = 0;
+	mFile =
+		mMapping =
+		mView = NULL;
+}
+
+uint32_t DealIndex::size() const
+{
+	uint32_t records = 0;
+	for (int i = 0; i < NUM_SOLVE_RESULTS; i++)
+	{
+		records += count(i);
+	}
+	return records;
+}
+
+int DealIndex::resultOf(uint32_t i) const
+{
+	for (int result = 0; result < NUM_SOLVE_RESULTS; result++)
+	{
+		if (i < count(result))
+		{
+			return result;
+		}
+		i -= count(result);
+	}
+	return NUM_SOLVE_RESULTS;
+}
+
+uint32_t DealIndex::range(int minDifficulty, int maxDifficulty, uint32_t* first) const
+{
+	*first = 0;
+	if (!mHeader || (minDifficulty > maxDifficulty) || (maxDifficulty < 0))
+	{
+		return 0;
+	}
+
+	/* The winnable section comes first and is sorted by difficulty */
+	const dealRecord* begin = mRecords;
+	const dealRecord* end = mRecords + count(SOLVE_WON);
+	dealRecord low = { 0, (uint16_t)(minDifficulty > 0 ? minDifficulty : 0), 0 };
+	dealRecord high = { 0, (uint16_t)(maxDifficulty < 0xFFFF ? maxDifficulty : 0xFFFF), 0 };
+	const dealRecord* lower = std::lower_bound(begin, end, low, easierThan);
+	const dealRecord* upper = std::upper_bound(lower, end, high, easierThan);
+
+	*first = (uint32_t)(lower - begin);
+	return (uint32_t)(upper - lower);
+}
+
+bool DealIndex::pick(Random& random, int minDifficulty, int maxDifficulty, uint32_t* seed) const
+{
+	uint32_t first;
+	uint32_t deals = range(minDifficulty, maxDifficulty, &first);
+	if (!deals)
+	{
+		return false;
+	}
+	*seed = mRecords[first + random.below(deals)].seed;
+	return true;
+}
+
+bool DealIndex::write(const char* path, std::vector<dealRecord> sections[NUM_SOLVE_RESULTS], uint32_t budget)
+{
+	dealIndexHeader header = {};
+	header.magic = DEAL_INDEX_MAGIC;
+	header.version = DEAL_INDEX_VERSION;
+	header.budget = budget;
+	for (int i = 0; i < NUM_SOLVE_RESULTS; i++)
+	{
+		std::stable_sort(sections[i].begin(), sections[i].end(), easierThan);
+		header.counts[i] = (uint32_t)sections[i].size();
+	}
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		printf("Unable to create %s!\n", path);
+		return false;
+	}
+	bool success = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (int i = 0; i < NUM_SOLVE_RESULTS; i++)
+	{
+		if (!sections[i].empty())
+		{
+			success &= fwrite(sections[i].data(), sizeof(dealRecord), sections[i].size(), file) == sections[i].size();
+		}
+	}
+	success &= fclose(file) == 0;
+	if (!success)
+	{
+		printf("Unable to write %s!\n", path);
+	}
+	return success;
+}
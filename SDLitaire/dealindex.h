@@ -0,0 +1,78 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _DEALINDEX_H
+#define _DEALINDEX_H
+
+/*
+	A file of deal seeds the solver has already been run on.
+	SDLitaireIndex writes it offline and the game maps it read-only,
+	so picking a deal neither solves anything nor reads the whole file.
+
+	Layout, little-endian:
+		dealIndexHeader
+		dealRecord[counts[SOLVE_WON]] winnable deals, easiest first
+		dealRecord[counts[SOLVE_STUCK]] deals with no win found, by difficulty
+		dealRecord[counts[SOLVE_GAVE_UP]] deals the solver gave up on, by difficulty
+*/
+
+#include "klondike.h"
+#include "solver.h"
+#include <cstddef>
+#include <vector>
+
+#define DEAL_INDEX_MAGIC 0x58444C53 /* "SLDX" */
+#define DEAL_INDEX_VERSION 1
+
+struct dealIndexHeader
+{
+	uint32_t magic, version;
+	uint32_t counts[NUM_SOLVE_RESULTS]; /* Records in each section */
+	uint32_t budget; /* The solver's budget when it was built */
+	uint32_t reserved[3];
+};
+
+struct dealRecord
+{
+	uint32_t seed;
+	uint16_t difficulty; /* Solver::difficultyOf */
+	uint16_t solutionMoves; /* 0 unless it is winnable */
+};
+
+class DealIndex
+{
+public:
+	DealIndex();
+	~DealIndex();
+
+	bool open(const char* path);
+	void close();
+	bool isOpen() const { return mHeader != NULL; }
+
+	uint32_t size() const;
+	uint32_t count(int result) const { return mHeader ? mHeader->counts[result] : 0; }
+	const dealRecord& at(uint32_t i) const { return mRecords[i]; }
+	/* Which SOLVE_RESULTS section a record is in */
+	int resultOf(uint32_t i) const;
+
+	/* The winnable deals with minDifficulty <= difficulty <= maxDifficulty are [*first, *first + return) */
+	uint32_t range(int minDifficulty, int maxDifficulty, uint32_t* first) const;
+
+	/* A random winnable deal in the range. False if there isn't one. */
+	bool pick(Random& random, int minDifficulty, int maxDifficulty, uint32_t* seed) const;
+
+	/* Sorts each section by difficulty and writes the file */
+	static bool write(const char* path, std::vector<dealRecord> sections[NUM_SOLVE_RESULTS], uint32_t budget);
+
+private:
+	const dealIndexHeader* mHeader;
+	const dealRecord* mRecords;
+	size_t mBytes;
+	/* Platform handles */
+	void* mFile;
+	void* mMapping;
+	void* mView;
+};
+
+#endif /* _DEALINDEX_H */
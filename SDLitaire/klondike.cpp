@@ -0,0 +1,307 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+#include "klondike.h"
+
+Random::Random(uint64_t seed)
+{
+	this->seed(seed);
+}
+
+void Random::seed(uint64_t seed)
+{
+	mState = seed;
+}
+
+uint32_t Random::next()
+{
+	/* SplitMix64 */
+	uint64_t z = (mState += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return (uint32_t)((z ^ (z >> 31)) >> 32);
+}
+
+uint32_t Random::below(uint32_t bound)
+{
+	return (uint32_t)(((uint64_t)next() * bound) >> 32);
+}
+
+
+Klondike::Klondike()
+{
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		mCounts[i] = 0;
+		mFaceDown[i] = 0;
+	}
+	mMoves =
+		mStockPasses = 0;
+	mSeed = 0;
+}
+
+void Klondike::shuffleDeck(cardFace deck[NUM_CARDS], uint32_t seed)
+{
+	/*
+		Yes, I'm pretending that index 0 doesn't exist.
+		This way 1 = Ace, 2 = 2, ... (13 = King)
+	*/
+	for (int i = 0; i < NUM_SUITS; i++)
+	{
+		for (int j = 1; j <= NUM_FACES; j++)
+		{
+			deck[(i * NUM_FACES) + (j - 1)].suit = i;
+			deck[(i * NUM_FACES) + (j - 1)].value = j;
+		}
+	}
+
+	/* Fisher-Yates */
+	Random random(seed);
+	for (int i = NUM_CARDS - 1; i > 0; i--)
+	{
+		int j = (int)random.below(i + 1);
+		cardFace swap = deck[i];
+		deck[i] = deck[j];
+		deck[j] = swap;
+	}
+}
+
+void Klondike::deal(uint32_t seed)
+{
+	cardFace deck[NUM_CARDS];
+	shuffleDeck(deck, seed);
+	deal(deck);
+	mSeed = seed;
+}
+
+void Klondike::deal(const cardFace deck[NUM_CARDS])
+{
+	*this = Klondike();
+
+	/* Row by row, each row starting one slot further right */
+	int next = 0;
+	for (int row = 0; row < NUM_TABLEAUS; row++)
+	{
+		for (int column = row; column < NUM_TABLEAUS; column++)
+		{
+			int rank = FIRST_TABLEAU + column;
+			mPiles[rank][mCounts[rank]++] = codeOf(deck[next++]);
+		}
+	}
+	for (int i = 0; i < NUM_TABLEAUS; i++)
+	{
+		mFaceDown[FIRST_TABLEAU + i] = (uint8_t)i; /* Only the top card is face-up */
+	}
+
+	/* The rest go to the stock with the next card dealt on top */
+	for (int i = NUM_CARDS - 1; i >= FIRST_DEAL; i--)
+	{
+		mPiles[STOCK_RANK][mCounts[STOCK_RANK]++] = codeOf(deck[i]);
+	}
+	mFaceDown[STOCK_RANK] = mCounts[STOCK_RANK];
+}
+
+void Klondike::setPile(int rank, const cardCode* cards, int count, int faceDown)
+{
+	for (int i = 0; i < count; i++)
+	{
+		mPiles[rank][i] = cards[i];
+	}
+	mCounts[rank] = (uint8_t)count;
+	mFaceDown[rank] = (uint8_t)(rank == STOCK_RANK ? count : faceDown);
+}
+
+bool slotAccepts(int rank, cardCode card, int count, bool empty, cardCode top)
+{
+	if ((rank >= FIRST_FOUNDATION) && (rank < FIRST_TABLEAU))
+	{
+		if (count != 1)
+		{
+			return false;
+		}
+		if (empty)
+		{
+			return valueOf(card) == ACE;
+		}
+		return (suitOf(card) == suitOf(top)) && (valueOf(card) == valueOf(top) + 1);
+	}
+
+	if (rank >= FIRST_TABLEAU)
+	{
+		if (empty)
+		{
+			return valueOf(card) == KING;
+		}
+		return (isRed(card) != isRed(top)) && (valueOf(card) + 1 == valueOf(top));
+	}
+
+	return false;
+}
+
+
+bool Klondike::accepts(int rank, cardCode card, int count) const
+{
+	bool empty = !mCounts[rank];
+	return slotAccepts(rank, card, count, empty, empty ? card : top(rank));
+}
+
+int Klondike::legalMoves(klondikeMove* moves) const
+{
+	int n = 0;
+
+	if (mCounts[STOCK_RANK])
+	{
+		klondikeMove draw = { MOVE_DRAW, STOCK_RANK, WASTE_RANK, 1 };
+		moves[n++] = draw;
+	}
+	else if (mCounts[WASTE_RANK])
+	{
+		klondikeMove recycle = { MOVE_RECYCLE, WASTE_RANK, STOCK_RANK, mCounts[WASTE_RANK] };
+		moves[n++] = recycle;
+	}
+
+	for (int from = WASTE_RANK; from < CARD_RANKS; from++)
+	{
+		if (!mCounts[from])
+		{
+			continue;
+		}
+
+		/* Any face-up run can leave a tableau, but only single cards leave the waste and foundations */
+		int lowest = (from >= FIRST_TABLEAU) ? mFaceDown[from] : mCounts[from] - 1;
+		for (int start = lowest; start < mCounts[from]; start++)
+		{
+			int count = mCounts[from] - start;
+			cardCode card = mPiles[from][start];
+			bool emptyFoundationTried = false;
+
+			for (int to = FIRST_FOUNDATION; to < CARD_RANKS; to++)
+			{
+				if (to == from)
+				{
+					continue;
+				}
+				if ((from >= FIRST_FOUNDATION) && (from < FIRST_TABLEAU) && (to < FIRST_TABLEAU))
+				{
+					continue; /* Foundation to foundation goes nowhere */
+				}
+				if (!mCounts[to])
+				{
+					/* One empty foundation is as good as another */
+					if (to < FIRST_TABLEAU)
+					{
+						if (emptyFoundationTried)
+						{
+							continue;
+						}
+						emptyFoundationTried = true;
+					}
+					/* Moving a whole column into an empty one goes nowhere */
+					else if ((from >= FIRST_TABLEAU) && (start == 0))
+					{
+						continue;
+					}
+				}
+				if (accepts(to, card, count))
+				{
+					klondikeMove move = { MOVE_CARDS, (uint8_t)from, (uint8_t)to, (uint8_t)count };
+					moves[n++] = move;
+				}
+			}
+		}
+	}
+	return n;
+}
+
+bool Klondike::isLegal(const klondikeMove& move) const
+{
+	switch (move.kind)
+	{
+	case MOVE_DRAW:
+		return mCounts[STOCK_RANK] > 0;
+	case MOVE_RECYCLE:
+		return !mCounts[STOCK_RANK] && (mCounts[WASTE_RANK] > 0);
+	case MOVE_CARDS:
+		if ((move.from == STOCK_RANK) || (move.from >= CARD_RANKS) || (move.to >= CARD_RANKS) ||
+			(move.from == move.to) || (move.count < 1))
+		{
+			return false;
+		}
+		if (move.from < FIRST_TABLEAU)
+		{
+			if ((move.count != 1) || !mCounts[move.from])
+			{
+				return false;
+			}
+		}
+		else if (move.count > mCounts[move.from] - mFaceDown[move.from])
+		{
+			return false;
+		}
+		return accepts(move.to, mPiles[move.from][mCounts[move.from] - move.count], move.count);
+	}
+	return false;
+}
+
+bool Klondike::reveals(const klondikeMove& move) const
+{
+	return (move.kind == MOVE_CARDS) && (move.from >= FIRST_TABLEAU) && mFaceDown[move.from] &&
+		(move.count == mCounts[move.from] - mFaceDown[move.from]);
+}
+
+void Klondike::apply(const klondikeMove& move)
+{
+	mMoves++;
+
+	switch (move.kind)
+	{
+	case MOVE_DRAW:
+		mPiles[WASTE_RANK][mCounts[WASTE_RANK]++] = mPiles[STOCK_RANK][--mCounts[STOCK_RANK]];
+		mFaceDown[STOCK_RANK] = mCounts[STOCK_RANK];
+		break;
+
+	case MOVE_RECYCLE:
+		/* Turning the waste over puts the first card drawn back on top */
+		while (mCounts[WASTE_RANK])
+		{
+			mPiles[STOCK_RANK][mCounts[STOCK_RANK]++] = mPiles[WASTE_RANK][--mCounts[WASTE_RANK]];
+		}
+		mFaceDown[STOCK_RANK] = mCounts[STOCK_RANK];
+		mStockPasses++;
+		break;
+
+	case MOVE_CARDS:
+	{
+		int start = mCounts[move.from] - move.count;
+		for (int i = 0; i < move.count; i++)
+		{
+			mPiles[move.to][mCounts[move.to]++] = mPiles[move.from][start + i];
+		}
+		mCounts[move.from] = (uint8_t)start;
+
+		/* Turn over whatever was under the run */
+		if (mCounts[move.from] && (mFaceDown[move.from] >= mCounts[move.from]))
+		{
+			mFaceDown[move.from] = mCounts[move.from] - 1;
+		}
+		break;
+	}
+	}
+}
+
+int Klondike::foundationCards() const
+{
+	int cards = 0;
+	for (int i = FIRST_FOUNDATION; i < FIRST_TABLEAU; i++)
+	{
+		cards += mCounts[i];
+	}
+	return cards;
+}
+
+bool Klondike::isWon() const
+{
+	return foundationCards() == NUM_CARDS;
+}
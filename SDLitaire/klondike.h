@@ -0,0 +1,147 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _KLONDIKE_H
+#define _KLONDIKE_H
+
+/*
+	The rules of the game, with no SDL in sight.
+	The window, the simulator and the other tools all deal and play through this.
+*/
+
+#include <cstdint>
+
+#define NUM_CARDS 52
+#define FIRST_DEAL 28 /* This is the number of cards dealt at the start of the game. */
+
+#define CARD_RANKS 13 /* The number of slots on the table */
+
+/* Where the slots are */
+#define STOCK_RANK 0
+#define WASTE_RANK 1
+#define FIRST_FOUNDATION 2
+#define FIRST_TABLEAU 6
+#define NUM_FOUNDATIONS 4
+#define NUM_TABLEAUS 7
+
+#define MAX_LEGAL_MOVES 128 /* More than any position can have */
+
+struct cardFace
+{
+	int suit,value;
+};
+
+enum SUITS
+{
+	SPADES,
+	CLUBS,
+	DIAMONDS,
+	HEARTS,
+	NUM_SUITS
+};
+
+enum FACES
+{
+	ACE = 1,
+	JACK = 11,
+	QUEEN,
+	KING,
+	NUM_FACES = KING /* Card Values per Suit */
+};
+
+enum MOVE_KINDS
+{
+	MOVE_DRAW, /* Stock to waste */
+	MOVE_RECYCLE, /* The whole waste back to the stock */
+	MOVE_CARDS, /* One or more face-up cards between slots */
+	NUM_MOVE_KINDS
+};
+
+struct klondikeMove
+{
+	uint8_t kind, from, to, count;
+};
+
+/* A card packed into a byte: suit * NUM_FACES + value - 1 */
+typedef uint8_t cardCode;
+
+inline cardCode codeOf(cardFace face) { return (cardCode)(face.suit * NUM_FACES + face.value - 1); }
+inline int suitOf(cardCode card) { return card / NUM_FACES; }
+inline int valueOf(cardCode card) { return card % NUM_FACES + 1; }
+inline bool isRed(cardCode card) { return (suitOf(card) == DIAMONDS) || (suitOf(card) == HEARTS); }
+
+/*
+	Can a run of count cards, starting with this one, go on top of a slot?
+	The slot's top card is only looked at when it isn't empty.
+*/
+bool slotAccepts(int rank, cardCode card, int count, bool empty, cardCode top);
+
+/* Small, fast and the same on every platform, so a seed is always the same deal */
+class Random
+{
+public:
+	explicit Random(uint64_t seed = 0);
+
+	void seed(uint64_t seed);
+	uint32_t next();
+
+	/* Uniform in [0, bound) */
+	uint32_t below(uint32_t bound);
+
+private:
+	uint64_t mState;
+};
+
+/* One game of draw-one Klondike */
+class Klondike
+{
+public:
+	Klondike();
+
+	/* Builds the deck in suit order and shuffles it. This is the deal the window uses. */
+	static void shuffleDeck(cardFace deck[NUM_CARDS], uint32_t seed);
+
+	/* Lays out a deck the way the window deals it */
+	void deal(uint32_t seed);
+	void deal(const cardFace deck[NUM_CARDS]);
+
+	/* Lays out any position, one slot at a time. The stock is always face-down. */
+	void setPile(int rank, const cardCode* cards, int count, int faceDown);
+	/* Swaps what one place holds, as when guessing at a face-down card */
+	void setCard(int rank, int file, cardCode card) { mPiles[rank][file] = card; }
+
+	/* Fills moves, which must hold MAX_LEGAL_MOVES, and returns how many there are */
+	int legalMoves(klondikeMove* moves) const;
+	bool isLegal(const klondikeMove& move) const;
+
+	/* Plays a legal move. A tableau card left face-down on top is turned over. */
+	void apply(const klondikeMove& move);
+
+	bool isWon() const;
+
+	/* Would this move turn over a face-down card? */
+	bool reveals(const klondikeMove& move) const;
+
+	int count(int rank) const { return mCounts[rank]; }
+	int faceDown(int rank) const { return mFaceDown[rank]; }
+	cardCode card(int rank, int file) const { return mPiles[rank][file]; }
+	cardCode top(int rank) const { return mPiles[rank][mCounts[rank] - 1]; }
+	int foundationCards() const;
+	int getMoves() const { return mMoves; }
+	int getStockPasses() const { return mStockPasses; }
+	uint32_t getSeed() const { return mSeed; }
+
+private:
+	/* Can this card go on top of that slot? */
+	bool accepts(int rank, cardCode card, int count) const;
+
+	cardCode mPiles[CARD_RANKS][NUM_CARDS]; /* Bottom to top */
+	uint8_t mCounts[CARD_RANKS];
+	uint8_t mFaceDown[CARD_RANKS]; /* Cards at the bottom of each slot that are face-down */
+	int mMoves,
+		mStockPasses;
+	uint32_t mSeed;
+};
+
+#endif /* _KLONDIKE_H */
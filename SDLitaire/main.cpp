@@ -4,15 +4,36 @@
 */
 
 #include "classes.h"
+#include "allocations.h"
 
 /* Exit code 0 is success and 1 is a generic failure */
 #define EXIT_FAILED_INIT 2
 #define EXIT_FAILED_FILES 3
+#define EXIT_ALLOCATIONS 4 /* -alloccheck saw a steady frame allocate */
+#define EXIT_LATENCY 5 /* -latency lost track of a traced input */
 
-#define CARD_SCALE 4
+#define ALLOC_WARMUP_FRAMES 120 /* Frames before the loops are expected not to allocate */
+#define ALLOC_CHECK_FRAMES 600 /* -alloccheck quits after this many, once the last ALLOC_CHECK_FRAMES - ALLOC_WARMUP_FRAMES were steady */
 
 #define TEXT_COLOR 0, 0, 0 /* Black */
 
+/* Everything the game threads share */
+struct gameThreads
+{
+	AssetManager* game;
+	EventQueue input; /* Main thread to simulation thread */
+	SDL_atomic_t quit;
+	SDL_atomic_t steady; /* Warm-up is over, so neither loop should allocate */
+	AllocationMeter* simulationMeter;
+	AllocationMeter* renderMeter;
+	TableWall* wall; /* Set with -tables, which plays it instead of the player's table */
+	LatencyHistogram latency; /* Filled by render, with -latency */
+
+	/* -alloccheck drags the card at (dragX, dragY) around, a step each frame */
+	bool scriptedDrag;
+	int dragX, dragY, dragStep;
+};
+
 void debugPause()
 {
 #if _DEBUG
@@ -20,215 +41,706 @@ void debugPause()
 #endif // DEBUG
 }
 
-int main(int argc, char* args[])
+/* -alloccheck: holds the card at (x, y) and circles it, so the moving cards are drawn every frame */
+void scriptDrag(EventQueue& input, int x, int y, int step)
 {
-#if _DEBUG
-	SetConsoleTitle("Debug Output");
-#endif // DEBUG
-
-	/* Start up SDL and create the window */
-	AssetManager gameManager;
-	if (!gameManager.Init())
+	SDL_Event e;
+	SDL_zero(e);
+	if (!step)
 	{
-		return EXIT_FAILED_INIT;
+		e.type = SDL_MOUSEBUTTONDOWN;
+		e.button.timestamp = SDL_GetTicks();
+		e.button.button = SDL_BUTTON_LEFT;
+		e.button.state = SDL_PRESSED;
+		e.button.x = x;
+		e.button.y = y;
+		while (!input.push(e))
+		{
+			SDL_Delay(1);
+		}
+		return;
 	}
 
-	if (!gameManager.LoadMedia()) /* Load Media */
+	/* Starts and ends each lap where the card was picked up */
+	float before = (step - 1) * 0.05f;
+	float angle = step * 0.05f;
+	e.type = SDL_MOUSEMOTION;
+	e.motion.timestamp = SDL_GetTicks();
+	e.motion.state = SDL_BUTTON_LMASK;
+	e.motion.x = x + (int)(100 * (cosf(angle) - 1));
+	e.motion.y = y + (int)(100 * sinf(angle));
+	e.motion.xrel = e.motion.x - (x + (int)(100 * (cosf(before) - 1)));
+	e.motion.yrel = e.motion.y - (y + (int)(100 * sinf(before)));
+	input.push(e);
+}
+
+/* Main thread, between frames: handles every waiting event and passes game input on. False once the game should quit. */
+bool pumpEvents(gameThreads* threads)
+{
+	AssetManager* gameManager = threads->game;
+	if (threads->scriptedDrag)
 	{
-		gameManager.Close(); /* Try to free resources and close SDL */
-		return EXIT_FAILED_FILES;
+		scriptDrag(threads->input, threads->dragX, threads->dragY, threads->dragStep++);
 	}
 
-	bool quit = false; /* Loop flag */
+	SDL_Event e; /* Event handler */
+	while (SDL_PollEvent(&e) != 0)
+	{
+		if (e.type == SDL_QUIT)
+		{
+			SDL_AtomicSet(&threads->quit, 1);
+		}
+
+		/* Render target contents are lost when the device resets */
+		if (e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET)
+		{
+			gameManager->loseStaticLayer();
+			if (threads->wall)
+			{
+				threads->wall->lose();
+			}
+		}
 
-	Window* gameWindow = gameManager.getWindow();
-	SDL_Renderer* gameRenderer = gameManager.getRenderer();
-	TTF_Font* font = gameManager.getFont();
-	Texture* fpsTexture = gameManager.getFPSTexture();
-	Texture* backgroundTexture = gameManager.getBackground();
-	Texture* deckTexture = gameManager.getCardBack();
-	Texture* outlineTexture = gameManager.getCardOutline();
+		/* An uncovered window shows all of the next software frame */
+		if (e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_EXPOSED)
+		{
+			gameManager->getSoftRenderer()->damageAll();
+		}
 
-	/* May be faster to store these */
-	int winH = gameWindow->getHeight();
-	int winW = gameWindow->getWidth();
+		/* Game input goes to the simulation thread */
+		if (e.type == SDL_MOUSEMOTION || e.type == SDL_MOUSEBUTTONDOWN ||
+			e.type == SDL_MOUSEBUTTONUP || e.type == SDL_WINDOWEVENT)
+		{
+			/* Stale motion can be dropped, but clicks and window changes must arrive */
+			while (!threads->input.push(e) && e.type != SDL_MOUSEMOTION)
+			{
+				SDL_Delay(1);
+			}
+		}
 
-	/* The Cards */
-	Card* card[NUM_CARDS];
+		/* Handle window events */
+		gameManager->getWindow()->handleEvent(e);
 
-	for (int i = 0; i < NUM_CARDS; i++)
-	{
-		card[i] = new Card;
-		card[i]->setFile(NUM_CARDS - i);
-		card[i]->assocGame(gameManager);
-		card[i]->setTexture(deckTexture);
-		card[i]->setFace(gameManager.getFace(i)); /* Face values were shuffled earlier */
+		/* Window menu events are of this type */
+		if (e.type == SDL_SYSWMEVENT)
+		{
+			if (e.syswm.msg->msg.win.msg == WM_COMMAND) /* and this type */
+			{
+				switch (e.syswm.msg->msg.win.wParam)
+				{
+				case MENU_EXIT:
+					SDL_AtomicSet(&threads->quit, 1);
+					break;
+				case MENU_NEW_GAME:
+				case MENU_NEW_WINNABLE:
+				{
+					/* The deal belongs to the simulation thread */
+					SDL_Event request;
+					SDL_zero(request);
+					request.type = SDL_USEREVENT;
+					request.user.code = (Sint32)e.syswm.msg->msg.win.wParam;
+					while (!threads->input.push(request))
+					{
+						SDL_Delay(1);
+					}
+					break;
+				}
+				}
+			}
+		}
 	}
+	return !SDL_AtomicGet(&threads->quit);
+}
 
-	/* Initial scaling should happen as soon as possible */
-	deckTexture->aspectScale(winW / CARD_SCALE, winH / CARD_SCALE);
-	outlineTexture->aspectScale(winW / CARD_SCALE, winH / CARD_SCALE);
-	gameManager.computeCardPlaces();
+/* Owns the game state: handles input, moves cards and publishes snapshots */
+int simulate(void* data)
+{
+	gameThreads* threads = (gameThreads*)data;
+	AssetManager* gameManager = threads->game;
 
-	/* Deal Cards */
-	int rank = 6; /* Rank 6 is the first one in the second row */
-	int file = 1;
-	card[0]->flip(); /* Flip the first card while it flys to 6,0 */
-	for (int i = 0; i < FIRST_DEAL; i++)
+	InputFrame frame;
+	Timer stepTimer; /* Keeps track of time between card steps */
+	stepTimer.start();
+
+	AllocationMeter* meter = threads->simulationMeter;
+
+	while (!SDL_AtomicGet(&threads->quit))
 	{
-		if (rank == CARD_RANKS)
+		meter->beginFrame(SDL_AtomicGet(&threads->steady) != 0);
+
+		/* Take the queue in one go, with the motion merged, so a fast mouse can't pile up work */
+		frame.drain(threads->input);
+		for (int i = 0; i < frame.size(); i++)
 		{
-			rank = 6 + file;
-			file++;
-			card[i]->flip(); /* When a new row starts, flip the first card */
+			gameManager->beginInputTrace(frame.at(i));
+			gameManager->dispatchInput(frame.at(i));
 		}
-		card[i]->dealTo(rank);
-		rank++;
+		meter->mark(0, "input");
+
+		/* Object Processing */
+		gameManager->moveCards(stepTimer.getTicks());
+		gameManager->updateWinOdds();
+		gameManager->logPosition();
+		gameManager->prefetchFaces();
+
+		stepTimer.start(); /* Restart step timer */
+		meter->mark(1, "move");
+
+		gameManager->publishSnapshot();
+		meter->mark(2, "publish");
+		meter->endFrame();
+		SDL_Delay(1);
 	}
-	card[FIRST_DEAL]->setClickability(true); /* Top Deck Card */
 
-	SDL_Event e; /* Event handler */
-	SDL_EventState(SDL_SYSWMEVENT, SDL_ENABLE); /* Allow standard window events to process */
+	if (gameManager->droppedInputTraces())
+	{
+		printf("%u inputs were not traced because too many were waiting on one frame.\n", gameManager->droppedInputTraces());
+	}
+	return 0;
+}
+
+/* Main thread: pumps events and draws the newest snapshot until the game quits. Nothing else touches the renderer. */
+void render(gameThreads* threads)
+{
+	AssetManager* gameManager = threads->game;
+
+	SDL_Renderer* gameRenderer = gameManager->getRenderer();
+	TTF_Font* font = gameManager->getFont();
+	GlyphAtlas* fpsGlyphs = gameManager->getFPSGlyphs();
+	Texture* backgroundTexture = gameManager->getBackground();
+	Texture* deckTexture = gameManager->getCardBack();
+	Texture* outlineTexture = gameManager->getCardOutline();
+	Texture* staticLayer = gameManager->getStaticLayer();
+	SpriteBatch* batch = gameManager->getSpriteBatch();
+
+	/* Without a GPU the CPU draws into the window surface */
+	bool software = gameManager->options()->softwareRender;
+	SoftRenderer* soft = gameManager->getSoftRenderer();
+	SDL_Window* window = gameManager->getWindow()->getSDLWindow();
+
+	FrameRecorder* recorder = gameManager->getRecorder();
+	AllocationMeter* meter = threads->renderMeter;
 
-	Timer stepTimer; /* Keeps track of time between card steps */
 	Timer fpsTimer; /* The frames per second timer */
 
-	SDL_Color textColor = { TEXT_COLOR }; /* Set text color */
-	std::stringstream timeText; /* In-memory text stream */
+	/* Input latency is counted once, on the first frame that shows each input */
+	LatencyHistogram& latency = threads->latency;
+	Uint32 lastSerial = 0;
+	Uint32 inputStamps[MAX_TRACED_INPUTS];
+	int inputCount = 0;
 
-	Card* draggingCard = NULL; /* This is set in the render loop so it can render last */
+	/* The FPS text is drawn from glyphs rendered once, so it never allocates */
+	SDL_Color textColor = { TEXT_COLOR }; /* Set text color */
+	char fpsText[64] = "";
+	char oddsText[64] = "";
+	bool showOdds = gameManager->options()->winOdds;
+	bool textShown = false; /* The last software frame had text drawn over it */
+	int sceneDraws = 0;
+	if ((gameManager->options()->showFPS || showOdds) && !fpsGlyphs->load(font, textColor, gameRenderer))
+	{
+		printf("Unable to render FPS glyphs!\n");
+	}
 
 	/* Start counting frames per second */
 	int countedFrames = 0;
-	if (gameManager.options()->showFPS)
+	if (gameManager->options()->showFPS)
 		fpsTimer.start();
 
-	/* While it's not quiting time */
-	while (!quit)
+	int frames = 0;
+	int steadyFrames = 0;
+	while (pumpEvents(threads)) /* Between frames, so the window can't change while one is drawn */
 	{
-		/* Handle events in queue */
-		while (SDL_PollEvent(&e) != 0)
-		{
-			if (e.type == SDL_QUIT)
-			{
-				quit = true;
-			}
-
-			/* Handle input for the cards */
-			for (int i = 0; i < NUM_CARDS; i++)
-			{
-				card[i]->handleEvent(e);
-			}
-
-			gameManager.handleEvent(e);
+		meter->beginFrame(SDL_AtomicGet(&threads->steady) != 0);
+		tableSnapshot* snapshot = gameManager->acquireSnapshot();
 
-			/* Handle window events */
-			gameWindow->handleEvent(e);
-
-			/* Window menu events are of this type */
-			if (e.type == SDL_SYSWMEVENT)
-			{
-				if (e.syswm.msg->msg.win.msg == WM_COMMAND) /* and this type */
-				{
-					switch (e.syswm.msg->msg.win.wParam)
-					{
-					case MENU_EXIT:
-						quit = true;
-						break;
-					}
-				}
-			}
+		/* Only draw when not minimized */
+		if (snapshot->minimized || !snapshot->width || !snapshot->height)
+		{
+			gameManager->releaseSnapshot(false);
+			SDL_Delay(10);
+			continue;
 		}
+		meter->mark(0, "snapshot");
 
 		/* Calculate and correct fps */
 		float avgFPS = countedFrames / (fpsTimer.getTicks() / 1000.f);
-		if (gameManager.options()->showFPS)
+		if (gameManager->options()->showFPS)
 		{
 			/* Set FPS text to be rendered */
-			timeText.str("");
-			timeText << "FPS: " << roundf(avgFPS);
+			if (software)
+			{
+				snprintf(fpsText, sizeof(fpsText), "FPS: %.0f  Threads: %i", roundf(avgFPS), soft->getThreads());
+			}
+			else
+			{
+				snprintf(fpsText, sizeof(fpsText), "FPS: %.0f  Draws: %i", roundf(avgFPS), sceneDraws);
+			}
 		}
-
-		/* Object Processing */
-		for (int i = 0; i < NUM_CARDS; i++)
+		if (showOdds)
 		{
-			card[i]->move(stepTimer.getTicks());
+			winEstimate odds = snapshot->odds;
+			if (odds.samples)
+			{
+				snprintf(oddsText, sizeof(oddsText), "Win: %u%%  (%u deals)", (odds.wins * 100 + odds.samples / 2) / odds.samples, odds.samples);
+			}
+			else
+			{
+				snprintf(oddsText, sizeof(oddsText), "Win: ?");
+			}
 		}
+		meter->mark(1, "text");
 
-		stepTimer.start(); /* Restart step timer */
-
-		/* Only draw when not minimized */
-		if (!gameWindow->isMinimized())
+		SDL_Surface* surface = NULL;
+		if (software)
 		{
-			gameManager.clearRenderer(); /* Clear screen */
-
-			/* Create FPS text texture*/
-			if (gameManager.options()->showFPS)
-				if (!fpsTexture->loadFromRenderedText(timeText.str().c_str(), textColor, font, gameRenderer))
-				{
-					printf("Unable to render FPS texture!\n");
-				}
+			/* The text is drawn over the window afterwards, so its strip is drawn again each frame */
+			bool text = gameManager->options()->showFPS || showOdds;
+			if (text || textShown)
+			{
+				soft->damage(0, 0, snapshot->width, fpsGlyphs->getHeight());
+			}
+			textShown = text;
 
-			winH = gameWindow->getHeight();
-			winW = gameWindow->getWidth();
-			/* Render objects */
-			backgroundTexture->setWidth(winW);
-			backgroundTexture->setHeight(winH);
-			deckTexture->aspectScale(winW / CARD_SCALE, winH / CARD_SCALE);
-			outlineTexture->aspectScale(winW / CARD_SCALE, winH / CARD_SCALE);
+			/* The CPU draws what changed into the window surface, and records it */
+			surface = soft->drawToWindow(window, snapshot, recorder);
+		}
+		else
+		{
+			gameManager->clearRenderer(); /* Clear screen */
+
+			/* Painted faces follow the card size */
+			gameManager->updateFaceAtlas(snapshot->cardW, snapshot->cardH);
+
+			/* Size everything to the snapshot's layout */
+			backgroundTexture->setWidth(snapshot->width);
+			backgroundTexture->setHeight(snapshot->height);
+			deckTexture->setWidth(snapshot->cardW);
+			deckTexture->setHeight(snapshot->cardH);
+			outlineTexture->setWidth(snapshot->cardW);
+			outlineTexture->setHeight(snapshot->cardH);
 			for (int i = 0; i < NUM_SUITS; i++)
 			{
 				for (int j = 1; j <= NUM_FACES; j++)
 				{
-					gameManager.getCardTexture(i, j)->aspectScale(winW / CARD_SCALE, winH / CARD_SCALE);
+					gameManager->getCardTexture(i, j)->setWidth(snapshot->cardW);
+					gameManager->getCardTexture(i, j)->setHeight(snapshot->cardH);
 				}
 			}
 
-			gameManager.computeCardPlaces();
+			/* Faces load the first time they are drawn */
+			gameManager->pageFaces(snapshot);
 
-			backgroundTexture->render(gameRenderer, 0, 0);
+			/* Resting cards only change when the board does */
+			if (gameManager->updateStaticLayer(snapshot))
+			{
+				batch->add(staticLayer, 0, 0);
+			}
 
-			for (int i = 0; i < CARD_RANKS; i++)
+			for (int i = 0; i < snapshot->movingCount; i++)
 			{
-				if (i != 1) /* No outline for the discard pile */
-				{
-					outlineTexture->render(gameRenderer, gameManager.getCardPlace(i)->x, gameManager.getCardPlace(i)->y);
-				}
+				batch->add(snapshot->moving[i].texture, snapshot->moving[i].x, snapshot->moving[i].y);
 			}
 
-			for (int i = 0; i < CARD_RANKS; i++) /* BOOM! Implicit Z ordering */
+			batch->flush(gameRenderer);
+			sceneDraws = batch->getDrawCalls();
+		}
+
+		/* A snapshot repeats inputs until one showing them is drawn, so skip those already counted */
+		inputCount = 0;
+		if (snapshot->serial != lastSerial)
+		{
+			for (int i = 0; i < snapshot->inputCount; i++)
 			{
-				Card* tempCard = nullptr;
-				for (int j = 0; j < NUM_CARDS; j++)
+				if (snapshot->inputSerials[i] > lastSerial)
 				{
-					if (tempCard = gameManager.getCard(i, j))
-					{
-						if (!tempCard->isDragging())
-						{
-							tempCard->render(gameRenderer, gameManager.getCardPlace(i));
-						}
-						else
-						{
-							draggingCard = tempCard;
-						}
-					}
+					inputStamps[inputCount++] = snapshot->inputStamps[i];
 				}
 			}
-			if (draggingCard) /* Dragging card is rendered last */
+			lastSerial = snapshot->serial;
+		}
+		int winW = snapshot->width;
+		gameManager->releaseSnapshot();
+		meter->mark(2, "draw");
+
+		/* Recorded without the FPS counter. Only a copy is made here; workers do the writing. */
+		if (!software && recorder->isRecording())
+		{
+			recorder->captureRenderer(gameRenderer);
+		}
+		meter->mark(3, "record");
+
+		/* The FPS goes in the top right, and the odds in the top left */
+		if (software)
+		{
+			if (surface && gameManager->options()->showFPS)
 			{
-				draggingCard->render(gameRenderer, gameManager.getCardPlace(draggingCard->getRank()));
+				fpsGlyphs->blit(surface, fpsText, surface->w - fpsGlyphs->measure(fpsText), 0);
 			}
-
-			if (gameManager.options()->showFPS)
+			if (surface && showOdds)
 			{
-				fpsTexture->render(gameRenderer, (winW - fpsTexture->getWidth()), 0);
-				countedFrames++;
+				fpsGlyphs->blit(surface, oddsText, 0, 0);
 			}
+		}
+		else
+		{
+			if (gameManager->options()->showFPS)
+			{
+				fpsGlyphs->draw(batch, fpsText, winW - fpsGlyphs->measure(fpsText), 0);
+			}
+			if (showOdds)
+			{
+				fpsGlyphs->draw(batch, oddsText, 0, 0);
+			}
+			batch->flush(gameRenderer);
+		}
+		if (gameManager->options()->showFPS)
+		{
+			countedFrames++;
+		}
 
+		if (software)
+		{
+			soft->present(window); /* Update screen */
+		}
+		else
+		{
 			SDL_RenderPresent(gameRenderer); /* Update screen */
+			gameManager->getFacePager()->endFrame(); /* Nothing queued can be evicted now */
+		}
+
+		if (inputCount)
+		{
+			Uint32 presented = SDL_GetTicks();
+			for (int i = 0; i < inputCount; i++)
+			{
+				latency.add(presented - inputStamps[i]);
+			}
+		}
+		meter->mark(4, "present");
+		meter->endFrame();
+
+		/*
+			Both loops have settled by now, once the faces prefetched while dealing are uploaded.
+			The drawn snapshot has to be as far along, or a fast renderer gets here before the simulation has asked for any.
+		*/
+		if ((++frames >= ALLOC_WARMUP_FRAMES) && (lastSerial >= ALLOC_WARMUP_FRAMES) && !SDL_AtomicGet(&threads->steady) &&
+			!gameManager->getFacePager()->isBusy())
+		{
+			SDL_AtomicSet(&threads->steady, 1);
+		}
+		else if (SDL_AtomicGet(&threads->steady))
+		{
+			steadyFrames++;
+		}
+		if (gameManager->options()->allocCheck && (steadyFrames >= ALLOC_CHECK_FRAMES - ALLOC_WARMUP_FRAMES))
+		{
+			SDL_AtomicSet(&threads->quit, 1);
+		}
+	}
+
+}
+
+/* -tables: plays the bots' moves and publishes the wall */
+int simulateTables(void* data)
+{
+	gameThreads* threads = (gameThreads*)data;
+	TableWall* wall = threads->wall;
+
+	InputFrame frame;
+	while (!SDL_AtomicGet(&threads->quit))
+	{
+		/* Nobody plays by hand, but the queue must not fill up */
+		frame.drain(threads->input);
+
+		wall->step(SDL_GetTicks());
+		wall->publish();
+		SDL_Delay(1);
+	}
+	return 0;
+}
+
+/* -tables, main thread: pumps events and draws the wall, where only the tiles that changed cost anything */
+void renderTables(gameThreads* threads)
+{
+	AssetManager* gameManager = threads->game;
+	TableWall* wall = threads->wall;
+
+	SDL_Renderer* gameRenderer = gameManager->getRenderer();
+	SDL_Window* window = gameManager->getWindow()->getSDLWindow();
+	SpriteBatch* batch = gameManager->getSpriteBatch();
+	GlyphAtlas* fpsGlyphs = gameManager->getFPSGlyphs();
+	bool showFPS = gameManager->options()->showFPS;
+
+	SDL_Color textColor = { TEXT_COLOR }; /* Set text color */
+	char fpsText[96] = "";
+	if (showFPS && !fpsGlyphs->load(gameManager->getFont(), textColor, gameRenderer))
+	{
+		printf("Unable to render FPS glyphs!\n");
+	}
+
+	Timer fpsTimer; /* The frames per second timer */
+	fpsTimer.start();
+	int countedFrames = 0;
+
+	while (pumpEvents(threads))
+	{
+		/* Only draw when not minimized */
+		int width, height;
+		if ((SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED) ||
+			(SDL_GetRendererOutputSize(gameRenderer, &width, &height) < 0) || !width || !height)
+		{
+			SDL_Delay(10);
+			continue;
+		}
+
+		gameManager->clearRenderer(); /* Clear screen */
+		wallSnapshot* snapshot = wall->acquire();
+		int redrawn = wall->draw(gameRenderer, batch, snapshot, width, height);
+		Uint32 won = snapshot->won;
+		Uint32 played = snapshot->played;
+		wall->release();
+
+		if (showFPS)
+		{
+			float avgFPS = countedFrames / (fpsTimer.getTicks() / 1000.f);
+			snprintf(fpsText, sizeof(fpsText), "FPS: %.0f  Tables: %i  Redrawn: %i  Won: %u/%u",
+				roundf(avgFPS), wall->getCount(), redrawn, won, played);
+			fpsGlyphs->draw(batch, fpsText, width - fpsGlyphs->measure(fpsText), 0);
+			countedFrames++;
+		}
+		batch->flush(gameRenderer);
+		SDL_RenderPresent(gameRenderer); /* Update screen */
+		gameManager->getFacePager()->endFrame();
+	}
+}
+
+int main(int argc, char* args[])
+{
+#if _DEBUG
+	SetConsoleTitle("Debug Output");
+#endif // DEBUG
+
+	/* Count SDL's allocations as well as ours. SDL must not have allocated yet. */
+	installAllocationHooks();
+
+	/* Start up SDL and create the window */
+	AssetManager gameManager;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(args[i], "-latency"))
+		{
+			gameManager.options()->measureLatency = true;
+		}
+		else if (!strcmp(args[i], "-audiobuffer") && (i + 1 < argc))
+		{
+			int ms = atoi(args[++i]); /* max is a macro, and would read the next argument twice */
+			gameManager.options()->audioBufferMs = max(ms, 1);
+		}
+		else if (!strcmp(args[i], "-winnable"))
+		{
+			gameManager.options()->winnableOnly = true;
+		}
+		else if (!strcmp(args[i], "-difficulty") && (i + 2 < argc))
+		{
+			gameManager.options()->minDifficulty = atoi(args[++i]);
+			gameManager.options()->maxDifficulty = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-dealindex") && (i + 1 < argc))
+		{
+			gameManager.options()->dealIndexPath = args[++i];
+		}
+		else if (!strcmp(args[i], "-movelog") && (i + 1 < argc))
+		{
+			gameManager.options()->moveLogPath = args[++i];
+		}
+		else if (!strcmp(args[i], "-positionlog") && (i + 1 < argc))
+		{
+			gameManager.options()->positionLogPath = args[++i];
+		}
+		else if (!strcmp(args[i], "-procedural"))
+		{
+			gameManager.options()->proceduralFaces = true;
+		}
+		else if (!strcmp(args[i], "-facebudget") && (i + 1 < argc))
+		{
+			int megabytes = atoi(args[++i]);
+			gameManager.options()->faceBudgetMB = max(megabytes, 0);
+		}
+		else if (!strcmp(args[i], "-software"))
+		{
+			gameManager.options()->softwareRender = true;
+		}
+		else if (!strcmp(args[i], "-record") && (i + 1 < argc))
+		{
+			gameManager.options()->recordPath = args[++i];
+		}
+		else if (!strcmp(args[i], "-recordyuv"))
+		{
+			gameManager.options()->recordYUV = true;
+		}
+		else if (!strcmp(args[i], "-recordfps") && (i + 1 < argc))
+		{
+			int fps = atoi(args[++i]);
+			gameManager.options()->recordFPS = max(fps, 1);
+		}
+		else if (!strcmp(args[i], "-tables") && (i + 1 < argc))
+		{
+			gameManager.options()->tables = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-tablems") && (i + 1 < argc))
+		{
+			int ms = atoi(args[++i]);
+			gameManager.options()->tableMoveMs = max(ms, 0);
+		}
+		else if (!strcmp(args[i], "-tablepolicy") && (i + 1 < argc))
+		{
+			gameManager.options()->tablePolicy = args[++i];
+		}
+		else if (!strcmp(args[i], "-noodds"))
+		{
+			gameManager.options()->winOdds = false;
+		}
+		else if (!strcmp(args[i], "-alloccheck"))
+		{
+			gameManager.options()->allocCheck = true;
+		}
+		else if (!strcmp(args[i], "-renderbench"))
+		{
+			gameManager.options()->softwareRender = true;
+			gameManager.options()->renderBench = true;
+		}
+	}
+
+	/* The wall draws with the renderer, and nobody is playing for the odds or the drag check */
+	if (gameManager.options()->tables)
+	{
+		if (gameManager.options()->softwareRender || gameManager.options()->allocCheck)
+		{
+			printf("-software and -alloccheck don't apply to -tables.\n");
+		}
+		gameManager.options()->softwareRender = false;
+		gameManager.options()->allocCheck = false;
+		gameManager.options()->winOdds = false;
+	}
+
+	if (!gameManager.Init())
+	{
+		return EXIT_FAILED_INIT;
+	}
+
+	if (!gameManager.LoadMedia()) /* Load Media */
+	{
+		gameManager.Close(); /* Try to free resources and close SDL */
+		return EXIT_FAILED_FILES;
+	}
+
+	/* The Cards. The game owns them, so there is nothing to free. */
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		gameManager.newCard();
+	}
+
+	/* Initial layout should happen as soon as possible */
+	gameManager.computeCardPlaces();
+
+	/* Deal Cards */
+	gameManager.newGame(gameManager.chooseDealSeed(gameManager.options()->winnableOnly));
+
+	if (gameManager.options()->renderBench)
+	{
+		gameManager.benchmarkRenderers();
+		gameManager.Close();
+		return EXIT_SUCCESS;
+	}
+
+	/* The first frame needs something to draw straight away */
+	gameManager.publishSnapshot();
+
+	SDL_EventState(SDL_SYSWMEVENT, SDL_ENABLE); /* Allow standard window events to process */
+
+	/* -alloccheck lands the deal and drags the top card of the last pile */
+	bool allocCheck = gameManager.options()->allocCheck;
+	gameThreads threads;
+	threads.scriptedDrag = allocCheck;
+	threads.dragX = threads.dragY = threads.dragStep = 0;
+	if (allocCheck)
+	{
+		gameManager.moveCards(0);
+		gameManager.publishSnapshot();
+		Card* top = gameManager.getCard(CARD_RANKS - 1, gameManager.stackedCards(CARD_RANKS - 1) - 1);
+		threads.dragX = top->getX() + gameManager.getCardWidth() / 2;
+		threads.dragY = top->getY() + gameManager.getCardHeight() / 2;
+	}
+
+	/*
+		Hand the game over to the simulation thread. The main thread pumps events and draws,
+		since SDL only supports rendering on the thread that made the window and renderer.
+	*/
+	AllocationMeter simulationMeter("Simulation");
+	AllocationMeter renderMeter("Render");
+	threads.game = &gameManager;
+	threads.simulationMeter = &simulationMeter;
+	threads.renderMeter = &renderMeter;
+	threads.wall = NULL;
+	SDL_AtomicSet(&threads.quit, 0);
+	SDL_AtomicSet(&threads.steady, 0);
+
+	/* -tables plays a wall of bot games instead */
+	TableWall wall;
+	if (gameManager.options()->tables)
+	{
+		if (wall.init(gameManager, gameManager.options()->tables, gameManager.options()->tablePolicy, gameManager.options()->tableMoveMs))
+		{
+			threads.wall = &wall;
+		}
+		else
+		{
+			printf("The tables could not be dealt, so this is a normal game.\n");
 		}
-		Sleep(0);
 	}
+	SDL_Thread* simulationThread = SDL_CreateThread(threads.wall ? simulateTables : simulate, "Simulation", &threads);
+	if (!simulationThread)
+	{
+		printf("The simulation thread could not be started!\nSDL Error: %s\n", SDL_GetError());
+	}
+	else if (threads.wall)
+	{
+		renderTables(&threads);
+	}
+	else
+	{
+		render(&threads);
+	}
+
+	SDL_AtomicSet(&threads.quit, 1);
+	SDL_WaitThread(simulationThread, NULL);
+
+	int exitCode = EXIT_SUCCESS;
+	if (allocCheck)
+	{
+		simulationMeter.print();
+		renderMeter.print();
+		if (simulationMeter.getSteadyAllocations() || renderMeter.getSteadyAllocations())
+		{
+			printf("Steady frames allocated!\n");
+			exitCode = EXIT_ALLOCATIONS;
+		}
+	}
+
+	/* Every traced input is measured once, unless the game quit before a frame showed it */
+	if (simulationThread && !threads.wall && gameManager.options()->measureLatency)
+	{
+		threads.latency.print();
+		Uint32 traced = gameManager.tracedInputs();
+		Uint32 undrawn = gameManager.undrawnInputTraces();
+		if (threads.latency.getCount() + undrawn != traced)
+		{
+			printf("%u inputs were traced, but %u were measured and %u never shown!\n", traced, threads.latency.getCount(), undrawn);
+			exitCode = EXIT_LATENCY;
+		}
+	}
+
 	gameManager.Close(); /* Free resources and close SDL */
-	return EXIT_SUCCESS;
+	return exitCode;
 }
@@ -0,0 +1,473 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+#include "movelog.h"
+#include <cstring>
+
+#ifdef _WIN32
+#define seek64 _fseeki64
+#else
+#define seek64 fseeko
+#endif
+
+#define READ_SLACK 8 /* Unpacking reads whole 64-bit words */
+
+/* Bits needed to hold a value */
+int widthOf(uint32_t value)
+{
+	int width = 0;
+	while (value)
+	{
+		width++;
+		value >>= 1;
+	}
+	return width;
+}
+
+/* Small differences either way become small numbers */
+uint32_t zigzag(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+int32_t unzigzag(uint32_t value)
+{
+	return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/* Eight values of a fixed width fill exactly width bytes, so they come out of one word with constant shifts */
+template <int WIDTH, typename T>
+uint32_t unpackEights(const uint8_t* bytes, uint32_t base, uint32_t count, T* values)
+{
+	const uint64_t mask = ((uint64_t)1 << WIDTH) - 1;
+	uint32_t i = 0;
+	for (; i + 8 <= count; i += 8, bytes += WIDTH)
+	{
+		uint64_t word;
+		memcpy(&word, bytes, sizeof(word));
+		for (int j = 0; j < 8; j++)
+		{
+			values[i + j] = (T)(((word >> (j * WIDTH)) & mask) + base);
+		}
+	}
+	return i;
+}
+
+template <typename T>
+void unpack(const uint8_t* data, const moveLogStream& stream, uint32_t count, std::vector<T>& out)
+{
+	out.resize(count);
+	if (!count)
+	{
+		return;
+	}
+
+	/* A delta stream holds the differences after its first value, which is in the header */
+	uint32_t total = count;
+	if (stream.delta)
+	{
+		out[0] = (T)stream.first;
+		count--;
+	}
+	T* values = out.data() + (total - count);
+
+	if (!stream.width)
+	{
+		for (uint32_t i = 0; i < count; i++)
+		{
+			values[i] = (T)stream.base;
+		}
+	}
+	else
+	{
+		const uint8_t* bytes = data + stream.offset;
+
+		/* The narrow columns take the fast path, and whatever is left over the general one */
+		uint32_t done = 0;
+		switch (stream.width)
+		{
+		case 1: done = unpackEights<1>(bytes, stream.base, count, values); break;
+		case 2: done = unpackEights<2>(bytes, stream.base, count, values); break;
+		case 3: done = unpackEights<3>(bytes, stream.base, count, values); break;
+		case 4: done = unpackEights<4>(bytes, stream.base, count, values); break;
+		case 5: done = unpackEights<5>(bytes, stream.base, count, values); break;
+		case 6: done = unpackEights<6>(bytes, stream.base, count, values); break;
+		case 7: done = unpackEights<7>(bytes, stream.base, count, values); break;
+		case 8: done = unpackEights<8>(bytes, stream.base, count, values); break;
+		}
+
+		const uint64_t mask = ((uint64_t)1 << stream.width) - 1;
+		uint64_t bit = (uint64_t)done * stream.width;
+		for (uint32_t i = done; i < count; i++, bit += stream.width)
+		{
+			uint64_t word;
+			memcpy(&word, bytes + (bit >> 3), sizeof(word));
+			values[i] = (T)(((word >> (bit & 7)) & mask) + stream.base);
+		}
+	}
+
+	if (stream.delta)
+	{
+		uint32_t value = stream.first;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			value += (uint32_t)unzigzag((uint32_t)values[i]);
+			values[i] = (T)value;
+		}
+	}
+}
+
+/* Fits in the block, with enough bits for every value? Otherwise unpack would read past the data. */
+bool validStream(const moveLogStream& stream, uint32_t count, uint32_t blockBytes)
+{
+	if (stream.width > 32)
+	{
+		return false;
+	}
+	if ((uint64_t)stream.offset + stream.bytes > blockBytes)
+	{
+		return false;
+	}
+	uint32_t values = (stream.delta && count) ? count - 1 : count;
+	return stream.bytes >= ((uint64_t)values * stream.width + 7) / 8;
+}
+
+MoveLogWriter::MoveLogWriter()
+{
+	mFile = NULL;
+	mOffset = 0;
+	mInGame = false;
+	mLastTime = 0;
+	mGames =
+		mMoves = 0;
+}
+
+MoveLogWriter::~MoveLogWriter()
+{
+	close();
+}
+
+bool MoveLogWriter::open(const char* path)
+{
+	close();
+
+	mFile = fopen(path, "wb");
+	if (!mFile)
+	{
+		printf("Unable to create the move log %s!\n", path);
+		return false;
+	}
+
+	moveLogHeader header = { MOVE_LOG_MAGIC, MOVE_LOG_VERSION };
+	fwrite(&header, sizeof(header), 1, mFile);
+	mOffset = sizeof(header);
+	mGames =
+		mMoves = 0;
+	mIndex.clear();
+	for (int i = 0; i < NUM_LOG_STREAMS; i++)
+	{
+		mColumns[i].clear();
+	}
+	return true;
+}
+
+void MoveLogWriter::beginGame(uint32_t seed)
+{
+	if (mInGame)
+	{
+		endGame(false);
+	}
+	mColumns[LOG_SEEDS].push_back(seed);
+	mColumns[LOG_LENGTHS].push_back(0);
+	mInGame = true;
+	mLastTime = 0;
+}
+
+void MoveLogWriter::addMove(const klondikeMove& move, uint32_t timeMs)
+{
+	if (!mInGame)
+	{
+		return;
+	}
+	mColumns[LOG_KINDS].push_back(move.kind);
+	mColumns[LOG_FROMS].push_back(move.from);
+	mColumns[LOG_TOS].push_back(move.to);
+	mColumns[LOG_COUNTS].push_back(move.count);
+	mColumns[LOG_TIMES].push_back(timeMs - mLastTime);
+	mLastTime = timeMs;
+	mColumns[LOG_LENGTHS].back()++;
+}
+
+void MoveLogWriter::endGame(bool won)
+{
+	if (!mInGame)
+	{
+		return;
+	}
+	mColumns[LOG_WINS].push_back(won ? 1 : 0);
+	mInGame = false;
+
+	if ((mColumns[LOG_KINDS].size() >= MOVE_LOG_BLOCK_MOVES) || (mColumns[LOG_SEEDS].size() >= MOVE_LOG_BLOCK_GAMES))
+	{
+		flush();
+	}
+}
+
+void MoveLogWriter::writeStream(int stream, const uint32_t* values, uint32_t count, bool delta)
+{
+	moveLogStream& info = mBlock.streams[stream];
+	std::vector<uint32_t>& coded = mColumns[stream]; /* Coded in place, the block is going anyway */
+
+	/* The first value goes in the header, so it doesn't set the width of the differences after it */
+	info.first = 0;
+	if (delta && count)
+	{
+		uint32_t previous = values[0];
+		info.first = previous;
+		for (uint32_t i = 1; i < count; i++)
+		{
+			uint32_t value = values[i];
+			coded[i - 1] = zigzag((int32_t)(value - previous));
+			previous = value;
+		}
+		values = coded.data();
+		count--;
+	}
+
+	/* Frame of reference: everything relative to the smallest value */
+	uint32_t low = count ? values[0] : 0;
+	uint32_t high = low;
+	for (uint32_t i = 1; i < count; i++)
+	{
+		low = values[i] < low ? values[i] : low;
+		high = values[i] > high ? values[i] : high;
+	}
+
+	info.offset = (uint32_t)mData.size();
+	info.base = low;
+	info.width = (uint8_t)widthOf(high - low);
+	info.delta = delta ? 1 : 0;
+	info.reserved = 0;
+	info.bytes = (uint32_t)(((uint64_t)count * info.width + 7) / 8);
+
+	mData.resize(mData.size() + info.bytes, 0);
+	uint8_t* bytes = mData.data() + info.offset;
+	uint64_t bit = 0;
+	for (uint32_t i = 0; i < count; i++, bit += info.width)
+	{
+		uint64_t value = values[i] - low;
+		for (int b = 0; b < info.width; b += 8 - (int)((bit + b) & 7))
+		{
+			uint64_t at = bit + b;
+			bytes[at >> 3] |= (uint8_t)((value >> b) << (at & 7));
+		}
+	}
+}
+
+bool MoveLogWriter::flush()
+{
+	uint32_t games = (uint32_t)mColumns[LOG_SEEDS].size();
+	uint32_t moves = (uint32_t)mColumns[LOG_KINDS].size();
+	if (!mFile || !games)
+	{
+		return true;
+	}
+
+	memset(&mBlock, 0, sizeof(mBlock));
+	mBlock.games = games;
+	mBlock.moves = moves;
+	mData.clear();
+	for (int i = 0; i < NUM_LOG_STREAMS; i++)
+	{
+		writeStream(i, mColumns[i].data(), (uint32_t)mColumns[i].size(), i == LOG_SEEDS);
+	}
+	mBlock.bytes = (uint32_t)mData.size();
+
+	moveLogIndexEntry entry = { mOffset, mGames, mMoves, games, moves };
+	mIndex.push_back(entry);
+
+	bool success = fwrite(&mBlock, sizeof(mBlock), 1, mFile) == 1;
+	if (!mData.empty())
+	{
+		success &= fwrite(mData.data(), 1, mData.size(), mFile) == mData.size();
+	}
+	mOffset += sizeof(mBlock) + mData.size();
+	mGames += games;
+	mMoves += moves;
+
+	for (int i = 0; i < NUM_LOG_STREAMS; i++)
+	{
+		mColumns[i].clear();
+	}
+	if (!success)
+	{
+		printf("Unable to write to the move log!\n");
+	}
+	return success;
+}
+
+bool MoveLogWriter::close()
+{
+	if (!mFile)
+	{
+		return true;
+	}
+	endGame(false);
+	bool success = flush();
+
+	moveLogTrailer trailer = { mOffset, (uint32_t)mIndex.size(), MOVE_LOG_MAGIC };
+	if (!mIndex.empty())
+	{
+		success &= fwrite(mIndex.data(), sizeof(moveLogIndexEntry), mIndex.size(), mFile) == mIndex.size();
+	}
+	success &= fwrite(&trailer, sizeof(trailer), 1, mFile) == 1;
+	success &= fclose(mFile) == 0;
+	mFile = NULL;
+	if (!success)
+	{
+		printf("Unable to finish the move log!\n");
+	}
+	return success;
+}
+
+
+MoveLogReader::MoveLogReader()
+{
+	mFile = NULL;
+	memset(&mHeader, 0, sizeof(mHeader));
+	mNext = 0;
+}
+
+MoveLogReader::~MoveLogReader()
+{
+	close();
+}
+
+bool MoveLogReader::open(const char* path)
+{
+	close();
+
+	mFile = fopen(path, "rb");
+	if (!mFile)
+	{
+		printf("Unable to open the move log %s!\n", path);
+		return false;
+	}
+
+	moveLogHeader header;
+	moveLogTrailer trailer;
+	if ((fread(&header, sizeof(header), 1, mFile) != 1) || (header.magic != MOVE_LOG_MAGIC) ||
+		(header.version != MOVE_LOG_VERSION) ||
+		seek64(mFile, -(long)sizeof(trailer), SEEK_END) || (fread(&trailer, sizeof(trailer), 1, mFile) != 1) ||
+		(trailer.magic != MOVE_LOG_MAGIC))
+	{
+		printf("%s is not a finished move log this version can read!\n", path);
+		close();
+		return false;
+	}
+
+	mIndex.resize(trailer.blocks);
+	if (trailer.blocks && (seek64(mFile, trailer.indexOffset, SEEK_SET) ||
+		(fread(mIndex.data(), sizeof(moveLogIndexEntry), trailer.blocks, mFile) != trailer.blocks)))
+	{
+		printf("The index of %s could not be read!\n", path);
+		close();
+		return false;
+	}
+	mNext = 0;
+	return true;
+}
+
+void MoveLogReader::close()
+{
+	if (mFile)
+	{
+		fclose(mFile);
+		mFile = NULL;
+	}
+	mIndex.clear();
+	mNext = 0;
+}
+
+uint32_t MoveLogReader::blockOfGame(uint64_t game)
+{
+	uint32_t low = 0;
+	uint32_t high = blockCount();
+	while (high - low > 1)
+	{
+		uint32_t middle = (low + high) / 2;
+		if (mIndex[middle].firstGame <= game)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+bool MoveLogReader::readBlock(uint32_t i, moveLogBlock& block, uint32_t columns)
+{
+	if (!mFile || (i >= blockCount()))
+	{
+		return false;
+	}
+
+	moveLogBlockHeader& header = mHeader;
+	if (seek64(mFile, mIndex[i].offset, SEEK_SET) || (fread(&header, sizeof(header), 1, mFile) != 1))
+	{
+		printf("Block %u of the move log could not be read!\n", i);
+		return false;
+	}
+	mData.resize(header.bytes + READ_SLACK);
+	if (fread(mData.data(), 1, header.bytes, mFile) != header.bytes)
+	{
+		printf("Block %u of the move log is cut short!\n", i);
+		return false;
+	}
+
+	/* The games' streams come first, then the moves' */
+	for (int stream = 0; stream < NUM_LOG_STREAMS; stream++)
+	{
+		uint32_t count = (stream < LOG_KINDS) ? header.games : header.moves;
+		if (!validStream(header.streams[stream], count, header.bytes))
+		{
+			printf("Block %u of the move log has a damaged stream header!\n", i);
+			return false;
+		}
+	}
+
+	block.games = header.games;
+	block.moves = header.moves;
+	const uint8_t* data = mData.data();
+	if (columns & LOG_COLUMN(LOG_SEEDS))
+		unpack(data, header.streams[LOG_SEEDS], header.games, block.seeds);
+	if (columns & LOG_COLUMN(LOG_LENGTHS))
+		unpack(data, header.streams[LOG_LENGTHS], header.games, block.lengths);
+	if (columns & LOG_COLUMN(LOG_WINS))
+		unpack(data, header.streams[LOG_WINS], header.games, block.wins);
+	if (columns & LOG_COLUMN(LOG_KINDS))
+		unpack(data, header.streams[LOG_KINDS], header.moves, block.kinds);
+	if (columns & LOG_COLUMN(LOG_FROMS))
+		unpack(data, header.streams[LOG_FROMS], header.moves, block.froms);
+	if (columns & LOG_COLUMN(LOG_TOS))
+		unpack(data, header.streams[LOG_TOS], header.moves, block.tos);
+	if (columns & LOG_COLUMN(LOG_COUNTS))
+		unpack(data, header.streams[LOG_COUNTS], header.moves, block.counts);
+	if (columns & LOG_COLUMN(LOG_TIMES))
+		unpack(data, header.streams[LOG_TIMES], header.moves, block.times);
+	return true;
+}
+
+bool MoveLogReader::next(moveLogBlock& block, uint32_t columns)
+{
+	if (mNext >= blockCount())
+	{
+		return false;
+	}
+	return readBlock(mNext++, block, columns);
+}
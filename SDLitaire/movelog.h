@@ -0,0 +1,157 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _MOVELOG_H
+#define _MOVELOG_H
+
+/*
+	A columnar log of whole games, for analysing lots of them at once.
+
+	Games are grouped into blocks. Inside a block each field is its own stream,
+	stored as (value - base) in the fewest bits that hold the block's largest value.
+	Seeds are delta coded first, with the first seed kept in the stream's header,
+	so a run of consecutive seeds takes no space at all.
+	An index of the blocks at the end of the file lets a reader seek straight to one.
+
+	Layout, little-endian:
+		moveLogHeader
+		blocks: moveLogBlockHeader, then its streams
+		moveLogIndexEntry[blocks]
+		moveLogTrailer
+*/
+
+#include "klondike.h"
+#include <cstdio>
+#include <vector>
+
+#define MOVE_LOG_MAGIC 0x4C4D4C53 /* "SLML" */
+#define MOVE_LOG_VERSION 2
+#define MOVE_LOG_BLOCK_MOVES 65536 /* A block is written once it holds this many moves */
+#define MOVE_LOG_BLOCK_GAMES 4096 /* or this many games */
+
+/* The streams in a block, and bits for choosing which ones to decode */
+enum LOG_STREAMS
+{
+	LOG_SEEDS,
+	LOG_LENGTHS, /* Moves in each game */
+	LOG_WINS,
+	LOG_KINDS,
+	LOG_FROMS,
+	LOG_TOS,
+	LOG_COUNTS,
+	LOG_TIMES, /* Milliseconds since the game's previous move */
+	NUM_LOG_STREAMS
+};
+#define LOG_COLUMN(stream) (1u << (stream))
+#define LOG_ALL_COLUMNS ((1u << NUM_LOG_STREAMS) - 1)
+
+struct moveLogHeader
+{
+	uint32_t magic, version;
+};
+
+struct moveLogStream
+{
+	uint32_t offset, bytes; /* Within the block's data */
+	uint32_t base; /* Added back to every value */
+	uint8_t width; /* Bits per value */
+	uint8_t delta; /* Values are zigzagged differences from the one before, and there is one less of them */
+	uint16_t reserved;
+	uint32_t first; /* Delta streams start from this value */
+};
+
+struct moveLogBlockHeader
+{
+	uint32_t games, moves;
+	uint32_t bytes; /* Data after this header */
+	uint32_t reserved;
+	moveLogStream streams[NUM_LOG_STREAMS];
+};
+
+struct moveLogIndexEntry
+{
+	uint64_t offset; /* Of the block header */
+	uint64_t firstGame, firstMove;
+	uint32_t games, moves;
+};
+
+struct moveLogTrailer
+{
+	uint64_t indexOffset;
+	uint32_t blocks;
+	uint32_t magic;
+};
+
+/* One block's columns. Only the streams asked for are filled in. */
+struct moveLogBlock
+{
+	uint32_t games, moves;
+	std::vector<uint32_t> seeds, lengths, times;
+	std::vector<uint8_t> wins, kinds, froms, tos, counts;
+};
+
+class MoveLogWriter
+{
+public:
+	MoveLogWriter();
+	~MoveLogWriter();
+
+	bool open(const char* path);
+	bool isOpen() { return mFile != NULL; }
+
+	void beginGame(uint32_t seed);
+	/* timeMs is when the move happened, counted from any fixed point in the game */
+	void addMove(const klondikeMove& move, uint32_t timeMs);
+	void endGame(bool won);
+
+	/* Writes what is left and the index */
+	bool close();
+
+private:
+	bool flush();
+	void writeStream(int stream, const uint32_t* values, uint32_t count, bool delta);
+
+	FILE* mFile;
+	uint64_t mOffset; /* Bytes written so far */
+	bool mInGame;
+	uint32_t mLastTime;
+	uint64_t mGames, mMoves; /* Already written */
+	std::vector<uint32_t> mColumns[NUM_LOG_STREAMS];
+	std::vector<uint8_t> mData; /* The block being written */
+	moveLogBlockHeader mBlock;
+	std::vector<moveLogIndexEntry> mIndex;
+};
+
+class MoveLogReader
+{
+public:
+	MoveLogReader();
+	~MoveLogReader();
+
+	bool open(const char* path);
+	void close();
+
+	uint32_t blockCount() { return (uint32_t)mIndex.size(); }
+	const moveLogIndexEntry& blockInfo(uint32_t i) { return mIndex[i]; }
+	/* The block holding a game, by binary search of the index */
+	uint32_t blockOfGame(uint64_t game);
+
+	/* Decodes only the columns asked for */
+	bool readBlock(uint32_t i, moveLogBlock& block, uint32_t columns = LOG_ALL_COLUMNS);
+	/* Streams through the blocks in order. False at the end. */
+	bool next(moveLogBlock& block, uint32_t columns = LOG_ALL_COLUMNS);
+	void rewind() { mNext = 0; }
+
+	/* How a stream of the last block read was stored */
+	const moveLogStream& streamInfo(int stream) { return mHeader.streams[stream]; }
+
+private:
+	FILE* mFile;
+	moveLogBlockHeader mHeader; /* The last block read */
+	std::vector<moveLogIndexEntry> mIndex;
+	std::vector<uint8_t> mData; /* One block, with slack for 64-bit reads */
+	uint32_t mNext;
+};
+
+#endif /* _MOVELOG_H */
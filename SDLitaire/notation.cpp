@@ -0,0 +1,607 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+#include "notation.h"
+#include <cstring>
+
+#define WRITE_BUFFER_BYTES (1 << 16)
+#define READ_BUFFER_BYTES (1 << 20) /* Also the longest line a reader takes */
+
+static const char VALUE_CHARS[] = "A23456789TJQK";
+static const char SUIT_CHARS[] = "scdh"; /* In SUITS order */
+
+/* Characters to values and suits, plus one so that zero is neither. Lookups don't mispredict like a switch does. */
+struct cardChars
+{
+	uint8_t values[256];
+	uint8_t suits[256];
+
+	cardChars()
+	{
+		memset(values, 0, sizeof(values));
+		memset(suits, 0, sizeof(suits));
+		for (int i = 0; i < NUM_FACES; i++)
+		{
+			values[(uint8_t)VALUE_CHARS[i]] = (uint8_t)(i + 1);
+		}
+		for (int i = 0; i < NUM_SUITS; i++)
+		{
+			suits[(uint8_t)SUIT_CHARS[i]] = (uint8_t)(i + 1);
+		}
+	}
+};
+static const cardChars CARD_CHARS;
+
+static cardCode codeOfCard(int suit, int value)
+{
+	cardFace face = { suit, value };
+	return codeOf(face);
+}
+
+/* "-" when there are none */
+static char* writeCards(char* out, const Klondike& game, int rank, int first, int last)
+{
+	if (first >= last)
+	{
+		*out++ = '-';
+	}
+	for (int i = first; i < last; i++)
+	{
+		cardCode card = game.card(rank, i);
+		*out++ = VALUE_CHARS[valueOf(card) - 1];
+		*out++ = SUIT_CHARS[suitOf(card)];
+	}
+	return out;
+}
+
+int formatPosition(const Klondike& game, char text[POSITION_TEXT_MAX])
+{
+	char* out = text;
+	for (int rank = STOCK_RANK; rank <= WASTE_RANK; rank++)
+	{
+		out = writeCards(out, game, rank, 0, game.count(rank));
+		*out++ = ' ';
+	}
+
+	for (int i = 0; i < NUM_FOUNDATIONS; i++)
+	{
+		int rank = FIRST_FOUNDATION + i;
+		int count = game.count(rank);
+		out = writeCards(out, game, rank, count ? count - 1 : 0, count);
+		*out++ = (i + 1 < NUM_FOUNDATIONS) ? '/' : ' ';
+	}
+
+	for (int i = 0; i < NUM_TABLEAUS; i++)
+	{
+		int rank = FIRST_TABLEAU + i;
+		int count = game.count(rank);
+		int faceDown = game.faceDown(rank);
+		if (faceDown)
+		{
+			out = writeCards(out, game, rank, 0, faceDown);
+			*out++ = ':';
+		}
+		out = writeCards(out, game, rank, faceDown, count);
+		if (i + 1 < NUM_TABLEAUS)
+		{
+			*out++ = '/';
+		}
+	}
+	*out = 0;
+	return (int)(out - text);
+}
+
+/* Reads cards up to the next separator. "-" is an empty pile. */
+static bool readCards(const char*& p, const char* end, cardCode* cards, int& count, uint64_t& used, const char** error)
+{
+	count = 0;
+	if ((p < end) && (*p == '-'))
+	{
+		p++;
+		return true;
+	}
+	while ((p + 1 < end) && CARD_CHARS.values[(uint8_t)p[0]])
+	{
+		int value = CARD_CHARS.values[(uint8_t)p[0]];
+		int suit = CARD_CHARS.suits[(uint8_t)p[1]] - 1;
+		if (suit < 0)
+		{
+			*error = "a card's suit isn't one of s, c, d or h";
+			return false;
+		}
+		cardCode card = codeOfCard(suit, value);
+		if (used & (1ull << card))
+		{
+			*error = "a card is there twice";
+			return false;
+		}
+		used |= 1ull << card;
+		cards[count++] = card;
+		p += 2;
+	}
+	return true;
+}
+
+static bool expect(const char*& p, const char* end, char separator, const char** error)
+{
+	if ((p < end) && (*p == separator))
+	{
+		p++;
+		return true;
+	}
+	if (p >= end)
+	{
+		*error = "the line ends too soon";
+	}
+	else
+	{
+		*error = (separator == '/') ? "a pile has something other than cards in it" : "a field has something other than cards in it";
+	}
+	return false;
+}
+
+bool parsePosition(const char* text, const char* end, Klondike& game, const char** error)
+{
+	const char* newline = (const char*)memchr(text, '\n', end - text);
+	end = newline ? newline : end;
+	while ((end > text) && ((end[-1] == '\r') || (end[-1] == ' ') || (end[-1] == '\t')))
+	{
+		end--;
+	}
+
+	const char* p = text;
+	cardCode cards[NUM_CARDS];
+	int count;
+	uint64_t used = 0;
+
+	if (!readCards(p, end, cards, count, used, error) || !expect(p, end, ' ', error))
+	{
+		return false;
+	}
+	game.setPile(STOCK_RANK, cards, count, count);
+
+	if (!readCards(p, end, cards, count, used, error) || !expect(p, end, ' ', error))
+	{
+		return false;
+	}
+	game.setPile(WASTE_RANK, cards, count, 0);
+
+	/* The top card says the whole foundation */
+	for (int i = 0; i < NUM_FOUNDATIONS; i++)
+	{
+		uint64_t top = 0;
+		if (!readCards(p, end, cards, count, top, error) ||
+			!expect(p, end, (i + 1 < NUM_FOUNDATIONS) ? '/' : ' ', error))
+		{
+			return false;
+		}
+		if (count > 1)
+		{
+			*error = "a foundation has more than its top card";
+			return false;
+		}
+		int value = count ? valueOf(cards[0]) : 0;
+		int suit = count ? suitOf(cards[0]) : 0;
+		for (int j = 0; j < value; j++)
+		{
+			cards[j] = codeOfCard(suit, j + 1);
+			if (used & (1ull << cards[j]))
+			{
+				*error = "a card is there twice";
+				return false;
+			}
+			used |= 1ull << cards[j];
+		}
+		game.setPile(FIRST_FOUNDATION + i, cards, value, 0);
+	}
+
+	for (int i = 0; i < NUM_TABLEAUS; i++)
+	{
+		int faceDown = 0;
+		if (!readCards(p, end, cards, count, used, error))
+		{
+			return false;
+		}
+		if ((p < end) && (*p == ':'))
+		{
+			p++;
+			faceDown = count;
+			int faceUp;
+			if (!readCards(p, end, cards + faceDown, faceUp, used, error))
+			{
+				return false;
+			}
+			count += faceUp;
+		}
+		if ((i + 1 < NUM_TABLEAUS) && !expect(p, end, '/', error))
+		{
+			return false;
+		}
+		game.setPile(FIRST_TABLEAU + i, cards, count, faceDown);
+	}
+
+	if (p != end)
+	{
+		*error = "there is more after the seventh column";
+		return false;
+	}
+	if (used != (1ull << NUM_CARDS) - 1)
+	{
+		*error = "some cards are missing";
+		return false;
+	}
+	return true;
+}
+
+void packPosition(const Klondike& game, positionRecord& record)
+{
+	memset(&record, 0, sizeof(record));
+	int n = 0;
+	for (int rank = 0; rank < CARD_RANKS; rank++)
+	{
+		int count = game.count(rank);
+		if (!count)
+		{
+			record.emptySlots |= (uint16_t)(1 << rank);
+			continue;
+		}
+		for (int j = 0; (j < count) && (n < NUM_CARDS); j++)
+		{
+			record.cards[n++] = game.card(rank, j) |
+				(j < game.faceDown(rank) ? POSITION_FACE_DOWN : 0) |
+				(j == count - 1 ? POSITION_PILE_END : 0);
+		}
+	}
+}
+
+bool unpackPosition(const positionRecord& record, Klondike& game, const char** error)
+{
+	cardCode cards[NUM_CARDS];
+	uint64_t used = 0;
+	int n = 0;
+	for (int rank = 0; rank < CARD_RANKS; rank++)
+	{
+		int count = 0;
+		int faceDown = 0;
+		bool ended = (record.emptySlots & (1 << rank)) != 0;
+		while (!ended)
+		{
+			if (n >= NUM_CARDS)
+			{
+				*error = "a pile runs past the last card";
+				return false;
+			}
+			uint8_t packed = record.cards[n++];
+			cardCode card = packed & POSITION_CARD_MASK;
+			if ((card >= NUM_CARDS) || (used & (1ull << card)))
+			{
+				*error = (card >= NUM_CARDS) ? "a card isn't one of the 52" : "a card is there twice";
+				return false;
+			}
+			used |= 1ull << card;
+
+			/* Face-down cards are only ever under the face-up ones */
+			if (packed & POSITION_FACE_DOWN)
+			{
+				if (faceDown != count)
+				{
+					*error = "a face-down card is on a face-up one";
+					return false;
+				}
+				faceDown++;
+			}
+
+			/* Foundations go up from the ace in one suit */
+			if ((rank >= FIRST_FOUNDATION) && (rank < FIRST_TABLEAU) &&
+				((valueOf(card) != count + 1) || (count && (suitOf(card) != suitOf(cards[0])))))
+			{
+				*error = "a foundation is out of order";
+				return false;
+			}
+			cards[count++] = card;
+			ended = (packed & POSITION_PILE_END) != 0;
+		}
+		if (faceDown && (rank != STOCK_RANK) && (rank < FIRST_TABLEAU))
+		{
+			*error = "only the stock and the columns have face-down cards";
+			return false;
+		}
+		game.setPile(rank, cards, count, faceDown);
+	}
+	if (used != (1ull << NUM_CARDS) - 1)
+	{
+		*error = "some cards are missing";
+		return false;
+	}
+	return true;
+}
+
+
+PositionWriter::PositionWriter()
+{
+	mFile = NULL;
+	mBinary = false;
+	mFailed = false;
+	mUsed = 0;
+	mCount = 0;
+}
+
+PositionWriter::~PositionWriter()
+{
+	close();
+}
+
+bool PositionWriter::open(const char* path, bool binary)
+{
+	close();
+
+	mFile = fopen(path, "wb");
+	if (!mFile)
+	{
+		printf("Unable to create the position file %s!\n", path);
+		return false;
+	}
+	mBinary = binary;
+	mFailed = false;
+	mBuffer.resize(WRITE_BUFFER_BYTES);
+	mUsed = 0;
+	mCount = 0;
+
+	if (mBinary)
+	{
+		positionFileHeader header = { POSITION_MAGIC, POSITION_VERSION, sizeof(positionRecord), 0 };
+		memcpy(mBuffer.data(), &header, sizeof(header));
+		mUsed = sizeof(header);
+	}
+	return true;
+}
+
+bool PositionWriter::write(const Klondike& game)
+{
+	if (!mFile)
+	{
+		return false;
+	}
+	if ((mUsed + POSITION_TEXT_MAX > mBuffer.size()) && !flush())
+	{
+		return false;
+	}
+
+	if (mBinary)
+	{
+		positionRecord record;
+		packPosition(game, record);
+		memcpy(mBuffer.data() + mUsed, &record, sizeof(record));
+		mUsed += sizeof(record);
+	}
+	else
+	{
+		mUsed += formatPosition(game, mBuffer.data() + mUsed);
+		mBuffer[mUsed++] = '\n';
+	}
+	mCount++;
+	return true;
+}
+
+bool PositionWriter::comment(const char* text)
+{
+	if (!mFile || mBinary)
+	{
+		return mFile != NULL;
+	}
+	size_t length = strlen(text);
+	if ((mUsed + length + 3 > mBuffer.size()) && !flush())
+	{
+		return false;
+	}
+	if (length + 3 > mBuffer.size())
+	{
+		return false;
+	}
+	mBuffer[mUsed++] = '#';
+	mBuffer[mUsed++] = ' ';
+	memcpy(mBuffer.data() + mUsed, text, length);
+	mUsed += length;
+	mBuffer[mUsed++] = '\n';
+	return true;
+}
+
+bool PositionWriter::flush()
+{
+	if (mUsed && (fwrite(mBuffer.data(), 1, mUsed, mFile) != mUsed))
+	{
+		mFailed = true;
+	}
+	mUsed = 0;
+	return !mFailed;
+}
+
+bool PositionWriter::close()
+{
+	if (!mFile)
+	{
+		return true;
+	}
+	flush();
+	mFailed |= fclose(mFile) != 0;
+	mFile = NULL;
+	mBuffer.clear();
+	mBuffer.shrink_to_fit();
+	return !mFailed;
+}
+
+
+PositionReader::PositionReader()
+{
+	mFile = NULL;
+	mBinary = false;
+	mStart =
+		mEnd = 0;
+	mEnded = false;
+	mLine = 0;
+	mCount = 0;
+	mError[0] = 0;
+}
+
+PositionReader::~PositionReader()
+{
+	close();
+}
+
+bool PositionReader::open(const char* path)
+{
+	close();
+
+	mFile = fopen(path, "rb");
+	if (!mFile)
+	{
+		printf("Unable to open the position file %s!\n", path);
+		return false;
+	}
+	mBuffer.resize(READ_BUFFER_BYTES);
+	mStart =
+		mEnd = 0;
+	mEnded = false;
+	mLine = 0;
+	mCount = 0;
+	mError[0] = 0;
+	fill();
+
+	positionFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(&header, mBuffer.data(), mEnd < sizeof(header) ? mEnd : sizeof(header));
+	mBinary = header.magic == POSITION_MAGIC;
+	if (mBinary)
+	{
+		if ((header.version != POSITION_VERSION) || (header.recordBytes != sizeof(positionRecord)))
+		{
+			printf("%s is a version %u position file with %u byte records. Only version %i with %i byte records can be read.\n",
+				path, header.version, header.recordBytes, POSITION_VERSION, (int)sizeof(positionRecord));
+			close();
+			return false;
+		}
+		mStart = sizeof(header);
+	}
+	return true;
+}
+
+void PositionReader::close()
+{
+	if (mFile)
+	{
+		fclose(mFile);
+		mFile = NULL;
+	}
+	mBuffer.clear();
+	mBuffer.shrink_to_fit();
+}
+
+bool PositionReader::fill()
+{
+	if (mEnded)
+	{
+		return false;
+	}
+	if (mStart)
+	{
+		memmove(mBuffer.data(), mBuffer.data() + mStart, mEnd - mStart);
+		mEnd -= mStart;
+		mStart = 0;
+	}
+	size_t got = fread(mBuffer.data() + mEnd, 1, mBuffer.size() - mEnd, mFile);
+	mEnd += got;
+	mEnded = got == 0;
+	return got != 0;
+}
+
+void PositionReader::fail(const char* error)
+{
+	snprintf(mError, sizeof(mError), "%s %llu: %s", mBinary ? "Record" : "Line",
+		(unsigned long long)(mBinary ? mCount + 1 : mLine), error);
+}
+
+bool PositionReader::next(Klondike& game)
+{
+	if (!mFile || mError[0])
+	{
+		return false;
+	}
+	const char* error = NULL;
+
+	if (mBinary)
+	{
+		if (mEnd - mStart < sizeof(positionRecord))
+		{
+			fill();
+		}
+		if (mEnd - mStart < sizeof(positionRecord))
+		{
+			if (mEnd != mStart)
+			{
+				fail("the file ends partway through it");
+			}
+			return false;
+		}
+		positionRecord record;
+		memcpy(&record, mBuffer.data() + mStart, sizeof(record));
+		mStart += sizeof(record);
+		if (!unpackPosition(record, game, &error))
+		{
+			fail(error);
+			return false;
+		}
+		mCount++;
+		return true;
+	}
+
+	for (;;)
+	{
+		const char* line = mBuffer.data() + mStart;
+		const char* newline = (const char*)memchr(line, '\n', mEnd - mStart);
+		if (!newline)
+		{
+			if (mStart || (mEnd < mBuffer.size()))
+			{
+				if (fill())
+				{
+					continue;
+				}
+			}
+			else
+			{
+				mLine++;
+				fail("the line is too long");
+				return false;
+			}
+			if (mStart == mEnd)
+			{
+				return false;
+			}
+			newline = mBuffer.data() + mEnd; /* The last line has no newline */
+		}
+		mLine++;
+		size_t next = newline - mBuffer.data() + 1;
+		mStart = next < mEnd ? next : mEnd;
+
+		/* Comments and blank lines */
+		const char* p = line;
+		while ((p < newline) && ((*p == ' ') || (*p == '\t') || (*p == '\r')))
+		{
+			p++;
+		}
+		if ((p == newline) || (*p == '#'))
+		{
+			continue;
+		}
+
+		if (!parsePosition(p, newline, game, &error))
+		{
+			fail(error);
+			return false;
+		}
+		mCount++;
+		return true;
+	}
+}
@@ -0,0 +1,131 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _NOTATION_H
+#define _NOTATION_H
+
+/*
+	Klondike positions written down, for trading deal sets with other solvers
+	and loading test corpora in bulk. Like FEN for chess, one line is one position.
+	Nothing in here needs SDL, and nothing allocates per position.
+
+	Text, four fields separated by spaces:
+		stock waste foundations columns
+	A card is its value, A 2-9 T J Q K, then its suit, s c d h, so "Td" is the ten of diamonds.
+	A pile is its cards bottom to top, or "-" when it is empty.
+	The stock is face-down and the waste face-up.
+	The four foundations and the seven columns are each separated by '/'.
+	A foundation is only its top card, since everything under it follows from that.
+	A column's face-down cards come before a ':' and its face-up cards after it.
+	A column with no ':' is all face-up.
+	Blank lines and lines starting with '#' are skipped.
+
+	Binary, little-endian: positionFileHeader, then positionRecords.
+*/
+
+#include "klondike.h"
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#define POSITION_MAGIC 0x4E504C53 /* "SLPN" */
+#define POSITION_VERSION 1
+#define POSITION_TEXT_MAX 160 /* The longest line, with its newline and a NUL */
+
+/* The high bits of each byte in positionRecord::cards */
+#define POSITION_FACE_DOWN 0x40
+#define POSITION_PILE_END 0x80 /* The pile's top card */
+#define POSITION_CARD_MASK 0x3F
+
+struct positionFileHeader
+{
+	uint32_t magic, version;
+	uint32_t recordBytes; /* sizeof(positionRecord) */
+	uint32_t reserved;
+};
+
+/* Every card, slot by slot, bottom to top. Empty slots have no cards, so they get a bit instead. */
+struct positionRecord
+{
+	uint8_t cards[NUM_CARDS]; /* A cardCode and the flags above */
+	uint16_t emptySlots; /* 1 << rank for each empty slot */
+	uint16_t reserved;
+};
+
+/* Writes a line, without its newline, into text. Returns its length. */
+int formatPosition(const Klondike& game, char text[POSITION_TEXT_MAX]);
+
+/*
+	Reads a line, which ends at end or at its newline. On failure game is left half set
+	and error says what was wrong. Doesn't check the position can be reached by playing.
+*/
+bool parsePosition(const char* text, const char* end, Klondike& game, const char** error);
+
+void packPosition(const Klondike& game, positionRecord& record);
+bool unpackPosition(const positionRecord& record, Klondike& game, const char** error);
+
+/* Streams positions to a file, through a buffer */
+class PositionWriter
+{
+public:
+	PositionWriter();
+	~PositionWriter();
+
+	bool open(const char* path, bool binary);
+	bool isOpen() { return mFile != NULL; }
+
+	bool write(const Klondike& game);
+	/* With a # in front, for text files. Binary files skip it. */
+	bool comment(const char* text);
+
+	/* Writes what is buffered. False if anything failed to write. */
+	bool close();
+
+	uint64_t getCount() { return mCount; }
+
+private:
+	bool flush();
+
+	FILE* mFile;
+	bool mBinary;
+	bool mFailed;
+	std::vector<char> mBuffer;
+	size_t mUsed;
+	uint64_t mCount;
+};
+
+/* Streams positions from a file written either way */
+class PositionReader
+{
+public:
+	PositionReader();
+	~PositionReader();
+
+	/* Tells text from binary by the header */
+	bool open(const char* path);
+	void close();
+	bool isBinary() { return mBinary; }
+
+	/* The next position. False at the end, or at a bad position, which getError describes. */
+	bool next(Klondike& game);
+	const char* getError() { return mError[0] ? mError : NULL; }
+
+	uint64_t getCount() { return mCount; }
+
+private:
+	/* Moves what is left to the front and reads more after it. False when nothing more came. */
+	bool fill();
+	void fail(const char* error);
+
+	FILE* mFile;
+	bool mBinary;
+	std::vector<char> mBuffer;
+	size_t mStart, mEnd; /* Read but not yet parsed */
+	bool mEnded; /* Nothing more in the file */
+	uint64_t mLine; /* Of the text just parsed */
+	uint64_t mCount;
+	char mError[128];
+};
+
+#endif /* _NOTATION_H */
@@ -0,0 +1,190 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+#include "policy.h"
+#include <cstring>
+
+const char* policyNames[] = { "greedy", "foundation-first", "random-legal", NULL };
+
+/* Moves that can never help: shuffling runs between tableaus without turning anything over */
+bool isIdle(const Klondike& game, const klondikeMove& move)
+{
+	if (move.kind != MOVE_CARDS)
+	{
+		return false;
+	}
+	if ((move.from >= FIRST_FOUNDATION) && (move.from < FIRST_TABLEAU))
+	{
+		return true; /* Foundation cards only come back down when a solver says so */
+	}
+	if ((move.from >= FIRST_TABLEAU) && (move.to >= FIRST_TABLEAU))
+	{
+		/* A run that leaves an empty tableau behind is only useful for a king */
+		return !game.reveals(move) && (move.count != game.count(move.from) || !game.faceDown(move.from));
+	}
+	return false;
+}
+
+int RandomPolicy::choose(const Klondike& /* game */, const klondikeMove* /* moves */, int count, Random& random)
+{
+	return count ? (int)random.below(count) : -1;
+}
+
+int FoundationFirstPolicy::choose(const Klondike& game, const klondikeMove* moves, int count, Random& /* random */)
+{
+	int best = -1;
+	int bestTier = 0;
+	for (int i = 0; i < count; i++)
+	{
+		const klondikeMove& move = moves[i];
+		int tier = 0;
+		if (isIdle(game, move))
+		{
+			continue;
+		}
+		else if (move.kind == MOVE_CARDS && move.to < FIRST_TABLEAU)
+		{
+			tier = 5;
+		}
+		else if (game.reveals(move))
+		{
+			tier = 4;
+		}
+		else if (move.kind == MOVE_CARDS && move.from == WASTE_RANK)
+		{
+			tier = 3;
+		}
+		else if (move.kind == MOVE_DRAW)
+		{
+			tier = 2;
+		}
+		else
+		{
+			tier = 1;
+		}
+
+		if (tier > bestTier)
+		{
+			best = i;
+			bestTier = tier;
+		}
+	}
+	return best;
+}
+
+int GreedyPolicy::choose(const Klondike& game, const klondikeMove* moves, int count, Random& random)
+{
+	int best = -1;
+	int bestScore = 0;
+	int ties = 0;
+	for (int i = 0; i < count; i++)
+	{
+		const klondikeMove& move = moves[i];
+		if (isIdle(game, move))
+		{
+			continue;
+		}
+
+		int score = 1; /* Drawing and recycling */
+		if (move.kind == MOVE_CARDS)
+		{
+			/* Hidden cards are worth the most, then foundation progress, then emptying the waste */
+			score = 20;
+			if (game.reveals(move))
+			{
+				score += 100 + 10 * game.faceDown(move.from);
+			}
+			if (move.to < FIRST_TABLEAU)
+			{
+				score += 50;
+			}
+			if (move.from == WASTE_RANK)
+			{
+				score += 10;
+			}
+		}
+
+		/* Break ties at random so the policy doesn't always favor the left */
+		if (score > bestScore)
+		{
+			best = i;
+			bestScore = score;
+			ties = 1;
+		}
+		else if ((score == bestScore) && !random.below(++ties))
+		{
+			best = i;
+		}
+	}
+	return best;
+}
+
+Policy* createPolicy(const char* name)
+{
+	if (!strcmp(name, "greedy"))
+	{
+		return new GreedyPolicy;
+	}
+	if (!strcmp(name, "foundation-first"))
+	{
+		return new FoundationFirstPolicy;
+	}
+	if (!strcmp(name, "random-legal"))
+	{
+		return new RandomPolicy;
+	}
+	return NULL;
+}
+
+bool playMove(Klondike& game, Policy& policy, Random& random, bool& progress, klondikeMove* played)
+{
+	if (game.isWon())
+	{
+		return false;
+	}
+
+	klondikeMove moves[MAX_LEGAL_MOVES];
+	int count = game.legalMoves(moves);
+	int choice = policy.choose(game, moves, count, random);
+	if (choice < 0)
+	{
+		return false;
+	}
+
+	const klondikeMove& move = moves[choice];
+	if (move.kind == MOVE_RECYCLE)
+	{
+		if (!progress)
+		{
+			return false;
+		}
+		progress = false;
+	}
+	else if (move.kind == MOVE_CARDS)
+	{
+		progress = true;
+	}
+	if (played)
+	{
+		*played = move;
+	}
+	game.apply(move);
+	return true;
+}
+
+bool playGame(Klondike& game, Policy& policy, Random& random, int maxMoves, std::vector<klondikeMove>* played)
+{
+	bool progress = true; /* Something happened since the last recycle */
+	klondikeMove move;
+
+	while ((game.getMoves() < maxMoves) && playMove(game, policy, random, progress, &move))
+	{
+		if (played)
+		{
+			played->push_back(move);
+		}
+	}
+	return game.isWon();
+}
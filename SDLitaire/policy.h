@@ -0,0 +1,68 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _POLICY_H
+#define _POLICY_H
+
+#include "klondike.h"
+#include <cstddef>
+#include <vector>
+
+/* How an automated player picks its moves */
+class Policy
+{
+public:
+	virtual ~Policy() {}
+
+	virtual const char* name() = 0;
+
+	/* Returns an index into moves, or -1 to give up */
+	virtual int choose(const Klondike& game, const klondikeMove* moves, int count, Random& random) = 0;
+};
+
+/* Any legal move at all */
+class RandomPolicy : public Policy
+{
+public:
+	const char* name() { return "random-legal"; }
+	int choose(const Klondike& game, const klondikeMove* moves, int count, Random& random);
+};
+
+/* Foundations first, then turning cards over, then the waste, then the stock */
+class FoundationFirstPolicy : public Policy
+{
+public:
+	const char* name() { return "foundation-first"; }
+	int choose(const Klondike& game, const klondikeMove* moves, int count, Random& random);
+};
+
+/* Scores every move on what it uncovers and takes the best one */
+class GreedyPolicy : public Policy
+{
+public:
+	const char* name() { return "greedy"; }
+	int choose(const Klondike& game, const klondikeMove* moves, int count, Random& random);
+};
+
+/* Makes a policy from its name. Returns NULL for unknown names. */
+Policy* createPolicy(const char* name);
+
+/* The names createPolicy knows, ending with NULL */
+extern const char* policyNames[];
+
+/*
+	Plays one move, or returns false when the game is won or stuck.
+	progress says whether a card has moved since the stock was last recycled.
+	It starts out true, and a recycle with nothing since is stuck.
+*/
+bool playMove(Klondike& game, Policy& policy, Random& random, bool& progress, klondikeMove* played = NULL);
+
+/*
+	Plays until the game is won, stuck or out of moves.
+	A game is stuck when the stock is recycled without anything happening since the last time.
+	Every move played is appended to played, if there is one.
+*/
+bool playGame(Klondike& game, Policy& policy, Random& random, int maxMoves, std::vector<klondikeMove>* played = NULL);
+
+#endif /* _POLICY_H */
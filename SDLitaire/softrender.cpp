@@ -0,0 +1,717 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+#include "softrender.h"
+#include <cstring>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SOFT_AVX2
+#define SOFT_SSE2
+#elif defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SOFT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SOFT_NEON
+#endif
+
+#define SCALE_BAND 16 /* Rows of a scaled image per job */
+
+/* The smallest rectangle holding both */
+static softRect unite(const softRect& a, const softRect& b)
+{
+	int right = a.x + a.w > b.x + b.w ? a.x + a.w : b.x + b.w;
+	int bottom = a.y + a.h > b.y + b.h ? a.y + a.h : b.y + b.h;
+	softRect both = { a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, 0, 0 };
+	both.w = right - both.x;
+	both.h = bottom - both.y;
+	return both;
+}
+
+void DamageList::reset(int width, int height)
+{
+	mWidth = width;
+	mHeight = height;
+	mCount = 0;
+	mAll = false;
+}
+
+void DamageList::add(int x, int y, int w, int h)
+{
+	if (mAll)
+	{
+		return;
+	}
+	int right = x + w < mWidth ? x + w : mWidth;
+	int bottom = y + h < mHeight ? y + h : mHeight;
+	x = x > 0 ? x : 0;
+	y = y > 0 ? y : 0;
+	if ((x >= right) || (y >= bottom))
+	{
+		return;
+	}
+	softRect added = { x, y, right - x, bottom - y };
+
+	/* Swallow whatever it touches, and start over since it grew */
+	for (int i = 0; i < mCount; i++)
+	{
+		softRect& r = mRects[i];
+		if ((r.x > added.x + added.w) || (added.x > r.x + r.w) || (r.y > added.y + added.h) || (added.y > r.y + r.h))
+		{
+			continue;
+		}
+		added = unite(r, added);
+		mRects[i] = mRects[--mCount];
+		i = -1;
+	}
+
+	/* Out of room, so it joins whichever rectangle grows least */
+	if (mCount == MAX_RECTS)
+	{
+		int best = 0;
+		int64_t bestGrowth = -1;
+		for (int i = 0; i < mCount; i++)
+		{
+			softRect both = unite(mRects[i], added);
+			int64_t growth = (int64_t)both.w * both.h - (int64_t)mRects[i].w * mRects[i].h;
+			if ((bestGrowth < 0) || (growth < bestGrowth))
+			{
+				best = i;
+				bestGrowth = growth;
+			}
+		}
+		softRect both = unite(mRects[best], added);
+		mRects[best] = mRects[--mCount];
+		add(both.x, both.y, both.w, both.h); /* It may touch others now */
+		return;
+	}
+	mRects[mCount++] = added;
+
+	/* Past three quarters of the frame, the bookkeeping costs more than it saves */
+	if (getArea() * 4 > (int64_t)mWidth * mHeight * 3)
+	{
+		addAll();
+	}
+}
+
+void DamageList::addAll()
+{
+	mAll = true;
+	mCount = 1;
+	softRect all = { 0, 0, mWidth, mHeight };
+	mRects[0] = all;
+}
+
+int64_t DamageList::getArea() const
+{
+	int64_t area = 0;
+	for (int i = 0; i < mCount; i++)
+	{
+		area += (int64_t)mRects[i].w * mRects[i].h;
+	}
+	return area;
+}
+
+void classifyImage(softImage& image)
+{
+	image.spans.resize(image.height * 4);
+	image.opaque = true;
+	for (int y = 0; y < image.height; y++)
+	{
+		const uint32_t* row = &image.pixels[y * image.width];
+		int start = 0, end = image.width;
+		while ((start < end) && !(row[start] >> 24))
+		{
+			start++;
+		}
+		while ((end > start) && !(row[end - 1] >> 24))
+		{
+			end--;
+		}
+
+		/* The longest solid run */
+		int opaqueStart = start, opaqueEnd = start;
+		for (int x = start; x < end; )
+		{
+			if ((row[x] >> 24) != 0xFF)
+			{
+				x++;
+				continue;
+			}
+			int run = x;
+			while ((run < end) && ((row[run] >> 24) == 0xFF))
+			{
+				run++;
+			}
+			if (run - x > opaqueEnd - opaqueStart)
+			{
+				opaqueStart = x;
+				opaqueEnd = run;
+			}
+			x = run;
+		}
+
+		int* span = &image.spans[y * 4];
+		span[0] = start;
+		span[1] = end;
+		span[2] = opaqueStart;
+		span[3] = opaqueEnd;
+		image.opaque = image.opaque && (opaqueStart == 0) && (opaqueEnd == image.width);
+	}
+}
+
+void boxDownsample(const uint32_t* src, int srcPitch, uint32_t* dst, int dstPitch, int dstW, int dstH)
+{
+	for (int y = 0; y < dstH; y++)
+	{
+		const uint32_t* row0 = (const uint32_t*)((const uint8_t*)src + (y * 2) * srcPitch);
+		const uint32_t* row1 = (const uint32_t*)((const uint8_t*)src + (y * 2 + 1) * srcPitch);
+		uint32_t* out = (uint32_t*)((uint8_t*)dst + y * dstPitch);
+		int x = 0;
+
+#ifdef SOFT_SSE2
+		/* Eight source pixels make four destination pixels */
+		for (; x + 4 <= dstW; x += 4)
+		{
+			__m128i a = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(row0 + x * 2)),
+				_mm_loadu_si128((const __m128i*)(row1 + x * 2)));
+			__m128i b = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(row0 + x * 2 + 4)),
+				_mm_loadu_si128((const __m128i*)(row1 + x * 2 + 4)));
+			__m128i even = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0)));
+			__m128i odd = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1)));
+			_mm_storeu_si128((__m128i*)(out + x), _mm_avg_epu8(even, odd));
+		}
+#endif
+
+		for (; x < dstW; x++)
+		{
+			uint32_t p[4] = { row0[x * 2], row0[x * 2 + 1], row1[x * 2], row1[x * 2 + 1] };
+			uint32_t pixel = 0;
+			for (int shift = 0; shift < 32; shift += 8)
+			{
+				uint32_t sum = 2;
+				for (int i = 0; i < 4; i++)
+				{
+					sum += (p[i] >> shift) & 0xFF;
+				}
+				pixel |= (sum / 4) << shift;
+			}
+			out[x] = pixel;
+		}
+	}
+}
+
+/* One pixel, with the exact rounded division by 255 the vector kernels use */
+inline uint32_t blendPixel(uint32_t dst, uint32_t src)
+{
+	uint32_t inverse = 0xFF - (src >> 24);
+	uint32_t rb = (dst & 0x00FF00FF) * inverse + 0x00800080;
+	uint32_t ag = ((dst >> 8) & 0x00FF00FF) * inverse + 0x00800080;
+	rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+	ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+	return src + (rb | ag);
+}
+
+#ifdef SOFT_SSE2
+/* Two pixels widened to 16 bits a channel */
+inline __m128i blendHalf(__m128i dst, __m128i alpha)
+{
+	__m128i inverse = _mm_sub_epi16(_mm_set1_epi16(0xFF), alpha);
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(dst, inverse), _mm_set1_epi16(0x80));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+inline __m128i blend4(__m128i dst, __m128i src)
+{
+	__m128i zero = _mm_setzero_si128();
+	__m128i alpha = _mm_srli_epi32(src, 24);
+	alpha = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 16)); /* Alpha in both halves of each pixel */
+	__m128i low = blendHalf(_mm_unpacklo_epi8(dst, zero), _mm_unpacklo_epi32(alpha, alpha));
+	__m128i high = blendHalf(_mm_unpackhi_epi8(dst, zero), _mm_unpackhi_epi32(alpha, alpha));
+	return _mm_adds_epu8(src, _mm_packus_epi16(low, high));
+}
+#endif
+
+#ifdef SOFT_AVX2
+inline __m256i blendHalf8(__m256i dst, __m256i alpha)
+{
+	__m256i inverse = _mm256_sub_epi16(_mm256_set1_epi16(0xFF), alpha);
+	__m256i t = _mm256_add_epi16(_mm256_mullo_epi16(dst, inverse), _mm256_set1_epi16(0x80));
+	return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+/* Every step stays inside its 128-bit lane, so the pack puts pixels back where they were */
+inline __m256i blend8(__m256i dst, __m256i src)
+{
+	__m256i zero = _mm256_setzero_si256();
+	__m256i alpha = _mm256_srli_epi32(src, 24);
+	alpha = _mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 16));
+	__m256i low = blendHalf8(_mm256_unpacklo_epi8(dst, zero), _mm256_unpacklo_epi32(alpha, alpha));
+	__m256i high = blendHalf8(_mm256_unpackhi_epi8(dst, zero), _mm256_unpackhi_epi32(alpha, alpha));
+	return _mm256_adds_epu8(src, _mm256_packus_epi16(low, high));
+}
+#endif
+
+void blendRow(uint32_t* dst, const uint32_t* src, int count)
+{
+	int x = 0;
+
+#if defined(SOFT_AVX2)
+	const __m256i alphaBits = _mm256_set1_epi32((int)0xFF000000);
+	for (; x + 8 <= count; x += 8)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*)(src + x));
+		__m256i alpha = _mm256_and_si256(s, alphaBits);
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, _mm256_setzero_si256())) == -1)
+		{
+			continue; /* All clear, like color-keyed pixels */
+		}
+		if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(alpha, alphaBits)) == -1)
+		{
+			_mm256_storeu_si256((__m256i*)(dst + x), s);
+			continue;
+		}
+		__m256i d = _mm256_loadu_si256((const __m256i*)(dst + x));
+		_mm256_storeu_si256((__m256i*)(dst + x), blend8(d, s));
+	}
+#elif defined(SOFT_SSE2)
+	const __m128i alphaBits = _mm_set1_epi32((int)0xFF000000);
+	for (; x + 4 <= count; x += 4)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(src + x));
+		__m128i alpha = _mm_and_si128(s, alphaBits);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, _mm_setzero_si128())) == 0xFFFF)
+		{
+			continue; /* All clear, like color-keyed pixels */
+		}
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaBits)) == 0xFFFF)
+		{
+			_mm_storeu_si128((__m128i*)(dst + x), s);
+			continue;
+		}
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + x));
+		_mm_storeu_si128((__m128i*)(dst + x), blend4(d, s));
+	}
+#elif defined(SOFT_NEON)
+	for (; x + 8 <= count; x += 8)
+	{
+		/* Loaded a channel to a register: blue, green, red, alpha */
+		uint8x8x4_t s = vld4_u8((const uint8_t*)(src + x));
+		uint64_t alpha = vget_lane_u64(vreinterpret_u64_u8(s.val[3]), 0);
+		if (!alpha)
+		{
+			continue; /* All clear, like color-keyed pixels */
+		}
+		if (alpha == ~0ull)
+		{
+			vst4_u8((uint8_t*)(dst + x), s);
+			continue;
+		}
+		uint8x8x4_t d = vld4_u8((const uint8_t*)(dst + x));
+		uint8x8_t inverse = vmvn_u8(s.val[3]);
+		for (int c = 0; c < 4; c++)
+		{
+			uint16x8_t t = vmull_u8(d.val[c], inverse);
+			d.val[c] = vqadd_u8(s.val[c], vraddhn_u16(t, vrshrq_n_u16(t, 8)));
+		}
+		vst4_u8((uint8_t*)(dst + x), d);
+	}
+#endif
+
+	for (; x < count; x++)
+	{
+		uint32_t alpha = src[x] >> 24;
+		if (alpha == 0xFF)
+		{
+			dst[x] = src[x];
+		}
+		else if (alpha)
+		{
+			dst[x] = blendPixel(dst[x], src[x]);
+		}
+	}
+}
+
+const char* blendKernelName()
+{
+#if defined(SOFT_AVX2)
+	return "AVX2";
+#elif defined(SOFT_SSE2)
+	return "SSE2";
+#elif defined(SOFT_NEON)
+	return "NEON";
+#else
+	return "scalar";
+#endif
+}
+
+
+SoftRasterizer::SoftRasterizer(int threads)
+{
+	mTarget = NULL;
+	mPitch =
+		mWidth =
+		mHeight =
+		mTilesX = 0;
+	mClear = 0;
+	mJob = NULL;
+	mJobData = NULL;
+	mJobCount = 0;
+	mNextJob = 0;
+	mBusy = 0;
+	mGeneration = 0;
+	mQuit = false;
+
+	for (int i = 1; i < threads; i++)
+	{
+		mWorkers.push_back(std::thread(&SoftRasterizer::work, this));
+	}
+}
+
+SoftRasterizer::~SoftRasterizer()
+{
+	{
+		std::lock_guard<std::mutex> hold(mLock);
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for (size_t i = 0; i < mWorkers.size(); i++)
+	{
+		mWorkers[i].join();
+	}
+}
+
+void SoftRasterizer::begin(uint32_t* target, int pitch, int width, int height, uint32_t clear)
+{
+	mSprites.clear();
+	mTarget = target;
+	mPitch = pitch;
+	mWidth = width;
+	mHeight = height;
+	mClear = clear;
+	mTilesX = (width + TILE_W - 1) / TILE_W;
+}
+
+void SoftRasterizer::add(const softImage* image, int x, int y)
+{
+	if (!image || !image->width || !image->height)
+	{
+		return;
+	}
+	sprite s = { image, x, y };
+	mSprites.push_back(s);
+}
+
+void SoftRasterizer::flush()
+{
+	if (!mTarget || (mWidth < 1) || (mHeight < 1))
+	{
+		return;
+	}
+	int tilesY = (mHeight + TILE_H - 1) / TILE_H;
+	parallelFor(mTilesX * tilesY, drawTile, this);
+}
+
+void SoftRasterizer::flush(const DamageList& damage)
+{
+	if (damage.isAll())
+	{
+		flush();
+		return;
+	}
+	if (!mTarget || (mWidth < 1) || (mHeight < 1) || damage.isEmpty())
+	{
+		return;
+	}
+
+	/*
+		Each tile draws the box around its share of the damage, so no two jobs
+		touch the same pixels even where the rectangles overlap.
+	*/
+	int tilesY = (mHeight + TILE_H - 1) / TILE_H;
+	if ((int)mTileDamage.size() < mTilesX * tilesY)
+	{
+		softRect none = { 0, 0, 0, 0 };
+		mTileDamage.resize(mTilesX * tilesY, none);
+	}
+	mDamagedTiles.clear();
+	for (int i = 0; i < damage.getCount(); i++)
+	{
+		const softRect& rect = damage.getRects()[i];
+		int right = rect.x + rect.w, bottom = rect.y + rect.h;
+		for (int ty = rect.y / TILE_H; ty * TILE_H < bottom; ty++)
+		{
+			for (int tx = rect.x / TILE_W; tx * TILE_W < right; tx++)
+			{
+				int x0 = tx * TILE_W > rect.x ? tx * TILE_W : rect.x;
+				int y0 = ty * TILE_H > rect.y ? ty * TILE_H : rect.y;
+				int x1 = (tx + 1) * TILE_W < right ? (tx + 1) * TILE_W : right;
+				int y1 = (ty + 1) * TILE_H < bottom ? (ty + 1) * TILE_H : bottom;
+
+				softRect& tile = mTileDamage[ty * mTilesX + tx];
+				if (!tile.w)
+				{
+					softRect first = { x0, y0, x1 - x0, y1 - y0 };
+					tile = first;
+					mDamagedTiles.push_back(ty * mTilesX + tx);
+					continue;
+				}
+				int tileRight = tile.x + tile.w, tileBottom = tile.y + tile.h;
+				tile.x = tile.x < x0 ? tile.x : x0;
+				tile.y = tile.y < y0 ? tile.y : y0;
+				tile.w = (tileRight > x1 ? tileRight : x1) - tile.x;
+				tile.h = (tileBottom > y1 ? tileBottom : y1) - tile.y;
+			}
+		}
+	}
+
+	parallelFor((int)mDamagedTiles.size(), drawDamagedTile, this);
+	for (size_t i = 0; i < mDamagedTiles.size(); i++)
+	{
+		mTileDamage[mDamagedTiles[i]].w = 0;
+	}
+}
+
+void SoftRasterizer::drawTile(void* data, int tile)
+{
+	SoftRasterizer* r = (SoftRasterizer*)data;
+	int x0 = (tile % r->mTilesX) * TILE_W;
+	int y0 = (tile / r->mTilesX) * TILE_H;
+	int x1 = x0 + TILE_W < r->mWidth ? x0 + TILE_W : r->mWidth;
+	int y1 = y0 + TILE_H < r->mHeight ? y0 + TILE_H : r->mHeight;
+	r->drawRegion(x0, y0, x1, y1);
+}
+
+void SoftRasterizer::drawDamagedTile(void* data, int i)
+{
+	SoftRasterizer* r = (SoftRasterizer*)data;
+	const softRect& damage = r->mTileDamage[r->mDamagedTiles[i]];
+	r->drawRegion(damage.x, damage.y, damage.x + damage.w, damage.y + damage.h);
+}
+
+void SoftRasterizer::drawRegion(int x0, int y0, int x1, int y1)
+{
+	/* Nothing under the topmost solid sprite that covers the whole region can show */
+	int first = -1;
+	for (int i = (int)mSprites.size() - 1; i >= 0; i--)
+	{
+		const sprite& s = mSprites[i];
+		if (s.image->opaque && (s.x <= x0) && (s.y <= y0) &&
+			(s.x + s.image->width >= x1) && (s.y + s.image->height >= y1))
+		{
+			first = i;
+			break;
+		}
+	}
+	if (first < 0)
+	{
+		for (int y = y0; y < y1; y++)
+		{
+			uint32_t* row = mTarget + y * mPitch;
+			for (int x = x0; x < x1; x++)
+			{
+				row[x] = mClear;
+			}
+		}
+		first = 0;
+	}
+
+	for (size_t i = first; i < mSprites.size(); i++)
+	{
+		const sprite& s = mSprites[i];
+		const softImage& image = *s.image;
+		int top = s.y > y0 ? s.y : y0;
+		int bottom = s.y + image.height < y1 ? s.y + image.height : y1;
+		int left = s.x > x0 ? s.x : x0;
+		int right = s.x + image.width < x1 ? s.x + image.width : x1;
+		if ((top >= bottom) || (left >= right))
+		{
+			continue;
+		}
+
+		for (int y = top; y < bottom; y++)
+		{
+			int imageY = y - s.y;
+			const uint32_t* src = &image.pixels[imageY * image.width];
+			uint32_t* dst = mTarget + y * mPitch + s.x;
+			const int* span = &image.spans[imageY * 4];
+
+			/* Clip the row's spans to the tile, in image coordinates */
+			int clipL = left - s.x, clipR = right - s.x;
+			int start = span[0] > clipL ? span[0] : clipL;
+			int end = span[1] < clipR ? span[1] : clipR;
+			int solidL = span[2] > start ? span[2] : start;
+			int solidR = span[3] < end ? span[3] : end;
+			if (start >= end)
+			{
+				continue;
+			}
+			if (solidL >= solidR)
+			{
+				blendRow(dst + start, src + start, end - start);
+				continue;
+			}
+			blendRow(dst + start, src + start, solidL - start);
+			memcpy(dst + solidL, src + solidL, (solidR - solidL) * sizeof(uint32_t));
+			blendRow(dst + solidR, src + solidR, end - solidR);
+		}
+	}
+}
+
+/* What scaleRows needs */
+struct scaleJob
+{
+	const softImage* level;
+	softImage* scaled;
+};
+
+void SoftRasterizer::scaleRows(void* data, int band)
+{
+	scaleJob* job = (scaleJob*)data;
+	const softImage& src = *job->level;
+	softImage& dst = *job->scaled;
+
+	/* 16.16 fixed point, sampling at pixel centers */
+	int64_t stepX = ((int64_t)src.width << 16) / dst.width;
+	int64_t stepY = ((int64_t)src.height << 16) / dst.height;
+	int lastY = band * SCALE_BAND + SCALE_BAND < dst.height ? band * SCALE_BAND + SCALE_BAND : dst.height;
+
+	for (int y = band * SCALE_BAND; y < lastY; y++)
+	{
+		int64_t sy = ((int64_t)y * stepY) + (stepY >> 1) - 0x8000;
+		sy = sy < 0 ? 0 : sy;
+		int y0 = (int)(sy >> 16);
+		int y1 = y0 + 1 < src.height ? y0 + 1 : y0;
+		uint32_t wy = (uint32_t)((sy >> 8) & 0xFF);
+		const uint32_t* row0 = &src.pixels[y0 * src.width];
+		const uint32_t* row1 = &src.pixels[y1 * src.width];
+		uint32_t* out = &dst.pixels[y * dst.width];
+
+		for (int x = 0; x < dst.width; x++)
+		{
+			int64_t sx = ((int64_t)x * stepX) + (stepX >> 1) - 0x8000;
+			sx = sx < 0 ? 0 : sx;
+			int x0 = (int)(sx >> 16);
+			int x1 = x0 + 1 < src.width ? x0 + 1 : x0;
+			uint32_t wx = (uint32_t)((sx >> 8) & 0xFF);
+
+			/* Two channels at a time, in 8.8 weights */
+			uint32_t p00 = row0[x0], p01 = row0[x1], p10 = row1[x0], p11 = row1[x1];
+			uint32_t rbTop = ((p00 & 0x00FF00FF) * (256 - wx) + (p01 & 0x00FF00FF) * wx) >> 8;
+			uint32_t agTop = (((p00 >> 8) & 0x00FF00FF) * (256 - wx) + ((p01 >> 8) & 0x00FF00FF) * wx) >> 8;
+			uint32_t rbBottom = ((p10 & 0x00FF00FF) * (256 - wx) + (p11 & 0x00FF00FF) * wx) >> 8;
+			uint32_t agBottom = (((p10 >> 8) & 0x00FF00FF) * (256 - wx) + ((p11 >> 8) & 0x00FF00FF) * wx) >> 8;
+			uint32_t rb = (((rbTop & 0x00FF00FF) * (256 - wy) + (rbBottom & 0x00FF00FF) * wy) >> 8) & 0x00FF00FF;
+			uint32_t ag = (((agTop & 0x00FF00FF) * (256 - wy) + (agBottom & 0x00FF00FF) * wy)) & 0xFF00FF00;
+			out[x] = rb | ag;
+		}
+	}
+}
+
+void SoftRasterizer::scale(const softImage& source, softImage& scaled, int width, int height)
+{
+	if ((width < 1) || (height < 1) || !source.width || !source.height)
+	{
+		scaled.width =
+			scaled.height = 0;
+		scaled.pixels.clear();
+		scaled.spans.clear();
+		return;
+	}
+
+	/* Box filter down while that still leaves at least the target size */
+	softImage halves[2];
+	const softImage* level = &source;
+	for (int i = 0; (level->width >= width * 2) && (level->height >= height * 2); i ^= 1)
+	{
+		softImage& half = halves[i];
+		half.width = level->width / 2;
+		half.height = level->height / 2;
+		half.pixels.resize(half.width * half.height);
+		boxDownsample(&level->pixels[0], level->width * 4, &half.pixels[0], half.width * 4, half.width, half.height);
+		level = &half;
+	}
+
+	scaled.width = width;
+	scaled.height = height;
+	scaled.pixels.resize(width * height);
+	if ((level->width == width) && (level->height == height))
+	{
+		scaled.pixels = level->pixels;
+	}
+	else
+	{
+		scaleJob job = { level, &scaled };
+		parallelFor((height + SCALE_BAND - 1) / SCALE_BAND, scaleRows, &job);
+	}
+	classifyImage(scaled);
+}
+
+void SoftRasterizer::parallelFor(int count, void (*job)(void* data, int i), void* data)
+{
+	if (mWorkers.empty() || (count < 2))
+	{
+		for (int i = 0; i < count; i++)
+		{
+			job(data, i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> hold(mLock);
+		mJob = job;
+		mJobData = data;
+		mJobCount = count;
+		mNextJob = 0;
+		mBusy = (int)mWorkers.size();
+		mGeneration++;
+	}
+	mWake.notify_all();
+
+	/* The caller takes jobs too */
+	runJobs();
+
+	std::unique_lock<std::mutex> hold(mLock);
+	mDone.wait(hold, [this] { return mBusy == 0; });
+}
+
+void SoftRasterizer::runJobs()
+{
+	for (;;)
+	{
+		int i = mNextJob.fetch_add(1);
+		if (i >= mJobCount)
+		{
+			return;
+		}
+		mJob(mJobData, i);
+	}
+}
+
+void SoftRasterizer::work()
+{
+	unsigned seen = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> hold(mLock);
+			mWake.wait(hold, [this, seen] { return mQuit || (mGeneration != seen); });
+			if (mQuit)
+			{
+				return;
+			}
+			seen = mGeneration;
+		}
+
+		runJobs();
+
+		std::lock_guard<std::mutex> hold(mLock);
+		if (--mBusy == 0)
+		{
+			mDone.notify_one();
+		}
+	}
+}
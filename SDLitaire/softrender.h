@@ -0,0 +1,152 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _SOFTRENDER_H
+#define _SOFTRENDER_H
+
+/*
+	Draws sprites on the CPU, for machines where SDL only has its generic software renderer.
+	Images are premultiplied ARGB8888, scaled once to the size they're drawn at,
+	and blended into the framebuffer one tile at a time on every core.
+	Nothing in here needs SDL.
+*/
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* A premultiplied ARGB8888 image, with where each row has anything to draw */
+struct softImage
+{
+	int width = 0, height = 0;
+	std::vector<uint32_t> pixels;
+
+	/*
+		Four per row: [start, end) isn't transparent, and [opaqueStart, opaqueEnd) is solid.
+		Color-keyed card art is solid between its corners, so most of it is a plain copy.
+	*/
+	std::vector<int> spans;
+	bool opaque = false; /* Every pixel is solid */
+};
+
+/* Part of a frame, in pixels */
+struct softRect
+{
+	int x, y, w, h;
+};
+
+/*
+	The parts of a frame that have to be drawn again, kept to a few rectangles.
+	Rectangles that touch are merged, and once they cover most of the frame it is simply all of it.
+*/
+class DamageList
+{
+public:
+	static const int MAX_RECTS = 16;
+
+	/* Empties the list for a frame this size */
+	void reset(int width, int height);
+
+	/* Clipped to the frame */
+	void add(int x, int y, int w, int h);
+	void addAll();
+
+	bool isEmpty() const { return !mCount; }
+	bool isAll() const { return mAll; }
+	int getCount() const { return mCount; }
+	const softRect* getRects() const { return mRects; }
+	/* Pixels covered, counting overlaps twice */
+	int64_t getArea() const;
+
+private:
+	softRect mRects[MAX_RECTS];
+	int mCount = 0;
+	int mWidth = 0, mHeight = 0;
+	bool mAll = false;
+};
+
+/* Works out each row's spans. Call after changing the pixels. */
+void classifyImage(softImage& image);
+
+/* Halves an ARGB8888 image with a 2x2 box filter. An odd last row or column is dropped. Pitches are in bytes. */
+void boxDownsample(const uint32_t* src, int srcPitch, uint32_t* dst, int dstPitch, int dstW, int dstH);
+
+/* Premultiplied "over": dst = src + dst * (1 - srcAlpha). Runs of clear or solid pixels are skipped or copied. */
+void blendRow(uint32_t* dst, const uint32_t* src, int count);
+
+/* The blend kernel this was built with */
+const char* blendKernelName();
+
+class SoftRasterizer
+{
+public:
+	static const int TILE_W = 256;
+	static const int TILE_H = 64;
+
+	/* threads counts the caller, so 1 means no workers */
+	explicit SoftRasterizer(int threads);
+	~SoftRasterizer();
+
+	/* Starts a frame. pitch is in pixels. Anything not covered by a sprite gets the clear color. */
+	void begin(uint32_t* target, int pitch, int width, int height, uint32_t clear);
+
+	/* Queues an image. Later ones are drawn on top. The image must live until flush. */
+	void add(const softImage* image, int x, int y);
+
+	/* Draws every tile and waits for them */
+	void flush();
+	/* Only draws what is damaged, leaving the rest of the target as it was */
+	void flush(const DamageList& damage);
+
+	/* Scales an image, a box filter down to within 2x and then bilinear, with rows shared out */
+	void scale(const softImage& source, softImage& scaled, int width, int height);
+
+	/* Runs job(data, i) for every i below count, on every thread, and waits */
+	void parallelFor(int count, void (*job)(void* data, int i), void* data);
+
+	int getThreads() { return (int)mWorkers.size() + 1; }
+
+private:
+	struct sprite
+	{
+		const softImage* image;
+		int x, y;
+	};
+
+	static void drawTile(void* data, int tile);
+	static void drawDamagedTile(void* data, int i);
+	/* Redraws [x0, x1) by [y0, y1) from the clear color up */
+	void drawRegion(int x0, int y0, int x1, int y1);
+	static void scaleRows(void* data, int band);
+	void runJobs();
+	void work();
+
+	std::vector<sprite> mSprites;
+	uint32_t* mTarget;
+	int mPitch,
+		mWidth,
+		mHeight,
+		mTilesX;
+	uint32_t mClear;
+	std::vector<softRect> mTileDamage; /* The damage within each tile, as one rectangle. Empty outside flush. */
+	std::vector<int> mDamagedTiles;
+
+	/* The worker pool */
+	std::vector<std::thread> mWorkers;
+	std::mutex mLock;
+	std::condition_variable mWake,
+		mDone;
+	void (*mJob)(void* data, int i);
+	void* mJobData;
+	int mJobCount;
+	std::atomic<int> mNextJob;
+	int mBusy; /* Workers still on the current job */
+	unsigned mGeneration; /* Bumped for each job */
+	bool mQuit;
+};
+
+#endif /* _SOFTRENDER_H */
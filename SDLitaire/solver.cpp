@@ -0,0 +1,255 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+#include "solver.h"
+#include <algorithm>
+#include <cmath>
+
+#define FNV_OFFSET 0xCBF29CE484222325ull
+#define FNV_PRIME 0x100000001B3ull
+
+Solver::Solver(uint32_t budget)
+{
+	mBudget = budget;
+	mNodes = 0;
+	mGaveUp = false;
+	mPath.resize(MAX_SOLVE_DEPTH + 1);
+	mLine.resize(MAX_SOLVE_DEPTH);
+	mMoves.resize(MAX_SOLVE_DEPTH * MAX_LEGAL_MOVES);
+}
+
+solveResult Solver::solve(const Klondike& game)
+{
+	mNodes = 0;
+	mGaveUp = false;
+	mSeen.clear();
+	mSolution.clear();
+	mPath[0] = game;
+
+	solveResult result;
+	result.moves = 0;
+	if (search(0))
+	{
+		result.result = SOLVE_WON;
+		result.moves = (int)mSolution.size();
+	}
+	else
+	{
+		result.result = mGaveUp ? SOLVE_GAVE_UP : SOLVE_STUCK;
+	}
+	result.nodes = mNodes;
+	return result;
+}
+
+int Solver::difficultyOf(const solveResult& result)
+{
+	return (int)(10 * log2((double)(result.nodes > 1 ? result.nodes : 1)) + 0.5);
+}
+
+bool Solver::search(int depth)
+{
+	const Klondike& game = mPath[depth];
+	if (game.isWon())
+	{
+		mSolution.assign(mLine.begin(), mLine.begin() + depth);
+		return true;
+	}
+	if (++mNodes > mBudget)
+	{
+		mGaveUp = true;
+		return false;
+	}
+	if (depth == MAX_SOLVE_DEPTH)
+	{
+		return false;
+	}
+	if (!mSeen.insert(hashOf(game)).second)
+	{
+		return false;
+	}
+
+	/* Nothing to decide */
+	klondikeMove forced;
+	if (safeMove(game, forced))
+	{
+		mPath[depth + 1] = game;
+		mPath[depth + 1].apply(forced);
+		mLine[depth] = forced;
+		return search(depth + 1);
+	}
+
+	klondikeMove* moves = &mMoves[depth * MAX_LEGAL_MOVES];
+	int scores[MAX_LEGAL_MOVES];
+	int count = 0;
+	klondikeMove legal[MAX_LEGAL_MOVES];
+	int legalCount = game.legalMoves(legal);
+
+	/* Best first, by insertion */
+	for (int i = 0; i < legalCount; i++)
+	{
+		if (!worthTrying(game, legal[i]))
+		{
+			continue;
+		}
+		int score = scoreOf(game, legal[i]);
+		int j = count++;
+		while ((j > 0) && (scores[j - 1] < score))
+		{
+			moves[j] = moves[j - 1];
+			scores[j] = scores[j - 1];
+			j--;
+		}
+		moves[j] = legal[i];
+		scores[j] = score;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		mPath[depth + 1] = game;
+		mPath[depth + 1].apply(moves[i]);
+		mLine[depth] = moves[i];
+		if (search(depth + 1))
+		{
+			return true;
+		}
+		if (mGaveUp)
+		{
+			return false;
+		}
+	}
+	return false;
+}
+
+uint64_t Solver::hashOf(const Klondike& game) const
+{
+	uint64_t piles[CARD_RANKS];
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		uint64_t hash = FNV_OFFSET;
+		hash = (hash ^ (uint64_t)game.count(i)) * FNV_PRIME;
+		hash = (hash ^ (uint64_t)game.faceDown(i)) * FNV_PRIME;
+		for (int j = 0; j < game.count(i); j++)
+		{
+			hash = (hash ^ (uint64_t)game.card(i, j)) * FNV_PRIME;
+		}
+		piles[i] = hash;
+	}
+	std::sort(piles + FIRST_FOUNDATION, piles + FIRST_TABLEAU);
+	std::sort(piles + FIRST_TABLEAU, piles + CARD_RANKS);
+
+	uint64_t hash = FNV_OFFSET;
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		hash = (hash ^ piles[i]) * FNV_PRIME;
+		hash ^= hash >> 29;
+	}
+	return hash;
+}
+
+bool Solver::safeMove(const Klondike& game, klondikeMove& move) const
+{
+	/* How high each suit has been built */
+	int built[NUM_SUITS] = { 0, 0, 0, 0 };
+	for (int i = FIRST_FOUNDATION; i < FIRST_TABLEAU; i++)
+	{
+		if (game.count(i))
+		{
+			built[suitOf(game.top(i))] = valueOf(game.top(i));
+		}
+	}
+
+	for (int from = WASTE_RANK; from < CARD_RANKS; from++)
+	{
+		if ((from >= FIRST_FOUNDATION) && (from < FIRST_TABLEAU))
+		{
+			continue;
+		}
+		if (!game.count(from) || (game.count(from) == game.faceDown(from)))
+		{
+			continue;
+		}
+		cardCode card = game.top(from);
+		int value = valueOf(card);
+		if (built[suitOf(card)] != value - 1)
+		{
+			continue;
+		}
+
+		/* Nothing of the other colour could still need it to hold a card */
+		int otherA = isRed(card) ? SPADES : DIAMONDS;
+		int otherB = isRed(card) ? CLUBS : HEARTS;
+		if ((value > 2) && ((built[otherA] < value - 1) || (built[otherB] < value - 1)))
+		{
+			continue;
+		}
+
+		for (int to = FIRST_FOUNDATION; to < FIRST_TABLEAU; to++)
+		{
+			klondikeMove candidate = { MOVE_CARDS, (uint8_t)from, (uint8_t)to, 1 };
+			if (game.isLegal(candidate))
+			{
+				move = candidate;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool Solver::worthTrying(const Klondike& game, const klondikeMove& move) const
+{
+	if (move.kind != MOVE_CARDS)
+	{
+		return true;
+	}
+	if ((move.from >= FIRST_FOUNDATION) && (move.from < FIRST_TABLEAU))
+	{
+		return false;
+	}
+	if ((move.from >= FIRST_TABLEAU) && (move.to >= FIRST_TABLEAU))
+	{
+		if (game.reveals(move) || (move.count == game.count(move.from)))
+		{
+			return true;
+		}
+
+		/* Splitting a run is only worth it to free the card underneath for a foundation */
+		cardCode freed = game.card(move.from, game.count(move.from) - move.count - 1);
+		for (int to = FIRST_FOUNDATION; to < FIRST_TABLEAU; to++)
+		{
+			bool empty = !game.count(to);
+			if (slotAccepts(to, freed, 1, empty, empty ? freed : game.top(to)))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+	return true;
+}
+
+int Solver::scoreOf(const Klondike& game, const klondikeMove& move) const
+{
+	switch (move.kind)
+	{
+	case MOVE_DRAW:
+		return 10;
+	case MOVE_RECYCLE:
+		return 5;
+	}
+	if (move.to < FIRST_TABLEAU)
+	{
+		return 100;
+	}
+	if (game.reveals(move))
+	{
+		return 80 + game.faceDown(move.from); /* Dig into the deepest columns first */
+	}
+	if (move.from == WASTE_RANK)
+	{
+		return 50;
+	}
+	return 40;
+}
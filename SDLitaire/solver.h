@@ -0,0 +1,71 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _SOLVER_H
+#define _SOLVER_H
+
+#include "klondike.h"
+#include <unordered_set>
+#include <vector>
+
+#define DEFAULT_SOLVE_BUDGET 100000 /* Positions searched before giving up on a deal */
+#define MAX_SOLVE_DEPTH 1000 /* Moves in the longest line it will follow */
+
+enum SOLVE_RESULTS
+{
+	SOLVE_WON, /* Found a winning line */
+	SOLVE_STUCK, /* Searched everything it looks at without winning */
+	SOLVE_GAVE_UP, /* Ran out of budget */
+	NUM_SOLVE_RESULTS
+};
+
+struct solveResult
+{
+	int result;
+	int moves; /* Length of the winning line, counting every draw */
+	uint32_t nodes; /* Positions searched */
+};
+
+/*
+	Depth-first search with a table of positions already seen.
+	Safe foundation moves are played without branching, cards never come back
+	off the foundations, and runs only move between tableaus when it turns a
+	card over, empties a column or frees a card for a foundation.
+	So a win it finds always plays, but SOLVE_STUCK isn't proof there is none.
+*/
+class Solver
+{
+public:
+	explicit Solver(uint32_t budget = DEFAULT_SOLVE_BUDGET);
+
+	solveResult solve(const Klondike& game);
+
+	/* The winning line from the last solve that found one */
+	const std::vector<klondikeMove>& getSolution() const { return mSolution; }
+
+	/* 10 * log2 of the positions it took, so each 10 points is twice the work */
+	static int difficultyOf(const solveResult& result);
+
+private:
+	bool search(int depth);
+
+	/* Columns and foundations hash the same in any order */
+	uint64_t hashOf(const Klondike& game) const;
+
+	/* A foundation move nothing else could want the card for. False if there isn't one. */
+	bool safeMove(const Klondike& game, klondikeMove& move) const;
+	bool worthTrying(const Klondike& game, const klondikeMove& move) const;
+	int scoreOf(const Klondike& game, const klondikeMove& move) const;
+
+	uint32_t mBudget;
+	uint32_t mNodes;
+	bool mGaveUp;
+	std::vector<Klondike> mPath; /* The position at each depth */
+	std::vector<klondikeMove> mLine; /* The move played from each depth */
+	std::vector<klondikeMove> mMoves; /* MAX_LEGAL_MOVES per depth */
+	std::unordered_set<uint64_t> mSeen;
+	std::vector<klondikeMove> mSolution;
+};
+
+#endif /* _SOLVER_H */
@@ -0,0 +1,175 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+#include "winodds.h"
+
+/* How the estimate is packed into 64 bits */
+#define ODDS_POSITION_SHIFT 32
+#define ODDS_WINS_SHIFT 16
+#define ODDS_COUNT_MASK 0xFFFF
+
+WinEstimator::WinEstimator()
+{
+	mBudget = ODDS_SOLVE_BUDGET;
+	mQuit = false;
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		mSeen[i] = true;
+	}
+	mHiddenCount = 0;
+	mPosition = 0;
+	mClaimed = ODDS_MAX_SAMPLES; /* Nothing to estimate yet */
+	mEstimate = 0;
+}
+
+WinEstimator::~WinEstimator()
+{
+	stop();
+}
+
+void WinEstimator::start(int threads, uint32_t budget)
+{
+	stop();
+	mBudget = budget;
+	mQuit = false;
+	for (int i = 0; i < (threads > 1 ? threads : 1); i++)
+	{
+		mWorkers.push_back(std::thread(&WinEstimator::work, this, i));
+	}
+}
+
+void WinEstimator::stop()
+{
+	{
+		std::lock_guard<std::mutex> hold(mLock);
+		mQuit = true;
+	}
+	mWake.notify_all();
+	for (size_t i = 0; i < mWorkers.size(); i++)
+	{
+		mWorkers[i].join();
+	}
+	mWorkers.clear();
+}
+
+void WinEstimator::setPosition(const Klondike& game, const bool seen[NUM_CARDS])
+{
+	std::lock_guard<std::mutex> hold(mLock);
+
+	/* Putting a dragged card back changes nothing */
+	bool same = true;
+	for (int i = 0; same && (i < NUM_CARDS); i++)
+	{
+		same = mSeen[i] == seen[i];
+	}
+	for (int i = 0; same && (i < CARD_RANKS); i++)
+	{
+		same = (mGame.count(i) == game.count(i)) && (mGame.faceDown(i) == game.faceDown(i));
+		for (int j = 0; same && (j < game.count(i)); j++)
+		{
+			same = mGame.card(i, j) == game.card(i, j);
+		}
+	}
+	if (same && mPosition)
+	{
+		return;
+	}
+
+	mGame = game;
+	mHiddenCount = 0;
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		mSeen[i] = seen[i];
+	}
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		for (int j = 0; j < game.count(i); j++)
+		{
+			if (!seen[game.card(i, j)])
+			{
+				mHiddenRank[mHiddenCount] = i;
+				mHiddenFile[mHiddenCount] = j;
+				mHiddenCount++;
+			}
+		}
+	}
+
+	mPosition++;
+	mClaimed = 0;
+	mEstimate = (uint64_t)mPosition << ODDS_POSITION_SHIFT;
+	mWake.notify_all();
+}
+
+winEstimate WinEstimator::getEstimate() const
+{
+	uint64_t packed = mEstimate;
+	winEstimate estimate;
+	estimate.position = (uint32_t)(packed >> ODDS_POSITION_SHIFT);
+	estimate.wins = (uint32_t)(packed >> ODDS_WINS_SHIFT) & ODDS_COUNT_MASK;
+	estimate.samples = (uint32_t)packed & ODDS_COUNT_MASK;
+	return estimate;
+}
+
+void WinEstimator::sample(Klondike& game, Random& random)
+{
+	cardCode cards[NUM_CARDS];
+	for (int i = 0; i < mHiddenCount; i++)
+	{
+		cards[i] = mGame.card(mHiddenRank[i], mHiddenFile[i]);
+	}
+
+	/* Fisher-Yates, the same as the deal */
+	for (int i = mHiddenCount - 1; i > 0; i--)
+	{
+		int j = (int)random.below(i + 1);
+		cardCode swap = cards[i];
+		cards[i] = cards[j];
+		cards[j] = swap;
+	}
+
+	game = mGame;
+	for (int i = 0; i < mHiddenCount; i++)
+	{
+		game.setCard(mHiddenRank[i], mHiddenFile[i], cards[i]);
+	}
+}
+
+void WinEstimator::work(int worker)
+{
+	Solver solver(mBudget);
+	Random random(0x0DD5ull + worker);
+	Klondike game;
+
+	for (;;)
+	{
+		uint32_t position;
+		{
+			/* With nothing to shuffle, one solve is the whole answer */
+			std::unique_lock<std::mutex> hold(mLock);
+			mWake.wait(hold, [this] { return mQuit || (mClaimed < (mHiddenCount > 1 ? ODDS_MAX_SAMPLES : 1u)); });
+			if (mQuit)
+			{
+				return;
+			}
+			mClaimed++;
+			position = mPosition;
+			sample(game, random);
+		}
+
+		bool won = solver.solve(game).result == SOLVE_WON;
+
+		/* A sample of a position that has since changed is thrown away */
+		uint64_t packed = mEstimate;
+		uint64_t counted;
+		do
+		{
+			if ((uint32_t)(packed >> ODDS_POSITION_SHIFT) != position)
+			{
+				break;
+			}
+			counted = packed + 1 + (won ? (1ull << ODDS_WINS_SHIFT) : 0);
+		} while (!mEstimate.compare_exchange_weak(packed, counted));
+	}
+}
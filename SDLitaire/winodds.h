@@ -0,0 +1,82 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _WINODDS_H
+#define _WINODDS_H
+
+/*
+	Estimates the chance of winning the game being played.
+	The cards the player hasn't seen are dealt at random into the places they could be,
+	and each of those deals is solved on a background thread. The share that can be won
+	is the estimate, and it sharpens as more deals are solved.
+	Nothing in here needs SDL.
+*/
+
+#include "klondike.h"
+#include "solver.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define ODDS_SOLVE_BUDGET 20000 /* Positions searched per sample. A sample that runs out counts as lost. */
+#define ODDS_MAX_SAMPLES 1000 /* Enough for about 3% either way. Then the workers rest. */
+
+struct winEstimate
+{
+	uint32_t position; /* Bumped for each new position */
+	uint32_t samples, /* Deals solved so far */
+		wins; /* The ones that could be won */
+};
+
+/*
+	Each sample is solved knowing every card, so the estimate is for a player
+	who guesses as well as possible, and a little high for anyone else.
+*/
+class WinEstimator
+{
+public:
+	WinEstimator();
+	~WinEstimator();
+
+	/* Starts the workers. Threads below 1 are taken as 1. */
+	void start(int threads, uint32_t budget = ODDS_SOLVE_BUDGET);
+	void stop();
+
+	/*
+		Starts estimating a new position. seen is indexed by cardCode and says which cards
+		the player has seen. The rest can be anywhere another unseen card is.
+		The same position again keeps the estimate it has. Doesn't allocate.
+	*/
+	void setPosition(const Klondike& game, const bool seen[NUM_CARDS]);
+
+	/* Any thread, without locking */
+	winEstimate getEstimate() const;
+
+private:
+	/* Deals the unseen cards into their places at random */
+	void sample(Klondike& game, Random& random);
+	void work(int worker);
+
+	std::vector<std::thread> mWorkers;
+	uint32_t mBudget;
+
+	/* Guarded by mLock */
+	std::mutex mLock;
+	std::condition_variable mWake;
+	bool mQuit;
+	Klondike mGame;
+	bool mSeen[NUM_CARDS];
+	int mHiddenRank[NUM_CARDS], /* Where each unseen card's place is */
+		mHiddenFile[NUM_CARDS];
+	int mHiddenCount;
+	uint32_t mPosition;
+	uint32_t mClaimed; /* Samples handed out for this position */
+
+	/* The estimate, packed so readers never wait: position, wins and samples */
+	std::atomic<uint64_t> mEstimate;
+};
+
+#endif /* _WINODDS_H */
@@ -0,0 +1,487 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+/*
+	Times the game's hot functions one at a time, on a table set up the way the game sets it up.
+	This links classes.cpp and SDL like the game, but never calls Init or LoadMedia,
+	and draws into SDL's software renderer with a one pixel target, so only the submission is timed.
+
+	SDLitaireBench [-reps N] [-warmup ms] [-rep ms] [-filter text] [-json file] [-baseline file] [-threshold percent]
+
+	Each benchmark is warmed up, then run for -reps repetitions of about -rep ms each.
+	The times are per call. -json writes them out; -baseline compares the medians against
+	a file written that way, and exits with 2 if any got slower by more than -threshold
+	with even its fastest repetition slower than the baseline's median.
+*/
+
+#include "../SDLitaire/classes.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define BENCH_TABLE_W 1600 /* The game's starting window */
+#define BENCH_TABLE_H 900
+#define BENCH_CARD_ART_W 71 /* Only the aspect ratio matters */
+#define BENCH_CARD_ART_H 96
+#define BENCH_POINTS 4096 /* Inputs cycled through by the geometry benchmarks, a power of two */
+#define BENCH_NAME 64
+
+typedef std::chrono::steady_clock benchClock;
+
+volatile int benchSink; /* Keeps the results alive */
+
+/* Everything the benchmarks work on, built once */
+struct benchTable
+{
+	AssetManager* game;
+	SDL_Renderer* renderer; /* Software, into a single pixel */
+	SDL_Surface* target;
+	SDL_Texture* textures[NUM_SOFT_IMAGES]; /* Numbered like cardStore::texture */
+	SpriteBatch batch;
+	Texture texture; /* For aspectScale */
+	SDL_Rect rects[BENCH_POINTS];
+	point points[BENCH_POINTS];
+	uint32_t seed;
+	int sink; /* Results go here, so nothing is optimized away */
+};
+
+/* Runs the function being timed this many times */
+typedef void (*benchFunction)(benchTable& table, uint32_t calls);
+
+struct benchmark
+{
+	const char* name;
+	benchFunction run;
+};
+
+struct benchResult
+{
+	char name[BENCH_NAME];
+	uint32_t calls; /* Per repetition */
+	int reps;
+	double minNs, medianNs, meanNs, p90Ns, stddevNs; /* Per call */
+};
+
+void benchAspectScale(benchTable& table, uint32_t calls)
+{
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		SDL_Rect& size = table.rects[i & (BENCH_POINTS - 1)];
+		table.texture.setWidth(BENCH_CARD_ART_W);
+		table.texture.setHeight(BENCH_CARD_ART_H);
+		table.texture.aspectScale(size.w, size.h);
+		table.sink += table.texture.getWidth();
+	}
+}
+
+void benchComputeCardPlaces(benchTable& table, uint32_t calls)
+{
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		table.game->computeCardPlaces();
+	}
+	table.sink += table.game->getCardPlace(CARD_RANKS - 1)->x;
+}
+
+/* Picks up the last column's top card and drops it back where it was */
+void benchCardDrop(benchTable& table, uint32_t calls)
+{
+	Card* card = table.game->getCard(CARD_RANKS - 1, table.game->stackedCards(CARD_RANKS - 1) - 1);
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		table.game->beginDrag(card, card->getX(), card->getY());
+		table.game->cardDrop(card);
+	}
+	table.sink += card->getRank();
+}
+
+/* One simulation step of a table at rest, which is nearly every step */
+void benchMoveCards(benchTable& table, uint32_t calls)
+{
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		table.game->moveCards(16);
+	}
+}
+
+/* What the render thread does with a snapshot, minus the rasterizing */
+void benchRender(benchTable& table, uint32_t calls)
+{
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		table.game->invalidateBoard();
+		table.game->publishSnapshot();
+		tableSnapshot* snapshot = table.game->acquireSnapshot();
+		for (int j = 0; j < snapshot->restingCount; j++)
+		{
+			cardSprite& sprite = snapshot->resting[j];
+			SDL_Rect dest = { sprite.x, sprite.y, snapshot->cardW, snapshot->cardH };
+			table.batch.add(table.textures[sprite.image], dest);
+		}
+		table.game->releaseSnapshot();
+		table.batch.flush(table.renderer);
+		table.sink += table.batch.getDrawCalls();
+	}
+}
+
+void benchRectCollision(benchTable& table, uint32_t calls)
+{
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		table.sink += testRectCollision(table.rects[i & (BENCH_POINTS - 1)], table.rects[(i + 1) & (BENCH_POINTS - 1)]);
+	}
+}
+
+void benchPointWithinBounds(benchTable& table, uint32_t calls)
+{
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		point& p = table.points[i & (BENCH_POINTS - 1)];
+		SDL_Rect& r = table.rects[i & (BENCH_POINTS - 1)];
+		table.sink += pointWithinBounds(p.x, p.y, r.x, r.y, r.w, r.h);
+	}
+}
+
+/* The deal LoadMedia and newGame make */
+void benchShuffle(benchTable& table, uint32_t calls)
+{
+	cardFace deck[NUM_CARDS];
+	for (uint32_t i = 0; i < calls; i++)
+	{
+		Klondike::shuffleDeck(deck, table.seed++);
+		table.sink += deck[0].value;
+	}
+}
+
+const benchmark benchmarks[] =
+{
+	{ "Texture::aspectScale", benchAspectScale },
+	{ "AssetManager::computeCardPlaces", benchComputeCardPlaces },
+	{ "AssetManager::cardDrop", benchCardDrop },
+	{ "AssetManager::moveCards", benchMoveCards },
+	{ "render", benchRender },
+	{ "testRectCollision", benchRectCollision },
+	{ "pointWithinBounds", benchPointWithinBounds },
+	{ "Klondike::shuffleDeck", benchShuffle },
+};
+const int NUM_BENCHMARKS = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+bool setUp(benchTable& table)
+{
+	table.game = new AssetManager();
+	table.game->setCardArtSize(BENCH_CARD_ART_W, BENCH_CARD_ART_H);
+	table.game->options()->winOdds = false;
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		table.game->newCard();
+	}
+
+	SDL_Event e;
+	SDL_zero(e);
+	e.type = SDL_WINDOWEVENT;
+	e.window.event = SDL_WINDOWEVENT_SIZE_CHANGED;
+	e.window.data1 = BENCH_TABLE_W;
+	e.window.data2 = BENCH_TABLE_H;
+	table.game->handleEvent(e);
+	table.game->newGame(1);
+	table.game->moveCards(0);
+
+	for (int i = 0; i < NUM_SOFT_IMAGES; i++)
+	{
+		table.textures[i] = NULL;
+	}
+	table.target = SDL_CreateRGBSurfaceWithFormat(0, 1, 1, 32, SDL_PIXELFORMAT_ARGB8888);
+	table.renderer = table.target ? SDL_CreateSoftwareRenderer(table.target) : NULL;
+	if (!table.renderer)
+	{
+		printf("The software renderer could not be created!\nSDL Error: %s\n", SDL_GetError());
+		return false;
+	}
+	for (int i = 0; i < NUM_SOFT_IMAGES; i++)
+	{
+		table.textures[i] = SDL_CreateTexture(table.renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+			BENCH_CARD_ART_W, BENCH_CARD_ART_H);
+	}
+
+	/* Card-sized rectangles and points scattered over the table, so branches go both ways */
+	Random random(1);
+	for (int i = 0; i < BENCH_POINTS; i++)
+	{
+		table.rects[i].w = table.game->getCardWidth();
+		table.rects[i].h = table.game->getCardHeight();
+		table.rects[i].x = (int)random.below(BENCH_TABLE_W);
+		table.rects[i].y = (int)random.below(BENCH_TABLE_H);
+		table.points[i].x = (int)random.below(BENCH_TABLE_W);
+		table.points[i].y = (int)random.below(BENCH_TABLE_H);
+	}
+	table.seed = 1;
+	table.sink = 0;
+	return true;
+}
+
+void tearDown(benchTable& table)
+{
+	for (int i = 0; i < NUM_SOFT_IMAGES; i++)
+	{
+		if (table.textures[i])
+		{
+			SDL_DestroyTexture(table.textures[i]);
+		}
+	}
+	if (table.renderer)
+	{
+		SDL_DestroyRenderer(table.renderer);
+	}
+	if (table.target)
+	{
+		SDL_FreeSurface(table.target);
+	}
+	delete table.game;
+}
+
+double secondsSince(benchClock::time_point start)
+{
+	return std::chrono::duration<double>(benchClock::now() - start).count();
+}
+
+/* Warms up, finds how many calls fill a repetition, then times the repetitions */
+benchResult measure(benchTable& table, const benchmark& bench, int reps, double warmupMs, double repMs)
+{
+	/* Doubling the calls also warms the caches and the branch predictors */
+	uint32_t calls = 1;
+	double took = 0;
+	benchClock::time_point warmup = benchClock::now();
+	for (;;)
+	{
+		benchClock::time_point start = benchClock::now();
+		bench.run(table, calls);
+		took = secondsSince(start) * 1000.0;
+		if ((took >= repMs) && (secondsSince(warmup) * 1000.0 >= warmupMs))
+		{
+			break;
+		}
+		if (took < repMs)
+		{
+			calls *= 2;
+		}
+	}
+	calls = (uint32_t)(calls * (repMs / took)) + 1;
+
+	std::vector<double> times(reps);
+	for (int i = 0; i < reps; i++)
+	{
+		benchClock::time_point start = benchClock::now();
+		bench.run(table, calls);
+		times[i] = secondsSince(start) * 1e9 / calls;
+	}
+	std::sort(times.begin(), times.end());
+
+	benchResult result;
+	snprintf(result.name, sizeof(result.name), "%s", bench.name);
+	result.calls = calls;
+	result.reps = reps;
+	result.minNs = times[0];
+	result.medianNs = (reps % 2) ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2;
+	result.p90Ns = times[(reps * 9) / 10 < reps ? (reps * 9) / 10 : reps - 1];
+	double sum = 0;
+	for (int i = 0; i < reps; i++)
+	{
+		sum += times[i];
+	}
+	result.meanNs = sum / reps;
+	double squares = 0;
+	for (int i = 0; i < reps; i++)
+	{
+		squares += (times[i] - result.meanNs) * (times[i] - result.meanNs);
+	}
+	result.stddevNs = (reps > 1) ? sqrt(squares / (reps - 1)) : 0;
+	return result;
+}
+
+/* One benchmark per line, so baselines diff cleanly and read back without a JSON library */
+bool writeJson(const char* path, const std::vector<benchResult>& results)
+{
+	FILE* file = fopen(path, "w");
+	if (!file)
+	{
+		printf("%s could not be written!\n", path);
+		return false;
+	}
+	fprintf(file, "{\n\t\"benchmarks\": [\n");
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const benchResult& r = results[i];
+		fprintf(file, "\t\t{ \"name\": \"%s\", \"calls\": %u, \"reps\": %i, \"min_ns\": %.3f, \"median_ns\": %.3f, "
+			"\"mean_ns\": %.3f, \"p90_ns\": %.3f, \"stddev_ns\": %.3f }%s\n",
+			r.name, r.calls, r.reps, r.minNs, r.medianNs, r.meanNs, r.p90Ns, r.stddevNs,
+			(i + 1 < results.size()) ? "," : "");
+	}
+	fprintf(file, "\t]\n}\n");
+	fclose(file);
+	return true;
+}
+
+/* Reads back what writeJson wrote */
+bool readJson(const char* path, std::vector<benchResult>& results)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+	{
+		printf("%s could not be read!\n", path);
+		return false;
+	}
+	char line[512];
+	while (fgets(line, sizeof(line), file))
+	{
+		const char* name = strstr(line, "\"name\": \"");
+		const char* median = strstr(line, "\"median_ns\": ");
+		if (!name || !median)
+		{
+			continue;
+		}
+		benchResult r;
+		memset(&r, 0, sizeof(r));
+		name += strlen("\"name\": \"");
+		const char* end = strchr(name, '"');
+		if (!end)
+		{
+			continue;
+		}
+		int length = (int)(end - name) < BENCH_NAME - 1 ? (int)(end - name) : BENCH_NAME - 1;
+		memcpy(r.name, name, length);
+		r.medianNs = atof(median + strlen("\"median_ns\": "));
+		results.push_back(r);
+	}
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char* args[])
+{
+	int reps = 30;
+	double warmupMs = 200;
+	double repMs = 20;
+	const char* filter = NULL;
+	const char* jsonPath = NULL;
+	const char* baselinePath = NULL;
+	double threshold = 10;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(args[i], "-reps") && (i + 1 < argc))
+		{
+			reps = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-warmup") && (i + 1 < argc))
+		{
+			warmupMs = atof(args[++i]);
+		}
+		else if (!strcmp(args[i], "-rep") && (i + 1 < argc))
+		{
+			repMs = atof(args[++i]);
+		}
+		else if (!strcmp(args[i], "-filter") && (i + 1 < argc))
+		{
+			filter = args[++i];
+		}
+		else if (!strcmp(args[i], "-json") && (i + 1 < argc))
+		{
+			jsonPath = args[++i];
+		}
+		else if (!strcmp(args[i], "-baseline") && (i + 1 < argc))
+		{
+			baselinePath = args[++i];
+		}
+		else if (!strcmp(args[i], "-threshold") && (i + 1 < argc))
+		{
+			threshold = atof(args[++i]);
+		}
+		else
+		{
+			printf("Usage: SDLitaireBench [-reps N] [-warmup ms] [-rep ms] [-filter text] [-json file] [-baseline file] [-threshold percent]\n");
+			return 1;
+		}
+	}
+	if (reps < 1)
+	{
+		reps = 1;
+	}
+	if (repMs <= 0)
+	{
+		repMs = 1;
+	}
+
+	std::vector<benchResult> baseline;
+	if (baselinePath && !readJson(baselinePath, baseline))
+	{
+		return 1;
+	}
+
+	benchTable table;
+	if (!setUp(table))
+	{
+		tearDown(table);
+		return 1;
+	}
+
+	printf("%-34s %12s %12s %12s %12s %9s", "Benchmark", "Median ns", "Min ns", "p90 ns", "Stddev ns", "Calls");
+	printf(baselinePath ? " %10s\n" : "\n", "Change");
+
+	std::vector<benchResult> results;
+	int slower = 0;
+	for (int b = 0; b < NUM_BENCHMARKS; b++)
+	{
+		if (filter && !strstr(benchmarks[b].name, filter))
+		{
+			continue;
+		}
+		benchResult r = measure(table, benchmarks[b], reps, warmupMs, repMs);
+		results.push_back(r);
+		printf("%-34s %12.2f %12.2f %12.2f %12.2f %9u", r.name, r.medianNs, r.minNs, r.p90Ns, r.stddevNs, r.calls);
+
+		if (baselinePath)
+		{
+			const benchResult* before = NULL;
+			for (size_t i = 0; i < baseline.size(); i++)
+			{
+				if (!strcmp(baseline[i].name, r.name))
+				{
+					before = &baseline[i];
+				}
+			}
+			if (before && (before->medianNs > 0))
+			{
+				double change = (r.medianNs - before->medianNs) * 100.0 / before->medianNs;
+				/* Even the fastest repetition has to be slower, so one noisy stretch isn't a regression */
+				bool regressed = (change > threshold) && (r.minNs > before->medianNs);
+				slower += regressed ? 1 : 0;
+				printf(" %+9.1f%%%s", change, regressed ? "  SLOWER" : (change < -threshold ? "  faster" : ""));
+			}
+			else
+			{
+				printf(" %10s", "new");
+			}
+		}
+		printf("\n");
+	}
+	benchSink = table.sink;
+	tearDown(table);
+
+	if (jsonPath && !writeJson(jsonPath, results))
+	{
+		return 1;
+	}
+	if (slower)
+	{
+		printf("%i benchmarks are more than %.0f%% slower than %s.\n", slower, threshold, baselinePath);
+		return 2;
+	}
+	return 0;
+}
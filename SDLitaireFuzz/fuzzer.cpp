@@ -0,0 +1,685 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+/*
+	Fires random mouse input through the same calls the simulation thread makes,
+	and checks the table after every step. No window is opened and nothing is drawn.
+	This links classes.cpp and SDL like the game, but never calls Init or LoadMedia.
+
+	SDLitaireFuzz [-seconds N] [-trials N] [-steps N] [-threads N] [-seed N] [-animation]
+	SDLitaireFuzz -replay file
+
+	A failing trial is shrunk to the fewest steps that still fail the same way,
+	then printed in the form -replay reads.
+*/
+
+#include "../SDLitaire/classes.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define FUZZ_TABLE_W 1600 /* The game's starting window */
+#define FUZZ_TABLE_H 900
+#define FUZZ_CARD_ART_W 71 /* Only the aspect ratio matters */
+#define FUZZ_CARD_ART_H 96
+#define FUZZ_FIRST_CLOCK 1000 /* Event timestamps start here */
+#define FUZZ_SLIDE_LIMIT 10000 /* ms an animated card may slide before it counts as stuck */
+#define FUZZ_MESSAGE 256
+
+enum FUZZ_STEPS
+{
+	STEP_DOWN,
+	STEP_MOTION,
+	STEP_UP,
+	STEP_NEW_GAME, /* x picks the deal: the trial's seed + x */
+	STEP_RESIZE,
+	NUM_FUZZ_STEPS
+};
+
+const char* stepNames[NUM_FUZZ_STEPS] = { "down", "motion", "up", "newgame", "resize" };
+
+/* One input, and the time since the one before it */
+struct fuzzStep
+{
+	uint8_t kind;
+	uint16_t ms;
+	int16_t x, y;
+};
+
+/* What was broken. Shrinking keeps a step only if the same invariant still breaks. */
+enum INVARIANTS
+{
+	HOLDS,
+	BAD_CARD_COUNT, /* Not every card is in exactly one pile */
+	BAD_SEATING, /* A card's rank or file doesn't match where its pile holds it */
+	BAD_DRAG, /* Dragging cards that aren't the run above the drag base */
+	BAD_CLICKABILITY, /* A settled pile whose top can't be clicked, or whose covered cards can */
+	BAD_ORIENTATION, /* A card facing the wrong way for where it rests */
+	BAD_BUILD, /* A foundation or tableau run that breaks the rules */
+	STUCK_SLIDING, /* A dealt card never arrived */
+	NUM_INVARIANTS
+};
+
+const char* invariantNames[NUM_INVARIANTS] = { "holds", "card count", "seating", "drag", "clickability",
+	"orientation", "build", "stuck sliding" };
+
+/* One game's worth of state, driven the way simulate() drives it */
+class FuzzTable
+{
+public:
+	FuzzTable(bool animation);
+	~FuzzTable();
+
+	void reset(uint32_t seed);
+
+	/* Plays one step and returns what it broke */
+	int play(const fuzzStep& step);
+
+	/* A step that is likely to do something in the current position */
+	fuzzStep generate(Random& random);
+
+	const char* getMessage() { return mMessage; }
+	uint64_t getEvents() { return mEvents; }
+
+private:
+	int check();
+	int fail(int invariant, const char* format, int a, int b);
+
+	/* Somewhere on a card, or on an empty slot */
+	point pointOnCard(Random& random, Card* card);
+	point pointOnSlot(Random& random, int rank);
+
+	AssetManager* mGame;
+	Card* mCards[NUM_CARDS];
+	uint32_t mSeed;
+	Uint32 mClock;
+	Uint32 mSlidingSince[NUM_CARDS]; /* 0 while resting */
+	bool mButtonDown;
+	uint64_t mEvents;
+	char mMessage[FUZZ_MESSAGE];
+};
+
+FuzzTable::FuzzTable(bool animation)
+{
+	mGame = new AssetManager();
+	mGame->options()->animation = animation;
+	mGame->setCardArtSize(FUZZ_CARD_ART_W, FUZZ_CARD_ART_H);
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		mCards[i] = mGame->newCard();
+	}
+	mSeed = 0;
+	mEvents = 0;
+	reset(0);
+}
+
+FuzzTable::~FuzzTable()
+{
+	delete mGame;
+}
+
+void FuzzTable::reset(uint32_t seed)
+{
+	mSeed = seed;
+	mClock = FUZZ_FIRST_CLOCK;
+	mButtonDown = false;
+	mMessage[0] = '\0';
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		mSlidingSince[i] = 0;
+	}
+
+	SDL_Event e;
+	SDL_zero(e);
+	e.type = SDL_WINDOWEVENT;
+	e.window.event = SDL_WINDOWEVENT_SIZE_CHANGED;
+	e.window.data1 = FUZZ_TABLE_W;
+	e.window.data2 = FUZZ_TABLE_H;
+	mGame->handleEvent(e);
+	mGame->newGame(seed);
+	mGame->moveCards(0);
+}
+
+int FuzzTable::play(const fuzzStep& step)
+{
+	mClock += step.ms;
+
+	SDL_Event e;
+	SDL_zero(e);
+	switch (step.kind)
+	{
+	case STEP_DOWN:
+	case STEP_UP:
+		e.type = (step.kind == STEP_DOWN) ? SDL_MOUSEBUTTONDOWN : SDL_MOUSEBUTTONUP;
+		e.button.timestamp = mClock;
+		e.button.button = SDL_BUTTON_LEFT;
+		e.button.x = step.x;
+		e.button.y = step.y;
+		mButtonDown = step.kind == STEP_DOWN;
+		break;
+	case STEP_MOTION:
+		e.type = SDL_MOUSEMOTION;
+		e.motion.timestamp = mClock;
+		e.motion.x = step.x;
+		e.motion.y = step.y;
+		break;
+	case STEP_NEW_GAME:
+		mGame->newGame(mSeed + (uint16_t)step.x);
+		mGame->moveCards(step.ms);
+		return check();
+	case STEP_RESIZE:
+		e.type = SDL_WINDOWEVENT;
+		e.window.timestamp = mClock;
+		e.window.event = SDL_WINDOWEVENT_SIZE_CHANGED;
+		e.window.data1 = step.x;
+		e.window.data2 = step.y;
+		break;
+	}
+
+	/* The same way as the simulation thread */
+	mGame->dispatchInput(e);
+	mGame->moveCards(step.ms);
+	mGame->updateWinOdds();
+	mGame->logPosition();
+	mGame->prefetchFaces();
+	mEvents++;
+	return check();
+}
+
+int FuzzTable::fail(int invariant, const char* format, int a, int b)
+{
+	snprintf(mMessage, FUZZ_MESSAGE, format, a, b);
+	return invariant;
+}
+
+int FuzzTable::check()
+{
+	/* Every card in exactly one pile, sitting where the pile says */
+	bool seen[NUM_CARDS] = { false };
+	int total = 0;
+	for (int rank = 0; rank < CARD_RANKS; rank++)
+	{
+		for (int file = 0; file < mGame->stackedCards(rank); file++)
+		{
+			Card* card = mGame->getCard(rank, file);
+			if (!card || seen[card->getIndex()])
+			{
+				return fail(BAD_CARD_COUNT, "Slot %i holds a missing or repeated card at %i.", rank, file);
+			}
+			seen[card->getIndex()] = true;
+			if ((card->getRank() != rank) || (card->getFile() != file))
+			{
+				return fail(BAD_SEATING, "The card at %i,%i thinks it is somewhere else.", rank, file);
+			}
+			total++;
+		}
+	}
+	if (total != NUM_CARDS)
+	{
+		return fail(BAD_CARD_COUNT, "There are %i cards on the table instead of %i.", total, NUM_CARDS);
+	}
+
+	/* Only the run from the drag base up is held */
+	Card* base = mGame->getDragBase();
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		bool held = base && (mCards[i]->getRank() == base->getRank()) && (mCards[i]->getFile() >= base->getFile());
+		if (mCards[i]->isDragging() != held)
+		{
+			return fail(BAD_DRAG, held ? "Card %i in slot %i was left behind by the drag." :
+				"Card %i in slot %i is dragged without a drag base.", i, mCards[i]->getRank());
+		}
+	}
+	if (base && !mButtonDown)
+	{
+		return fail(BAD_DRAG, "Cards from %i,%i are still held after the button came up.", base->getRank(), base->getFile());
+	}
+
+	/* Dealt cards have to land, right away without animation */
+	bool sliding = false;
+	for (int i = 0; i < NUM_CARDS; i++)
+	{
+		if (mCards[i]->getDestRank() == mCards[i]->getRank())
+		{
+			mSlidingSince[i] = 0;
+			continue;
+		}
+		sliding = true;
+		if (!mGame->options()->animation)
+		{
+			return fail(STUCK_SLIDING, "Card %i is still headed for slot %i.", i, mCards[i]->getDestRank());
+		}
+		if (!mSlidingSince[i])
+		{
+			mSlidingSince[i] = mClock;
+		}
+		else if (mClock - mSlidingSince[i] > FUZZ_SLIDE_LIMIT)
+		{
+			return fail(STUCK_SLIDING, "Card %i has been sliding toward slot %i for too long.", i, mCards[i]->getDestRank());
+		}
+	}
+	if (sliding || base)
+	{
+		return HOLDS; /* The rest only holds once the table is still */
+	}
+
+	for (int rank = 0; rank < CARD_RANKS; rank++)
+	{
+		int count = mGame->stackedCards(rank);
+		bool tableau = rank >= FIRST_TABLEAU;
+		for (int file = 0; file < count; file++)
+		{
+			Card* card = mGame->getCard(rank, file);
+			bool top = file == count - 1;
+			bool faceUp = card->getFlipState();
+
+			if (top && !card->getClickability())
+			{
+				return fail(BAD_CLICKABILITY, "The top of slot %i (%i cards) can't be clicked.", rank, count);
+			}
+			if (!top && card->getClickability() && !(tableau && faceUp))
+			{
+				return fail(BAD_CLICKABILITY, "A covered card in slot %i can be clicked at %i.", rank, file);
+			}
+
+			/* The stock is face-down, the waste and foundations face-up, and each tableau face-down underneath */
+			if (tableau)
+			{
+				if (!faceUp && (file > 0) && mGame->getCard(rank, file - 1)->getFlipState())
+				{
+					return fail(BAD_ORIENTATION, "Slot %i has a face-down card on a face-up one at %i.", rank, file);
+				}
+			}
+			else if (faceUp != (rank != STOCK_RANK))
+			{
+				return fail(BAD_ORIENTATION, "Slot %i has a card facing the wrong way at %i.", rank, file);
+			}
+
+			/* Each card has to be one the rules allow on the card under it */
+			if ((file > 0) && (rank >= FIRST_FOUNDATION) && faceUp && mGame->getCard(rank, file - 1)->getFlipState())
+			{
+				cardCode under = codeOf(mGame->getCard(rank, file - 1)->getFace());
+				if (!slotAccepts(rank, codeOf(card->getFace()), 1, false, under))
+				{
+					return fail(BAD_BUILD, "Slot %i breaks the rules at %i.", rank, file);
+				}
+			}
+			if ((file == 0) && (rank >= FIRST_FOUNDATION) && (rank < FIRST_TABLEAU) &&
+				!slotAccepts(rank, codeOf(card->getFace()), 1, true, 0))
+			{
+				return fail(BAD_BUILD, "Foundation %i doesn't start with an ace.", rank, 0);
+			}
+		}
+	}
+	return HOLDS;
+}
+
+point FuzzTable::pointOnCard(Random& random, Card* card)
+{
+	int w = mGame->getCardWidth() > 1 ? mGame->getCardWidth() : 2;
+	int h = mGame->getCardHeight() > 1 ? mGame->getCardHeight() : 2;
+	point p = { card->getX() + (int)random.below(w), card->getY() + (int)random.below(h) };
+	return p;
+}
+
+point FuzzTable::pointOnSlot(Random& random, int rank)
+{
+	int count = mGame->stackedCards(rank);
+	if (count)
+	{
+		return pointOnCard(random, mGame->getCard(rank, count - 1));
+	}
+	int w = mGame->getCardWidth() > 1 ? mGame->getCardWidth() : 2;
+	int h = mGame->getCardHeight() > 1 ? mGame->getCardHeight() : 2;
+	point p = { mGame->getCardPlace(rank)->x + (int)random.below(w), mGame->getCardPlace(rank)->y + (int)random.below(h) };
+	return p;
+}
+
+fuzzStep FuzzTable::generate(Random& random)
+{
+	fuzzStep step;
+	point p;
+
+	/* Mostly a frame apart, sometimes together, sometimes either side of a double-click */
+	uint32_t timing = random.below(10);
+	step.ms = (uint16_t)(timing < 6 ? 16 : (timing < 8 ? 0 : 100 + random.below(500)));
+
+	uint32_t roll = random.below(1000);
+	if (mButtonDown && (roll < 600))
+	{
+		/* Carry whatever is held toward a slot, and sometimes let go */
+		p = pointOnSlot(random, random.below(CARD_RANKS));
+		step.kind = (uint8_t)(random.below(3) ? STEP_MOTION : STEP_UP);
+	}
+	else if (roll < 550)
+	{
+		/* Grab a card that could be clicked */
+		int rank = random.below(CARD_RANKS);
+		int count = mGame->stackedCards(rank);
+		if (count)
+		{
+			Card* card = mGame->getCard(rank, count - 1 - (int)random.below(count));
+			p = pointOnCard(random, card->getClickability() ? card : mGame->getCard(rank, count - 1));
+		}
+		else
+		{
+			p = pointOnSlot(random, rank);
+		}
+		step.kind = STEP_DOWN;
+	}
+	else if (roll < 750)
+	{
+		/* The stock, which draws or turns the waste over */
+		p = pointOnSlot(random, STOCK_RANK);
+		step.kind = (uint8_t)(mButtonDown ? STEP_UP : STEP_DOWN);
+	}
+	else if (roll < 990)
+	{
+		/* Anywhere, even off the window */
+		p.x = (int)random.below(FUZZ_TABLE_W + 200) - 100;
+		p.y = (int)random.below(FUZZ_TABLE_H + 200) - 100;
+		step.kind = (uint8_t)random.below(STEP_UP + 1);
+	}
+	else if (roll < 997)
+	{
+		/* Down to nothing, and back up */
+		p.x = (int)random.below(2 * FUZZ_TABLE_W);
+		p.y = (int)random.below(2 * FUZZ_TABLE_H);
+		step.kind = STEP_RESIZE;
+	}
+	else
+	{
+		p.x = (int)random.below(16);
+		p.y = 0;
+		step.kind = STEP_NEW_GAME;
+	}
+	step.x = (int16_t)p.x;
+	step.y = (int16_t)p.y;
+	return step;
+}
+
+
+/* Replays steps from a fresh deal. Returns what broke, and the step that broke it. */
+int replay(FuzzTable& table, uint32_t seed, const std::vector<fuzzStep>& steps, size_t* failedAt)
+{
+	table.reset(seed);
+	for (size_t i = 0; i < steps.size(); i++)
+	{
+		int broken = table.play(steps[i]);
+		if (broken != HOLDS)
+		{
+			*failedAt = i;
+			return broken;
+		}
+	}
+	return HOLDS;
+}
+
+/* Drops chunks of steps, halving the chunk size, for as long as the same invariant still breaks */
+void shrink(FuzzTable& table, uint32_t seed, std::vector<fuzzStep>& steps, int invariant)
+{
+	size_t failedAt = steps.size() - 1;
+	replay(table, seed, steps, &failedAt);
+	steps.resize(failedAt + 1);
+
+	for (size_t chunk = steps.size() / 2; chunk >= 1; )
+	{
+		bool progress = false;
+		for (size_t start = 0; start < steps.size(); )
+		{
+			std::vector<fuzzStep> fewer(steps.begin(), steps.begin() + start);
+			size_t end = start + chunk < steps.size() ? start + chunk : steps.size();
+			fewer.insert(fewer.end(), steps.begin() + end, steps.end());
+			if (!fewer.empty() && (replay(table, seed, fewer, &failedAt) == invariant))
+			{
+				fewer.resize(failedAt + 1);
+				steps.swap(fewer);
+				progress = true;
+			}
+			else
+			{
+				start += chunk;
+			}
+		}
+		if (!progress)
+		{
+			chunk /= 2;
+		}
+		else if (chunk > steps.size() / 2)
+		{
+			chunk = steps.size() / 2 ? steps.size() / 2 : 1;
+		}
+	}
+}
+
+void printSteps(FILE* out, uint32_t seed, const std::vector<fuzzStep>& steps)
+{
+	fprintf(out, "seed %u\n", seed);
+	for (size_t i = 0; i < steps.size(); i++)
+	{
+		fprintf(out, "%s %u %i %i\n", stepNames[steps[i].kind], steps[i].ms, steps[i].x, steps[i].y);
+	}
+}
+
+bool readSteps(const char* path, uint32_t* seed, std::vector<fuzzStep>& steps)
+{
+	FILE* in = fopen(path, "r");
+	if (!in)
+	{
+		printf("%s could not be opened!\n", path);
+		return false;
+	}
+
+	char name[16];
+	unsigned ms;
+	int x, y;
+	bool success = fscanf(in, " seed %u", seed) == 1;
+	while (success && (fscanf(in, " %15s %u %i %i", name, &ms, &x, &y) == 4))
+	{
+		fuzzStep step = { NUM_FUZZ_STEPS, (uint16_t)ms, (int16_t)x, (int16_t)y };
+		for (int i = 0; i < NUM_FUZZ_STEPS; i++)
+		{
+			if (!strcmp(name, stepNames[i]))
+			{
+				step.kind = (uint8_t)i;
+			}
+		}
+		if (step.kind == NUM_FUZZ_STEPS)
+		{
+			printf("%s has an unknown step: %s\n", path, name);
+			success = false;
+		}
+		steps.push_back(step);
+	}
+	if (!feof(in))
+	{
+		success = false;
+	}
+	fclose(in);
+	if (!success)
+	{
+		printf("%s is not a list of steps.\n", path);
+	}
+	return success;
+}
+
+
+/* Everything the workers share */
+struct fuzzRun
+{
+	uint32_t firstSeed;
+	uint64_t trials;
+	int steps;
+	bool animation;
+	std::chrono::steady_clock::time_point deadline;
+	std::atomic<uint64_t> nextTrial;
+	std::atomic<uint64_t> trialsRun, stepsRun, eventsRun;
+	std::atomic<bool> failed;
+	std::mutex reportLock;
+};
+
+void work(fuzzRun* run)
+{
+	FuzzTable table(run->animation);
+	std::vector<fuzzStep> steps;
+	uint64_t trials = 0, stepsRun = 0;
+
+	while (!run->failed.load(std::memory_order_relaxed) && (std::chrono::steady_clock::now() < run->deadline))
+	{
+		uint64_t trial = run->nextTrial.fetch_add(1);
+		if (trial >= run->trials)
+		{
+			break;
+		}
+
+		/* The steps depend only on the trial, so any failure replays */
+		uint32_t seed = run->firstSeed + (uint32_t)trial;
+		Random random(((uint64_t)seed << 32) | 0xF022);
+		table.reset(seed);
+		steps.clear();
+
+		int broken = HOLDS;
+		for (int i = 0; (i < run->steps) && (broken == HOLDS); i++)
+		{
+			steps.push_back(table.generate(random));
+			broken = table.play(steps.back());
+		}
+		trials++;
+		stepsRun += steps.size();
+
+		if (broken != HOLDS)
+		{
+			if (run->failed.exchange(true))
+			{
+				break; /* Another worker is already reporting */
+			}
+			std::lock_guard<std::mutex> hold(run->reportLock);
+			printf("Trial %llu (seed %u) broke %s after %u steps: %s\n", (unsigned long long)trial, seed,
+				invariantNames[broken], (unsigned)steps.size(), table.getMessage());
+			shrink(table, seed, steps, broken);
+			size_t failedAt = 0;
+			replay(table, seed, steps, &failedAt);
+			printf("Shrunk to %u steps: %s\n", (unsigned)steps.size(), table.getMessage());
+			printSteps(stdout, seed, steps);
+		}
+	}
+
+	run->trialsRun += trials;
+	run->stepsRun += stepsRun;
+	run->eventsRun += table.getEvents();
+}
+
+int main(int argc, char* args[])
+{
+	double seconds = 10.0;
+	uint64_t trials = ~0ull;
+	int steps = 2000;
+	int threads = (int)std::thread::hardware_concurrency();
+	uint32_t firstSeed = 1;
+	bool animation = false;
+	const char* replayPath = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(args[i], "-seconds") && (i + 1 < argc))
+		{
+			seconds = atof(args[++i]);
+		}
+		else if (!strcmp(args[i], "-trials") && (i + 1 < argc))
+		{
+			trials = strtoull(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-steps") && (i + 1 < argc))
+		{
+			steps = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-threads") && (i + 1 < argc))
+		{
+			threads = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-seed") && (i + 1 < argc))
+		{
+			firstSeed = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-animation"))
+		{
+			animation = true;
+		}
+		else if (!strcmp(args[i], "-replay") && (i + 1 < argc))
+		{
+			replayPath = args[++i];
+		}
+		else
+		{
+			printf("Usage: SDLitaireFuzz [-seconds N] [-trials N] [-steps N] [-threads N] [-seed N] [-animation]\n"
+				"       SDLitaireFuzz -replay file\n");
+			return 1;
+		}
+	}
+
+	if (replayPath)
+	{
+		uint32_t seed;
+		std::vector<fuzzStep> replayed;
+		if (!readSteps(replayPath, &seed, replayed))
+		{
+			return 1;
+		}
+		FuzzTable table(animation);
+		size_t failedAt = 0;
+		int broken = replay(table, seed, replayed, &failedAt);
+		if (broken == HOLDS)
+		{
+			printf("All %u steps hold.\n", (unsigned)replayed.size());
+			return 0;
+		}
+		printf("Step %u broke %s: %s\n", (unsigned)failedAt + 1, invariantNames[broken], table.getMessage());
+		return 2;
+	}
+
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+	if (steps < 1)
+	{
+		steps = 1;
+	}
+
+	fuzzRun run;
+	run.firstSeed = firstSeed;
+	run.trials = trials;
+	run.steps = steps;
+	run.animation = animation;
+	run.nextTrial = 0;
+	run.trialsRun = 0;
+	run.stepsRun = 0;
+	run.eventsRun = 0;
+	run.failed = false;
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	run.deadline = start + std::chrono::microseconds((long long)(seconds * 1e6));
+
+	std::vector<std::thread> workers;
+	for (int t = 0; t < threads; t++)
+	{
+		workers.push_back(std::thread(work, &run));
+	}
+	for (int t = 0; t < threads; t++)
+	{
+		workers[t].join();
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%llu trials, %llu steps (%.2fM events/s) on %i threads in %.1f s%s\n",
+		(unsigned long long)run.trialsRun.load(), (unsigned long long)run.stepsRun.load(),
+		run.eventsRun.load() / elapsed / 1e6, threads, elapsed, run.failed ? "" : ". Every invariant held.");
+	return run.failed ? 2 : 0;
+}
@@ -0,0 +1,201 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+/*
+	Solves a range of deal seeds and writes the index the game picks winnable deals from.
+	This only links the rules (klondike.cpp, solver.cpp and dealindex.cpp), not SDL.
+
+	SDLitaireIndex [-deals N] [-seed N] [-threads N] [-budget N] [-out file]
+	SDLitaireIndex -read file [-difficulty min max]
+*/
+
+#include "../SDLitaire/klondike.h"
+#include "../SDLitaire/solver.h"
+#include "../SDLitaire/dealindex.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define DEALS_PER_CLAIM 64 /* Deals a worker takes at a time */
+
+/* Everything the workers share */
+struct indexJob
+{
+	uint32_t deals;
+	uint32_t firstSeed;
+	uint32_t budget;
+	std::atomic<uint32_t> nextDeal;
+	std::atomic<uint32_t> done;
+};
+
+void work(indexJob* job, std::vector<dealRecord>* sections)
+{
+	Solver solver(job->budget);
+	Klondike game;
+
+	for (;;)
+	{
+		uint32_t first = job->nextDeal.fetch_add(DEALS_PER_CLAIM);
+		if (first >= job->deals)
+		{
+			break;
+		}
+		uint32_t last = first + DEALS_PER_CLAIM < job->deals ? first + DEALS_PER_CLAIM : job->deals;
+
+		for (uint32_t i = first; i < last; i++)
+		{
+			uint32_t seed = job->firstSeed + i;
+			game.deal(seed);
+			solveResult result = solver.solve(game);
+
+			int difficulty = Solver::difficultyOf(result);
+			dealRecord record = { seed, (uint16_t)(difficulty < 0xFFFF ? difficulty : 0xFFFF), (uint16_t)result.moves };
+			sections[result.result].push_back(record);
+		}
+		job->done.fetch_add(last - first);
+	}
+}
+
+/* Prints what an index holds, through the same mapping the game uses */
+int readIndex(const char* path, int minDifficulty, int maxDifficulty)
+{
+	DealIndex index;
+	if (!index.open(path))
+	{
+		return 1;
+	}
+
+	printf("%s: %u deals\n", path, index.size());
+	printf("  winnable %u, no win found %u, gave up %u\n",
+		index.count(SOLVE_WON), index.count(SOLVE_STUCK), index.count(SOLVE_GAVE_UP));
+
+	uint32_t winnable = index.count(SOLVE_WON);
+	if (winnable)
+	{
+		printf("  winnable difficulty: easiest %u, median %u, hardest %u\n",
+			index.at(0).difficulty, index.at(winnable / 2).difficulty, index.at(winnable - 1).difficulty);
+	}
+
+	uint32_t first;
+	uint32_t deals = index.range(minDifficulty, maxDifficulty, &first);
+	printf("  %u winnable deals with difficulty %i-%i", deals, minDifficulty, maxDifficulty);
+	if (deals)
+	{
+		printf(", e.g. seed %u in %u moves", index.at(first).seed, index.at(first).solutionMoves);
+	}
+	printf("\n");
+	return 0;
+}
+
+int main(int argc, char* args[])
+{
+	uint32_t deals = 10000;
+	uint32_t firstSeed = 1;
+	int threads = (int)std::thread::hardware_concurrency();
+	uint32_t budget = DEFAULT_SOLVE_BUDGET;
+	const char* out = "deals.idx";
+	const char* read = NULL;
+	int minDifficulty = 0;
+	int maxDifficulty = 0xFFFF;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(args[i], "-deals") && (i + 1 < argc))
+		{
+			deals = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-seed") && (i + 1 < argc))
+		{
+			firstSeed = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-threads") && (i + 1 < argc))
+		{
+			threads = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-budget") && (i + 1 < argc))
+		{
+			budget = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-out") && (i + 1 < argc))
+		{
+			out = args[++i];
+		}
+		else if (!strcmp(args[i], "-read") && (i + 1 < argc))
+		{
+			read = args[++i];
+		}
+		else if (!strcmp(args[i], "-difficulty") && (i + 2 < argc))
+		{
+			minDifficulty = atoi(args[++i]);
+			maxDifficulty = atoi(args[++i]);
+		}
+		else
+		{
+			printf("Usage: %s [-deals N] [-seed N] [-threads N] [-budget N] [-out file]\n", args[0]);
+			printf("       %s -read file [-difficulty min max]\n", args[0]);
+			return 1;
+		}
+	}
+
+	if (read)
+	{
+		return readIndex(read, minDifficulty, maxDifficulty);
+	}
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+
+	printf("Solving %u deals from seed %u on %i threads, %u positions each at most\n", deals, firstSeed, threads, budget);
+
+	indexJob job;
+	job.deals = deals;
+	job.firstSeed = firstSeed;
+	job.budget = budget;
+	job.nextDeal = 0;
+	job.done = 0;
+
+	std::vector<std::vector<dealRecord> > sections(threads * NUM_SOLVE_RESULTS);
+	std::vector<std::thread> workers;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int t = 0; t < threads; t++)
+	{
+		workers.push_back(std::thread(work, &job, &sections[t * NUM_SOLVE_RESULTS]));
+	}
+	while (job.done < deals)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		printf("\r%u/%u", job.done.load(), deals);
+		fflush(stdout);
+	}
+	for (size_t t = 0; t < workers.size(); t++)
+	{
+		workers[t].join();
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("\r%u deals in %.1fs (%.1f deals/s)\n", deals, seconds, deals / seconds);
+
+	/* Merge the workers' sections */
+	std::vector<dealRecord> merged[NUM_SOLVE_RESULTS];
+	for (int t = 0; t < threads; t++)
+	{
+		for (int i = 0; i < NUM_SOLVE_RESULTS; i++)
+		{
+			std::vector<dealRecord>& section = sections[t * NUM_SOLVE_RESULTS + i];
+			merged[i].insert(merged[i].end(), section.begin(), section.end());
+		}
+	}
+
+	if (!DealIndex::write(out, merged, budget))
+	{
+		return 1;
+	}
+	return readIndex(out, minDifficulty, maxDifficulty);
+}
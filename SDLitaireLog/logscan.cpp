@@ -0,0 +1,286 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+/*
+	Scans a columnar move log and aggregates it, decoding only the columns it needs.
+	This only links the rules (klondike.cpp and movelog.cpp), not SDL.
+
+	SDLitaireLog file [-game N]
+	SDLitaireLog -selftest file
+*/
+
+#include "../SDLitaire/klondike.h"
+#include "../SDLitaire/movelog.h"
+#include <chrono>
+#include <cstdio>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+const char* kindNames[NUM_MOVE_KINDS] = { "draw", "recycle", "cards" };
+const char* rankNames[CARD_RANKS] = { "stock", "waste", "f1", "f2", "f3", "f4", "t1", "t2", "t3", "t4", "t5", "t6", "t7" };
+
+/* Seeks to one game through the block index and prints its moves */
+int printGame(MoveLogReader& reader, uint64_t game)
+{
+	uint32_t blockIndex = reader.blockOfGame(game);
+	const moveLogIndexEntry& info = reader.blockInfo(blockIndex);
+	moveLogBlock block;
+	if (!reader.readBlock(blockIndex, block) || (game - info.firstGame >= block.games))
+	{
+		printf("There is no game %llu.\n", (unsigned long long)game);
+		return 1;
+	}
+
+	uint32_t local = (uint32_t)(game - info.firstGame);
+	uint32_t move = 0;
+	for (uint32_t g = 0; g < local; g++)
+	{
+		move += block.lengths[g];
+	}
+
+	printf("Game %llu: seed %u, %u moves, %s\n", (unsigned long long)game, block.seeds[local],
+		block.lengths[local], block.wins[local] ? "won" : "lost");
+	uint32_t time = 0;
+	for (uint32_t m = move; m < move + block.lengths[local]; m++)
+	{
+		time += block.times[m];
+		printf("%8u ms  %-8s %-5s -> %-5s x%u\n", time, kindNames[block.kinds[m]],
+			rankNames[block.froms[m]], rankNames[block.tos[m]], block.counts[m]);
+	}
+	return 0;
+}
+
+/*
+	Writes a log of consecutive seeds from a high start, as a simulator run would, and reads it back.
+	Every seed has to come back, and after the first one, which is in the block header, they have to take no space.
+*/
+int selfTest(const char* path)
+{
+	const uint32_t firstSeed = 0xF0000000u;
+	const uint32_t games = MOVE_LOG_BLOCK_GAMES + 100; /* Into a second block */
+
+	MoveLogWriter writer;
+	if (!writer.open(path))
+	{
+		return 1;
+	}
+	for (uint32_t g = 0; g < games; g++)
+	{
+		writer.beginGame(firstSeed + g);
+		klondikeMove move = { MOVE_DRAW, STOCK_RANK, WASTE_RANK, 1 };
+		writer.addMove(move, g);
+		writer.endGame((g & 1) != 0);
+	}
+	if (!writer.close())
+	{
+		return 1;
+	}
+
+	MoveLogReader reader;
+	if (!reader.open(path))
+	{
+		return 1;
+	}
+	int failures = 0;
+	uint32_t game = 0;
+	moveLogBlock block;
+	while (reader.next(block, LOG_COLUMN(LOG_SEEDS)))
+	{
+		if (reader.streamInfo(LOG_SEEDS).width)
+		{
+			printf("FAILED: consecutive seeds were stored %i bits each.\n", reader.streamInfo(LOG_SEEDS).width);
+			failures++;
+		}
+		for (uint32_t i = 0; i < block.games; i++, game++)
+		{
+			if (block.seeds[i] != firstSeed + game)
+			{
+				printf("FAILED: game %u read back seed %u instead of %u.\n", game, block.seeds[i], firstSeed + game);
+				failures++;
+				break;
+			}
+		}
+	}
+	if (game != games)
+	{
+		printf("FAILED: %u games read back instead of %u.\n", game, games);
+		failures++;
+	}
+	reader.close();
+
+	/* A stream wider than a value can be has to be refused, not read past the block */
+	FILE* file = fopen(path, "r+b");
+	uint8_t width = 40;
+	if (!file || fseek(file, (long)(sizeof(moveLogHeader) + offsetof(moveLogBlockHeader, streams) + offsetof(moveLogStream, width)), SEEK_SET) ||
+		(fwrite(&width, 1, 1, file) != 1))
+	{
+		printf("FAILED: the log could not be damaged.\n");
+		failures++;
+	}
+	if (file)
+	{
+		fclose(file);
+	}
+	if (reader.open(path) && reader.next(block, LOG_COLUMN(LOG_SEEDS)))
+	{
+		printf("FAILED: a block with a %u bit stream was read.\n", width);
+		failures++;
+	}
+	reader.close();
+	remove(path);
+
+	if (!failures)
+	{
+		printf("Every seed read back, consecutive seeds took no space, and a damaged block was refused.\n");
+	}
+	return failures ? 1 : 0;
+}
+
+int main(int argc, char* args[])
+{
+	if (argc < 2)
+	{
+		printf("Usage: %s file [-game N]\n       %s -selftest file\n", args[0], args[0]);
+		return 1;
+	}
+	if ((argc == 3) && !strcmp(args[1], "-selftest"))
+	{
+		return selfTest(args[2]);
+	}
+
+	MoveLogReader reader;
+	if (!reader.open(args[1]))
+	{
+		return 1;
+	}
+	if ((argc == 4) && !strcmp(args[2], "-game"))
+	{
+		return printGame(reader, strtoull(args[3], NULL, 10));
+	}
+
+	uint64_t games = 0, wins = 0, moves = 0, totalTime = 0, timedMoves = 0;
+	uint64_t kinds[NUM_MOVE_KINDS] = {};
+	uint64_t routes[CARD_RANKS][CARD_RANKS] = {};
+	uint64_t cardsMoved = 0;
+
+	/*
+		Runs of the same move (draw, draw, draw...) would make every increment wait on the one before,
+		so the counting is spread over four copies of each histogram and added up at the end.
+	*/
+	static uint32_t kindCounts[4][4];
+	static uint32_t routeCounts[4][256];
+	memset(kindCounts, 0, sizeof(kindCounts));
+	memset(routeCounts, 0, sizeof(routeCounts));
+
+	const uint32_t columns = LOG_COLUMN(LOG_WINS) | LOG_COLUMN(LOG_KINDS) | LOG_COLUMN(LOG_FROMS) |
+		LOG_COLUMN(LOG_TOS) | LOG_COLUMN(LOG_COUNTS) | LOG_COLUMN(LOG_TIMES);
+
+	auto start = std::chrono::steady_clock::now();
+	moveLogBlock block;
+	while (reader.next(block, columns))
+	{
+		games += block.games;
+		moves += block.moves;
+		for (uint32_t i = 0; i < block.games; i++)
+		{
+			wins += block.wins[i];
+		}
+
+		/* Each aggregate is one straight pass over one or two columns */
+		const uint8_t* kind = block.kinds.data();
+		const uint8_t* from = block.froms.data();
+		const uint8_t* to = block.tos.data();
+		const uint8_t* count = block.counts.data();
+		const uint32_t* time = block.times.data();
+		uint32_t i = 0;
+		for (; i + 4 <= block.moves; i += 4)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				kindCounts[j][kind[i + j]]++;
+				routeCounts[j][(from[i + j] << 4) | to[i + j]]++;
+			}
+		}
+		for (; i < block.moves; i++)
+		{
+			kindCounts[0][kind[i]]++;
+			routeCounts[0][(from[i] << 4) | to[i]]++;
+		}
+
+		uint32_t blockCards = 0, blockTime = 0, blockTimed = 0;
+		for (i = 0; i < block.moves; i++)
+		{
+			blockCards += (kind[i] == MOVE_CARDS) ? count[i] : 0;
+		}
+		for (i = 0; i < block.moves; i++)
+		{
+			blockTime += time[i];
+			blockTimed += time[i] ? 1 : 0;
+		}
+		cardsMoved += blockCards;
+		totalTime += blockTime;
+		timedMoves += blockTimed;
+
+		/* Fold the 32-bit counters in before a block could overflow them */
+		for (int j = 0; j < 4; j++)
+		{
+			for (int k = 0; k < NUM_MOVE_KINDS; k++)
+			{
+				kinds[k] += kindCounts[j][k];
+			}
+			for (int f = 0; f < CARD_RANKS; f++)
+			{
+				for (int t = 0; t < CARD_RANKS; t++)
+				{
+					routes[f][t] += routeCounts[j][(f << 4) | t];
+				}
+			}
+		}
+		memset(kindCounts, 0, sizeof(kindCounts));
+		memset(routeCounts, 0, sizeof(routeCounts));
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%llu games in %u blocks, %llu won (%.2f%%), %.1f moves a game\n",
+		(unsigned long long)games, reader.blockCount(), (unsigned long long)wins,
+		games ? 100.0 * wins / games : 0.0, games ? (double)moves / games : 0.0);
+	for (int i = 0; i < NUM_MOVE_KINDS; i++)
+	{
+		printf("  %-8s %12llu\n", kindNames[i], (unsigned long long)kinds[i]);
+	}
+	printf("  %.2f cards per card move\n", kinds[MOVE_CARDS] ? (double)cardsMoved / kinds[MOVE_CARDS] : 0.0);
+	if (timedMoves)
+	{
+		printf("  %.0f ms between moves\n", (double)totalTime / timedMoves);
+	}
+
+	printf("Busiest routes:\n");
+	for (int shown = 0; shown < 8; shown++)
+	{
+		int bestFrom = 0, bestTo = 0;
+		for (int f = 0; f < CARD_RANKS; f++)
+		{
+			for (int t = 0; t < CARD_RANKS; t++)
+			{
+				if (routes[f][t] > routes[bestFrom][bestTo])
+				{
+					bestFrom = f;
+					bestTo = t;
+				}
+			}
+		}
+		if (!routes[bestFrom][bestTo])
+		{
+			break;
+		}
+		printf("  %-5s -> %-5s %12llu\n", rankNames[bestFrom], rankNames[bestTo], (unsigned long long)routes[bestFrom][bestTo]);
+		routes[bestFrom][bestTo] = 0;
+	}
+
+	printf("Scanned %llu moves in %.3fs (%.0f million moves/s)\n", (unsigned long long)moves, seconds,
+		seconds > 0 ? moves / seconds / 1e6 : 0.0);
+	return 0;
+}
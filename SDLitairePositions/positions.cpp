@@ -0,0 +1,249 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+/*
+	Writes, converts and solves position files (notation.cpp), for trading deal sets with other solvers.
+	This only links the rules (klondike.cpp, solver.cpp and notation.cpp), not SDL.
+
+	SDLitairePositions -export file [-deals N] [-seed N] [-binary]
+	SDLitairePositions -convert in out [-binary]
+	SDLitairePositions -solve file [-threads N] [-budget N]
+
+	-export writes the starting position of each deal, the way the game deals it.
+	-convert rewrites a file of either kind as text, or as binary with -binary.
+	-solve runs the solver on every position in a file and counts how many can be won.
+*/
+
+#include "../SDLitaire/klondike.h"
+#include "../SDLitaire/solver.h"
+#include "../SDLitaire/notation.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#define SOLVE_CHUNK 4096 /* Positions read before the workers solve them */
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int exportDeals(const char* path, uint32_t deals, uint32_t firstSeed, bool binary)
+{
+	PositionWriter writer;
+	if (!writer.open(path, binary))
+	{
+		return 1;
+	}
+	char comment[64];
+	snprintf(comment, sizeof(comment), "Deals %u to %u", firstSeed, firstSeed + deals - 1);
+	writer.comment(comment);
+
+	Klondike game;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < deals; i++)
+	{
+		game.deal(firstSeed + i);
+		writer.write(game);
+	}
+	if (!writer.close())
+	{
+		printf("%s could not be written!\n", path);
+		return 1;
+	}
+	double seconds = secondsSince(start);
+	printf("Wrote %u deals to %s in %.2fs (%.0f positions/s)\n", deals, path, seconds, deals / seconds);
+	return 0;
+}
+
+int convert(const char* from, const char* to, bool binary)
+{
+	PositionReader reader;
+	PositionWriter writer;
+	if (!reader.open(from) || !writer.open(to, binary))
+	{
+		return 1;
+	}
+
+	Klondike game;
+	auto start = std::chrono::steady_clock::now();
+	while (reader.next(game))
+	{
+		writer.write(game);
+	}
+	if (reader.getError())
+	{
+		printf("%s: %s\n", from, reader.getError());
+		return 1;
+	}
+	if (!writer.close())
+	{
+		printf("%s could not be written!\n", to);
+		return 1;
+	}
+	double seconds = secondsSince(start);
+	printf("Converted %llu positions from %s %s to %s in %.2fs (%.0f positions/s)\n",
+		(unsigned long long)reader.getCount(), reader.isBinary() ? "binary" : "text",
+		from, binary ? "binary" : "text", seconds, reader.getCount() / seconds);
+	return 0;
+}
+
+/* Everything the workers share */
+struct solveJob
+{
+	std::vector<Klondike> positions;
+	uint32_t count; /* Filled in this chunk */
+	uint32_t budget;
+	std::atomic<uint32_t> next;
+	std::atomic<uint64_t> results[NUM_SOLVE_RESULTS];
+};
+
+void work(solveJob* job)
+{
+	Solver solver(job->budget);
+	for (uint32_t i = job->next++; i < job->count; i = job->next++)
+	{
+		job->results[solver.solve(job->positions[i]).result]++;
+	}
+}
+
+int solve(const char* path, int threads, uint32_t budget)
+{
+	PositionReader reader;
+	if (!reader.open(path))
+	{
+		return 1;
+	}
+
+	solveJob job;
+	job.positions.resize(SOLVE_CHUNK);
+	job.budget = budget;
+	for (int i = 0; i < NUM_SOLVE_RESULTS; i++)
+	{
+		job.results[i] = 0;
+	}
+
+	printf("Solving the positions in %s on %i threads, %u positions each at most\n", path, threads, budget);
+	auto start = std::chrono::steady_clock::now();
+	double reading = 0;
+	for (;;)
+	{
+		auto chunkStart = std::chrono::steady_clock::now();
+		job.count = 0;
+		while ((job.count < SOLVE_CHUNK) && reader.next(job.positions[job.count]))
+		{
+			job.count++;
+		}
+		reading += secondsSince(chunkStart);
+		if (!job.count)
+		{
+			break;
+		}
+
+		job.next = 0;
+		std::vector<std::thread> workers;
+		for (int t = 0; t < threads; t++)
+		{
+			workers.push_back(std::thread(work, &job));
+		}
+		for (size_t t = 0; t < workers.size(); t++)
+		{
+			workers[t].join();
+		}
+		printf("\r%llu", (unsigned long long)reader.getCount());
+		fflush(stdout);
+	}
+	if (reader.getError())
+	{
+		printf("\n%s: %s\n", path, reader.getError());
+		return 1;
+	}
+
+	uint64_t total = reader.getCount();
+	double seconds = secondsSince(start);
+	printf("\r%llu positions in %.1fs (%.1f positions/s). Reading them took %.3fs (%.0f positions/s).\n",
+		(unsigned long long)total, seconds, total / seconds, reading, reading > 0 ? total / reading : 0.0);
+	printf("  winnable %llu, no win found %llu, gave up %llu\n",
+		(unsigned long long)job.results[SOLVE_WON].load(), (unsigned long long)job.results[SOLVE_STUCK].load(),
+		(unsigned long long)job.results[SOLVE_GAVE_UP].load());
+	return 0;
+}
+
+int main(int argc, char* args[])
+{
+	uint32_t deals = 10000;
+	uint32_t firstSeed = 1;
+	int threads = (int)std::thread::hardware_concurrency();
+	uint32_t budget = DEFAULT_SOLVE_BUDGET;
+	bool binary = false;
+	const char* exportPath = NULL;
+	const char* convertFrom = NULL;
+	const char* convertTo = NULL;
+	const char* solvePath = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(args[i], "-export") && (i + 1 < argc))
+		{
+			exportPath = args[++i];
+		}
+		else if (!strcmp(args[i], "-convert") && (i + 2 < argc))
+		{
+			convertFrom = args[++i];
+			convertTo = args[++i];
+		}
+		else if (!strcmp(args[i], "-solve") && (i + 1 < argc))
+		{
+			solvePath = args[++i];
+		}
+		else if (!strcmp(args[i], "-deals") && (i + 1 < argc))
+		{
+			deals = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-seed") && (i + 1 < argc))
+		{
+			firstSeed = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-threads") && (i + 1 < argc))
+		{
+			threads = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-budget") && (i + 1 < argc))
+		{
+			budget = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-binary"))
+		{
+			binary = true;
+		}
+		else
+		{
+			exportPath = convertFrom = solvePath = NULL;
+			break;
+		}
+	}
+
+	if (exportPath)
+	{
+		return exportDeals(exportPath, deals, firstSeed, binary);
+	}
+	if (convertFrom)
+	{
+		return convert(convertFrom, convertTo, binary);
+	}
+	if (solvePath)
+	{
+		return solve(solvePath, threads < 1 ? 1 : threads, budget);
+	}
+
+	printf("Usage: %s -export file [-deals N] [-seed N] [-binary]\n", args[0]);
+	printf("       %s -convert in out [-binary]\n", args[0]);
+	printf("       %s -solve file [-threads N] [-budget N]\n", args[0]);
+	return 1;
+}
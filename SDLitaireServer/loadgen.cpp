@@ -0,0 +1,402 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+/*
+	Plays bots against SDLitaireServer as hard as it can, to measure it.
+	This only links the rules (klondike.cpp and policy.cpp), not SDL, and needs Linux like the server.
+
+	SDLitaireLoad [-socket path] [-connections N] [-sessions N] [-seconds N] [-policy name] [-seed N] [-maxmoves N]
+
+	Each connection gets a thread and -sessions games. A round sends one move for every game
+	in a single write, then reads every reply. Each game is also played here, from the same seed,
+	so every reply is checked against what the move should have turned over.
+	A finished game is closed and a new deal opened in the same round.
+*/
+
+#include "../SDLitaire/klondike.h"
+#include "../SDLitaire/policy.h"
+#include "protocol.h"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* One game, as this side plays it */
+struct mirroredGame
+{
+	Klondike game;
+	Random random;
+	bool progress; /* For playMove */
+	bool over; /* Won, stuck or out of moves */
+	bool open; /* The server has a session for it */
+	uint32_t session;
+};
+
+/* A request in flight, and what its reply should say */
+struct sentRequest
+{
+	uint32_t game;
+	uint8_t op;
+	uint8_t status;
+	uint8_t card;
+};
+
+/* Everything the connections share */
+struct loadRun
+{
+	sockaddr_un address;
+	const char* policyName;
+	uint32_t sessions;
+	int maxMoves;
+	std::atomic<uint32_t> nextSeed;
+	std::atomic<bool> stopping;
+	std::atomic<uint64_t> moves, requests, games, wins, rounds, mismatches;
+	std::atomic<uint64_t> roundNs;
+	std::atomic<int> failed;
+};
+
+bool sendAll(int fd, const void* data, size_t bytes)
+{
+	const char* from = (const char*)data;
+	while (bytes)
+	{
+		ssize_t sent = send(fd, from, bytes, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return false;
+		}
+		from += sent;
+		bytes -= (size_t)sent;
+	}
+	return true;
+}
+
+bool receiveAll(int fd, void* data, size_t bytes)
+{
+	char* to = (char*)data;
+	while (bytes)
+	{
+		ssize_t got = recv(fd, to, bytes, 0);
+		if (got <= 0)
+		{
+			if ((got < 0) && (errno == EINTR))
+			{
+				continue;
+			}
+			return false;
+		}
+		to += got;
+		bytes -= (size_t)got;
+	}
+	return true;
+}
+
+void request(std::vector<serverRequest>& requests, std::vector<sentRequest>& sent,
+	uint32_t game, uint32_t session, uint8_t op, uint8_t status, uint8_t card)
+{
+	serverRequest r = { session, op, 0, 0, 0 };
+	requests.push_back(r);
+	sentRequest s = { game, op, status, card };
+	sent.push_back(s);
+}
+
+/* Plays one move here and asks the server to play it too. False when the game is over. */
+bool requestMove(mirroredGame& g, uint32_t index, Policy& policy, int maxMoves,
+	std::vector<serverRequest>& requests, std::vector<sentRequest>& sent)
+{
+	if (g.game.getMoves() >= maxMoves)
+	{
+		return false;
+	}
+	uint8_t faceDown[CARD_RANKS];
+	for (int i = 0; i < CARD_RANKS; i++)
+	{
+		faceDown[i] = (uint8_t)g.game.faceDown(i);
+	}
+	klondikeMove move;
+	if (!playMove(g.game, policy, g.random, g.progress, &move))
+	{
+		return false;
+	}
+
+	uint8_t op = SERVER_MOVE;
+	uint8_t card = SERVER_NO_CARD;
+	if (move.kind == MOVE_DRAW)
+	{
+		op = SERVER_DRAW;
+		card = g.game.top(WASTE_RANK);
+	}
+	else if (move.kind == MOVE_RECYCLE)
+	{
+		op = SERVER_RECYCLE;
+	}
+	else if ((move.from >= FIRST_TABLEAU) && (g.game.faceDown(move.from) < faceDown[move.from]))
+	{
+		card = g.game.top(move.from);
+	}
+	request(requests, sent, index, g.session, op, g.game.isWon() ? SERVER_WON : SERVER_OK, card);
+	requests.back().from = move.from;
+	requests.back().to = move.to;
+	requests.back().count = move.count;
+	return true;
+}
+
+void deal(mirroredGame& g, uint32_t index, loadRun* run,
+	std::vector<serverRequest>& requests, std::vector<sentRequest>& sent)
+{
+	/* The policy's dice depend only on the deal, as in SDLitaireSim */
+	uint32_t seed = run->nextSeed++;
+	g.game.deal(seed);
+	g.random.seed(((uint64_t)seed << 32) | 0x5EED);
+	g.progress = true;
+	g.over = false;
+	request(requests, sent, index, seed, SERVER_NEW, SERVER_OK, SERVER_NO_CARD);
+}
+
+void work(loadRun* run)
+{
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if ((fd < 0) || (connect(fd, (sockaddr*)&run->address, sizeof(run->address)) < 0))
+	{
+		printf("%s could not be connected to: %s\n", run->address.sun_path, strerror(errno));
+		run->failed = 1;
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return;
+	}
+
+	Policy* policy = createPolicy(run->policyName);
+	std::vector<mirroredGame> games(run->sessions);
+	std::vector<serverRequest> requests;
+	std::vector<sentRequest> sent;
+	std::vector<serverReply> replies;
+	uint64_t moves = 0, sentRequests = 0, finished = 0, wins = 0, rounds = 0, mismatches = 0, roundNs = 0;
+
+	for (uint32_t i = 0; i < run->sessions; i++)
+	{
+		games[i].open = false;
+		deal(games[i], i, run, requests, sent);
+	}
+
+	while (!run->stopping || requests.size())
+	{
+		auto start = std::chrono::steady_clock::now();
+		replies.resize(requests.size());
+		if (!sendAll(fd, requests.data(), requests.size() * sizeof(serverRequest)) ||
+			!receiveAll(fd, replies.data(), replies.size() * sizeof(serverReply)))
+		{
+			printf("The server went away\n");
+			run->failed = 1;
+			break;
+		}
+		sentRequests += requests.size();
+		roundNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		rounds++;
+
+		for (size_t i = 0; i < replies.size(); i++)
+		{
+			mirroredGame& g = games[sent[i].game];
+			if ((replies[i].op != sent[i].op) || (replies[i].status != sent[i].status) ||
+				((sent[i].op != SERVER_NEW) && (replies[i].card != sent[i].card)))
+			{
+				if (!mismatches)
+				{
+					printf("Game %u: sent op %i, expected status %i card %i, got op %i status %i card %i\n",
+						g.game.getSeed(), sent[i].op, sent[i].status, sent[i].card,
+						replies[i].op, replies[i].status, replies[i].card);
+				}
+				mismatches++;
+				g.over = true;
+			}
+			if (sent[i].op == SERVER_NEW)
+			{
+				g.session = replies[i].session;
+				g.open = replies[i].status == SERVER_OK;
+			}
+			else if (sent[i].op == SERVER_CLOSE)
+			{
+				g.open = false;
+			}
+			else
+			{
+				moves++;
+			}
+		}
+
+		requests.clear();
+		sent.clear();
+		for (uint32_t i = 0; i < run->sessions; i++)
+		{
+			mirroredGame& g = games[i];
+			if (!g.open)
+			{
+				continue;
+			}
+			if (!g.over && !run->stopping && requestMove(g, i, *policy, run->maxMoves, requests, sent))
+			{
+				continue;
+			}
+
+			/* Over, so start the next deal in the same round */
+			if (!g.over && !run->stopping)
+			{
+				finished++;
+				wins += g.game.isWon();
+			}
+			g.over = true;
+			request(requests, sent, i, g.session, SERVER_CLOSE, SERVER_OK, SERVER_NO_CARD);
+			if (!run->stopping)
+			{
+				deal(g, i, run, requests, sent);
+			}
+		}
+	}
+
+	run->moves += moves;
+	run->requests += sentRequests;
+	run->games += finished;
+	run->wins += wins;
+	run->rounds += rounds;
+	run->mismatches += mismatches;
+	run->roundNs += roundNs;
+	delete policy;
+	close(fd);
+}
+
+double cpuSeconds()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+int main(int argc, char* args[])
+{
+	const char* path = SERVER_DEFAULT_SOCKET;
+	int connections = 4;
+	uint32_t sessions = 256;
+	double seconds = 10;
+	const char* policyName = "greedy";
+	uint32_t firstSeed = 1;
+	int maxMoves = 1000;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(args[i], "-socket") && (i + 1 < argc))
+		{
+			path = args[++i];
+		}
+		else if (!strcmp(args[i], "-connections") && (i + 1 < argc))
+		{
+			connections = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-sessions") && (i + 1 < argc))
+		{
+			sessions = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-seconds") && (i + 1 < argc))
+		{
+			seconds = atof(args[++i]);
+		}
+		else if (!strcmp(args[i], "-policy") && (i + 1 < argc))
+		{
+			policyName = args[++i];
+		}
+		else if (!strcmp(args[i], "-seed") && (i + 1 < argc))
+		{
+			firstSeed = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-maxmoves") && (i + 1 < argc))
+		{
+			maxMoves = atoi(args[++i]);
+		}
+		else
+		{
+			printf("Usage: %s [-socket path] [-connections N] [-sessions N] [-seconds N] [-policy name] [-seed N] [-maxmoves N]\n", args[0]);
+			return 1;
+		}
+	}
+
+	Policy* check = createPolicy(policyName);
+	if (!check)
+	{
+		printf("Unknown policy %s. Choose from:", policyName);
+		for (int i = 0; policyNames[i]; i++)
+		{
+			printf(" %s", policyNames[i]);
+		}
+		printf("\n");
+		return 1;
+	}
+	delete check;
+	if ((connections < 1) || (sessions < 1))
+	{
+		printf("There has to be at least one connection and one session.\n");
+		return 1;
+	}
+
+	loadRun run;
+	memset(&run.address, 0, sizeof(run.address));
+	run.address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(run.address.sun_path))
+	{
+		printf("The socket path %s is too long!\n", path);
+		return 1;
+	}
+	strcpy(run.address.sun_path, path);
+	run.policyName = policyName;
+	run.sessions = sessions;
+	run.maxMoves = maxMoves;
+	run.nextSeed = firstSeed;
+	run.stopping = false;
+	run.moves = run.requests = run.games = run.wins = run.rounds = run.mismatches = run.roundNs = 0;
+	run.failed = 0;
+
+	printf("Playing %s on %i connections, %u sessions each, for %.0fs\n", policyName, connections, sessions, seconds);
+	fflush(stdout);
+	auto start = std::chrono::steady_clock::now();
+	double startCpu = cpuSeconds();
+	std::vector<std::thread> workers;
+	for (int i = 0; i < connections; i++)
+	{
+		workers.push_back(std::thread(work, &run));
+	}
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	run.stopping = true;
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double cpu = cpuSeconds() - startCpu;
+
+	uint64_t moves = run.moves;
+	uint64_t rounds = run.rounds;
+	printf("%llu moves in %.1fs: %.0f moves/s, %.0f moves/s per load generator core\n",
+		(unsigned long long)moves, elapsed, moves / elapsed, cpu > 0 ? moves / cpu : 0.0);
+	printf("%llu games finished, %llu won. %llu rounds of %.0f requests, %.3f ms each.\n",
+		(unsigned long long)run.games.load(), (unsigned long long)run.wins.load(), (unsigned long long)rounds,
+		rounds ? (double)run.requests / rounds : 0.0, rounds ? run.roundNs / 1e6 / rounds : 0.0);
+	if (run.mismatches)
+	{
+		printf("%llu replies disagreed with the game played here!\n", (unsigned long long)run.mismatches.load());
+		return 2;
+	}
+	return run.failed ? 1 : 0;
+}
@@ -0,0 +1,64 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+#ifndef _PROTOCOL_H
+#define _PROTOCOL_H
+
+/*
+	What SDLitaireServer and its load generator say to each other over a Unix domain socket.
+	Both directions are a stream of fixed 8-byte frames, little-endian, with no other framing.
+	A client may send as many requests as it likes before reading, and gets one reply per request, in order.
+
+	Sessions are dealt from a seed the same way the window deals, so a client that knows
+	the seed can play its own copy alongside. Each reply carries the card the move turned face-up,
+	which lets it check the two still agree.
+	Session numbers belong to the connection, and closing it ends its sessions.
+*/
+
+#include <cstdint>
+
+#define SERVER_DEFAULT_SOCKET "/tmp/sdlitaire.sock"
+
+enum SERVER_OPS
+{
+	SERVER_NEW, /* session is the seed to deal. The reply has the new session's number. */
+	SERVER_DRAW, /* Stock to waste */
+	SERVER_RECYCLE, /* The whole waste back to the stock */
+	SERVER_MOVE, /* count face-up cards from one slot to another */
+	SERVER_CLOSE, /* Ends the session, so its number can be reused */
+	NUM_SERVER_OPS
+};
+
+enum SERVER_STATUS
+{
+	SERVER_OK,
+	SERVER_WON, /* The move was played and put the last card on the foundations */
+	SERVER_ILLEGAL, /* Nothing was played */
+	SERVER_NO_SESSION, /* Not a session this connection has open */
+	SERVER_FULL, /* The connection already has as many sessions as the server allows */
+	SERVER_BAD_OP
+};
+
+#define SERVER_NO_CARD 0xFF /* serverReply::card when nothing was turned over */
+
+struct serverRequest
+{
+	uint32_t session;
+	uint8_t op;
+	uint8_t from, to, count; /* Slots are klondike.h ranks. Only read for SERVER_MOVE. */
+};
+
+struct serverReply
+{
+	uint32_t session;
+	uint8_t op; /* The request's */
+	uint8_t status;
+	uint8_t card; /* The cardCode of what the move turned face-up, or SERVER_NO_CARD */
+	uint8_t foundationCards;
+};
+
+static_assert(sizeof(serverRequest) == 8, "serverRequest is sent as is");
+static_assert(sizeof(serverReply) == 8, "serverReply is sent as is");
+
+#endif /* _PROTOCOL_H */
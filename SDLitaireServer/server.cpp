@@ -0,0 +1,507 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+/*
+	Hosts thousands of games at once for bots to play, headless, over a Unix domain socket (protocol.h).
+	A session is only a Klondike, with no window, cards or textures behind it.
+	This only links the rules (klondike.cpp), not SDL, and needs Linux for epoll.
+
+	SDLitaireServer [-socket path] [-threads N] [-sessions N] [-report seconds]
+
+	Each thread runs its own epoll loop and accepts its own connections, so a connection
+	and its sessions only ever belong to one thread. Everything a read brings in is played
+	before the replies go back in one write.
+	Every -report seconds, and when stopped, it prints moves per second and per core,
+	which is moves over the CPU time the process used.
+*/
+
+#include "../SDLitaire/klondike.h"
+#include "protocol.h"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define READ_BYTES 65536 /* Read at a time, and so the most requests one batch plays. Nothing more is read until its replies are sent. */
+#define MAX_EVENTS 64
+#define WAIT_MS 100 /* How often the loops look for a stop */
+#define LISTEN_BACKLOG 128
+
+/* One client's games */
+struct connection
+{
+	int fd;
+	std::vector<Klondike> games; /* Indexed by session number */
+	std::vector<uint8_t> open;
+	std::vector<uint32_t> freeSessions;
+	uint32_t openSessions;
+
+	char input[READ_BYTES];
+	size_t inputUsed;
+	std::vector<serverReply> output;
+	size_t outputSent; /* Bytes */
+	bool waitingToWrite; /* Reading stops until output drains */
+};
+
+/* One thread's loop and what it has done */
+struct worker
+{
+	int epoll;
+	int listener;
+	uint32_t maxSessions;
+	std::atomic<uint64_t> moves, requests, batches, illegal, won;
+	std::atomic<uint32_t> connections, sessions;
+};
+
+volatile sig_atomic_t gStopping = 0;
+
+void stop(int)
+{
+	gStopping = 1;
+}
+
+serverReply play(connection& c, const serverRequest& request, uint32_t maxSessions)
+{
+	serverReply reply = { request.session, request.op, SERVER_OK, SERVER_NO_CARD, 0 };
+
+	if (request.op == SERVER_NEW)
+	{
+		if (c.openSessions >= maxSessions)
+		{
+			reply.status = SERVER_FULL;
+			return reply;
+		}
+		uint32_t session;
+		if (c.freeSessions.empty())
+		{
+			session = (uint32_t)c.games.size();
+			c.games.push_back(Klondike());
+			c.open.push_back(0);
+		}
+		else
+		{
+			session = c.freeSessions.back();
+			c.freeSessions.pop_back();
+		}
+		c.games[session].deal(request.session);
+		c.open[session] = 1;
+		c.openSessions++;
+		reply.session = session;
+		return reply;
+	}
+
+	if ((request.session >= c.games.size()) || !c.open[request.session])
+	{
+		reply.status = (request.op < NUM_SERVER_OPS) ? SERVER_NO_SESSION : SERVER_BAD_OP;
+		return reply;
+	}
+	Klondike& game = c.games[request.session];
+
+	klondikeMove move;
+	switch (request.op)
+	{
+	case SERVER_DRAW:
+		move.kind = MOVE_DRAW;
+		move.from = STOCK_RANK;
+		move.to = WASTE_RANK;
+		move.count = 1;
+		break;
+	case SERVER_RECYCLE:
+		move.kind = MOVE_RECYCLE;
+		move.from = WASTE_RANK;
+		move.to = STOCK_RANK;
+		move.count = (uint8_t)game.count(WASTE_RANK);
+		break;
+	case SERVER_MOVE:
+		move.kind = MOVE_CARDS;
+		move.from = request.from;
+		move.to = request.to;
+		move.count = request.count;
+		break;
+	case SERVER_CLOSE:
+		c.open[request.session] = 0;
+		c.freeSessions.push_back(request.session);
+		c.openSessions--;
+		return reply;
+	default:
+		reply.status = SERVER_BAD_OP;
+		return reply;
+	}
+
+	if (!game.isLegal(move))
+	{
+		reply.status = SERVER_ILLEGAL;
+		reply.foundationCards = (uint8_t)game.foundationCards();
+		return reply;
+	}
+	bool reveals = game.reveals(move);
+	game.apply(move);
+
+	if (move.kind == MOVE_DRAW)
+	{
+		reply.card = game.top(WASTE_RANK);
+	}
+	else if (reveals)
+	{
+		reply.card = game.top(move.from);
+	}
+	reply.foundationCards = (uint8_t)game.foundationCards();
+	if ((move.to >= FIRST_FOUNDATION) && (move.to < FIRST_TABLEAU) && game.isWon())
+	{
+		reply.status = SERVER_WON;
+	}
+	return reply;
+}
+
+/* Sends what it can. False if the connection is gone. */
+bool flush(connection& c)
+{
+	size_t total = c.output.size() * sizeof(serverReply);
+	while (c.outputSent < total)
+	{
+		ssize_t sent = send(c.fd, (const char*)c.output.data() + c.outputSent, total - c.outputSent, MSG_NOSIGNAL);
+		if (sent < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			return (errno == EAGAIN) || (errno == EWOULDBLOCK);
+		}
+		c.outputSent += (size_t)sent;
+	}
+	c.output.clear();
+	c.outputSent = 0;
+	return true;
+}
+
+/* Only wants to hear it can write while replies are backed up */
+void watch(worker& w, connection& c)
+{
+	bool waiting = c.outputSent < c.output.size() * sizeof(serverReply);
+	if (waiting == c.waitingToWrite)
+	{
+		return;
+	}
+	c.waitingToWrite = waiting;
+	epoll_event event;
+	event.events = waiting ? EPOLLOUT : EPOLLIN;
+	event.data.ptr = &c;
+	epoll_ctl(w.epoll, EPOLL_CTL_MOD, c.fd, &event);
+}
+
+void disconnect(worker& w, connection* c)
+{
+	epoll_ctl(w.epoll, EPOLL_CTL_DEL, c->fd, NULL);
+	close(c->fd);
+	w.sessions -= c->openSessions;
+	w.connections--;
+	delete c;
+}
+
+/* Plays every whole request that has come in. False if the connection is gone. */
+bool readRequests(worker& w, connection& c)
+{
+	ssize_t got = recv(c.fd, c.input + c.inputUsed, READ_BYTES - c.inputUsed, 0);
+	if (got <= 0)
+	{
+		return (got < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR));
+	}
+	c.inputUsed += (size_t)got;
+
+	/* Counted here rather than per move, so the hot loop touches no shared cache lines */
+	size_t whole = c.inputUsed / sizeof(serverRequest);
+	uint32_t openBefore = c.openSessions;
+	uint64_t moves = 0, illegal = 0, won = 0;
+	for (size_t i = 0; i < whole; i++)
+	{
+		serverRequest request;
+		memcpy(&request, c.input + i * sizeof(serverRequest), sizeof(request));
+		serverReply reply = play(c, request, w.maxSessions);
+		c.output.push_back(reply);
+		if ((reply.op >= SERVER_DRAW) && (reply.op <= SERVER_MOVE))
+		{
+			moves += reply.status <= SERVER_WON;
+			illegal += reply.status == SERVER_ILLEGAL;
+			won += reply.status == SERVER_WON;
+		}
+	}
+	w.moves += moves;
+	w.illegal += illegal;
+	w.won += won;
+	w.requests += whole;
+	w.batches++;
+	w.sessions += c.openSessions - openBefore;
+
+	/* Keep the part of a request that hasn't all arrived */
+	size_t used = whole * sizeof(serverRequest);
+	memmove(c.input, c.input + used, c.inputUsed - used);
+	c.inputUsed -= used;
+
+	if (!flush(c))
+	{
+		return false;
+	}
+	watch(w, c);
+	return true;
+}
+
+void acceptAll(worker& w)
+{
+	for (;;)
+	{
+		int fd = accept4(w.listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+			{
+				printf("A connection could not be accepted: %s\n", strerror(errno));
+			}
+			return;
+		}
+		connection* c = new connection;
+		c->fd = fd;
+		c->openSessions = 0;
+		c->inputUsed = 0;
+		c->outputSent = 0;
+		c->waitingToWrite = false;
+
+		epoll_event event;
+		event.events = EPOLLIN;
+		event.data.ptr = c;
+		if (epoll_ctl(w.epoll, EPOLL_CTL_ADD, fd, &event) < 0)
+		{
+			printf("A connection could not be watched: %s\n", strerror(errno));
+			close(fd);
+			delete c;
+			continue;
+		}
+		w.connections++;
+	}
+}
+
+/* Connections still open when the server stops go with the process */
+void work(worker* w)
+{
+	epoll_event events[MAX_EVENTS];
+	while (!gStopping)
+	{
+		int count = epoll_wait(w->epoll, events, MAX_EVENTS, WAIT_MS);
+		for (int i = 0; i < count; i++)
+		{
+			/* The listener is the only thing registered without a connection */
+			if (!events[i].data.ptr)
+			{
+				acceptAll(*w);
+				continue;
+			}
+
+			connection* c = (connection*)events[i].data.ptr;
+			bool alive = !(events[i].events & (EPOLLERR | EPOLLHUP)) || (events[i].events & EPOLLIN);
+			if (alive && (events[i].events & EPOLLOUT))
+			{
+				alive = flush(*c);
+				if (alive)
+				{
+					watch(*w, *c);
+				}
+			}
+			else if (alive && (events[i].events & EPOLLIN))
+			{
+				alive = readRequests(*w, *c);
+			}
+			if (!alive)
+			{
+				disconnect(*w, c);
+			}
+		}
+	}
+	close(w->epoll);
+}
+
+double cpuSeconds()
+{
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+double wallSeconds()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* What every worker did, for the report */
+struct serverTotals
+{
+	uint64_t moves, requests, batches, illegal, won;
+	uint32_t connections, sessions;
+};
+
+serverTotals total(std::vector<worker*>& workers)
+{
+	serverTotals t;
+	memset(&t, 0, sizeof(t));
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		t.moves += workers[i]->moves;
+		t.requests += workers[i]->requests;
+		t.batches += workers[i]->batches;
+		t.illegal += workers[i]->illegal;
+		t.won += workers[i]->won;
+		t.connections += workers[i]->connections;
+		t.sessions += workers[i]->sessions;
+	}
+	return t;
+}
+
+void report(const serverTotals& now, const serverTotals& before, double seconds, double cpu)
+{
+	uint64_t moves = now.moves - before.moves;
+	uint64_t requests = now.requests - before.requests;
+	uint64_t batches = now.batches - before.batches;
+	printf("%u connections, %u sessions: %.0f moves/s, %.0f moves/s per core, %.1f requests per batch, %llu won, %llu illegal\n",
+		now.connections, now.sessions, moves / seconds, cpu > 0 ? moves / cpu : 0.0,
+		batches ? (double)requests / batches : 0.0,
+		(unsigned long long)(now.won - before.won), (unsigned long long)(now.illegal - before.illegal));
+	fflush(stdout);
+}
+
+int main(int argc, char* args[])
+{
+	const char* path = SERVER_DEFAULT_SOCKET;
+	int threads = (int)std::thread::hardware_concurrency();
+	uint32_t maxSessions = 65536;
+	double reportSeconds = 5;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(args[i], "-socket") && (i + 1 < argc))
+		{
+			path = args[++i];
+		}
+		else if (!strcmp(args[i], "-threads") && (i + 1 < argc))
+		{
+			threads = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-sessions") && (i + 1 < argc))
+		{
+			maxSessions = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-report") && (i + 1 < argc))
+		{
+			reportSeconds = atof(args[++i]);
+		}
+		else
+		{
+			printf("Usage: %s [-socket path] [-threads N] [-sessions N] [-report seconds]\n", args[0]);
+			return 1;
+		}
+	}
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+	if (reportSeconds <= 0)
+	{
+		reportSeconds = 5;
+	}
+
+	sockaddr_un address;
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path))
+	{
+		printf("The socket path %s is too long!\n", path);
+		return 1;
+	}
+	strcpy(address.sun_path, path);
+
+	int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	unlink(path); /* Left over from a server that didn't stop cleanly */
+	if ((listener < 0) || (bind(listener, (sockaddr*)&address, sizeof(address)) < 0) || (listen(listener, LISTEN_BACKLOG) < 0))
+	{
+		printf("%s could not be listened on: %s\n", path, strerror(errno));
+		return 1;
+	}
+	signal(SIGINT, stop);
+	signal(SIGTERM, stop);
+
+	/* Every loop watches the listener, and only one is woken for each connection */
+	std::vector<worker*> workers;
+	std::vector<std::thread> running;
+	for (int t = 0; t < threads; t++)
+	{
+		worker* w = new worker;
+		w->epoll = epoll_create1(EPOLL_CLOEXEC);
+		w->listener = listener;
+		w->maxSessions = maxSessions;
+		w->moves = w->requests = w->batches = w->illegal = w->won = 0;
+		w->connections = w->sessions = 0;
+
+		epoll_event event;
+		event.events = EPOLLIN | EPOLLEXCLUSIVE;
+		event.data.ptr = NULL;
+		if ((w->epoll < 0) || (epoll_ctl(w->epoll, EPOLL_CTL_ADD, listener, &event) < 0))
+		{
+			printf("The event loop could not be set up: %s\n", strerror(errno));
+			return 1;
+		}
+		workers.push_back(w);
+		running.push_back(std::thread(work, w));
+	}
+	printf("Listening on %s with %i threads, %u sessions per connection at most\n", path, threads, maxSessions);
+	fflush(stdout);
+
+	double start = wallSeconds();
+	double startCpu = cpuSeconds();
+	double last = start;
+	double lastCpu = startCpu;
+	serverTotals before = total(workers);
+	while (!gStopping)
+	{
+		usleep(WAIT_MS * 1000);
+		double now = wallSeconds();
+		if (now - last < reportSeconds)
+		{
+			continue;
+		}
+		double cpu = cpuSeconds();
+		serverTotals totals = total(workers);
+		report(totals, before, now - last, cpu - lastCpu);
+		before = totals;
+		last = now;
+		lastCpu = cpu;
+	}
+
+	for (size_t t = 0; t < running.size(); t++)
+	{
+		running[t].join();
+	}
+	close(listener);
+	unlink(path);
+
+	serverTotals none;
+	memset(&none, 0, sizeof(none));
+	printf("\nIn all, ");
+	report(total(workers), none, wallSeconds() - start, cpuSeconds() - startCpu);
+	for (size_t t = 0; t < workers.size(); t++)
+	{
+		delete workers[t];
+	}
+	return 0;
+}
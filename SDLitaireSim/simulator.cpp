@@ -0,0 +1,253 @@
+/*
+	This awesome code was written by Chris Roxby.
+	This project was created using SDL.
+*/
+
+/*
+	Plays huge numbers of deals with automated policies and reports how they do.
+	This only links the rules (klondike.cpp and policy.cpp), not SDL.
+
+	SDLitaireSim [-games N] [-threads N] [-seed N] [-maxmoves N] [-policy name]... [-log file]
+
+	-log writes every game to a columnar move log (movelog.cpp) for SDLitaireLog to scan.
+*/
+
+#include "../SDLitaire/klondike.h"
+#include "../SDLitaire/policy.h"
+#include "../SDLitaire/movelog.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define GAMES_PER_CLAIM 1024 /* Games a worker takes at a time */
+
+/* What one worker saw */
+struct policyStats
+{
+	uint64_t games, wins, moves, stockPasses;
+};
+
+/* Everything the workers share for one policy */
+struct simulation
+{
+	const char* policyName;
+	uint64_t games;
+	uint32_t firstSeed;
+	int maxMoves;
+	std::atomic<uint64_t> nextGame;
+	MoveLogWriter* log; /* Shared by every worker, or NULL */
+	std::mutex logLock;
+};
+
+/* A claim's games, held until they can be logged together */
+struct playedGame
+{
+	uint32_t seed;
+	bool won;
+	uint32_t firstMove, moves;
+};
+
+void work(simulation* sim, policyStats* stats)
+{
+	Policy* policy = createPolicy(sim->policyName);
+	Klondike game;
+	std::vector<playedGame> played;
+	std::vector<klondikeMove> moves;
+
+	for (;;)
+	{
+		uint64_t first = sim->nextGame.fetch_add(GAMES_PER_CLAIM);
+		if (first >= sim->games)
+		{
+			break;
+		}
+		uint64_t last = first + GAMES_PER_CLAIM < sim->games ? first + GAMES_PER_CLAIM : sim->games;
+
+		for (uint64_t i = first; i < last; i++)
+		{
+			/* Every policy plays the same deals, and the policy's dice depend only on the deal */
+			uint32_t seed = sim->firstSeed + (uint32_t)i;
+			Random random(((uint64_t)seed << 32) | 0x5EED);
+			game.deal(seed);
+
+			uint32_t firstMove = (uint32_t)moves.size();
+			bool won = playGame(game, *policy, random, sim->maxMoves, sim->log ? &moves : NULL);
+			if (won)
+			{
+				stats->wins++;
+			}
+			if (sim->log)
+			{
+				playedGame record = { seed, won, firstMove, (uint32_t)moves.size() - firstMove };
+				played.push_back(record);
+			}
+			stats->games++;
+			stats->moves += game.getMoves();
+			stats->stockPasses += game.getStockPasses();
+		}
+
+		if (sim->log)
+		{
+			/* Simulated games take no time, so every move is at 0 ms */
+			std::lock_guard<std::mutex> hold(sim->logLock);
+			for (size_t g = 0; g < played.size(); g++)
+			{
+				sim->log->beginGame(played[g].seed);
+				for (uint32_t m = 0; m < played[g].moves; m++)
+				{
+					sim->log->addMove(moves[played[g].firstMove + m], 0);
+				}
+				sim->log->endGame(played[g].won);
+			}
+			played.clear();
+			moves.clear();
+		}
+	}
+	delete policy;
+}
+
+/* 95% Wilson score interval */
+void wilson(uint64_t wins, uint64_t games, double* low, double* high)
+{
+	const double z = 1.96;
+	double n = (double)games;
+	double p = wins / n;
+	double center = (p + z * z / (2 * n)) / (1 + z * z / n);
+	double spread = z * sqrt(p * (1 - p) / n + z * z / (4 * n * n)) / (1 + z * z / n);
+	*low = center - spread;
+	*high = center + spread;
+}
+
+int main(int argc, char* args[])
+{
+	uint64_t games = 1000000;
+	int threads = (int)std::thread::hardware_concurrency();
+	uint32_t firstSeed = 1;
+	int maxMoves = 1000;
+	std::vector<const char*> policies;
+	const char* logPath = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(args[i], "-games") && (i + 1 < argc))
+		{
+			games = strtoull(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-threads") && (i + 1 < argc))
+		{
+			threads = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-seed") && (i + 1 < argc))
+		{
+			firstSeed = (uint32_t)strtoul(args[++i], NULL, 10);
+		}
+		else if (!strcmp(args[i], "-maxmoves") && (i + 1 < argc))
+		{
+			maxMoves = atoi(args[++i]);
+		}
+		else if (!strcmp(args[i], "-policy") && (i + 1 < argc))
+		{
+			policies.push_back(args[++i]);
+		}
+		else if (!strcmp(args[i], "-log") && (i + 1 < argc))
+		{
+			logPath = args[++i];
+		}
+		else
+		{
+			printf("Usage: %s [-games N] [-threads N] [-seed N] [-maxmoves N] [-policy name]... [-log file]\n", args[0]);
+			return 1;
+		}
+	}
+
+	if (policies.empty())
+	{
+		for (int i = 0; policyNames[i]; i++)
+		{
+			policies.push_back(policyNames[i]);
+		}
+	}
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+	if (!games)
+	{
+		return 0;
+	}
+
+	MoveLogWriter log;
+	if (logPath && !log.open(logPath))
+	{
+		return 1;
+	}
+
+	printf("%llu deals from seed %u on %i threads\n\n", (unsigned long long)games, firstSeed, threads);
+	printf("%-18s %9s %18s %10s %12s %12s %14s\n",
+		"Policy", "Win rate", "95% interval", "Avg moves", "Avg passes", "Games/s", "Games/s/core");
+
+	for (size_t p = 0; p < policies.size(); p++)
+	{
+		Policy* check = createPolicy(policies[p]);
+		if (!check)
+		{
+			printf("Unknown policy %s\n", policies[p]);
+			continue;
+		}
+		delete check;
+
+		simulation sim;
+		sim.policyName = policies[p];
+		sim.games = games;
+		sim.firstSeed = firstSeed;
+		sim.maxMoves = maxMoves;
+		sim.nextGame = 0;
+		sim.log = logPath ? &log : NULL;
+
+		/* Keep each worker's counters on their own cache line */
+		struct alignas(64) paddedStats { policyStats stats; };
+		std::vector<paddedStats> stats(threads);
+		std::vector<std::thread> workers;
+
+		auto start = std::chrono::steady_clock::now();
+		for (int t = 0; t < threads; t++)
+		{
+			stats[t].stats = policyStats();
+			workers.push_back(std::thread(work, &sim, &stats[t].stats));
+		}
+		for (size_t t = 0; t < workers.size(); t++)
+		{
+			workers[t].join();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		policyStats total = policyStats();
+		for (int t = 0; t < threads; t++)
+		{
+			total.games += stats[t].stats.games;
+			total.wins += stats[t].stats.wins;
+			total.moves += stats[t].stats.moves;
+			total.stockPasses += stats[t].stats.stockPasses;
+		}
+
+		double low, high;
+		wilson(total.wins, total.games, &low, &high);
+		double rate = total.games / seconds;
+		printf("%-18s %8.3f%% %8.3f%%-%7.3f%% %10.1f %12.2f %12.0f %14.0f\n",
+			policies[p], 100.0 * total.wins / total.games, 100 * low, 100 * high,
+			(double)total.moves / total.games, (double)total.stockPasses / total.games,
+			rate, rate / threads);
+	}
+
+	if (logPath && !log.close())
+	{
+		return 1;
+	}
+	return 0;
+}